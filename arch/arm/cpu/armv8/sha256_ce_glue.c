@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 backend using the ARMv8 Cryptography Extensions
+ */
+
+#include <common.h>
+#include <hash.h>
+
+void sha256_ce_blocks(void *state, const uint8_t *data, unsigned int blocks);
+
+static bool sha256_ce_probe(void)
+{
+	u64 isar0;
+
+	/* ID_AA64ISAR0_EL1.SHA2 is non-zero if SHA256H and friends exist */
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return ((isar0 >> 12) & 0xf) != 0;
+}
+
+U_BOOT_HASH_BACKEND(sha256_ce) = {
+	.algo		= "sha256",
+	.name		= "armv8-ce",
+	.priority	= 100,
+	.probe		= sha256_ce_probe,
+	.blocks		= sha256_ce_blocks,
+};
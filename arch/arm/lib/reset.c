@@ -21,6 +21,7 @@
  */
 
 #include <common.h>
+#include <console.h>
 
 __weak void reset_misc(void)
 {
@@ -29,6 +30,7 @@ __weak void reset_misc(void)
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	puts ("resetting ...\n");
+	console_flush();
 
 	udelay (50000);				/* wait 50 ms */
 
@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <console.h>
 #include <cpu.h>
 #include <dm.h>
 #include <errno.h>
@@ -30,6 +31,7 @@ int checkboard(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	console_flush();
 	disable_interrupts();
 	/* indirect call to go beyond 256MB limitation of toolchain */
 	nios2_callr(gd->arch.reset_addr);
@@ -9,8 +9,102 @@
 #ifndef __ETH_H
 #define __ETH_H
 
+#include <net.h>
+
+struct udevice;
+
 void sandbox_eth_disable_response(int index, bool disable);
 
 void sandbox_eth_skip_timeout(void);
 
+/**
+ * sandbox_eth_tx_hand_f() - Handle a packet sent on a sandbox Ethernet device
+ *
+ * The handler may queue replies with sandbox_eth_recv_queue().
+ *
+ * @dev:	Device the packet was sent on
+ * @pkt:	Packet, starting with the Ethernet header
+ * @len:	Length of the packet
+ * @return 0 if OK, -ve on error
+ */
+typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
+				  unsigned int len);
+
+/**
+ * sandbox_eth_set_tx_handler() - Set the handler for sent packets
+ *
+ * @index:	The alias index (also DM seq number)
+ * @handler:	Handler to use, or NULL for the default, which answers ARP
+ *		requests and pings
+ */
+void sandbox_eth_set_tx_handler(int index, sandbox_eth_tx_hand_f *handler);
+
+/**
+ * sandbox_eth_set_csum_offload() - Set the checksums the device offloads
+ *
+ * The device then fills in these checksums on sent packets and drops
+ * received packets where they are wrong, as hardware would.
+ *
+ * @index:	The alias index (also DM seq number)
+ * @flags:	Mask of enum eth_csum_offload, 0 for none
+ */
+void sandbox_eth_set_csum_offload(int index, int flags);
+
+/**
+ * sandbox_eth_recv_queue() - Add a packet to be received
+ *
+ * @dev:	Device to receive the packet
+ * @packet:	Packet, starting with the Ethernet header
+ * @length:	Length of the packet
+ * @return 0 if OK, -ENOSPC if the receive queue is full, -EBADMSG if the
+ *	device offloads a checksum which is wrong
+ */
+int sandbox_eth_recv_queue(struct udevice *dev, const void *packet,
+			   int length);
+
+/**
+ * sandbox_eth_get_placed() - Get the number of packets placed by the stack
+ *
+ * A received packet is placed when the network stack says where its payload
+ * should go, see net_rx_place(). The count is reset by each call.
+ *
+ * @index:	The alias index (also DM seq number)
+ * @return number of packets placed since the last call
+ */
+int sandbox_eth_get_placed(int index);
+
+/**
+ * sandbox_eth_get_fake_host() - Get the addresses of the mocked machine
+ *
+ * @dev:	Device to check
+ * @hwaddr:	Returns the MAC address (ARP_HLEN bytes)
+ * @ipaddr:	Returns the IP address, as learnt from the last ARP request
+ */
+void sandbox_eth_get_fake_host(struct udevice *dev, uchar *hwaddr,
+			       struct in_addr *ipaddr);
+
+/**
+ * sandbox_eth_arp_req_to_reply() - Reply to an ARP request
+ *
+ * @dev:	Device the request was sent on
+ * @packet:	Packet that was sent
+ * @len:	Length of the packet
+ * @return 0 if a reply was queued, -EAGAIN if the packet is not an ARP
+ *	request, -ENOSPC if the receive queue is full
+ */
+int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
+				 unsigned int len);
+
+/**
+ * sandbox_eth_ping_req_to_reply() - Reply to an ICMP echo request
+ *
+ * @dev:	Device the request was sent on
+ * @packet:	Packet that was sent
+ * @len:	Length of the packet
+ * @return 0 if a reply was queued, -EAGAIN if the packet is not a ping,
+ *	-ENOSPC if the receive queue is full
+ */
+int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
+				  unsigned int len);
+
 #endif /* __ETH_H */
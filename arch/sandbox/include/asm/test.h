@@ -90,4 +90,23 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_serial_set_tx_busy() - Make the UART refuse output
+ *
+ * While busy, the puts() method returns -EAGAIN so that output stays in the
+ * uclass TX buffer (CONFIG_SERIAL_TX_BUFFER).
+ *
+ * @dev:	Serial device to update
+ * @busy:	true to refuse output, false to accept it
+ */
+void sandbox_serial_set_tx_busy(struct udevice *dev, bool busy);
+
+/**
+ * sandbox_serial_get_tx_count() - Get the number of characters sent by puts()
+ *
+ * @dev:	Serial device to check
+ * @return number of characters written through the puts() method
+ */
+uint sandbox_serial_get_tx_count(struct udevice *dev);
+
 #endif
@@ -13,36 +13,73 @@ static int blkc_show(cmd_tbl_t *cmdtp, int flag,
 		     int argc, char * const argv[])
 {
 	struct block_cache_stats stats;
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+	struct blk_readahead_stats ra;
+#endif
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
+	       "partial hits: %u\n"
 	       "misses: %u\n"
+	       "evictions: %u\n"
 	       "entries: %u\n"
-	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "cache size: %lu bytes\n"
+	       "line size: %u bytes, %u ways\n"
+	       "max blocks/read: %u\n",
+	       stats.hits, stats.partial_hits, stats.misses, stats.evictions,
+	       stats.entries, stats.max_entries, stats.size, stats.line_size,
+	       stats.ways, stats.max_blocks_per_entry);
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+	blkra_stats(&ra);
+	printf("read-ahead hits: %lu blocks\n"
+	       "read-ahead requests: %u (%lu blocks)\n"
+	       "read-ahead window reductions: %u\n"
+	       "max read-ahead: %lu bytes\n",
+	       ra.hits, ra.reads, ra.blocks, ra.shrinks, ra.max_size);
+#endif
 	return 0;
 }
 
 static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 			  int argc, char * const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
+	unsigned long size;
+	unsigned max_blocks;
+
 	if (argc != 3)
 		return CMD_RET_USAGE;
 
-	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	size = simple_strtoul(argv[1], 0, 0);
+	max_blocks = simple_strtoul(argv[2], 0, 0);
+	blkcache_configure(size, max_blocks);
+	printf("changed to %lu bytes, caching reads of up to %u blocks\n",
+	       size, max_blocks);
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+static int blkc_readahead(cmd_tbl_t *cmdtp, int flag,
+			  int argc, char * const argv[])
+{
+	unsigned long size;
+
+	if (argc != 2)
+		return CMD_RET_USAGE;
+
+	size = simple_strtoul(argv[1], 0, 0);
+	blkra_configure(size);
+	printf("changed max read-ahead to %lu bytes\n", size);
 	return 0;
 }
+#endif
 
 static cmd_tbl_t cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
 	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+	U_BOOT_CMD_MKENT(readahead, 2, 0, blkc_readahead, "", ""),
+#endif
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -82,5 +119,9 @@ U_BOOT_CMD(
 	blkcache, 4, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"blkcache configure size blocks - set cache size in bytes and\n"
+	"    largest read (in blocks) to cache"
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+	"\nblkcache readahead size - set max read-ahead in bytes (0 = off)"
+#endif
 );
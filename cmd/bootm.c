@@ -12,8 +12,10 @@
 #include <command.h>
 #include <environment.h>
 #include <errno.h>
+#include <fs.h>
 #include <image.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <nand.h>
 #include <asm/byteorder.h>
 #include <linux/ctype.h>
@@ -195,6 +197,87 @@ U_BOOT_CMD(
 	"boot application image from memory", bootm_help_text
 );
 
+#if defined(CONFIG_CMD_BOOTFIT)
+/*******************************************************************/
+/* bootfit - boot a FIT from a filesystem, streaming in the kernel */
+/*******************************************************************/
+struct bootfit_file {
+	const char *filename;
+	loff_t pos;
+};
+
+/* The file stays open while the FIT is read, see fs_file_open() */
+static long bootfit_read(struct image_stream *st, void *buf, ulong len)
+{
+	struct bootfit_file *file = st->priv;
+	loff_t actread;
+
+	if (fs_file_read(file->filename, map_to_sysmem(buf), file->pos, len,
+			 &actread))
+		return -EIO;
+	file->pos += actread;
+
+	return actread;
+}
+
+static int do_bootfit(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	struct bootfit_file file;
+	struct image_stream st = {
+		.read = bootfit_read,
+		.priv = &file,
+	};
+	const char *config = NULL;
+	char addr_str[64];
+	char *bootm_argv[] = { "bootm", addr_str, NULL };
+	loff_t size;
+	int ret;
+
+	if (argc < 4)
+		return CMD_RET_USAGE;
+	file.filename = argv[3];
+	file.pos = 0;
+	if (argc > 4)
+		config = argv[4];
+
+	if (fs_set_blk_dev(argv[1], argv[2], FS_TYPE_ANY))
+		return CMD_RET_FAILURE;
+	if (fs_file_open(file.filename, &size)) {
+		printf("** File not found %s **\n", file.filename);
+		return CMD_RET_FAILURE;
+	}
+	st.size = size;
+
+	ret = fit_image_load_stream(&st, load_addr, config,
+				    env_get_yesno("verify"));
+	fs_file_close();
+	if (ret)
+		return CMD_RET_FAILURE;
+	env_set_hex("filesize", size);
+
+	if (config)
+		snprintf(addr_str, sizeof(addr_str), "%lx#%s", load_addr,
+			 config);
+	else
+		snprintf(addr_str, sizeof(addr_str), "%lx", load_addr);
+
+	return do_bootm(cmdtp, flag, 2, bootm_argv);
+}
+
+U_BOOT_CMD(
+	bootfit,	5,	1,	do_bootfit,
+	"boot a FIT image from a filesystem",
+	"<interface> <dev[:part]> <filename> [config]\n"
+	"    - Read FIT image 'filename' from partition 'part' on device type\n"
+	"      'interface' instance 'dev' to $loadaddr and boot it with\n"
+	"      bootm. A kernel stored outside the FIT structure (mkimage -E)\n"
+	"      is decompressed to its load address while it is being read.\n"
+	"      'config' selects the configuration, otherwise the default is\n"
+	"      used."
+);
+#endif
+
 /*******************************************************************/
 /* bootd - boot default image */
 /*******************************************************************/
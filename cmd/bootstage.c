@@ -4,6 +4,7 @@
  */
 
 #include <common.h>
+#include <mapmem.h>
 
 static int do_bootstage_report(cmd_tbl_t *cmdtp, int flag, int argc,
 			       char * const argv[])
@@ -57,8 +58,35 @@ static int do_bootstage_stash(cmd_tbl_t *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int do_bootstage_json(cmd_tbl_t *cmdtp, int flag, int argc,
+			     char * const argv[])
+{
+	ulong base, size;
+	char *buf;
+	int len;
+
+	if (argc < 2) {
+		bootstage_export_json(NULL, 0);
+		return 0;
+	}
+	if (argc < 3 || get_base_size(argc, argv, &base, &size))
+		return CMD_RET_USAGE;
+
+	buf = map_sysmem(base, size);
+	len = bootstage_export_json(buf, size);
+	unmap_sysmem(buf);
+	if (len > size) {
+		printf("Not enough space: need %#x bytes\n", len);
+		return 1;
+	}
+	env_set_hex("filesize", len);
+
+	return 0;
+}
+
 static cmd_tbl_t cmd_bootstage_sub[] = {
 	U_BOOT_CMD_MKENT(report, 2, 1, do_bootstage_report, "", ""),
+	U_BOOT_CMD_MKENT(json, 4, 1, do_bootstage_json, "", ""),
 	U_BOOT_CMD_MKENT(stash, 4, 0, do_bootstage_stash, "", ""),
 	U_BOOT_CMD_MKENT(unstash, 4, 0, do_bootstage_stash, "", ""),
 };
@@ -89,6 +117,8 @@ U_BOOT_CMD(bootstage, 4, 1, do_boostage,
 	"Boot stage command",
 	" - check boot progress and timing\n"
 	"report                      - Print a report\n"
+	"json [<start> <size>]       - Write trace-event JSON to the console\n"
+	"                              or to memory, setting 'filesize'\n"
 	"stash [<start> [<size>]]    - Stash data into memory\n"
 	"unstash [<start> [<size>]]  - Unstash data from memory"
 );
@@ -77,6 +77,62 @@ static int create_call_list(int argc, char * const argv[])
 	return 0;
 }
 
+static int create_agg_list(int argc, char * const argv[])
+{
+	size_t buff_size, avail, buff_ptr, used;
+	unsigned int needed;
+	char *buff;
+	int err;
+
+	if (get_args(argc, argv, &buff, &buff_ptr, &buff_size))
+		return -1;
+
+	/* Write the function stats followed by the samples */
+	avail = buff_size - buff_ptr;
+	err = trace_list_stats(buff + buff_ptr, avail, &needed);
+	used = min(avail, (size_t)needed);
+	if (!err) {
+		avail -= used;
+		err = trace_list_samples(buff + buff_ptr + used, avail,
+					 &needed);
+		used += min(avail, (size_t)needed);
+	}
+	if (err)
+		printf("Error: truncated (%#x bytes needed)\n", needed);
+	printf("Aggregate trace dumped to %08lx, size %#zx\n",
+	       (ulong)map_to_sysmem(buff + buff_ptr), used);
+
+	env_set_hex("profbase", map_to_sysmem(buff));
+	env_set_hex("profsize", buff_size);
+	env_set_hex("profoffset", buff_ptr + used);
+
+	return 0;
+}
+
+static int set_mode(int argc, char * const argv[])
+{
+	static const char *const mode_name[TRACE_MODE_COUNT] = {
+		"calls", "agg", "sample",
+	};
+	uint sample_us = 0;
+	int mode;
+
+	if (argc < 3)
+		return -1;
+	for (mode = 0; mode < TRACE_MODE_COUNT; mode++) {
+		if (!strcmp(argv[2], mode_name[mode]))
+			break;
+	}
+	if (mode == TRACE_MODE_COUNT)
+		return -1;
+	if (argc > 3)
+		sample_us = simple_strtoul(argv[3], NULL, 10);
+	if (trace_set_mode(mode, sample_us))
+		printf("Trace is disabled\n");
+
+	return 0;
+}
+
 int do_trace(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	const char *cmd = argc < 2 ? NULL : argv[1];
@@ -98,6 +154,14 @@ int do_trace(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		if (create_func_list(argc, argv))
 			return cmd_usage(cmdtp);
 		break;
+	case 'a':
+		if (create_agg_list(argc, argv))
+			return cmd_usage(cmdtp);
+		break;
+	case 'm':
+		if (set_mode(argc, argv))
+			return cmd_usage(cmdtp);
+		break;
 	case 's':
 		trace_print_stats();
 		break;
@@ -116,5 +180,8 @@ U_BOOT_CMD(
 	"trace resume                       - resume tracing\n"
 	"trace funclist [<addr> <size>]     - dump function list into buffer\n"
 	"trace calls  [<addr> <size>]       "
-		"- dump function call trace into buffer"
+		"- dump function call trace into buffer\n"
+	"trace agg  [<addr> <size>]         "
+		"- dump function stats and samples into buffer\n"
+	"trace mode calls|agg|sample [<us>] - select what is recorded"
 );
@@ -489,6 +489,21 @@ static int reserve_bootstage(void)
 	return 0;
 }
 
+static int reserve_log_ring(void)
+{
+#ifdef CONFIG_LOG_RING
+	int size = log_ring_get_size();
+
+	gd->start_addr_sp -= size;
+	gd->start_addr_sp &= ~0xf;
+	gd->new_log_ring = map_sysmem(gd->start_addr_sp, size);
+	debug("Reserving %#x Bytes for log ring at: %08lx\n", size,
+	      gd->start_addr_sp);
+#endif
+
+	return 0;
+}
+
 __weak int arch_reserve_stacks(void)
 {
 	return 0;
@@ -613,6 +628,21 @@ static int reloc_bootstage(void)
 	return 0;
 }
 
+static int reloc_log_ring(void)
+{
+#ifdef CONFIG_LOG_RING
+	if (gd->flags & GD_FLG_SKIP_RELOC)
+		return 0;
+	if (gd->new_log_ring) {
+		debug("Moving log ring from %p to %p\n", gd->log_ring,
+		      gd->new_log_ring);
+		log_ring_move(gd->new_log_ring);
+	}
+#endif
+
+	return 0;
+}
+
 static int setup_reloc(void)
 {
 	if (gd->flags & GD_FLG_SKIP_RELOC) {
@@ -857,6 +887,7 @@ static const init_fnc_t init_sequence_f[] = {
 	reserve_global_data,
 	reserve_fdt,
 	reserve_bootstage,
+	reserve_log_ring,
 	reserve_arch,
 	reserve_stacks,
 	dram_init_banksize,
@@ -876,6 +907,7 @@ static const init_fnc_t init_sequence_f[] = {
 	INIT_FUNC_WATCHDOG_RESET
 	reloc_fdt,
 	reloc_bootstage,
+	reloc_log_ring,
 	setup_reloc,
 #if defined(CONFIG_X86) || defined(CONFIG_ARC)
 	copy_uboot_to_ram,
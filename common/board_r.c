@@ -876,6 +876,9 @@ void board_init_r(gd_t *new_gd, ulong dest_addr)
 		init_sequence_r[i] += gd->reloc_off;
 #endif
 
+	/* Any init function in board_f which relocated U-Boot did not return */
+	bootstage_span_end_all();
+
 	if (initcall_run_list(init_sequence_r))
 		hang();
 
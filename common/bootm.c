@@ -8,6 +8,7 @@
 #include <common.h>
 #include <bootstage.h>
 #include <bzlib.h>
+#include <console.h>
 #include <errno.h>
 #include <fdt_support.h>
 #include <lmb.h>
@@ -442,6 +443,124 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 	return 0;
 }
 
+#if defined(CONFIG_FIT_STREAM) && !defined(USE_HOSTCC)
+int bootm_decomp_stream(int comp, ulong load, int type, void *load_buf,
+			ulong unc_len, struct image_stream *src,
+			ulong image_len, ulong *load_end)
+{
+	ulong chunk, done, size = 0;
+	struct gunzip_stream *gz = NULL;
+	struct ulz4_stream *lz = NULL;
+	void *buf;
+	int ret = 0;
+
+	unc_len = min_t(ulong, unc_len, CONFIG_SYS_BOOTM_LEN);
+	switch (comp) {
+	case IH_COMP_NONE:
+		break;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		gz = gunzip_stream_start(load_buf, unc_len);
+		if (!gz)
+			return -ENOMEM;
+		break;
+#endif
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+		lz = ulz4fn_stream_start(load_buf, unc_len);
+		if (!lz)
+			return -ENOMEM;
+		break;
+#endif
+	default:
+		return -ENOSYS;
+	}
+
+	*load_end = load;
+	print_decomp_msg(comp, type, false);
+
+	if (comp == IH_COMP_NONE) {
+		if (image_len > unc_len)
+			return handle_decomp_error(comp, image_len, unc_len, 1);
+		ret = image_stream_read(src, load_buf, image_len);
+		if (ret)
+			return ret;
+		*load_end = load + image_len;
+		puts("OK\n");
+
+		return 0;
+	}
+
+	/*
+	 * Only one chunk of compressed data is held at a time and it is
+	 * decompressed while still in the cache, rather than reading the
+	 * whole image to memory and then going over it all again.
+	 */
+	chunk = min_t(ulong, image_len, CONFIG_FIT_STREAM_BUF_SIZE);
+	buf = malloc(chunk);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (done = 0; done < image_len; done += chunk) {
+		chunk = min(chunk, image_len - done);
+		ret = image_stream_read(src, buf, chunk);
+		if (ret)
+			break;
+		/* Anything after the end of the stream is still read */
+		if (IS_ENABLED(CONFIG_GZIP) && gz)
+			ret = gunzip_stream_feed(gz, buf, chunk);
+		else if (IS_ENABLED(CONFIG_LZ4) && lz)
+			ret = ulz4fn_stream_feed(lz, buf, chunk);
+		if (ret < 0)
+			break;
+	}
+	free(buf);
+
+out:
+	if (IS_ENABLED(CONFIG_GZIP) && gz) {
+		if (gunzip_stream_finish(gz, &size) && !ret)
+			ret = -EIO;
+	} else if (IS_ENABLED(CONFIG_LZ4) && lz) {
+		size_t lz_size;
+
+		if (ulz4fn_stream_finish(lz, &lz_size) && !ret)
+			ret = -EINVAL;
+		size = lz_size;
+	}
+	if (ret < 0)
+		return handle_decomp_error(comp, size, unc_len, ret);
+	*load_end = load + size;
+
+	puts("OK\n");
+
+	return 0;
+}
+
+static bool bootm_os_streamed(bootm_headers_t *images, ulong load,
+			      ulong *load_end)
+{
+	ulong streamed_load;
+
+	if (!images->fit_hdr_os ||
+	    !fit_image_streamed(images->fit_hdr_os, images->fit_noffset_os,
+				&streamed_load, load_end))
+		return false;
+	fit_image_stream_done();
+	if (streamed_load != load)
+		return false;
+	printf("   Kernel already loaded from stream ... OK\n");
+
+	return true;
+}
+#elif !defined(USE_HOSTCC)
+static bool bootm_os_streamed(bootm_headers_t *images, ulong load,
+			      ulong *load_end)
+{
+	return false;
+}
+#endif
+
 #ifndef USE_HOSTCC
 static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 {
@@ -460,9 +579,13 @@ static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
-	err = bootm_decomp_image(os.comp, load, os.image_start, os.type,
-				 load_buf, image_buf, image_len,
-				 CONFIG_SYS_BOOTM_LEN, &load_end);
+	if (bootm_os_streamed(images, load, &load_end))
+		err = 0;
+	else
+		err = bootm_decomp_image(os.comp, load, os.image_start,
+					 os.type, load_buf, image_buf,
+					 image_len, CONFIG_SYS_BOOTM_LEN,
+					 &load_end);
 	if (err) {
 		bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
 		return err;
@@ -729,9 +852,11 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	}
 
 	/* Now run the OS! We hope this doesn't return */
-	if (!ret && (states & BOOTM_STATE_OS_GO))
+	if (!ret && (states & BOOTM_STATE_OS_GO)) {
+		console_flush();
 		ret = boot_selected_os(argc, argv, BOOTM_STATE_OS_GO,
 				images, boot_fn);
+	}
 
 	/* Deal with any fallout */
 err:
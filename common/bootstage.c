@@ -18,6 +18,7 @@ DECLARE_GLOBAL_DATA_PTR;
 
 enum {
 	RECORD_COUNT = CONFIG_VAL(BOOTSTAGE_RECORD_COUNT),
+	SPAN_COUNT = CONFIG_VAL(BOOTSTAGE_SPAN_COUNT),
 };
 
 struct bootstage_record {
@@ -28,10 +29,28 @@ struct bootstage_record {
 	enum bootstage_id id;
 };
 
+/*
+ * A span covers a stretch of time between bootstage_span_begin() and
+ * bootstage_span_end(). Spans nest: each one records the span which was open
+ * when it began.
+ */
+struct bootstage_span {
+	uint32_t start_us;
+	uint32_t end_us;	/* 0 while the span is still open */
+	const char *name;	/* NULL for an init function */
+	ulong func;		/* Unrelocated address of init function */
+	short parent;		/* Index of enclosing span, or -1 if none */
+	short depth;		/* Number of enclosing spans */
+};
+
 struct bootstage_data {
 	uint rec_count;
 	uint next_id;
 	struct bootstage_record record[RECORD_COUNT];
+	uint span_count;
+	uint span_lost;		/* Spans not recorded as the table was full */
+	int span_cur;		/* Innermost open span, or -1 if none */
+	struct bootstage_span span[SPAN_COUNT];
 };
 
 enum {
@@ -59,6 +78,10 @@ int bootstage_relocate(void)
 	debug("Relocating %d records\n", data->rec_count);
 	for (i = 0; i < data->rec_count; i++)
 		data->record[i].name = strdup(data->record[i].name);
+	for (i = 0; i < data->span_count; i++) {
+		if (data->span[i].name)
+			data->span[i].name = strdup(data->span[i].name);
+	}
 
 	return 0;
 }
@@ -195,6 +218,76 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+static int add_span(const char *name, ulong func)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_span *span;
+	int parent;
+
+	/* Init functions run before bootstage is set up are not recorded */
+	if (!data)
+		return -ENOSYS;
+	if (data->span_count >= SPAN_COUNT) {
+		data->span_lost++;
+		return -ENOSPC;
+	}
+	parent = data->span_cur;
+	span = &data->span[data->span_count];
+	span->start_us = timer_get_boot_us();
+	span->end_us = 0;
+	span->name = name;
+	span->func = func;
+	span->parent = parent;
+	span->depth = parent == -1 ? 0 : data->span[parent].depth + 1;
+	data->span_cur = data->span_count++;
+
+	return data->span_cur;
+}
+
+int bootstage_span_begin(const char *name)
+{
+	return add_span(name, 0);
+}
+
+int bootstage_span_begin_func(ulong func)
+{
+	return add_span(NULL, func);
+}
+
+void bootstage_span_end(int span_id)
+{
+	struct bootstage_data *data = gd->bootstage;
+	uint32_t now;
+	int i;
+
+	if (!data || span_id < 0 || span_id >= data->span_count ||
+	    data->span[span_id].end_us)
+		return;
+
+	/* Close any inner spans left open, e.g. on an error path */
+	now = timer_get_boot_us();
+	for (i = data->span_cur; i != -1; i = data->span[i].parent) {
+		data->span[i].end_us = now;
+		if (i == span_id)
+			break;
+	}
+	data->span_cur = data->span[span_id].parent;
+}
+
+void bootstage_span_end_all(void)
+{
+	struct bootstage_data *data = gd->bootstage;
+	int i;
+
+	if (!data || data->span_cur == -1)
+		return;
+
+	/* Ending the outermost open span ends all the others */
+	for (i = data->span_cur; data->span[i].parent != -1;)
+		i = data->span[i].parent;
+	bootstage_span_end(i);
+}
+
 /**
  * Get a record name as a printable string
  *
@@ -216,6 +309,27 @@ static const char *get_record_name(char *buf, int len,
 	return buf;
 }
 
+/**
+ * Get a span name as a printable string
+ *
+ * Spans for init functions are named after the function address, which can
+ * be looked up in System.map
+ *
+ * @param buf	Buffer to put name if needed
+ * @param len	Length of buffer
+ * @param span	Span to get the name from
+ * @return pointer to name, either from the span or pointing to buf.
+ */
+static const char *get_span_name(char *buf, int len,
+				 const struct bootstage_span *span)
+{
+	if (span->name)
+		return span->name;
+	snprintf(buf, len, "initcall %#lx", span->func);
+
+	return buf;
+}
+
 static uint32_t print_time_record(struct bootstage_record *rec, uint32_t prev)
 {
 	char buf[20];
@@ -240,6 +354,43 @@ static int h_compare_record(const void *r1, const void *r2)
 }
 
 #ifdef CONFIG_OF_LIBFDT
+/**
+ * Add all bootstage spans to a device tree
+ *
+ * This adds a 'spans' node with one entry per span in each of the 'name',
+ * 'start', 'end' and 'parent' properties. The parent is the index of the
+ * enclosing span, or -1 if none. An end time of 0 means the span was still
+ * open.
+ *
+ * @param blob		Device tree blob
+ * @param bootstage	Offset of bootstage node
+ * @return 0 on success, != 0 on failure.
+ */
+static int add_spans_devicetree(struct fdt_header *blob, int bootstage)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_span *span;
+	char buf[30];
+	int node;
+	int i;
+
+	node = fdt_add_subnode(blob, bootstage, "spans");
+	if (node < 0)
+		return -EINVAL;
+
+	for (i = 0, span = data->span; i < data->span_count; i++, span++) {
+		const char *name = get_span_name(buf, sizeof(buf), span);
+
+		if (fdt_appendprop_string(blob, node, "name", name) ||
+		    fdt_appendprop_u32(blob, node, "start", span->start_us) ||
+		    fdt_appendprop_u32(blob, node, "end", span->end_us) ||
+		    fdt_appendprop_u32(blob, node, "parent", span->parent))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
 /**
  * Add all bootstage timings to a device tree.
  *
@@ -292,6 +443,9 @@ static int add_bootstages_devicetree(struct fdt_header *blob)
 			return -EINVAL;
 	}
 
+	if (data->span_count)
+		return add_spans_devicetree(blob, bootstage);
+
 	return 0;
 }
 
@@ -334,6 +488,27 @@ void bootstage_report(void)
 		if (rec->start_us)
 			prev = print_time_record(rec, -1);
 	}
+
+	if (data->span_count) {
+		struct bootstage_span *span = data->span;
+		char buf[30];
+
+		printf("\nSpans:\n%11s%11s  %s\n", "Start", "Duration", "Span");
+		for (i = 0; i < data->span_count; i++, span++) {
+			print_grouped_ull(span->start_us, BOOTSTAGE_DIGITS);
+			if (span->end_us)
+				print_grouped_ull(span->end_us - span->start_us,
+						  BOOTSTAGE_DIGITS);
+			else
+				printf("%11s", "(open)");
+			printf("  %*s%s\n", span->depth * 2, "",
+			       get_span_name(buf, sizeof(buf), span));
+		}
+	}
+	if (data->span_lost)
+		printf("Overflowed span table by %d entries\n"
+		       "Please increase CONFIG_(SPL_)BOOTSTAGE_SPAN_COUNT\n",
+		       data->span_lost);
 }
 
 /**
@@ -358,6 +533,120 @@ static void append_data(char **ptrp, char *end, const void *data, int size)
 	memcpy(ptr, data, size);
 }
 
+/**
+ * struct json_out - destination for the trace-event export
+ *
+ * @ptr:	Next position to write. This moves on even when there is no
+ *		space left, so that the size needed can be worked out
+ * @end:	End of the buffer, or NULL to write to the console
+ * @first:	true if no event has been written yet
+ */
+struct json_out {
+	char *ptr;
+	char *end;
+	bool first;
+};
+
+static void json_write(struct json_out *out, const char *str, int len)
+{
+	if (out->end) {
+		append_data(&out->ptr, out->end, str, len);
+	} else {
+		printf("%.*s", len, str);
+		out->ptr += len;
+	}
+}
+
+static void json_printf(struct json_out *out, const char *fmt, ...)
+{
+	char buf[80];
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vscnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	json_write(out, buf, len);
+}
+
+/* Write a string, quoted and with any special characters escaped */
+static void json_string(struct json_out *out, const char *str)
+{
+	json_write(out, "\"", 1);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			json_write(out, "\\", 1);
+		if ((uchar)*str >= ' ')
+			json_write(out, str, 1);
+	}
+	json_write(out, "\"", 1);
+}
+
+/* Start an event with the given type, name and time */
+static void json_event(struct json_out *out, char type, const char *name,
+		       uint32_t time_us)
+{
+	json_printf(out, "%s\n{\"name\":", out->first ? "" : ",");
+	out->first = false;
+	json_string(out, name);
+	json_printf(out, ",\"ph\":\"%c\",\"ts\":%u,\"pid\":0,\"tid\":0", type,
+		    time_us);
+}
+
+int bootstage_export_json(char *buf, int size)
+{
+	struct bootstage_data *data = gd->bootstage;
+	const struct bootstage_record *rec;
+	const struct bootstage_span *span;
+	struct json_out out;
+	char name[30];
+	bool first;
+	int i;
+
+	out.ptr = buf;
+	out.end = buf ? buf + size : NULL;
+	out.first = true;
+	json_printf(&out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	json_event(&out, 'M', "thread_name", 0);
+	json_printf(&out, ",\"args\":{\"name\":\"U-Boot\"}}");
+
+	/* Marks are instant events, accumulated times do not have a place */
+	for (i = 0, rec = data->record; i < data->rec_count; i++, rec++) {
+		if (rec->start_us ||
+		    (rec->id != BOOTSTAGE_ID_AWAKE && !rec->time_us))
+			continue;
+		json_event(&out, 'i', get_record_name(name, sizeof(name), rec),
+			   rec->time_us);
+		json_printf(&out, ",\"s\":\"p\"}");
+	}
+
+	/* Spans which did not end are left to run on to the end of the trace */
+	for (i = 0, span = data->span; i < data->span_count; i++, span++) {
+		json_event(&out, span->end_us ? 'X' : 'B',
+			   get_span_name(name, sizeof(name), span),
+			   span->start_us);
+		if (span->end_us)
+			json_printf(&out, ",\"dur\":%u",
+				    span->end_us - span->start_us);
+		json_printf(&out, ",\"args\":{\"id\":%d,\"parent\":%d}}", i,
+			    span->parent);
+	}
+
+	json_printf(&out, "\n],\"otherData\":{");
+	for (i = 0, first = true, rec = data->record; i < data->rec_count;
+	     i++, rec++) {
+		if (!rec->start_us)
+			continue;
+		json_printf(&out, "%s", first ? "" : ",");
+		first = false;
+		json_string(&out, get_record_name(name, sizeof(name), rec));
+		json_printf(&out, ":%lu", rec->time_us);
+	}
+	json_printf(&out, "}}\n");
+
+	return out.ptr - buf;
+}
+
 int bootstage_stash(void *base, int size)
 {
 	const struct bootstage_data *data = gd->bootstage;
@@ -498,6 +787,7 @@ int bootstage_init(bool first)
 		return -ENOMEM;
 	data = gd->bootstage;
 	memset(data, '\0', size);
+	data->span_cur = -1;
 	if (first) {
 		data->next_id = BOOTSTAGE_ID_USER;
 		bootstage_add_record(BOOTSTAGE_ID_AWAKE, "reset", 0, 0);
@@ -539,6 +539,8 @@ int cli_readline_into_buffer(const char *const prompt, char *buffer,
 			initted = 1;
 		}
 
+		/* Write out any log records held back while busy */
+		log_ring_flush();
 		if (prompt)
 			puts(prompt);
 
@@ -553,6 +555,8 @@ int cli_readline_into_buffer(const char *const prompt, char *buffer,
 	int	col;				/* output column cnt	*/
 	char	c;
 
+	log_ring_flush();
+
 	/* print prompt */
 	if (prompt) {
 		plen = strlen(prompt);
@@ -18,6 +18,8 @@
 #include <errno.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <bootm.h>
+#include <hash.h>
 #include <malloc.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
@@ -1875,7 +1877,9 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/* A kernel which was streamed in has had its hashes checked already */
+	ret = fit_image_select(fit, noffset, images->verify &&
+			       !fit_image_streamed(fit, noffset, NULL, NULL));
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -2011,6 +2015,327 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	return noffset;
 }
 
+#if defined(CONFIG_FIT_STREAM) && !defined(USE_HOSTCC)
+#define FIT_STREAM_MAX_HASHES	4
+
+/* The kernel most recently loaded by fit_image_load_stream() */
+static struct {
+	const void *fit;
+	int noffset;
+	u32 fit_crc;
+	ulong load;
+	ulong load_end;
+} fit_streamed;
+
+struct fit_stream_hash {
+	int noffset;
+	struct hash_algo *algo;
+	void *ctx;
+};
+
+/* Passes the kernel data on from the real source, hashing it on the way */
+struct fit_stream_data {
+	struct image_stream st;
+	struct image_stream *src;
+	struct fit_stream_hash hash[FIT_STREAM_MAX_HASHES];
+	int count;
+};
+
+static long fit_stream_hash_read(struct image_stream *st, void *buf, ulong len)
+{
+	struct fit_stream_data *sd = container_of(st, struct fit_stream_data,
+						  st);
+	struct fit_stream_hash *hash;
+	long ret;
+
+	ret = sd->src->read(sd->src, buf, len);
+	if (ret <= 0)
+		return ret;
+	for (hash = sd->hash; hash < sd->hash + sd->count; hash++) {
+		if (hash->ctx && hash->algo->hash_update(hash->algo, hash->ctx,
+							 buf, ret, 0)) {
+			/* The context has been freed */
+			hash->ctx = NULL;
+			return -EIO;
+		}
+	}
+
+	return ret;
+}
+
+static void fit_stream_hash_free(struct fit_stream_data *sd)
+{
+	struct fit_stream_hash *hash;
+	u8 value[FIT_MAX_HASH_LEN];
+
+	for (hash = sd->hash; hash < sd->hash + sd->count; hash++) {
+		if (hash->ctx)
+			hash->algo->hash_finish(hash->algo, hash->ctx, value,
+						sizeof(value));
+	}
+	sd->count = 0;
+}
+
+/* Returns true if required keys in U-Boot's own FDT cover image nodes */
+static bool fit_stream_image_sigs_required(void)
+{
+	const void *blob = gd_fdt_blob();
+	const char *required;
+	int sig_node, noffset;
+
+	if (!IMAGE_ENABLE_VERIFY || !blob)
+		return false;
+	sig_node = fdt_subnode_offset(blob, 0, FIT_SIG_NODENAME);
+	if (sig_node < 0)
+		return false;
+	fdt_for_each_subnode(noffset, blob, sig_node) {
+		required = fdt_getprop(blob, noffset, "required", NULL);
+		if (required && !strcmp(required, "image"))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Set up a progressive hash for each hash node of the image. This fails if
+ * the image cannot be checked a piece at a time, e.g. because it is signed
+ * or uses an algorithm which needs all the data at once.
+ */
+static int fit_stream_hash_init(struct fit_stream_data *sd, const void *fit,
+				int image_noffset)
+{
+	struct fit_stream_hash *hash;
+	int noffset, ignore;
+	char *algo;
+
+	if (fit_stream_image_sigs_required())
+		return -ENOSYS;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (!strncmp(name, FIT_SIG_NODENAME, strlen(FIT_SIG_NODENAME)))
+			return -ENOSYS;
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			return -EINVAL;
+		if (sd->count == FIT_STREAM_MAX_HASHES)
+			return -ENOSYS;
+		hash = &sd->hash[sd->count];
+		if (hash_progressive_lookup_algo(algo, &hash->algo))
+			return -ENOSYS;
+		if (hash->algo->hash_init(hash->algo, &hash->ctx))
+			return -ENOMEM;
+		hash->noffset = noffset;
+		sd->count++;
+	}
+
+	return 0;
+}
+
+static int fit_stream_hash_check(struct fit_stream_data *sd, const void *fit)
+{
+	struct fit_stream_hash *hash;
+	u8 value[FIT_MAX_HASH_LEN];
+	u8 *fit_value;
+	int fit_value_len;
+	int ret = 0;
+
+	if (!sd->count)
+		return 0;
+
+	puts("   Verifying Hash Integrity ... ");
+	for (hash = sd->hash; hash < sd->hash + sd->count; hash++) {
+		printf("%s", hash->algo->name);
+		if (!hash->ctx ||
+		    hash->algo->hash_finish(hash->algo, hash->ctx, value,
+					    sizeof(value))) {
+			hash->ctx = NULL;
+			ret = -EIO;
+			break;
+		}
+		hash->ctx = NULL;
+		/* FIT stores CRC32 values big-endian */
+		if (!strcmp(hash->algo->name, "crc32"))
+			*(u32 *)value = cpu_to_uimage(*(u32 *)value);
+		if (fit_image_hash_get_value(fit, hash->noffset, &fit_value,
+					     &fit_value_len) ||
+		    fit_value_len != hash->algo->digest_size ||
+		    memcmp(value, fit_value, fit_value_len)) {
+			ret = -EACCES;
+			break;
+		}
+		puts("+ ");
+	}
+	if (ret) {
+		puts("Bad Data Hash\n");
+		fit_stream_hash_free(sd);
+		return ret;
+	}
+	puts("OK\n");
+
+	return 0;
+}
+
+int image_stream_read(struct image_stream *src, void *buf, ulong len)
+{
+	long ret;
+
+	while (len) {
+		ret = src->read(src, buf, len);
+		if (!ret)
+			ret = -EIO;
+		if (ret < 0) {
+			printf("Error reading image (err=%ld)\n", ret);
+			return ret;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+int fit_image_load_stream(struct image_stream *src, ulong addr,
+			  const char *fit_uname_config, int verify)
+{
+	struct fit_stream_data sd = {
+		.st.read = fit_stream_hash_read,
+		.src = src,
+	};
+	ulong pos, data_pos, load, load_end, unc_len;
+	int cfg_noffset, noffset, data_size, offset;
+	uint8_t comp, type;
+	void *fit;
+	int ret;
+
+	fit_image_stream_done();
+	if (src->size < sizeof(struct fdt_header))
+		return -EINVAL;
+	fit = map_sysmem(addr, src->size);
+
+	pos = sizeof(struct fdt_header);
+	ret = image_stream_read(src, fit, pos);
+	if (ret)
+		return ret;
+	if (fdt_check_header(fit) || fdt_totalsize(fit) > src->size)
+		goto load_rest;
+	ret = image_stream_read(src, fit + pos, fdt_totalsize(fit) - pos);
+	if (ret)
+		return ret;
+	pos = fdt_totalsize(fit);
+	if (!fit_check_format(fit))
+		goto load_rest;
+
+	/* Find the kernel in the same way as fit_image_load() */
+	if (IMAGE_ENABLE_BEST_MATCH && !fit_uname_config)
+		cfg_noffset = fit_conf_find_compat(fit, gd_fdt_blob());
+	else
+		cfg_noffset = fit_conf_get_node(fit, fit_uname_config);
+	if (cfg_noffset < 0)
+		goto load_rest;
+	noffset = fit_conf_get_prop_node(fit, cfg_noffset, FIT_KERNEL_PROP);
+	if (noffset < 0)
+		goto load_rest;
+
+	/* The kernel data must follow the FIT structure */
+	if (!fit_image_get_data_position(fit, noffset, &offset))
+		data_pos = offset;
+	else if (!fit_image_get_data_offset(fit, noffset, &offset))
+		data_pos = ALIGN(pos, 4) + offset;
+	else
+		goto load_rest;
+	if (fit_image_get_data_size(fit, noffset, &data_size) ||
+	    data_pos < pos || data_pos + data_size > src->size)
+		goto load_rest;
+
+	if (fit_image_get_type(fit, noffset, &type) ||
+	    type != IH_TYPE_KERNEL ||
+	    fit_image_get_comp(fit, noffset, &comp) ||
+	    fit_image_get_load(fit, noffset, &load))
+		goto load_rest;
+
+	/* The kernel must not run into the FIT, which is still to be read */
+	if (load >= addr && load < addr + src->size)
+		goto load_rest;
+	unc_len = load < addr ? addr - load : ULONG_MAX;
+
+	if (verify && fit_stream_hash_init(&sd, fit, noffset)) {
+		fit_stream_hash_free(&sd);
+		goto load_rest;
+	}
+
+	ret = image_stream_read(src, fit + pos, data_pos - pos);
+	if (ret)
+		goto err;
+	pos = data_pos;
+
+	printf("## Streaming '%s' kernel from FIT Image to %08lx ...\n",
+	       fit_get_name(fit, noffset, NULL), load);
+	ret = bootm_decomp_stream(comp, load, IH_TYPE_KERNEL,
+				  map_sysmem(load, 0), unc_len, &sd.st,
+				  data_size, &load_end);
+	if (ret == -ENOSYS) {
+		fit_stream_hash_free(&sd);
+		goto load_rest;
+	}
+	if (ret)
+		goto err;
+	pos += data_size;
+
+	ret = fit_stream_hash_check(&sd, fit);
+	if (ret)
+		return ret;
+
+	ret = image_stream_read(src, fit + pos, src->size - pos);
+	if (ret)
+		return ret;
+
+	fit_streamed.fit = fit;
+	fit_streamed.noffset = noffset;
+	fit_streamed.fit_crc = crc32(0, fit, fdt_totalsize(fit));
+	fit_streamed.load = load;
+	fit_streamed.load_end = load_end;
+
+	return 0;
+
+err:
+	fit_stream_hash_free(&sd);
+	return ret;
+
+load_rest:
+	/* Leave it to bootm to deal with the whole image as usual */
+	return image_stream_read(src, fit + pos, src->size - pos);
+}
+
+bool fit_image_streamed(const void *fit, int noffset, ulong *loadp,
+			ulong *load_endp)
+{
+	if (!fit_streamed.fit || fit != fit_streamed.fit ||
+	    noffset != fit_streamed.noffset ||
+	    crc32(0, fit, fdt_totalsize(fit)) != fit_streamed.fit_crc)
+		return false;
+	if (loadp)
+		*loadp = fit_streamed.load;
+	if (load_endp)
+		*load_endp = fit_streamed.load_end;
+
+	return true;
+}
+
+void fit_image_stream_done(void)
+{
+	fit_streamed.fit = NULL;
+}
+#endif /* CONFIG_FIT_STREAM && !USE_HOSTCC */
+
 int boot_get_setup_fit(bootm_headers_t *images, uint8_t arch,
 			ulong *setup_start, ulong *setup_len)
 {
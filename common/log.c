@@ -175,6 +175,13 @@ static bool log_passes_filters(struct log_device *ldev, struct log_rec *rec)
 	return false;
 }
 
+bool log_device_passes_filters(const char *drv_name, struct log_rec *rec)
+{
+	struct log_device *ldev = log_device_find_by_name(drv_name);
+
+	return ldev && log_passes_filters(ldev, rec);
+}
+
 /**
  * log_dispatch() - Send a log record to all log devices for processing
  *
@@ -11,7 +11,7 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
-static int log_console_emit(struct log_device *ldev, struct log_rec *rec)
+void log_console_show(struct log_rec *rec)
 {
 	int fmt = gd->log_fmt;
 
@@ -37,6 +37,14 @@ static int log_console_emit(struct log_device *ldev, struct log_rec *rec)
 		printf("%s()", rec->func);
 	if (fmt & (1 << LOGF_MSG))
 		printf("%s%s", fmt != (1 << LOGF_MSG) ? " " : "", rec->msg);
+}
+
+static int log_console_emit(struct log_device *ldev, struct log_rec *rec)
+{
+	/* The ring driver writes the record out later */
+	if (log_ring_defer(rec))
+		return 0;
+	log_console_show(rec);
 
 	return 0;
 }
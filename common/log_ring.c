@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Log driver which keeps records in a ring buffer
+ *
+ * Each record is stored in binary form: a small header with the time,
+ * category, level and source location, followed by the message text. The
+ * file and function names are not copied, since they are string constants
+ * in the U-Boot image. When the buffer is full the oldest records are
+ * overwritten.
+ *
+ * With CONFIG_LOG_RING_DEFER the console log driver leaves its output to
+ * the ring, which writes out everything new in one go when U-Boot is idle
+ * (waiting for a command or about to boot an OS), so that a slow console
+ * does not hold up the code doing the logging. Each record notes whether
+ * it passed the filters of the ring device, the console device or both, so
+ * that the console only shows what its own filters allow and 'log dump'
+ * only shows what the ring's filters allow.
+ *
+ * Before relocation the ring is allocated from the early malloc() area,
+ * with CONFIG_LOG_RING_F_SIZE bytes. Its records are moved into the full
+ * ring reserved by board_init_f() when U-Boot relocates.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Longest message stored, the rest is dropped */
+#define LOG_RING_MSG_MAX	240
+
+enum log_ring_flags {
+	LOGRF_PRE_RELOC	= 1 << 0,	/* file/func not yet relocated */
+	LOGRF_PAD	= 1 << 1,	/* unused space up to the buffer end */
+	LOGRF_DUMP	= 1 << 2,	/* passed the ring's filters */
+	LOGRF_CONSOLE	= 1 << 3,	/* passed the console's filters */
+};
+
+/**
+ * struct log_ring_rec - a record in the ring
+ *
+ * @time_us: Time when the record was added (see timer_get_boot_us())
+ * @len: Length of the record, including the header and padding
+ * @line: Line number where the record was generated
+ * @cat: Category (enum log_category_t)
+ * @level: Level (enum log_level_t)
+ * @flags: Flags (enum log_ring_flags)
+ * @file: File where the record was generated
+ * @func: Function where the record was generated
+ * @msg: Message, nul-terminated
+ */
+struct log_ring_rec {
+	u32 time_us;
+	u32 len;
+	u32 line;
+	u16 cat;
+	u8 level;
+	u8 flags;
+	const char *file;
+	const char *func;
+	char msg[];
+};
+
+/**
+ * struct log_ring - a ring buffer of log records
+ *
+ * The offsets are free-running and are taken modulo @size to index @buf. A
+ * record is only added to the ring by moving @head past it once it is
+ * complete, so a reader never sees half a record.
+ *
+ * @size: Size of @buf in bytes, a power of two
+ * @head: Offset where the next record is added
+ * @tail: Offset of the oldest record
+ * @shown: Offset of the oldest record not yet written to the console
+ * @lost: Number of records overwritten before being written to the console
+ * @busy: Non-zero while reading the time or writing to the console, which
+ *	may themselves log
+ * @buf: Records
+ */
+struct log_ring {
+	u32 size;
+	u32 head;
+	u32 tail;
+	u32 shown;
+	u32 lost;
+	u32 busy;
+	char buf[] __aligned(sizeof(long));
+};
+
+static uint log_ring_rec_size(uint msglen)
+{
+	return ALIGN(sizeof(struct log_ring_rec) + msglen + 1, sizeof(long));
+}
+
+static struct log_ring_rec *log_ring_rec(struct log_ring *ring, u32 off)
+{
+	return (struct log_ring_rec *)(ring->buf + (off & (ring->size - 1)));
+}
+
+/*
+ * Get the space taken by the record at @off. If there is no room left for a
+ * header before the end of the buffer, that space is padding.
+ */
+static uint log_ring_rec_len(struct log_ring *ring, u32 off)
+{
+	uint room = ring->size - (off & (ring->size - 1));
+
+	if (room < sizeof(struct log_ring_rec))
+		return room;
+
+	return log_ring_rec(ring, off)->len;
+}
+
+static bool log_ring_is_pad(struct log_ring *ring, u32 off)
+{
+	uint room = ring->size - (off & (ring->size - 1));
+
+	return room < sizeof(struct log_ring_rec) ||
+		(log_ring_rec(ring, off)->flags & LOGRF_PAD);
+}
+
+/* Check if the record at @off is to be written to the console */
+static bool log_ring_for_console(struct log_ring *ring, u32 off)
+{
+	return !log_ring_is_pad(ring, off) &&
+		(log_ring_rec(ring, off)->flags & LOGRF_CONSOLE);
+}
+
+static void log_ring_setup(struct log_ring *ring, uint size)
+{
+	memset(ring, '\0', sizeof(*ring));
+	ring->size = size;
+}
+
+static void log_ring_add(struct log_ring *ring, const struct log_ring_rec *hdr,
+			 const char *msg, uint msglen)
+{
+	struct log_ring_rec *rec;
+	uint len = log_ring_rec_size(msglen);
+	uint room, need;
+
+	if (len > ring->size / 2)
+		return;
+	room = ring->size - (ring->head & (ring->size - 1));
+	need = room < len ? room + len : len;
+
+	/* Drop the oldest records to make space */
+	while (ring->head + need - ring->tail > ring->size) {
+		if (ring->tail == ring->shown) {
+			if (log_ring_for_console(ring, ring->tail))
+				ring->lost++;
+			ring->shown += log_ring_rec_len(ring, ring->tail);
+		}
+		ring->tail += log_ring_rec_len(ring, ring->tail);
+	}
+
+	/* Records do not wrap, so skip to the start if needed */
+	if (room < len) {
+		if (room >= sizeof(*rec)) {
+			rec = log_ring_rec(ring, ring->head);
+			rec->len = room;
+			rec->flags = LOGRF_PAD;
+		}
+		if (ring->shown == ring->head)
+			ring->shown += room;
+		ring->head += room;
+	}
+
+	rec = log_ring_rec(ring, ring->head);
+	*rec = *hdr;
+	rec->len = len;
+	memcpy(rec->msg, msg, msglen);
+	rec->msg[msglen] = '\0';
+	ring->head += len;
+}
+
+/* Copy the records from one ring to another, which may be a different size */
+static void log_ring_copy(struct log_ring *to, struct log_ring *from)
+{
+	struct log_ring_rec *rec;
+	u32 off;
+
+	for (off = from->tail; off != from->head;
+	     off += log_ring_rec_len(from, off)) {
+		if (off == from->shown)
+			to->shown = to->head;
+		if (log_ring_is_pad(from, off))
+			continue;
+		rec = log_ring_rec(from, off);
+		log_ring_add(to, rec, rec->msg, strlen(rec->msg));
+	}
+	if (from->shown == from->head)
+		to->shown = to->head;
+	to->lost += from->lost;
+}
+
+/*
+ * Get the ring to use, allocating it if needed. After relocation a ring
+ * still using its pre-relocation size (e.g. because it was not reserved)
+ * is replaced by a full one.
+ */
+static struct log_ring *log_ring_get(void)
+{
+	struct log_ring *ring = gd->log_ring, *new;
+	uint size = CONFIG_LOG_RING_SIZE;
+
+	/* Offsets are taken modulo the size with a mask */
+	BUILD_BUG_ON(!CONFIG_LOG_RING_SIZE ||
+		     (CONFIG_LOG_RING_SIZE & (CONFIG_LOG_RING_SIZE - 1)));
+	BUILD_BUG_ON(CONFIG_LOG_RING_F_SIZE & (CONFIG_LOG_RING_F_SIZE - 1));
+
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		size = CONFIG_LOG_RING_F_SIZE;
+		if (ring || !size)
+			return ring;
+	} else if (ring && ring->size == size) {
+		return ring;
+	}
+
+	new = malloc(sizeof(*new) + size);
+	if (!new)
+		return ring;
+	log_ring_setup(new, size);
+	if (ring)
+		log_ring_copy(new, ring);
+	gd->log_ring = new;
+
+	return new;
+}
+
+static int log_ring_store(struct log_rec *rec, uint flags)
+{
+	struct log_ring *ring = log_ring_get();
+	struct log_ring_rec hdr;
+
+	if (!ring)
+		return -ENOMEM;
+
+	memset(&hdr, '\0', sizeof(hdr));
+	if (!ring->busy) {
+		ring->busy++;
+		hdr.time_us = timer_get_boot_us();
+		ring->busy--;
+	}
+	hdr.line = rec->line;
+	hdr.cat = rec->cat;
+	hdr.level = rec->level;
+	hdr.flags = flags;
+	if (!(gd->flags & GD_FLG_RELOC))
+		hdr.flags |= LOGRF_PRE_RELOC;
+	hdr.file = rec->file;
+	hdr.func = rec->func;
+	log_ring_add(ring, &hdr, rec->msg, strnlen(rec->msg, LOG_RING_MSG_MAX));
+
+	/* Without deferral the console has already shown everything */
+	if (!IS_ENABLED(CONFIG_LOG_RING_DEFER))
+		ring->shown = ring->head;
+
+	return 0;
+}
+
+static int log_ring_emit(struct log_device *ldev, struct log_rec *rec)
+{
+	uint flags = LOGRF_DUMP;
+
+	if (IS_ENABLED(CONFIG_LOG_RING_DEFER) &&
+	    log_device_passes_filters("console", rec))
+		flags |= LOGRF_CONSOLE;
+
+	return log_ring_store(rec, flags);
+}
+
+/* Write the record at @off to the console */
+static void log_ring_show(struct log_ring *ring, u32 off, bool show_time)
+{
+	struct log_ring_rec *hdr = log_ring_rec(ring, off);
+	char msg[LOG_RING_MSG_MAX + 1];
+	struct log_rec rec;
+	ulong reloc_off = 0;
+	u32 time_us;
+
+	/* Take a copy, since the console might log and overwrite it */
+	if ((hdr->flags & LOGRF_PRE_RELOC) && (gd->flags & GD_FLG_RELOC))
+		reloc_off = gd->reloc_off;
+	rec.cat = hdr->cat;
+	rec.level = hdr->level;
+	rec.file = hdr->file ? hdr->file + reloc_off : "";
+	rec.line = hdr->line;
+	rec.func = hdr->func ? hdr->func + reloc_off : "";
+	strlcpy(msg, hdr->msg, sizeof(msg));
+	rec.msg = msg;
+	time_us = hdr->time_us;
+
+	if (show_time)
+		printf("[%5u.%06u] ", time_us / 1000000, time_us % 1000000);
+	log_console_show(&rec);
+}
+
+void log_ring_flush(void)
+{
+	struct log_ring *ring = gd->log_ring;
+	u32 off;
+
+	if (!ring || ring->busy)
+		return;
+
+	ring->busy++;
+	if (ring->lost) {
+		printf("(%u log records lost)\n", ring->lost);
+		ring->lost = 0;
+	}
+	while (ring->shown != ring->head) {
+		off = ring->shown;
+		ring->shown += log_ring_rec_len(ring, off);
+		if (log_ring_for_console(ring, off))
+			log_ring_show(ring, off, false);
+	}
+	ring->busy--;
+}
+
+int log_ring_dump(void)
+{
+	struct log_ring *ring = gd->log_ring;
+	u32 off, end;
+	int count = 0;
+
+	if (!ring)
+		return 0;
+
+	ring->busy++;
+	end = ring->head;
+	for (off = ring->tail; off != end; off += log_ring_rec_len(ring, off)) {
+		/* Skip anything overwritten while the console was busy */
+		if ((s32)(off - ring->tail) < 0)
+			off = ring->tail;
+		if (log_ring_is_pad(ring, off))
+			continue;
+		/* Show console-only records too, if they are still pending */
+		if (!(log_ring_rec(ring, off)->flags & LOGRF_DUMP) &&
+		    !(log_ring_for_console(ring, off) &&
+		      (s32)(off - ring->shown) >= 0))
+			continue;
+		log_ring_show(ring, off, true);
+		count++;
+	}
+	if ((s32)(end - ring->shown) > 0)
+		ring->shown = end;
+	ring->lost = 0;
+	ring->busy--;
+
+	return count;
+}
+
+bool log_ring_defer(struct log_rec *rec)
+{
+	if (!IS_ENABLED(CONFIG_LOG_RING_DEFER) || !log_ring_get())
+		return false;
+
+	/* Records which pass the ring's filters are stored by its driver */
+	if (!log_device_passes_filters("ring", rec))
+		log_ring_store(rec, LOGRF_CONSOLE);
+
+	return true;
+}
+
+int log_ring_get_size(void)
+{
+	return sizeof(struct log_ring) + CONFIG_LOG_RING_SIZE;
+}
+
+void log_ring_move(void *buf)
+{
+	struct log_ring *ring = buf;
+
+	log_ring_setup(ring, CONFIG_LOG_RING_SIZE);
+	if (gd->log_ring)
+		log_ring_copy(ring, gd->log_ring);
+	gd->log_ring = ring;
+}
+
+LOG_DRIVER(ring) = {
+	.name	= "ring",
+	.emit	= log_ring_emit,
+};
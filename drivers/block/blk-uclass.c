@@ -7,10 +7,14 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <fs.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
 
+/* Longest time to wait for a device to make room for a request, in ms */
+#define BLK_SUBMIT_TIMEOUT	30000
+
 static const char *if_typename_str[IF_TYPE_COUNT] = {
 	[IF_TYPE_IDE]		= "ide",
 	[IF_TYPE_SCSI]		= "scsi",
@@ -318,6 +322,9 @@ int blk_select_hwpart(struct udevice *dev, int hwpart)
 	if (!ops->select_hwpart)
 		return 0;
 
+	blkra_invalidate(dev_get_uclass_platdata(dev));
+	fs_cache_invalidate(dev_get_uclass_platdata(dev));
+
 	return ops->select_hwpart(dev, hwpart);
 }
 
@@ -406,20 +413,35 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
+	ulong blks_read, cached;
 
 	if (!ops->read)
 		return -ENOSYS;
 
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
+	cached = blkcache_read(block_dev->if_type, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	if (cached == blkcnt)
 		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
+	start += cached;
+	blkcnt -= cached;
+	buffer += cached * block_dev->blksz;
+
+	blks_read = blkra_read(block_dev, start, blkcnt, buffer);
+	if (blks_read < blkcnt) {
+		ulong n = blkcnt - blks_read;
+		ulong count;
+
+		count = ops->read(dev, start + blks_read, n,
+				  buffer + blks_read * block_dev->blksz);
+		if (count > n)
+			return count;	/* error code */
+		blks_read += count;
+	}
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
 
-	return blks_read;
+	return cached + blks_read;
 }
 
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
@@ -431,7 +453,10 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->write)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
+	blkra_invalidate(block_dev);
+	fs_cache_invalidate(block_dev);
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -444,10 +469,110 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->erase)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
+	blkra_invalidate(block_dev);
+	fs_cache_invalidate(block_dev);
 	return ops->erase(dev, start, blkcnt);
 }
 
+void blk_request_done(struct blk_request *req, lbaint_t blks_done,
+		      int status)
+{
+	req->blks_done = blks_done;
+	req->status = status;
+	if (req->complete)
+		req->complete(req);
+}
+
+/* Carry out a request using the synchronous operations */
+static void blk_sync_request(struct blk_desc *block_dev,
+			     struct blk_request *req)
+{
+	ulong blks;
+
+	if (req->op == BLK_REQ_READ)
+		blks = blk_dread(block_dev, req->start, req->blkcnt,
+				 req->buffer);
+	else
+		blks = blk_dwrite(block_dev, req->start, req->blkcnt,
+				  req->buffer);
+	if (IS_ERR_VALUE(blks))
+		blk_request_done(req, 0, blks);
+	else
+		blk_request_done(req, blks, blks == req->blkcnt ? 0 : -EIO);
+}
+
+int blk_dsubmit(struct blk_desc *block_dev, struct list_head *reqs)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_request *req, *next;
+	ulong start;
+	int ret = 0;
+
+	list_for_each_entry(req, reqs, list) {
+		req->blks_done = 0;
+		req->status = -EINPROGRESS;
+	}
+
+	list_for_each_entry_safe(req, next, reqs, list) {
+		if (ret) {
+			blk_request_done(req, 0, ret);
+			continue;
+		}
+		if (req->op == BLK_REQ_WRITE) {
+			blkcache_invalidate_range(block_dev->if_type,
+						  block_dev->devnum,
+						  req->start, req->blkcnt);
+			blkra_invalidate(block_dev);
+			fs_cache_invalidate(block_dev);
+		}
+		if (!ops->submit) {
+			blk_sync_request(block_dev, req);
+			continue;
+		}
+		start = get_timer(0);
+		while ((ret = ops->submit(dev, req)) == -EBUSY) {
+			ret = ops->poll(dev);
+			if (ret < 0)
+				break;
+			if (get_timer(start) > BLK_SUBMIT_TIMEOUT) {
+				ret = -ETIMEDOUT;
+				break;
+			}
+		}
+		if (ret)
+			blk_request_done(req, 0, ret);
+	}
+
+	return ret;
+}
+
+int blk_dpoll(struct blk_desc *block_dev)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+int blk_dwait(struct blk_desc *block_dev, ulong timeout_ms)
+{
+	ulong start = get_timer(0);
+	int ret;
+
+	while ((ret = blk_dpoll(block_dev)) > 0) {
+		if (get_timer(start) > timeout_ms)
+			return -ETIMEDOUT;
+	}
+
+	return ret;
+}
+
 int blk_prepare_device(struct udevice *dev)
 {
 	struct blk_desc *desc = dev_get_uclass_platdata(dev);
@@ -621,8 +746,20 @@ int blk_unbind_all(int if_type)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	blkra_release(dev_get_uclass_platdata(dev));
+	fs_cache_invalidate(dev_get_uclass_platdata(dev));
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
+	.pre_remove	= blk_pre_remove,
 	.per_device_platdata_auto_alloc_size = sizeof(struct blk_desc),
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+	.per_device_auto_alloc_size = sizeof(struct blk_readahead),
+#endif
 };
@@ -9,164 +9,334 @@
 #include <malloc.h>
 #include <part.h>
 #include <linux/ctype.h>
-#include <linux/list.h>
+#include <linux/log2.h>
 
-struct block_cache_node {
-	struct list_head lh;
+/*
+ * The cache is split into fixed-size lines, each holding an aligned group of
+ * blocks from one device. Lines are grouped into sets of
+ * CONFIG_BLOCK_CACHE_WAYS entries and a line can only live in the set
+ * selected by hashing its (iftype, devnum, first block) key, so a lookup
+ * touches a single set no matter how large the cache is. Within a set the
+ * least-recently-used line is replaced. Each line keeps a bitmap of which of
+ * its blocks are valid, so small reads can populate part of a line.
+ */
+#define BLKCACHE_LINE_SIZE	CONFIG_BLOCK_CACHE_LINE_SIZE
+#define BLKCACHE_MAX_LINE_BLKS	32
+
+struct block_cache_line {
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
-	char *cache;
+	lbaint_t start;		/* first block held by this line */
+	u32 valid;		/* bitmap of valid blocks in the line */
+	u32 age;		/* value of 'cache_clock' at last use */
+	char *data;
 };
 
-static LIST_HEAD(block_cache);
+static struct block_cache_line *cache_lines;
+static char *cache_data;
+static unsigned int cache_sets;
+static u32 cache_clock;
+static bool cache_failed;
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 2,
-	.max_entries = 32
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_MAX_BLOCKS,
+	.size = CONFIG_BLOCK_CACHE_SIZE,
+	.line_size = BLKCACHE_LINE_SIZE,
+	.ways = CONFIG_BLOCK_CACHE_WAYS,
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static void cache_free(void)
 {
-	struct block_cache_node *node;
-
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
-			return node;
-		}
+	free(cache_lines);
+	free(cache_data);
+	cache_lines = NULL;
+	cache_data = NULL;
+	cache_sets = 0;
+	_stats.entries = 0;
+	_stats.max_entries = 0;
+}
+
+static int cache_init(void)
+{
+	unsigned int lines, ways, i;
+
+	/* Blocks are located within a line by masking */
+	BUILD_BUG_ON(BLKCACHE_LINE_SIZE & (BLKCACHE_LINE_SIZE - 1));
+
+	if (cache_lines)
+		return 0;
+	if (cache_failed)
+		return -ENOMEM;
+
+	lines = _stats.size / BLKCACHE_LINE_SIZE;
+	ways = min_t(unsigned int, _stats.ways, lines);
+	if (!ways)
+		return -ENOSPC;
+	cache_sets = __rounddown_pow_of_two(lines / ways);
+	lines = cache_sets * ways;
+
+	cache_lines = calloc(lines, sizeof(*cache_lines));
+	cache_data = malloc(lines * BLKCACHE_LINE_SIZE);
+	if (!cache_lines || !cache_data) {
+		debug("blkcache: cannot allocate %u lines\n", lines);
+		cache_free();
+		cache_failed = true;
+		return -ENOMEM;
+	}
+	for (i = 0; i < lines; i++)
+		cache_lines[i].data = cache_data + i * BLKCACHE_LINE_SIZE;
+	_stats.ways = ways;
+	_stats.max_entries = lines;
+
 	return 0;
 }
 
+/*
+ * cache_line_blocks() - get the number of blocks per cache line
+ *
+ * @return blocks per line, or 0 if blocks of this size cannot be cached
+ */
+static unsigned int cache_line_blocks(unsigned long blksz)
+{
+	unsigned int blocks;
+
+	if (!blksz || blksz > BLKCACHE_LINE_SIZE || !is_power_of_2(blksz))
+		return 0;
+	blocks = BLKCACHE_LINE_SIZE / blksz;
+	if (blocks > BLKCACHE_MAX_LINE_BLKS)
+		return 0;
+
+	return blocks;
+}
+
+static struct block_cache_line *cache_set(int iftype, int devnum,
+					  lbaint_t start, unsigned int blocks)
+{
+	u64 index = (u64)start >> ilog2(blocks);
+	u32 hash;
+
+	hash = (u32)index ^ (u32)(index >> 32);
+	hash ^= iftype * 0x9e3779b9 ^ devnum * 0x85ebca6b;
+	hash ^= hash >> 16;
+	hash *= 0x7feb352d;
+	hash ^= hash >> 15;
+
+	return &cache_lines[(hash & (cache_sets - 1)) * _stats.ways];
+}
+
+static struct block_cache_line *cache_find(int iftype, int devnum,
+					   lbaint_t start, unsigned long blksz,
+					   unsigned int blocks)
+{
+	struct block_cache_line *line;
+	int i;
+
+	line = cache_set(iftype, devnum, start, blocks);
+	for (i = 0; i < _stats.ways; i++, line++) {
+		if (line->valid &&
+		    line->start == start &&
+		    line->devnum == devnum &&
+		    line->iftype == iftype &&
+		    line->blksz == blksz) {
+			line->age = ++cache_clock;
+			return line;
+		}
+	}
+
+	return NULL;
+}
+
+static struct block_cache_line *cache_alloc(int iftype, int devnum,
+					    lbaint_t start, unsigned long blksz,
+					    unsigned int blocks)
+{
+	struct block_cache_line *line, *victim;
+	int i;
+
+	line = cache_set(iftype, devnum, start, blocks);
+	victim = line;
+	for (i = 0; i < _stats.ways; i++, line++) {
+		if (!line->valid) {
+			victim = line;
+			break;
+		}
+		if ((s32)(line->age - victim->age) < 0)
+			victim = line;
+	}
+
+	if (victim->valid) {
+		debug("drop: start " LBAF "\n", victim->start);
+		_stats.evictions++;
+	} else {
+		_stats.entries++;
+	}
+
+	victim->iftype = iftype;
+	victim->devnum = devnum;
+	victim->start = start;
+	victim->blksz = blksz;
+	victim->valid = 0;
+	victim->age = ++cache_clock;
+
+	return victim;
+}
+
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
+	struct block_cache_line *line;
+	unsigned int blocks, offset, i;
+	lbaint_t done = 0;
+
+	blocks = cache_line_blocks(blksz);
+	if (!blocks || !cache_lines) {
+		++_stats.misses;
+		return 0;
+	}
+
+	while (done < blkcnt) {
+		lbaint_t blk = start + done;
+
+		offset = blk & (blocks - 1);
+		line = cache_find(iftype, devnum, blk - offset, blksz, blocks);
+		if (!line)
+			break;
+
+		/* Take as many consecutive valid blocks as we can */
+		for (i = offset; i < blocks && done + i - offset < blkcnt; i++)
+			if (!(line->valid & (1U << i)))
+				break;
+		if (i == offset)
+			break;
+
+		memcpy(buffer + done * blksz, line->data + offset * blksz,
+		       (i - offset) * blksz);
+		done += i - offset;
+		if (i < blocks && done < blkcnt)
+			break;
+	}
+
+	if (done == blkcnt) {
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
 		++_stats.hits;
-		return 1;
+	} else if (done) {
+		debug("partial: start " LBAF ", count " LBAFU "/" LBAFU "\n",
+		      start, done, blkcnt);
+		++_stats.partial_hits;
+	} else {
+		debug("miss: start " LBAF ", count " LBAFU "\n",
+		      start, blkcnt);
+		++_stats.misses;
 	}
 
-	debug("miss: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
-	++_stats.misses;
-	return 0;
+	return done;
 }
 
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	struct block_cache_line *line;
+	unsigned int blocks, offset, count, i;
+	lbaint_t done = 0;
 
 	/* don't cache big stuff */
 	if (blkcnt > _stats.max_blocks_per_entry)
 		return;
 
-	if (_stats.max_entries == 0)
+	blocks = cache_line_blocks(blksz);
+	if (!blocks || cache_init())
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
+	debug("fill: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
+	while (done < blkcnt) {
+		lbaint_t blk = start + done;
+
+		offset = blk & (blocks - 1);
+		count = min_t(lbaint_t, blocks - offset, blkcnt - done);
+		line = cache_find(iftype, devnum, blk - offset, blksz, blocks);
+		if (!line)
+			line = cache_alloc(iftype, devnum, blk - offset, blksz,
+					   blocks);
+
+		memcpy(line->data + offset * blksz, buffer + done * blksz,
+		       count * blksz);
+		for (i = offset; i < offset + count; i++)
+			line->valid |= 1U << i;
+		done += count;
 	}
+}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+void blkcache_invalidate_range(int iftype, int devnum,
+			       lbaint_t start, lbaint_t blkcnt)
+{
+	struct block_cache_line *line;
+	lbaint_t first, last, blk;
+	unsigned int i;
+
+	if (!cache_lines)
+		return;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	for (i = 0, line = cache_lines; i < _stats.max_entries; i++, line++) {
+		if (!line->valid || line->iftype != iftype ||
+		    line->devnum != devnum)
+			continue;
+
+		first = max_t(lbaint_t, start, line->start);
+		last = min_t(lbaint_t, start + blkcnt,
+			     line->start + BLKCACHE_LINE_SIZE / line->blksz);
+		for (blk = first; blk < last; blk++)
+			line->valid &= ~(1U << (blk - line->start));
+		if (!line->valid)
+			_stats.entries--;
+	}
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
-
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+	struct block_cache_line *line;
+	unsigned int i;
+
+	if (!cache_lines)
+		return;
+
+	for (i = 0, line = cache_lines; i < _stats.max_entries; i++, line++) {
+		if (line->valid && line->iftype == iftype &&
+		    line->devnum == devnum) {
+			line->valid = 0;
+			_stats.entries--;
 		}
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_configure(unsigned long size, unsigned blocks)
 {
-	struct block_cache_node *node;
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+	if (size != _stats.size) {
+		/* invalidate cache; it is reallocated on the next fill */
+		cache_free();
+		cache_failed = false;
+		_stats.size = size;
+		_stats.ways = CONFIG_BLOCK_CACHE_WAYS;
 	}
 
 	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
 
 	_stats.hits = 0;
+	_stats.partial_hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
+	_stats.partial_hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
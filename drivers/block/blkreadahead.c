@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sequential read-ahead for block devices
+ *
+ * Filesystems tend to read files a cluster or a block at a time, which
+ * turns into a long series of small requests to the device. When a read
+ * starts where the previous one on the same device ended, read a larger
+ * window of blocks into a per-device buffer and serve the following
+ * requests from there. The window doubles each time it is refilled by a
+ * sequential stream, up to CONFIG_BLOCK_READAHEAD_SIZE, and is halved
+ * again when the access pattern becomes random.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <memalign.h>
+
+#define BLKRA_MIN_BLOCKS	8
+
+static struct blk_readahead_stats _stats = {
+	.max_size = CONFIG_BLOCK_READAHEAD_SIZE,
+};
+
+static int blkra_alloc(struct blk_readahead *ra, lbaint_t blocks,
+		       unsigned long blksz)
+{
+	if (ra->buf && ra->size >= blocks)
+		return 0;
+
+	free(ra->buf);
+	ra->count = 0;
+	ra->size = 0;
+	ra->buf = memalign(ARCH_DMA_MINALIGN, blocks * blksz);
+	if (!ra->buf)
+		return -ENOMEM;
+	ra->size = blocks;
+
+	return 0;
+}
+
+ulong blkra_read(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		 void *buffer)
+{
+	struct udevice *dev = desc->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_readahead *ra = dev_get_uclass_priv(dev);
+	unsigned long blksz = desc->blksz;
+	lbaint_t done = 0, max, count;
+	ulong blks_read;
+
+	if (!ra || !_stats.max_size)
+		return 0;
+
+	/* First take whatever we already have */
+	if (ra->count && start >= ra->start &&
+	    start < ra->start + ra->count) {
+		done = min(blkcnt, ra->start + ra->count - start);
+		memcpy(buffer, ra->buf + (start - ra->start) * blksz,
+		       done * blksz);
+		_stats.hits += done;
+		ra->next = start + done;
+		if (done == blkcnt)
+			return done;
+		start += done;
+		blkcnt -= done;
+		buffer += done * blksz;
+	}
+
+	if (start != ra->next) {
+		/* Not a sequential stream, so back off */
+		if (ra->window > BLKRA_MIN_BLOCKS) {
+			ra->window /= 2;
+			_stats.shrinks++;
+		}
+		ra->next = start + blkcnt;
+		return done;
+	}
+	ra->next = start + blkcnt;
+
+	max = _stats.max_size / blksz;
+	ra->window = min(max, max_t(lbaint_t, ra->window * 2,
+				     BLKRA_MIN_BLOCKS));
+	count = ra->window;
+	if (desc->lba)
+		count = start < desc->lba ? min(count, desc->lba - start) : 0;
+
+	/* Large requests gain nothing from going through the buffer */
+	if (blkcnt >= count)
+		return done;
+
+	if (blkra_alloc(ra, max, blksz))
+		return done;
+
+	blks_read = ops->read(dev, start, count, ra->buf);
+	if (blks_read != count) {
+		debug("%s: read-ahead of " LBAFU " blocks at " LBAF
+		      " failed\n", __func__, count, start);
+		ra->count = 0;
+		return done;
+	}
+	_stats.reads++;
+	_stats.blocks += count;
+	ra->start = start;
+	ra->count = count;
+
+	memcpy(buffer, ra->buf, blkcnt * blksz);
+	_stats.hits += blkcnt;
+
+	return done + blkcnt;
+}
+
+void blkra_invalidate(struct blk_desc *desc)
+{
+	struct blk_readahead *ra;
+
+	if (!desc->bdev)
+		return;
+	ra = dev_get_uclass_priv(desc->bdev);
+	if (!ra)
+		return;
+	ra->count = 0;
+	ra->window = 0;
+}
+
+void blkra_release(struct blk_desc *desc)
+{
+	struct blk_readahead *ra = dev_get_uclass_priv(desc->bdev);
+
+	if (!ra)
+		return;
+	free(ra->buf);
+	ra->buf = NULL;
+	ra->size = 0;
+	ra->count = 0;
+}
+
+void blkra_configure(unsigned long size)
+{
+	_stats.max_size = size;
+	_stats.hits = 0;
+	_stats.reads = 0;
+	_stats.blocks = 0;
+	_stats.shrinks = 0;
+}
+
+void blkra_stats(struct blk_readahead_stats *stats)
+{
+	memcpy(stats, &_stats, sizeof(*stats));
+	_stats.hits = 0;
+	_stats.reads = 0;
+	_stats.blocks = 0;
+	_stats.shrinks = 0;
+}
@@ -217,9 +217,55 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 }
 
 #ifdef CONFIG_BLK
+static int host_block_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct host_block_dev *host_dev = dev_get_priv(dev);
+	int slot;
+
+	if (host_dev->queue_count == HOST_QUEUE_DEPTH)
+		return -EBUSY;
+
+	slot = (host_dev->queue_head + host_dev->queue_count) %
+		HOST_QUEUE_DEPTH;
+	host_dev->queue[slot] = req;
+	host_dev->queue_count++;
+
+	return 0;
+}
+
+/* Complete the oldest request each time, to mimic a real device */
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_priv(dev);
+	struct blk_request *req;
+	ulong blks;
+
+	if (!host_dev->queue_count)
+		return 0;
+
+	req = host_dev->queue[host_dev->queue_head];
+	host_dev->queue_head = (host_dev->queue_head + 1) % HOST_QUEUE_DEPTH;
+	host_dev->queue_count--;
+
+	if (req->op == BLK_REQ_READ)
+		blks = host_block_read(dev, req->start, req->blkcnt,
+				       req->buffer);
+	else
+		blks = host_block_write(dev, req->start, req->blkcnt,
+					req->buffer);
+	if (IS_ERR_VALUE(blks))
+		blk_request_done(req, 0, -EIO);
+	else
+		blk_request_done(req, blks, blks == req->blkcnt ? 0 : -EIO);
+
+	return host_dev->queue_count;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
@@ -373,6 +373,7 @@ int device_probe(struct udevice *dev)
 		goto fail;
 	}
 	dev->seq = seq;
+	uclass_index_update(dev);
 
 	dev->flags |= DM_FLAG_ACTIVATED;
 
@@ -436,6 +437,7 @@ fail:
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
 	dev->seq = -1;
+	uclass_index_update(dev);
 	device_free(dev);
 
 	return ret;
@@ -594,6 +596,74 @@ int device_get_child_by_of_offset(struct udevice *parent, int node,
 	return device_get_device_tail(dev, ret, devp);
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+void dev_set_ofnode(struct udevice *dev, ofnode node)
+{
+	dev->node = node;
+	uclass_index_update(dev);
+}
+
+static int device_depth(struct udevice *dev)
+{
+	int depth = 0;
+
+	for (; dev->parent; dev = dev->parent)
+		depth++;
+
+	return depth;
+}
+
+/* Check if @a comes before @b in a depth-first walk of the device tree */
+static bool device_is_before(struct udevice *a, struct udevice *b)
+{
+	int depth_a = device_depth(a), depth_b = device_depth(b);
+	struct udevice *dev;
+	int depth;
+
+	for (depth = depth_a; depth > depth_b; depth--)
+		a = a->parent;
+	for (depth = depth_b; depth > depth_a; depth--)
+		b = b->parent;
+	if (a == b)
+		return depth_a < depth_b;	/* a parent comes first */
+
+	while (a->parent != b->parent) {
+		a = a->parent;
+		b = b->parent;
+	}
+	list_for_each_entry(dev, &a->parent->child_head, sibling_node) {
+		if (dev == a)
+			return true;
+		if (dev == b)
+			break;
+	}
+
+	return false;
+}
+
+/*
+ * Search each uclass's index rather than the whole tree. If several devices
+ * are attached to the node, return the one the tree walk would have found.
+ */
+static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
+						     ofnode ofnode)
+{
+	struct udevice *dev, *found = NULL;
+	struct uclass *uc;
+
+	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
+		for (dev = NULL, uclass_find_next_device_by_ofnode(uc, ofnode,
+								   &dev);
+		     dev;
+		     uclass_find_next_device_by_ofnode(uc, ofnode, &dev)) {
+			if (!found || device_is_before(dev, found))
+				found = dev;
+		}
+	}
+
+	return found;
+}
+#else
 static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 						     ofnode ofnode)
 {
@@ -610,10 +680,14 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 
 	return NULL;
 }
+#endif
 
 int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
+	u64 start = dm_stats_start();
+
 	*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
+	dm_stats_end(DM_LOOKUP_GLOBAL_OFNODE, start, *devp);
 
 	return *devp ? 0 : -ENOENT;
 }
@@ -621,8 +695,10 @@ int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 int device_get_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
 	struct udevice *dev;
+	u64 start = dm_stats_start();
 
 	dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
+	dm_stats_end(DM_LOOKUP_GLOBAL_OFNODE, start, dev);
 	return device_get_device_tail(dev, dev ? 0 : -ENOENT, devp);
 }
 
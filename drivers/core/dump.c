@@ -4,12 +4,15 @@
  */
 
 #include <common.h>
+#include <div64.h>
 #include <dm.h>
 #include <mapmem.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/uclass-internal.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 static void show_devices(struct udevice *dev, int depth, int last_flag)
 {
 	int i, is_last;
@@ -96,3 +99,34 @@ void dm_dump_uclass(void)
 		puts("\n");
 	}
 }
+
+#if CONFIG_IS_ENABLED(DM_STATS)
+void dm_dump_stats(void)
+{
+	static const char *const names[DM_LOOKUP_COUNT] = {
+		"seq", "name", "ofnode", "phandle", "global ofnode",
+	};
+	struct dm_lookup_stats *stats = dm_get_lookup_stats();
+	ulong rate = get_tbclk();
+	struct uclass *uc;
+	int uclasses = 0, devices = 0;
+	int i;
+
+	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
+		uclasses++;
+		devices += list_count_items(&uc->dev_head);
+	}
+	printf("%d devices in %d uclasses", devices, uclasses);
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		printf(", indexed");
+	printf("\n\n%-14s %8s %8s %10s %8s\n", "Lookup", "Calls", "Found",
+	       "Time (us)", "Avg (ns)");
+	for (i = 0; i < DM_LOOKUP_COUNT; i++) {
+		u64 us = rate ? lldiv(stats[i].ticks * 1000000, rate) : 0;
+
+		printf("%-14s %8lu %8lu %10llu %8llu\n", names[i],
+		       stats[i].calls, stats[i].found, us,
+		       stats[i].calls ? lldiv(us * 1000, stats[i].calls) : 0);
+	}
+}
+#endif
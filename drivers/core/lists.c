@@ -15,7 +15,11 @@
 #include <dm/uclass.h>
 #include <dm/util.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <linux/compiler.h>
+#include <linux/log2.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 struct driver *lists_driver_lookup_name(const char *name)
 {
@@ -122,10 +126,144 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp)
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+/*
+ * The compatible-string index is an open-addressed hash table holding one
+ * entry for each distinct compatible string in the drivers' of_match tables.
+ * Drivers are added in linker-list order and a string that is already
+ * present is skipped, so a lookup returns the same driver and match as the
+ * linear search does.
+ */
+struct compat_entry {
+	const char *compat;
+	struct driver *drv;
+	const struct udevice_id *id;
+};
+
+static struct compat_entry *compat_index;
+static uint compat_index_mask;
+static bool compat_index_failed;
+
+static uint compat_hash(const char *compat)
+{
+	uint hash = 2166136261U;
+
+	while (*compat)
+		hash = (hash ^ (u8)*compat++) * 16777619U;
+
+	return hash;
+}
+
+static int compat_index_build(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *of_match;
+	struct compat_entry *slot;
+	struct driver *entry;
+	uint count = 0, size, pos;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (of_match = entry->of_match;
+		     of_match && of_match->compatible;
+		     of_match++)
+			count++;
+	}
+
+	/* Keep the table at most half full so that probe runs stay short */
+	size = roundup_pow_of_two(max(count * 2, 16U));
+	compat_index = calloc(size, sizeof(*compat_index));
+	if (!compat_index) {
+		dm_warn("Cannot allocate compatible index (%u entries)\n",
+			size);
+		compat_index_failed = true;
+		return -ENOMEM;
+	}
+	compat_index_mask = size - 1;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (of_match = entry->of_match;
+		     of_match && of_match->compatible;
+		     of_match++) {
+			pos = compat_hash(of_match->compatible);
+			for (;; pos++) {
+				slot = &compat_index[pos & compat_index_mask];
+				if (!slot->compat) {
+					slot->compat = of_match->compatible;
+					slot->drv = entry;
+					slot->id = of_match;
+					break;
+				}
+				if (!strcmp(slot->compat, of_match->compatible))
+					break;
+			}
+		}
+	}
+	pr_debug("Compatible index: %u strings, %u slots\n", count, size);
+
+	return 0;
+}
+
+/**
+ * compat_index_ready() - Check whether the compatible index can be used
+ *
+ * This builds the index the first time it is called once full malloc() is
+ * available.
+ *
+ * @return true if the index is available, false to use the linear search
+ */
+static bool compat_index_ready(void)
+{
+	/* BSS is not available and malloc() space is scarce before this */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return false;
+	if (compat_index)
+		return true;
+	if (compat_index_failed)
+		return false;
+
+	return !compat_index_build();
+}
+
+static struct driver *compat_index_find(const char *compat,
+					const struct udevice_id **idp)
+{
+	struct compat_entry *slot;
+	uint pos;
+
+	for (pos = compat_hash(compat);; pos++) {
+		slot = &compat_index[pos & compat_index_mask];
+		if (!slot->compat)
+			return NULL;
+		if (!strcmp(slot->compat, compat)) {
+			*idp = slot->id;
+			return slot->drv;
+		}
+	}
+}
+#endif
+
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **idp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	if (compat_index_ready())
+		return compat_index_find(compat, idp);
+#endif
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (!driver_check_compatible(entry->of_match, idp, compat))
+			return entry;
+	}
+
+	return NULL;
+}
+
+int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
@@ -162,13 +300,8 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp)
 		pr_debug("   - attempt to match compatible string '%s'\n",
 			 compat);
 
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
-		}
-		if (entry == driver + n_ents)
+		entry = lists_driver_lookup_compat(compat, &id);
+		if (!entry)
 			continue;
 
 		pr_debug("   - found match at '%s'\n", entry->name);
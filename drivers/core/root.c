@@ -171,10 +171,10 @@ int dm_init(bool of_live)
 #if CONFIG_IS_ENABLED(OF_CONTROL)
 # if CONFIG_IS_ENABLED(OF_LIVE)
 	if (of_live)
-		DM_ROOT_NON_CONST->node = np_to_ofnode(gd->of_root);
+		dev_set_ofnode(DM_ROOT_NON_CONST, np_to_ofnode(gd->of_root));
 	else
 #endif
-		DM_ROOT_NON_CONST->node = offset_to_ofnode(0);
+		dev_set_ofnode(DM_ROOT_NON_CONST, offset_to_ofnode(0));
 #endif
 	ret = device_probe(DM_ROOT_NON_CONST);
 	if (ret)
@@ -335,7 +335,9 @@ int dm_extended_scan_fdt(const void *blob, bool pre_reloc_only)
 	int ret;
 	ofnode node;
 
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_SCAN, "dm_scan");
 	ret = dm_scan_fdt(gd->fdt_blob, pre_reloc_only);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_SCAN);
 	if (ret) {
 		debug("dm_scan_fdt() failed: %d\n", ret);
 		return ret;
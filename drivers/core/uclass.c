@@ -19,6 +19,256 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#if CONFIG_IS_ENABLED(DM_STATS)
+static struct dm_lookup_stats dm_stats[DM_LOOKUP_COUNT];
+/* Set while reading the timer, which may itself look up a timer device */
+static bool dm_stats_busy;
+
+u64 dm_stats_start(void)
+{
+	u64 now;
+
+	if (!(gd->flags & GD_FLG_RELOC) || dm_stats_busy)
+		return 0;
+	dm_stats_busy = true;
+	now = get_ticks();
+	dm_stats_busy = false;
+
+	return now;
+}
+
+void dm_stats_end(enum dm_lookup_t type, u64 start, bool found)
+{
+	struct dm_lookup_stats *stats = &dm_stats[type];
+
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	stats->calls++;
+	if (found)
+		stats->found++;
+	if (start && !dm_stats_busy) {
+		dm_stats_busy = true;
+		stats->ticks += get_ticks() - start;
+		dm_stats_busy = false;
+	}
+}
+
+struct dm_lookup_stats *dm_get_lookup_stats(void)
+{
+	return dm_stats;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/*
+ * Each uclass has three hash tables of its devices, keyed by sequence
+ * number, device tree node and phandle, so that looking up a device does not
+ * need to walk the whole list. The tables are allocated when the first
+ * device is bound and doubled in size whenever the number of devices exceeds
+ * the number of buckets. Several devices may share a node, so lookups pick
+ * the matching device which was bound first, as a walk of the list would.
+ *
+ * Names are not indexed, since uclass_find_device_by_name() returns the
+ * first device whose name starts with the one given.
+ */
+#define UCLASS_INDEX_MIN_BITS	3
+
+enum {
+	UCLASS_INDEX_SEQ,
+	UCLASS_INDEX_OFNODE,
+	UCLASS_INDEX_PHANDLE,
+
+	UCLASS_INDEX_COUNT,
+};
+
+static uint uclass_hash(ulong key, uint bits)
+{
+	u32 hash = (u32)key ^ (u32)((u64)key >> 32);
+
+	return (hash * 0x9e3779b1) >> (32 - bits);
+}
+
+static struct hlist_head *uclass_bucket(struct uclass *uc, int table,
+					uint hash)
+{
+	return &uc->index[(table << uc->index_bits) + hash];
+}
+
+static void uclass_index_add_dev(struct uclass *uc, struct udevice *dev)
+{
+	uint bits = uc->index_bits;
+
+	if (dev->seq != -1)
+		hlist_add_head(&dev->seq_node,
+			       uclass_bucket(uc, UCLASS_INDEX_SEQ,
+					     uclass_hash(dev->seq, bits)));
+	if (!ofnode_valid(dev->node))
+		return;
+	hlist_add_head(&dev->ofnode_node,
+		       uclass_bucket(uc, UCLASS_INDEX_OFNODE,
+				     uclass_hash(dev->node.of_offset, bits)));
+	if (CONFIG_IS_ENABLED(OF_CONTROL)) {
+		uint phandle = dev_read_phandle(dev);
+
+		if (phandle)
+			hlist_add_head(&dev->phandle_node,
+				       uclass_bucket(uc, UCLASS_INDEX_PHANDLE,
+						     uclass_hash(phandle,
+								 bits)));
+	}
+}
+
+static void uclass_index_del_dev(struct udevice *dev)
+{
+	hlist_del_init(&dev->seq_node);
+	hlist_del_init(&dev->ofnode_node);
+	hlist_del_init(&dev->phandle_node);
+}
+
+static void uclass_index_free(struct uclass *uc)
+{
+	struct udevice *dev;
+
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		INIT_HLIST_NODE(&dev->seq_node);
+		INIT_HLIST_NODE(&dev->ofnode_node);
+		INIT_HLIST_NODE(&dev->phandle_node);
+	}
+	free(uc->index);
+	uc->index = NULL;
+}
+
+/* Allocate new tables with 1 << bits buckets and index all devices again */
+static int uclass_index_resize(struct uclass *uc, uint bits)
+{
+	struct hlist_head *index;
+	struct udevice *dev;
+
+	index = calloc(UCLASS_INDEX_COUNT << bits, sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+	free(uc->index);
+	uc->index = index;
+	uc->index_bits = bits;
+
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		INIT_HLIST_NODE(&dev->seq_node);
+		INIT_HLIST_NODE(&dev->ofnode_node);
+		INIT_HLIST_NODE(&dev->phandle_node);
+		uclass_index_add_dev(uc, dev);
+	}
+
+	return 0;
+}
+
+/* Called after dev has been added to the end of the uclass's list */
+static void uclass_index_bind(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+
+	dev->bind_order = uc->bind_count++;
+	uc->dev_count++;
+	/*
+	 * The simple malloc() used before relocation cannot free the old
+	 * tables when they grow, so wait for the full one. All devices are
+	 * added when the tables are first allocated.
+	 */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return;
+	if (!uc->index || uc->dev_count > 1U << uc->index_bits) {
+		uint bits = uc->index ? uc->index_bits + 1 :
+			UCLASS_INDEX_MIN_BITS;
+
+		while (uc->dev_count > 1U << bits)
+			bits++;
+		if (uclass_index_resize(uc, bits)) {
+			/* Carry on without an index, as before */
+			debug("%s: cannot index uclass %s\n", __func__,
+			      uc->uc_drv->name);
+			uclass_index_free(uc);
+		}
+		return;
+	}
+	uclass_index_add_dev(uc, dev);
+}
+
+static void uclass_index_unbind(struct udevice *dev)
+{
+	dev->uclass->dev_count--;
+	uclass_index_del_dev(dev);
+}
+
+void uclass_index_update(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+
+	/* Devices are only indexed once they are in the uclass's list */
+	if (!uc->index || list_empty(&dev->uclass_node))
+		return;
+	uclass_index_del_dev(dev);
+	uclass_index_add_dev(uc, dev);
+}
+
+static struct udevice *uclass_index_find_seq(struct uclass *uc, int seq)
+{
+	struct hlist_head *head;
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	head = uclass_bucket(uc, UCLASS_INDEX_SEQ,
+			     uclass_hash(seq, uc->index_bits));
+	hlist_for_each_entry(dev, pos, head, seq_node) {
+		/* Sequence numbers are unique within a uclass */
+		if (dev->seq == seq)
+			return dev;
+	}
+
+	return NULL;
+}
+
+static struct udevice *uclass_index_find_ofnode(struct uclass *uc,
+						ofnode node)
+{
+	struct udevice *dev, *found = NULL;
+	struct hlist_head *head;
+	struct hlist_node *pos;
+
+	head = uclass_bucket(uc, UCLASS_INDEX_OFNODE,
+			     uclass_hash(node.of_offset, uc->index_bits));
+	hlist_for_each_entry(dev, pos, head, ofnode_node) {
+		if (ofnode_equal(dev->node, node) &&
+		    (!found || dev->bind_order < found->bind_order))
+			found = dev;
+	}
+
+	return found;
+}
+
+#if CONFIG_IS_ENABLED(OF_CONTROL)
+static struct udevice *uclass_index_find_phandle(struct uclass *uc,
+						 uint phandle)
+{
+	struct udevice *dev, *found = NULL;
+	struct hlist_head *head;
+	struct hlist_node *pos;
+
+	head = uclass_bucket(uc, UCLASS_INDEX_PHANDLE,
+			     uclass_hash(phandle, uc->index_bits));
+	hlist_for_each_entry(dev, pos, head, phandle_node) {
+		if (dev_read_phandle(dev) == phandle &&
+		    (!found || dev->bind_order < found->bind_order))
+			found = dev;
+	}
+
+	return found;
+}
+#endif
+#else
+static inline void uclass_index_free(struct uclass *uc) {}
+static inline void uclass_index_bind(struct udevice *dev) {}
+static inline void uclass_index_unbind(struct udevice *dev) {}
+#endif
+
 struct uclass *uclass_find(enum uclass_id key)
 {
 	struct uclass *uc;
@@ -127,6 +377,7 @@ int uclass_destroy(struct uclass *uc)
 	uc_drv = uc->uc_drv;
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
+	uclass_index_free(uc);
 	list_del(&uc->sibling_node);
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
@@ -248,8 +499,9 @@ int uclass_find_next_device(struct udevice **devp)
 int uclass_find_device_by_name(enum uclass_id id, const char *name,
 			       struct udevice **devp)
 {
+	struct udevice *dev, *found = NULL;
 	struct uclass *uc;
-	struct udevice *dev;
+	u64 start;
 	int ret;
 
 	*devp = NULL;
@@ -259,14 +511,17 @@ int uclass_find_device_by_name(enum uclass_id id, const char *name,
 	if (ret)
 		return ret;
 
+	start = dm_stats_start();
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		if (!strncmp(dev->name, name, strlen(name))) {
-			*devp = dev;
-			return 0;
+			found = dev;
+			break;
 		}
 	}
+	dm_stats_end(DM_LOOKUP_NAME, start, found);
+	*devp = found;
 
-	return -ENODEV;
+	return found ? 0 : -ENODEV;
 }
 
 int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
@@ -274,6 +529,7 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 {
 	struct uclass *uc;
 	struct udevice *dev;
+	u64 start;
 	int ret;
 
 	*devp = NULL;
@@ -284,18 +540,32 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	if (ret)
 		return ret;
 
+	start = dm_stats_start();
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	/*
+	 * Drivers may set req_seq in their bind() method, so only seq is
+	 * indexed
+	 */
+	if (uc->index && !find_req_seq) {
+		*devp = uclass_index_find_seq(uc, seq_or_req_seq);
+		goto done;
+	}
+#endif
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		debug("   - %d %d '%s'\n", dev->req_seq, dev->seq, dev->name);
 		if ((find_req_seq ? dev->req_seq : dev->seq) ==
 				seq_or_req_seq) {
 			*devp = dev;
-			debug("   - found\n");
-			return 0;
+			break;
 		}
 	}
-	debug("   - not found\n");
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+done:
+#endif
+	dm_stats_end(DM_LOOKUP_SEQ, start, *devp);
+	debug("   - %s\n", *devp ? "found" : "not found");
 
-	return -ENODEV;
+	return *devp ? 0 : -ENODEV;
 }
 
 int uclass_find_device_by_of_offset(enum uclass_id id, int node,
@@ -327,6 +597,7 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 {
 	struct uclass *uc;
 	struct udevice *dev;
+	u64 start;
 	int ret;
 
 	log(LOGC_DM, LOGL_DEBUG, "Looking for %s\n", ofnode_get_name(node));
@@ -337,6 +608,15 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	if (ret)
 		return ret;
 
+	start = dm_stats_start();
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (uc->index) {
+		*devp = uclass_index_find_ofnode(uc, node);
+		if (!*devp)
+			ret = -ENODEV;
+		goto done;
+	}
+#endif
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
 		    dev->name);
@@ -348,18 +628,85 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	ret = -ENODEV;
 
 done:
+	dm_stats_end(DM_LOOKUP_OFNODE, start, *devp);
 	log(LOGC_DM, LOGL_DEBUG, "   - result for %s: %s (ret=%d)\n",
 	    ofnode_get_name(node), *devp ? (*devp)->name : "(none)", ret);
 	return ret;
 }
 
+void uclass_find_next_device_by_ofnode(struct uclass *uc, ofnode node,
+				       struct udevice **devp)
+{
+	struct udevice *dev = *devp;
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (uc->index) {
+		struct hlist_node *pos;
+
+		if (dev) {
+			pos = dev->ofnode_node.next;
+		} else {
+			pos = uclass_bucket(uc, UCLASS_INDEX_OFNODE,
+					    uclass_hash(node.of_offset,
+							uc->index_bits))->first;
+		}
+		hlist_for_each_entry_from(dev, pos, ofnode_node) {
+			if (ofnode_equal(dev->node, node)) {
+				*devp = dev;
+				return;
+			}
+		}
+		*devp = NULL;
+		return;
+	}
+#endif
+	dev = list_prepare_entry(dev, &uc->dev_head, uclass_node);
+	list_for_each_entry_continue(dev, &uc->dev_head, uclass_node) {
+		if (ofnode_equal(dev->node, node)) {
+			*devp = dev;
+			return;
+		}
+	}
+	*devp = NULL;
+}
+
 #if CONFIG_IS_ENABLED(OF_CONTROL)
+static struct udevice *uclass_find_by_phandle_id(struct uclass *uc,
+						 uint phandle_id)
+{
+	struct udevice *dev, *found = NULL;
+	u64 start;
+
+	start = dm_stats_start();
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (uc->index) {
+		found = uclass_index_find_phandle(uc, phandle_id);
+		goto done;
+	}
+#endif
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		uint phandle;
+
+		phandle = dev_read_phandle(dev);
+
+		if (phandle == phandle_id) {
+			found = dev;
+			break;
+		}
+	}
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+done:
+#endif
+	dm_stats_end(DM_LOOKUP_PHANDLE, start, found);
+
+	return found;
+}
+
 static int uclass_find_device_by_phandle(enum uclass_id id,
 					 struct udevice *parent,
 					 const char *name,
 					 struct udevice **devp)
 {
-	struct udevice *dev;
 	struct uclass *uc;
 	int find_phandle;
 	int ret;
@@ -372,18 +719,9 @@ static int uclass_find_device_by_phandle(enum uclass_id id,
 	if (ret)
 		return ret;
 
-	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
-		uint phandle;
-
-		phandle = dev_read_phandle(dev);
-
-		if (phandle == find_phandle) {
-			*devp = dev;
-			return 0;
-		}
-	}
+	*devp = uclass_find_by_phandle_id(uc, find_phandle);
 
-	return -ENODEV;
+	return *devp ? 0 : -ENODEV;
 }
 #endif
 
@@ -499,18 +837,11 @@ int uclass_get_device_by_phandle_id(enum uclass_id id, uint phandle_id,
 	if (ret)
 		return ret;
 
-	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
-		uint phandle;
-
-		phandle = dev_read_phandle(dev);
-
-		if (phandle == phandle_id) {
-			*devp = dev;
-			return uclass_get_device_tail(dev, ret, devp);
-		}
-	}
+	dev = uclass_find_by_phandle_id(uc, phandle_id);
+	if (!dev)
+		return -ENODEV;
 
-	return -ENODEV;
+	return uclass_get_device_tail(dev, 0, devp);
 }
 
 int uclass_get_device_by_phandle(enum uclass_id id, struct udevice *parent,
@@ -596,6 +927,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_index_bind(dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -610,6 +942,7 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
+	uclass_index_unbind(dev);
 	list_del(&dev->uclass_node);
 
 	return ret;
@@ -628,6 +961,7 @@ int uclass_unbind_device(struct udevice *dev)
 			return ret;
 	}
 
+	uclass_index_unbind(dev);
 	list_del(&dev->uclass_node);
 	return 0;
 }
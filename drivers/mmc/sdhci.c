@@ -10,6 +10,7 @@
 #include <common.h>
 #include <errno.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <mmc.h>
 #include <sdhci.h>
 
@@ -19,6 +20,8 @@ void *aligned_buffer = (void *)CONFIG_FIXED_SDHCI_ALIGNED_BUFFER;
 void *aligned_buffer;
 #endif
 
+#define SDHCI_ALIGNED_BUFFER_SIZE	(512 * 1024)
+
 static void sdhci_reset(struct sdhci_host *host, u8 mask)
 {
 	unsigned long timeout;
@@ -67,18 +70,121 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 	}
 }
 
-static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
-				unsigned int start_addr)
+#ifdef CONFIG_MMC_SDHCI_ADMA
+static void sdhci_adma_desc(struct sdhci_adma_desc *desc, dma_addr_t addr,
+			    u16 len, bool end)
+{
+	desc->attr = ADMA_DESC_ATTR_VALID | ADMA_DESC_TRANSFER_DATA;
+	if (end)
+		desc->attr |= ADMA_DESC_ATTR_END;
+	desc->reserved = 0;
+	desc->len = cpu_to_le16(len);
+	desc->addr_lo = cpu_to_le32(lower_32_bits(addr));
+#ifdef CONFIG_DMA_ADDR_T_64BIT
+	desc->addr_hi = cpu_to_le32(upper_32_bits(addr));
+#endif
+}
+
+/*
+ * Describe the whole transfer in one descriptor chain, so that the
+ * controller moves all the blocks without the CPU having to restart it.
+ */
+static void sdhci_prepare_adma_table(struct sdhci_host *host,
+				     dma_addr_t addr, int trans_bytes)
+{
+	struct sdhci_adma_desc *desc = host->adma_desc_table;
+	dma_addr_t table = (ulong)host->adma_desc_table;
+
+	while (trans_bytes > ADMA_MAX_LEN) {
+		sdhci_adma_desc(desc++, addr, ADMA_MAX_LEN, false);
+		addr += ADMA_MAX_LEN;
+		trans_bytes -= ADMA_MAX_LEN;
+	}
+	sdhci_adma_desc(desc++, addr, trans_bytes, true);
+
+	flush_cache(table, ALIGN((ulong)desc - (ulong)table,
+				 CONFIG_SYS_CACHELINE_SIZE));
+
+	sdhci_writel(host, lower_32_bits(table), SDHCI_ADMA_ADDRESS);
+	if (host->flags & USE_ADMA64)
+		sdhci_writel(host, upper_32_bits(table),
+			     SDHCI_ADMA_ADDRESS_HI);
+}
+#endif
+
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
+/* Transfer through aligned_buffer, copying read data back when done */
+static void sdhci_bounce(struct mmc_data *data, dma_addr_t *start_addr,
+			 int *is_aligned, int trans_bytes)
+{
+	*is_aligned = 0;
+	*start_addr = (unsigned long)aligned_buffer;
+	if (data->flags != MMC_DATA_READ)
+		memcpy(aligned_buffer, data->src, trans_bytes);
+}
+
+static int sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
+			     dma_addr_t *start_addr, int *is_aligned,
+			     int trans_bytes)
 {
-	unsigned int stat, rdy, mask, timeout, block = 0;
-	bool transfer_done = false;
-#ifdef CONFIG_MMC_SDHCI_SDMA
 	unsigned char ctrl;
+
 	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	if (host->flags & USE_ADMA64)
+		ctrl |= SDHCI_CTRL_ADMA64;
+	else if (host->flags & USE_ADMA)
+		ctrl |= SDHCI_CTRL_ADMA32;
 	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+
+	if (data->flags == MMC_DATA_READ)
+		*start_addr = (unsigned long)data->dest;
+	else
+		*start_addr = (unsigned long)data->src;
+	if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+			(*start_addr & 0x7) != 0x0)
+		sdhci_bounce(data, start_addr, is_aligned, trans_bytes);
+
+#if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
+	/*
+	 * Always use this bounce-buffer when
+	 * CONFIG_FIXED_SDHCI_ALIGNED_BUFFER is defined
+	 */
+	sdhci_bounce(data, start_addr, is_aligned, trans_bytes);
 #endif
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (host->flags & (USE_ADMA | USE_ADMA64)) {
+		/* Descriptors can only point at 32-bit aligned data */
+		if (*start_addr & (ADMA_ALIGN - 1)) {
+			if (!aligned_buffer)
+				aligned_buffer = memalign(ARCH_DMA_MINALIGN,
+						SDHCI_ALIGNED_BUFFER_SIZE);
+			if (!aligned_buffer ||
+			    trans_bytes > SDHCI_ALIGNED_BUFFER_SIZE) {
+				printf("%s: Unaligned buffer for ADMA\n",
+				       __func__);
+				return -EINVAL;
+			}
+			sdhci_bounce(data, start_addr, is_aligned,
+				     trans_bytes);
+		}
+		sdhci_prepare_adma_table(host, *start_addr, trans_bytes);
+		return 0;
+	}
+#endif
+	sdhci_writel(host, *start_addr, SDHCI_DMA_ADDRESS);
+
+	return 0;
+}
+#endif
+
+static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
+				dma_addr_t start_addr)
+{
+	unsigned int stat, rdy, mask, timeout, block = 0;
+	bool transfer_done = false;
+
 	timeout = 1000000;
 	rdy = SDHCI_INT_SPACE_AVAIL | SDHCI_INT_DATA_AVAIL;
 	mask = SDHCI_DATA_AVAILABLE | SDHCI_SPACE_AVAILABLE;
@@ -105,7 +211,8 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 			}
 		}
 #ifdef CONFIG_MMC_SDHCI_SDMA
-		if (!transfer_done && (stat & SDHCI_INT_DMA_END)) {
+		if (!transfer_done && (stat & SDHCI_INT_DMA_END) &&
+		    (host->flags & USE_SDMA)) {
 			sdhci_writel(host, SDHCI_INT_DMA_END, SDHCI_INT_STATUS);
 			start_addr &= ~(SDHCI_DEFAULT_BOUNDARY_SIZE - 1);
 			start_addr += SDHCI_DEFAULT_BOUNDARY_SIZE;
@@ -149,7 +256,8 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	int ret = 0;
 	int trans_bytes = 0, is_aligned = 1;
 	u32 mask, flags, mode;
-	unsigned int time = 0, start_addr = 0;
+	unsigned int time = 0;
+	dma_addr_t start_addr = 0;
 	int mmc_dev = mmc_get_blk_desc(mmc)->devnum;
 	ulong start = get_timer(0);
 
@@ -218,32 +326,14 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->flags == MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
-#ifdef CONFIG_MMC_SDHCI_SDMA
-		if (data->flags == MMC_DATA_READ)
-			start_addr = (unsigned long)data->dest;
-		else
-			start_addr = (unsigned long)data->src;
-		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				(start_addr & 0x7) != 0x0) {
-			is_aligned = 0;
-			start_addr = (unsigned long)aligned_buffer;
-			if (data->flags != MMC_DATA_READ)
-				memcpy(aligned_buffer, data->src, trans_bytes);
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
+		if (host->flags & USE_DMA) {
+			ret = sdhci_prepare_dma(host, data, &start_addr,
+						&is_aligned, trans_bytes);
+			if (ret)
+				return ret;
+			mode |= SDHCI_TRNS_DMA;
 		}
-
-#if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
-		/*
-		 * Always use this bounce-buffer when
-		 * CONFIG_FIXED_SDHCI_ALIGNED_BUFFER is defined
-		 */
-		is_aligned = 0;
-		start_addr = (unsigned long)aligned_buffer;
-		if (data->flags != MMC_DATA_READ)
-			memcpy(aligned_buffer, data->src, trans_bytes);
-#endif
-
-		sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
-		mode |= SDHCI_TRNS_DMA;
 #endif
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
 				data->blocksize),
@@ -255,11 +345,10 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	}
 
 	sdhci_writel(host, cmd->cmdarg, SDHCI_ARGUMENT);
-#ifdef CONFIG_MMC_SDHCI_SDMA
-	if (data) {
-		trans_bytes = ALIGN(trans_bytes, CONFIG_SYS_CACHELINE_SIZE);
-		flush_cache(start_addr, trans_bytes);
-	}
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
+	if (data && (host->flags & USE_DMA))
+		flush_cache(start_addr,
+			    ALIGN(trans_bytes, CONFIG_SYS_CACHELINE_SIZE));
 #endif
 	sdhci_writew(host, SDHCI_MAKE_CMD(cmd->cmdidx, flags), SDHCI_COMMAND);
 	start = get_timer(0);
@@ -294,8 +383,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	stat = sdhci_readl(host, SDHCI_INT_STATUS);
 	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
 	if (!ret) {
-		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				!is_aligned && (data->flags == MMC_DATA_READ))
+		if (!is_aligned && (data->flags == MMC_DATA_READ))
 			memcpy(data->dest, aligned_buffer, trans_bytes);
 		return 0;
 	}
@@ -512,7 +600,7 @@ static int sdhci_init(struct mmc *mmc)
 	sdhci_reset(host, SDHCI_RESET_ALL);
 
 	if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) && !aligned_buffer) {
-		aligned_buffer = memalign(8, 512*1024);
+		aligned_buffer = memalign(8, SDHCI_ALIGNED_BUFFER_SIZE);
 		if (!aligned_buffer) {
 			printf("%s: Aligned buffer alloc failed!!!\n",
 			       __func__);
@@ -564,11 +652,34 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 
 	caps = sdhci_readl(host, SDHCI_CAPABILITIES);
 
-#ifdef CONFIG_MMC_SDHCI_SDMA
-	if (!(caps & SDHCI_CAN_DO_SDMA)) {
-		printf("%s: Your controller doesn't support SDMA!!\n",
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	/* ADMA2 is preferred as it needs no restart at buffer boundaries */
+	if (!(caps & SDHCI_CAN_DO_ADMA2)) {
+		printf("%s: Your controller doesn't support ADMA2!!\n",
 		       __func__);
-		return -EINVAL;
+	} else if (IS_ENABLED(CONFIG_DMA_ADDR_T_64BIT) &&
+		   !(caps & SDHCI_CAN_64BIT)) {
+		printf("%s: Your controller doesn't support 64-bit ADMA!!\n",
+		       __func__);
+	} else {
+		if (!host->adma_desc_table)
+			host->adma_desc_table = memalign(ARCH_DMA_MINALIGN,
+							 ADMA_TABLE_SZ);
+		if (host->adma_desc_table)
+			host->flags |= IS_ENABLED(CONFIG_DMA_ADDR_T_64BIT) ?
+				USE_ADMA64 : USE_ADMA;
+	}
+#endif
+#ifdef CONFIG_MMC_SDHCI_SDMA
+	/* SDMA is only needed if ADMA2 cannot be used */
+	if (!(host->flags & (USE_ADMA | USE_ADMA64))) {
+		if (!(caps & SDHCI_CAN_DO_SDMA)) {
+			printf("%s: Your controller doesn't support SDMA!!\n",
+			       __func__);
+			return -EINVAL;
+		}
+
+		host->flags |= USE_SDMA;
 	}
 #endif
 	if (host->quirks & SDHCI_QUIRK_REG32_RW)
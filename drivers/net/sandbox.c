@@ -10,26 +10,42 @@
 #include <dm.h>
 #include <malloc.h>
 #include <net.h>
+#include <asm/eth.h>
 #include <asm/test.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Number of packets that can be waiting to be received */
+#define SANDBOX_ETH_RX_QUEUE	32
+
 /**
  * struct eth_sandbox_priv - memory for sandbox mock driver
  *
  * fake_host_hwaddr: MAC address of mocked machine
  * fake_host_ipaddr: IP address of mocked machine
- * recv_packet_buffer: buffer of the packet returned as received
- * recv_packet_length: length of the packet returned as received
+ * recv_packet_buffer: queue of packets to be returned as received. Buffers
+ *	come from the receive buffer pool and are returned to it when the
+ *	packet is freed
+ * recv_packet_length: lengths of the packets in the queue
+ * recv_payload: where the payload of each packet in the queue was placed,
+ *	NULL if it is in the buffer with the rest of the packet
+ * recv_head: index of the first packet in the queue
+ * recv_packets: number of packets in the queue
  */
 struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
-	uchar *recv_packet_buffer;
-	int recv_packet_length;
+	uchar *recv_packet_buffer[SANDBOX_ETH_RX_QUEUE];
+	int recv_packet_length[SANDBOX_ETH_RX_QUEUE];
+	void *recv_payload[SANDBOX_ETH_RX_QUEUE];
+	int recv_head;
+	int recv_packets;
 };
 
 static bool disabled[8] = {false};
+static sandbox_eth_tx_hand_f *tx_handler[8];
+static int csum_offload[8];
+static int placed[8];
 static bool skip_timeout;
 
 /*
@@ -53,103 +69,334 @@ void sandbox_eth_skip_timeout(void)
 	skip_timeout = true;
 }
 
+/*
+ * sandbox_eth_set_tx_handler()
+ *
+ * index - The alias index (also DM seq number)
+ * handler - Function to handle packets sent on this device, or NULL to use
+ *	the default handler, which answers ARP requests and pings
+ */
+void sandbox_eth_set_tx_handler(int index, sandbox_eth_tx_hand_f *handler)
+{
+	tx_handler[index] = handler;
+}
+
+/*
+ * sandbox_eth_set_csum_offload()
+ *
+ * index - The alias index (also DM seq number)
+ * flags - Checksums (enum eth_csum_offload) the device handles as hardware
+ *	would: filling them in on sent packets and dropping received packets
+ *	where they are wrong
+ */
+void sandbox_eth_set_csum_offload(int index, int flags)
+{
+	csum_offload[index] = flags;
+}
+
+static int sb_eth_get_csum_offload(struct udevice *dev)
+{
+	if (dev->seq < 0 || dev->seq >= ARRAY_SIZE(csum_offload))
+		return 0;
+
+	return csum_offload[dev->seq];
+}
+
+/* Returns the IP header if this is an IPv4 packet which is long enough */
+static struct ip_udp_hdr *sb_eth_ip_hdr(void *packet, int length)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+
+	if (length < ETHER_HDR_SIZE + IP_UDP_HDR_SIZE ||
+	    ntohs(eth->et_protlen) != PROT_IP)
+		return NULL;
+	if (ip->ip_p == IPPROTO_UDP &&
+	    ntohs(ip->udp_len) > length - ETHER_HDR_SIZE - IP_HDR_SIZE)
+		return NULL;
+
+	return ip;
+}
+
+/* Fills in the checksums the device offloads, as the hardware would */
+static void sb_eth_tx_csum(struct udevice *dev, void *packet, int length)
+{
+	int flags = sb_eth_get_csum_offload(dev);
+	struct ip_udp_hdr *ip;
+	unsigned sum;
+
+	ip = sb_eth_ip_hdr(packet, length);
+	if (!flags || !ip)
+		return;
+	if (flags & ETH_CSUM_TX_IP) {
+		ip->ip_sum = 0;
+		ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+	}
+	if ((flags & ETH_CSUM_TX_UDP) && ip->ip_p == IPPROTO_UDP) {
+		ip->udp_xsum = 0;
+		sum = compute_udp_checksum(ip);
+		ip->udp_xsum = sum ? sum : 0xffff;
+	}
+}
+
+/* Checks the checksums the device offloads, as the hardware would */
+static bool sb_eth_rx_csum_ok(struct udevice *dev, void *packet, int length)
+{
+	int flags = sb_eth_get_csum_offload(dev);
+	struct ip_udp_hdr *ip;
+
+	ip = sb_eth_ip_hdr(packet, length);
+	if (!flags || !ip)
+		return true;
+	if ((flags & ETH_CSUM_RX_IP) && !ip_checksum_ok(ip, IP_HDR_SIZE))
+		return false;
+	if ((flags & ETH_CSUM_RX_UDP) && ip->ip_p == IPPROTO_UDP &&
+	    ip->udp_xsum && compute_udp_checksum(ip))
+		return false;
+
+	return true;
+}
+
+/*
+ * Returns the buffer for the next packet to be queued, or NULL if the queue
+ * is full or there is no free buffer in the pool
+ */
+static void *sb_eth_recv_slot(struct eth_sandbox_priv *priv)
+{
+	int slot;
+
+	if (priv->recv_packets == SANDBOX_ETH_RX_QUEUE)
+		return NULL;
+	slot = (priv->recv_head + priv->recv_packets) % SANDBOX_ETH_RX_QUEUE;
+	if (!priv->recv_packet_buffer[slot])
+		priv->recv_packet_buffer[slot] = net_rx_pool_alloc();
+
+	return priv->recv_packet_buffer[slot];
+}
+
+/* Drops all queued packets and returns their buffers to the pool */
+static void sb_eth_recv_flush(struct eth_sandbox_priv *priv)
+{
+	int i;
+
+	for (i = 0; i < SANDBOX_ETH_RX_QUEUE; i++) {
+		net_rx_pool_free(priv->recv_packet_buffer[i]);
+		priv->recv_packet_buffer[i] = NULL;
+	}
+	priv->recv_head = 0;
+	priv->recv_packets = 0;
+}
+
+/*
+ * Adds the packet written to the buffer from sb_eth_recv_slot(), with its
+ * payload at @payload if that is not NULL
+ */
+static void sb_eth_recv_commit(struct eth_sandbox_priv *priv, int length,
+			       void *payload)
+{
+	int slot;
+
+	slot = (priv->recv_head + priv->recv_packets) % SANDBOX_ETH_RX_QUEUE;
+	priv->recv_packet_length[slot] = length;
+	priv->recv_payload[slot] = payload;
+	priv->recv_packets++;
+}
+
+/*
+ * sandbox_eth_recv_queue()
+ *
+ * Add a packet to those waiting to be received. Returns -ENOSPC if the queue
+ * is full, or -EBADMSG if a checksum the device checks is wrong, in which
+ * case the packet is dropped as real hardware would do.
+ *
+ * Like a device which can split headers from data, this asks the network
+ * stack where the payload should go and copies it straight there.
+ */
+int sandbox_eth_recv_queue(struct udevice *dev, const void *packet,
+			   int length)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int offset, size;
+	void *buf, *dest;
+
+	if (!sb_eth_rx_csum_ok(dev, (void *)packet, length))
+		return -EBADMSG;
+	buf = sb_eth_recv_slot(priv);
+	if (!buf || length > PKTSIZE_ALIGN)
+		return -ENOSPC;
+	dest = net_rx_place(packet, length, &offset, &size);
+	if (dest) {
+		memcpy(buf, packet, offset);
+		memcpy(dest, packet + offset, size);
+		if (dev->seq >= 0 && dev->seq < ARRAY_SIZE(placed))
+			placed[dev->seq]++;
+	} else {
+		memcpy(buf, packet, length);
+	}
+	sb_eth_recv_commit(priv, length, dest);
+
+	return 0;
+}
+
+/*
+ * sandbox_eth_get_placed()
+ *
+ * index - The alias index (also DM seq number)
+ *
+ * Returns the number of packets received with their payload placed by the
+ * network stack since the last call, and resets the count
+ */
+int sandbox_eth_get_placed(int index)
+{
+	int count = placed[index];
+
+	placed[index] = 0;
+
+	return count;
+}
+
+/*
+ * sandbox_eth_get_fake_host()
+ *
+ * Returns the hardware and IP address of the mocked machine. The IP address
+ * is learnt from the last ARP request.
+ */
+void sandbox_eth_get_fake_host(struct udevice *dev, uchar *hwaddr,
+			       struct in_addr *ipaddr)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	memcpy(hwaddr, priv->fake_host_hwaddr, ARP_HLEN);
+	*ipaddr = priv->fake_host_ipaddr;
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
 
 	debug("eth_sandbox: Start\n");
 
-	priv->recv_packet_buffer = net_rx_packets[0];
+	sb_eth_recv_flush(priv);
 
 	return 0;
 }
 
-static int sb_eth_send(struct udevice *dev, void *packet, int length)
+/*
+ * sandbox_eth_arp_req_to_reply()
+ *
+ * Check if a packet is an ARP request and if so queue a reply to it. Returns
+ * 0 if a reply was queued, -EAGAIN if the packet is not an ARP request.
+ */
+int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
+				 unsigned int len)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
 	struct ethernet_hdr *eth = packet;
+	struct arp_hdr *arp = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_recv;
+	struct arp_hdr *arp_recv;
+
+	if (ntohs(eth->et_protlen) != PROT_ARP ||
+	    ntohs(arp->ar_op) != ARPOP_REQUEST)
+		return -EAGAIN;
+
+	/* store this as the assumed IP of the fake host */
+	priv->fake_host_ipaddr = net_read_ip(&arp->ar_tpa);
+	/* Formulate a fake response */
+	eth_recv = sb_eth_recv_slot(priv);
+	if (!eth_recv)
+		return -ENOSPC;
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_ARP);
+
+	arp_recv = (void *)eth_recv + ETHER_HDR_SIZE;
+	arp_recv->ar_hrd = htons(ARP_ETHER);
+	arp_recv->ar_pro = htons(PROT_IP);
+	arp_recv->ar_hln = ARP_HLEN;
+	arp_recv->ar_pln = ARP_PLEN;
+	arp_recv->ar_op = htons(ARPOP_REPLY);
+	memcpy(&arp_recv->ar_sha, priv->fake_host_hwaddr, ARP_HLEN);
+	net_write_ip(&arp_recv->ar_spa, priv->fake_host_ipaddr);
+	memcpy(&arp_recv->ar_tha, &arp->ar_sha, ARP_HLEN);
+	net_copy_ip(&arp_recv->ar_tpa, &arp->ar_spa);
+
+	sb_eth_recv_commit(priv, ETHER_HDR_SIZE + ARP_HDR_SIZE, NULL);
 
-	debug("eth_sandbox: Send packet %d\n", length);
+	return 0;
+}
 
-	if (dev->seq >= 0 && dev->seq < ARRAY_SIZE(disabled) &&
-	    disabled[dev->seq])
-		return 0;
+/*
+ * sandbox_eth_ping_req_to_reply()
+ *
+ * Check if a packet is an ICMP echo request and if so queue a reply to it.
+ * Returns 0 if a reply was queued, -EAGAIN if the packet is not a ping.
+ */
+int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
+				  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct icmp_hdr *icmp = (struct icmp_hdr *)&ip->udp_src;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+	struct icmp_hdr *icmpr;
+
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_ICMP ||
+	    icmp->type != ICMP_ECHO_REQUEST)
+		return -EAGAIN;
+
+	/* reply to the ping */
+	eth_recv = sb_eth_recv_slot(priv);
+	if (!eth_recv)
+		return -ENOSPC;
+	memcpy(eth_recv, packet, len);
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	icmpr = (struct icmp_hdr *)&ipr->udp_src;
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	ipr->ip_sum = 0;
+	ipr->ip_off = 0;
+	net_copy_ip((void *)&ipr->ip_dst, &ip->ip_src);
+	net_write_ip((void *)&ipr->ip_src, priv->fake_host_ipaddr);
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+
+	icmpr->type = ICMP_ECHO_REPLY;
+	icmpr->checksum = 0;
+	icmpr->checksum = compute_ip_checksum(icmpr, ICMP_HDR_SIZE);
+
+	sb_eth_recv_commit(priv, len, NULL);
 
-	if (ntohs(eth->et_protlen) == PROT_ARP) {
-		struct arp_hdr *arp = packet + ETHER_HDR_SIZE;
-
-		if (ntohs(arp->ar_op) == ARPOP_REQUEST) {
-			struct ethernet_hdr *eth_recv;
-			struct arp_hdr *arp_recv;
-
-			/* store this as the assumed IP of the fake host */
-			priv->fake_host_ipaddr = net_read_ip(&arp->ar_tpa);
-			/* Formulate a fake response */
-			eth_recv = (void *)priv->recv_packet_buffer;
-			memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
-			memcpy(eth_recv->et_src, priv->fake_host_hwaddr,
-			       ARP_HLEN);
-			eth_recv->et_protlen = htons(PROT_ARP);
-
-			arp_recv = (void *)priv->recv_packet_buffer +
-				ETHER_HDR_SIZE;
-			arp_recv->ar_hrd = htons(ARP_ETHER);
-			arp_recv->ar_pro = htons(PROT_IP);
-			arp_recv->ar_hln = ARP_HLEN;
-			arp_recv->ar_pln = ARP_PLEN;
-			arp_recv->ar_op = htons(ARPOP_REPLY);
-			memcpy(&arp_recv->ar_sha, priv->fake_host_hwaddr,
-			       ARP_HLEN);
-			net_write_ip(&arp_recv->ar_spa, priv->fake_host_ipaddr);
-			memcpy(&arp_recv->ar_tha, &arp->ar_sha, ARP_HLEN);
-			net_copy_ip(&arp_recv->ar_tpa, &arp->ar_spa);
-
-			priv->recv_packet_length = ETHER_HDR_SIZE +
-				ARP_HDR_SIZE;
-		}
-	} else if (ntohs(eth->et_protlen) == PROT_IP) {
-		struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
-
-		if (ip->ip_p == IPPROTO_ICMP) {
-			struct icmp_hdr *icmp = (struct icmp_hdr *)&ip->udp_src;
-
-			if (icmp->type == ICMP_ECHO_REQUEST) {
-				struct ethernet_hdr *eth_recv;
-				struct ip_udp_hdr *ipr;
-				struct icmp_hdr *icmpr;
-
-				/* reply to the ping */
-				memcpy(priv->recv_packet_buffer, packet,
-				       length);
-				eth_recv = (void *)priv->recv_packet_buffer;
-				ipr = (void *)priv->recv_packet_buffer +
-					ETHER_HDR_SIZE;
-				icmpr = (struct icmp_hdr *)&ipr->udp_src;
-				memcpy(eth_recv->et_dest, eth->et_src,
-				       ARP_HLEN);
-				memcpy(eth_recv->et_src, priv->fake_host_hwaddr,
-				       ARP_HLEN);
-				ipr->ip_sum = 0;
-				ipr->ip_off = 0;
-				net_copy_ip((void *)&ipr->ip_dst, &ip->ip_src);
-				net_write_ip((void *)&ipr->ip_src,
-					     priv->fake_host_ipaddr);
-				ipr->ip_sum = compute_ip_checksum(ipr,
-					IP_HDR_SIZE);
-
-				icmpr->type = ICMP_ECHO_REPLY;
-				icmpr->checksum = 0;
-				icmpr->checksum = compute_ip_checksum(icmpr,
-					ICMP_HDR_SIZE);
-
-				priv->recv_packet_length = length;
-			}
-		}
-	}
+	return 0;
+}
+
+static int sb_default_handler(struct udevice *dev, void *packet,
+			      unsigned int len)
+{
+	if (sandbox_eth_arp_req_to_reply(dev, packet, len) == -EAGAIN)
+		sandbox_eth_ping_req_to_reply(dev, packet, len);
 
 	return 0;
 }
 
+static int sb_eth_send(struct udevice *dev, void *packet, int length)
+{
+	sandbox_eth_tx_hand_f *handler = sb_default_handler;
+
+	debug("eth_sandbox: Send packet %d\n", length);
+
+	if (dev->seq >= 0 && dev->seq < ARRAY_SIZE(disabled)) {
+		if (disabled[dev->seq])
+			return 0;
+		if (tx_handler[dev->seq])
+			handler = tx_handler[dev->seq];
+	}
+	sb_eth_tx_csum(dev, packet, length);
+
+	return handler(dev, packet, length);
+}
+
 static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -159,21 +406,67 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		skip_timeout = false;
 	}
 
-	if (priv->recv_packet_length) {
-		int lcl_recv_packet_length = priv->recv_packet_length;
+	if (priv->recv_packets) {
+		int lcl_recv_packet_length =
+			priv->recv_packet_length[priv->recv_head];
 
 		debug("eth_sandbox: received packet %d\n",
-		      priv->recv_packet_length);
-		priv->recv_packet_length = 0;
-		*packetp = priv->recv_packet_buffer;
+		      lcl_recv_packet_length);
+		*packetp = priv->recv_packet_buffer[priv->recv_head];
 		return lcl_recv_packet_length;
 	}
 	return 0;
 }
 
+static int sb_eth_recv_batch(struct udevice *dev, int flags,
+			     struct eth_rx_desc *descs, int max)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int count, slot, i;
+
+	if (skip_timeout) {
+		sandbox_timer_add_offset(11000UL);
+		skip_timeout = false;
+	}
+
+	count = min(max, priv->recv_packets);
+	for (i = 0; i < count; i++) {
+		slot = (priv->recv_head + i) % SANDBOX_ETH_RX_QUEUE;
+		descs[i].packet = priv->recv_packet_buffer[slot];
+		descs[i].length = priv->recv_packet_length[slot];
+		descs[i].payload = priv->recv_payload[slot];
+	}
+	debug("eth_sandbox: received %d packets\n", count);
+
+	return count;
+}
+
+static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int head = priv->recv_head;
+
+	/*
+	 * Packets are freed in the order they were received. Replies queued
+	 * while this packet was processed stay behind it.
+	 */
+	if (priv->recv_packets && packet == priv->recv_packet_buffer[head]) {
+		net_rx_pool_free(packet);
+		priv->recv_packet_buffer[head] = NULL;
+		priv->recv_head = (head + 1) % SANDBOX_ETH_RX_QUEUE;
+		priv->recv_packets--;
+	}
+
+	return 0;
+}
+
 static void sb_eth_stop(struct udevice *dev)
 {
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
 	debug("eth_sandbox: Stop\n");
+
+	sb_eth_recv_flush(priv);
 }
 
 static int sb_eth_write_hwaddr(struct udevice *dev)
@@ -189,12 +482,19 @@ static const struct eth_ops sb_eth_ops = {
 	.start			= sb_eth_start,
 	.send			= sb_eth_send,
 	.recv			= sb_eth_recv,
+	.recv_batch		= sb_eth_recv_batch,
+	.free_pkt		= sb_eth_free_pkt,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
+	.get_csum_offload	= sb_eth_get_csum_offload,
 };
 
 static int sb_eth_remove(struct udevice *dev)
 {
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	sb_eth_recv_flush(priv);
+
 	return 0;
 }
 
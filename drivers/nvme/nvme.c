@@ -10,9 +10,10 @@
 #include <memalign.h>
 #include <pci.h>
 #include <dm/device-internal.h>
+#include <linux/log2.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		64
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
@@ -20,6 +21,9 @@
 #define IO_TIMEOUT		30
 #define MAX_PRP_POOL		512
 
+/* Set in blk_request->drv_priv when one of its commands fails */
+#define NVME_REQ_FAILED		(1UL << 31)
+
 enum nvme_queue_id {
 	NVME_ADMIN_Q,
 	NVME_IO_Q,
@@ -669,6 +673,80 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+/**
+ * nvme_process_cq() - complete queued block requests
+ *
+ * This handles all entries in the I/O completion queue which were
+ * generated by commands from nvme_blk_submit().
+ *
+ * @dev:	NVMe controller
+ * @return number of commands still outstanding
+ */
+static int nvme_process_cq(struct nvme_dev *dev)
+{
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct nvme_async_cmd *cmd;
+	struct blk_request *req;
+	u16 head, status, cid;
+
+	while (dev->async_count) {
+		head = nvmeq->cq_head;
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) != nvmeq->cq_phase)
+			break;
+		cid = le16_to_cpu(readw(&nvmeq->cqes[head].command_id));
+
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			nvmeq->cq_phase = !nvmeq->cq_phase;
+		}
+		writel(head, nvmeq->q_db + dev->db_stride);
+		nvmeq->cq_head = head;
+
+		if (cid >= dev->q_depth || !dev->async_cmds[cid].req) {
+			debug("%s: unexpected completion %u\n", __func__, cid);
+			continue;
+		}
+		cmd = &dev->async_cmds[cid];
+		req = cmd->req;
+		cmd->req = NULL;
+		dev->async_count--;
+
+		status >>= 1;
+		if (status) {
+			printf("ERROR: status = %x, command = %u\n", status,
+			       cid);
+			req->drv_priv |= NVME_REQ_FAILED;
+		} else {
+			if (req->op == BLK_REQ_READ)
+				invalidate_dcache_range((ulong)cmd->buffer,
+							(ulong)cmd->buffer +
+							cmd->len);
+			req->blks_done += cmd->lbas;
+		}
+		if (--req->drv_priv & ~NVME_REQ_FAILED)
+			continue;
+
+		blk_request_done(req, req->blks_done,
+				 req->drv_priv & NVME_REQ_FAILED ? -EIO : 0);
+	}
+
+	return dev->async_count;
+}
+
+/* Wait for all queued commands to complete */
+static int nvme_drain_cq(struct nvme_dev *dev)
+{
+	ulong start = get_timer(0);
+
+	while (nvme_process_cq(dev)) {
+		if (get_timer(start) > IO_TIMEOUT * 1000)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
@@ -685,6 +763,10 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
 	u64 total_lbas = blkcnt;
 
+	/* Queued commands would consume our completion */
+	if (nvme_drain_cq(dev))
+		return -EIO;
+
 	if (!read)
 		flush_dcache_range((unsigned long)buffer,
 				   (unsigned long)buffer + total_len);
@@ -730,6 +812,128 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	return (total_len - temp_len) >> desc->log2blksz;
 }
 
+/* Set up the PRPs for a queued command, using its own PRP list page */
+static int nvme_setup_async_prps(struct nvme_dev *dev,
+				 struct nvme_async_cmd *cmd, u64 *prp2,
+				 int total_len, u64 dma_addr)
+{
+	u32 page_size = dev->page_size;
+	int offset = dma_addr & (page_size - 1);
+	int length = total_len - (page_size - offset);
+	int i, nprps;
+
+	if (length <= 0) {
+		*prp2 = 0;
+		return 0;
+	}
+
+	dma_addr += (page_size - offset);
+	if (length <= page_size) {
+		*prp2 = dma_addr;
+		return 0;
+	}
+
+	if (!cmd->prp_list) {
+		cmd->prp_list = memalign(page_size, page_size);
+		if (!cmd->prp_list)
+			return -ENOMEM;
+	}
+
+	nprps = DIV_ROUND_UP(length, page_size);
+	for (i = 0; i < nprps; i++, dma_addr += page_size)
+		cmd->prp_list[i] = cpu_to_le64(dma_addr);
+	flush_dcache_range((ulong)cmd->prp_list,
+			   (ulong)cmd->prp_list + page_size);
+	*prp2 = (ulong)cmd->prp_list;
+
+	return 0;
+}
+
+static int nvme_blk_submit(struct udevice *udev, struct blk_request *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	bool read = req->op == BLK_REQ_READ;
+	struct nvme_async_cmd *cmd;
+	struct nvme_command c;
+	lbaint_t left = req->blkcnt;
+	u64 slba = req->start;
+	void *buffer = req->buffer;
+	u32 max_lbas, lbas, len;
+	int ncmds, slot, ret;
+	u64 prp2;
+	ulong blks;
+
+	/* Each command's PRP list must fit in one page */
+	max_lbas = 1 << (min_t(u32, dev->max_transfer_shift,
+			       2 * ilog2(dev->page_size) - 3) - ns->lba_shift);
+	ncmds = DIV_ROUND_UP(req->blkcnt, max_lbas);
+
+	/* Too large to ever fit in the queue, so do it synchronously */
+	if (ncmds >= nvmeq->q_depth) {
+		blks = nvme_blk_rw(udev, req->start, req->blkcnt, req->buffer,
+				   read);
+		blk_request_done(req, blks, blks == req->blkcnt ? 0 : -EIO);
+		return 0;
+	}
+	if (dev->async_count + ncmds >= nvmeq->q_depth)
+		return -EBUSY;
+
+	if (!read)
+		flush_dcache_range((ulong)buffer,
+				   (ulong)buffer +
+				   (req->blkcnt << ns->lba_shift));
+
+	memset(&c, '\0', sizeof(c));
+	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
+	c.rw.nsid = cpu_to_le32(ns->ns_id);
+
+	req->drv_priv = ncmds;
+	for (slot = 0; left; left -= lbas) {
+		lbas = min_t(lbaint_t, left, max_lbas);
+		len = lbas << ns->lba_shift;
+
+		while (dev->async_cmds[slot].req)
+			slot++;
+		cmd = &dev->async_cmds[slot];
+		ret = nvme_setup_async_prps(dev, cmd, &prp2, len,
+					    (ulong)buffer);
+		if (ret) {
+			/* Fail the commands which were not issued */
+			req->drv_priv |= NVME_REQ_FAILED;
+			req->drv_priv -= DIV_ROUND_UP(left, max_lbas);
+			if (!(req->drv_priv & ~NVME_REQ_FAILED))
+				blk_request_done(req, req->blks_done, ret);
+			return 0;
+		}
+		cmd->req = req;
+		cmd->buffer = buffer;
+		cmd->len = len;
+		cmd->lbas = lbas;
+
+		c.rw.command_id = cpu_to_le16(slot);
+		c.rw.slba = cpu_to_le64(slba);
+		c.rw.length = cpu_to_le16(lbas - 1);
+		c.rw.prp1 = cpu_to_le64((ulong)buffer);
+		c.rw.prp2 = cpu_to_le64(prp2);
+		nvme_submit_cmd(nvmeq, &c);
+		dev->async_count++;
+
+		slba += lbas;
+		buffer += len;
+	}
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	return nvme_process_cq(ns->dev);
+}
+
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
 			   lbaint_t blkcnt, void *buffer)
 {
@@ -745,6 +949,8 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -765,6 +971,18 @@ static int nvme_bind(struct udevice *udev)
 	return device_set_name(udev, name);
 }
 
+static void nvme_free_async_cmds(struct nvme_dev *ndev)
+{
+	int i;
+
+	if (!ndev->async_cmds)
+		return;
+	for (i = 0; i < ndev->q_depth; i++)
+		free(ndev->async_cmds[i].prp_list);
+	free(ndev->async_cmds);
+	ndev->async_cmds = NULL;
+}
+
 static int nvme_probe(struct udevice *udev)
 {
 	int ret;
@@ -802,29 +1020,48 @@ static int nvme_probe(struct udevice *udev)
 	ndev->db_stride = 1 << NVME_CAP_STRIDE(ndev->cap);
 	ndev->dbs = ((void __iomem *)ndev->bar) + 4096;
 
+	ndev->async_cmds = calloc(ndev->q_depth, sizeof(*ndev->async_cmds));
+	if (!ndev->async_cmds) {
+		ret = -ENOMEM;
+		printf("Error: %s: Out of memory!\n", udev->name);
+		goto free_queue;
+	}
+
 	ret = nvme_configure_admin_queue(ndev);
 	if (ret)
-		goto free_queue;
+		goto free_async;
 
 	ret = nvme_setup_io_queues(ndev);
 	if (ret)
-		goto free_queue;
+		goto free_async;
 
 	nvme_get_info_from_identify(ndev);
 
 	return 0;
 
+free_async:
+	nvme_free_async_cmds(ndev);
 free_queue:
 	free((void *)ndev->queues);
 free_nvme:
 	return ret;
 }
 
+static int nvme_remove(struct udevice *udev)
+{
+	struct nvme_dev *ndev = dev_get_priv(udev);
+
+	nvme_free_async_cmds(ndev);
+
+	return 0;
+}
+
 U_BOOT_DRIVER(nvme) = {
 	.name	= "nvme",
 	.id	= UCLASS_NVME,
 	.bind	= nvme_bind,
 	.probe	= nvme_probe,
+	.remove	= nvme_remove,
 	.priv_auto_alloc_size = sizeof(struct nvme_dev),
 };
 
@@ -602,6 +602,18 @@ enum {
 	NVME_CSTS_SHST_MASK	= 3 << 2,
 };
 
+/*
+ * A read or write command issued on behalf of a queued block request. The
+ * command ID is the index of the entry in nvme_dev->async_cmds.
+ */
+struct nvme_async_cmd {
+	struct blk_request *req;
+	u64 *prp_list;
+	void *buffer;
+	u32 len;
+	u16 lbas;
+};
+
 /* Represents an NVM Express device. Each nvme_dev is a PCI function. */
 struct nvme_dev {
 	struct list_head node;
@@ -627,6 +639,8 @@ struct nvme_dev {
 	u64 *prp_pool;
 	u32 prp_entry_num;
 	u32 nn;
+	struct nvme_async_cmd *async_cmds;
+	int async_count;
 };
 
 /*
@@ -336,6 +336,24 @@ static int ns16550_serial_putc(struct udevice *dev, const char ch)
 	return 0;
 }
 
+static int ns16550_serial_puts(struct udevice *dev, const char *s, size_t len)
+{
+	struct NS16550 *const com_port = dev_get_priv(dev);
+	size_t i;
+
+	/* Once the holding register is empty, so is the whole FIFO */
+	if (!(serial_in(&com_port->lsr) & UART_LSR_THRE))
+		return -EAGAIN;
+	len = min_t(size_t, len, max(com_port->plat->fifo_size, 1));
+	for (i = 0; i < len; i++) {
+		serial_out(s[i], &com_port->thr);
+		if (s[i] == '\n')
+			WATCHDOG_RESET();
+	}
+
+	return len;
+}
+
 static int ns16550_serial_pending(struct udevice *dev, bool input)
 {
 	struct NS16550 *const com_port = dev_get_priv(dev);
@@ -465,6 +483,7 @@ int ns16550_serial_ofdata_to_platdata(struct udevice *dev)
 	plat->fcr = UART_FCR_DEFVAL;
 	if (port_type == PORT_JZ4780)
 		plat->fcr |= UART_FCR_UME;
+	plat->fifo_size = dev_read_u32_default(dev, "fifo-size", 16);
 
 	return 0;
 }
@@ -472,6 +491,7 @@ int ns16550_serial_ofdata_to_platdata(struct udevice *dev)
 
 const struct dm_serial_ops ns16550_serial_ops = {
 	.putc = ns16550_serial_putc,
+	.puts = ns16550_serial_puts,
 	.pending = ns16550_serial_pending,
 	.getc = ns16550_serial_getc,
 	.setbrg = ns16550_serial_setbrg,
@@ -19,6 +19,7 @@
 #include <video.h>
 #include <linux/compiler.h>
 #include <asm/state.h>
+#include <asm/test.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -41,6 +42,8 @@ struct sandbox_serial_platdata {
 
 struct sandbox_serial_priv {
 	bool start_of_line;
+	bool tx_busy;		/* puts() reports that the UART is full */
+	uint tx_count;		/* Number of characters written by puts() */
 };
 
 /**
@@ -103,6 +106,45 @@ static int sandbox_serial_putc(struct udevice *dev, const char ch)
 	return 0;
 }
 
+/* Write up to the end of the first line, so it can start with a colour */
+static int sandbox_serial_puts(struct udevice *dev, const char *s, size_t len)
+{
+	struct sandbox_serial_priv *priv = dev_get_priv(dev);
+	struct sandbox_serial_platdata *plat = dev->platdata;
+	const char *nl;
+
+	if (priv->tx_busy)
+		return -EAGAIN;
+	if (priv->start_of_line && plat->colour != -1) {
+		priv->start_of_line = false;
+		output_ansi_colour(plat->colour);
+	}
+
+	nl = memchr(s, '\n', len);
+	if (nl)
+		len = nl + 1 - s;
+	os_write(1, s, len);
+	if (nl)
+		priv->start_of_line = true;
+	priv->tx_count += len;
+
+	return len;
+}
+
+void sandbox_serial_set_tx_busy(struct udevice *dev, bool busy)
+{
+	struct sandbox_serial_priv *priv = dev_get_priv(dev);
+
+	priv->tx_busy = busy;
+}
+
+uint sandbox_serial_get_tx_count(struct udevice *dev)
+{
+	struct sandbox_serial_priv *priv = dev_get_priv(dev);
+
+	return priv->tx_count;
+}
+
 static unsigned int increment_buffer_index(unsigned int index)
 {
 	return (index + 1) % ARRAY_SIZE(serial_buf);
@@ -171,6 +213,7 @@ static int sandbox_serial_ofdata_to_platdata(struct udevice *dev)
 
 static const struct dm_serial_ops sandbox_serial_ops = {
 	.putc = sandbox_serial_putc,
+	.puts = sandbox_serial_puts,
 	.pending = sandbox_serial_pending,
 	.getc = sandbox_serial_getc,
 };
@@ -166,11 +166,134 @@ void serial_initialize(void)
 	serial_init();
 }
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+/*
+ * Send the next run of characters from the TX buffer, as many as the UART
+ * will take. Returns false if it is busy.
+ */
+static bool serial_tx_next(struct udevice *dev, struct serial_dev_priv *upriv)
+{
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	uint rd = upriv->tx_rd & (CONFIG_SERIAL_TX_BUFFER_SIZE - 1);
+	uint len = min(upriv->tx_wr - upriv->tx_rd,
+		       CONFIG_SERIAL_TX_BUFFER_SIZE - rd);
+	int ret;
+
+	if (ops->puts) {
+		ret = ops->puts(dev, upriv->tx_buf + rd, len);
+	} else {
+		ret = ops->putc(dev, upriv->tx_buf[rd]);
+		if (!ret)
+			ret = 1;
+	}
+	if (ret == -EAGAIN)
+		return false;
+
+	/* On error, drop the output rather than get stuck */
+	upriv->tx_rd += ret > 0 ? ret : len;
+
+	return true;
+}
+
+/*
+ * Feed the UART from the TX buffer. Unless @wait, this stops as soon as
+ * the UART cannot take any more.
+ */
+static void serial_tx_drain(struct udevice *dev, bool wait)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	if (!upriv->tx_buf)
+		return;
+	while (upriv->tx_rd != upriv->tx_wr) {
+		if (!serial_tx_next(dev, upriv)) {
+			if (!wait)
+				break;
+			WATCHDOG_RESET();
+		}
+	}
+}
+
+static void serial_tx_add(struct udevice *dev, struct serial_dev_priv *upriv,
+			  char ch)
+{
+	if (ch == '\n')
+		serial_tx_add(dev, upriv, '\r');
+
+	/* If the buffer is full, wait for the UART to take something */
+	while (upriv->tx_wr - upriv->tx_rd == CONFIG_SERIAL_TX_BUFFER_SIZE) {
+		if (!serial_tx_next(dev, upriv))
+			WATCHDOG_RESET();
+	}
+	upriv->tx_buf[upriv->tx_wr++ & (CONFIG_SERIAL_TX_BUFFER_SIZE - 1)] = ch;
+}
+
+/* Set up the TX buffer once there is room in the full malloc() area */
+static void serial_tx_init(struct udevice *dev)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	/* The offsets are masked with the size, so it must be a power of 2 */
+	BUILD_BUG_ON(CONFIG_SERIAL_TX_BUFFER_SIZE &
+		     (CONFIG_SERIAL_TX_BUFFER_SIZE - 1));
+
+	if (gd->flags & GD_FLG_RELOC)
+		upriv->tx_buf = malloc(CONFIG_SERIAL_TX_BUFFER_SIZE);
+}
+
+static void serial_tx_remove(struct udevice *dev)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	serial_tx_drain(dev, true);
+	free(upriv->tx_buf);
+	upriv->tx_buf = NULL;
+}
+
+void serial_flush(void)
+{
+	struct udevice *dev = gd->cur_serial_dev;
+	struct dm_serial_ops *ops;
+
+	if (!dev)
+		return;
+	serial_tx_drain(dev, true);
+
+	/* Wait for the UART to send what it holds */
+	ops = serial_get_ops(dev);
+	if (ops->pending) {
+		while (ops->pending(dev, false) > 0)
+			WATCHDOG_RESET();
+	}
+}
+#else
+static inline void serial_tx_drain(struct udevice *dev, bool wait)
+{
+}
+
+static inline void serial_tx_init(struct udevice *dev)
+{
+}
+
+static inline void serial_tx_remove(struct udevice *dev)
+{
+}
+#endif /* CONFIG_IS_ENABLED(SERIAL_TX_BUFFER) */
+
 static void _serial_putc(struct udevice *dev, char ch)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 	int err;
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	if (upriv->tx_buf) {
+		serial_tx_add(dev, upriv, ch);
+		serial_tx_drain(dev, false);
+		return;
+	}
+#endif
 	if (ch == '\n')
 		_serial_putc(dev, '\r');
 
@@ -181,6 +304,17 @@ static void _serial_putc(struct udevice *dev, char ch)
 
 static void _serial_puts(struct udevice *dev, const char *str)
 {
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	/* Queue the whole string, then send what the UART can take */
+	if (upriv->tx_buf) {
+		while (*str)
+			serial_tx_add(dev, upriv, *str++);
+		serial_tx_drain(dev, false);
+		return;
+	}
+#endif
 	while (*str)
 		_serial_putc(dev, *str++);
 }
@@ -191,6 +325,7 @@ static int __serial_getc(struct udevice *dev)
 	int err;
 
 	do {
+		serial_tx_drain(dev, false);
 		err = ops->getc(dev);
 		if (err == -EAGAIN)
 			WATCHDOG_RESET();
@@ -203,6 +338,9 @@ static int __serial_tstc(struct udevice *dev)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 
+	/* Polling for input is a good time to send queued output */
+	serial_tx_drain(dev, false);
+
 	if (ops->pending)
 		return ops->pending(dev, true);
 
@@ -394,6 +532,8 @@ static int serial_post_probe(struct udevice *dev)
 		ops->getc += gd->reloc_off;
 	if (ops->putc)
 		ops->putc += gd->reloc_off;
+	if (ops->puts)
+		ops->puts += gd->reloc_off;
 	if (ops->pending)
 		ops->pending += gd->reloc_off;
 	if (ops->clear)
@@ -410,6 +550,8 @@ static int serial_post_probe(struct udevice *dev)
 			return ret;
 	}
 
+	serial_tx_init(dev);
+
 #ifdef CONFIG_DM_STDIO
 	if (!(gd->flags & GD_FLG_RELOC))
 		return 0;
@@ -441,6 +583,7 @@ static int serial_pre_remove(struct udevice *dev)
 	if (stdio_deregister_dev(upriv->sdev, true))
 		return -EPERM;
 #endif
+	serial_tx_remove(dev);
 
 	return 0;
 }
@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <console.h>
 #include <sysreset.h>
 #include <dm.h>
 #include <errno.h>
@@ -29,6 +30,8 @@ int sysreset_walk(enum sysreset_t type)
 	struct udevice *dev;
 	int ret = -ENOSYS;
 
+	/* Make sure the last output gets out before the reset */
+	console_flush();
 	while (ret != -EINPROGRESS && type < SYSRESET_COUNT) {
 		for (uclass_first_device(UCLASS_SYSRESET, &dev);
 		     dev;
@@ -14,6 +14,7 @@
 #include <search.h>
 #include <errno.h>
 #include <malloc.h>
+#include <memalign.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -100,6 +101,278 @@ int set_default_vars(int nvars, char * const vars[], int flags)
 				flags, 0, nvars, vars);
 }
 
+#ifdef CONFIG_ENV_APPEND_LOG
+/*
+ * Append log
+ *
+ * A full save writes the variables as usual, but fills the rest of the
+ * data area with 0xff, as read back from erased flash, and computes the
+ * CRC over that. Later saves only append a record with the variables
+ * which changed since then, so the environment does not have to be
+ * erased and rewritten each time. A record is a struct env_log_hdr
+ * followed by "name=value\0" entries, or "name\0" for a deleted
+ * variable. Records start on an ENV_LOG_ALIGN boundary after the end of
+ * the variables.
+ *
+ * On load the records are applied in order, up to the first one which is
+ * not valid, e.g. because writing it was interrupted. The CRC in the
+ * header keeps covering the variables and the erased log area.
+ *
+ * What is stored is only tracked for one location at a time, the one last
+ * loaded from or saved to. Saving to another location does a full save.
+ */
+#define ENV_LOG_MAGIC	0xe5
+#define ENV_LOG_ALIGN	4
+
+struct env_log_hdr {
+	uint8_t		magic;		/* ENV_LOG_MAGIC		*/
+	uint8_t		pad[3];
+	uint32_t	len;		/* length of the entries	*/
+	uint32_t	crc;		/* CRC32 over the entries	*/
+};
+
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_SAVEENV)
+#define ENV_LOG_SAVE
+#endif
+
+#ifdef ENV_LOG_SAVE
+static env_t *env_log_image;	/* the environment as stored */
+static char *env_log_vars;	/* its variables, as exported */
+static char *env_log_new;	/* buffer for the next export */
+static uint env_log_free;	/* offset of the next record, 0 if none */
+static enum env_location env_log_loc;	/* where the tracked copy is stored */
+#endif
+
+/* Return the offset just past the terminating NUL of the variables */
+static uint env_log_vars_end(const uchar *data)
+{
+	uint off = 0;
+
+	while (off < ENV_SIZE && data[off]) {
+		while (off < ENV_SIZE && data[off])
+			off++;
+		off++;
+	}
+
+	return min_t(uint, off + 1, ENV_SIZE);
+}
+
+/* Compute the CRC of an environment whose log area is still erased */
+static uint32_t env_log_crc(const uchar *data)
+{
+	uchar erased[64];
+	uint off = env_log_vars_end(data);
+	uint32_t crc;
+	uint n;
+
+	memset(erased, 0xff, sizeof(erased));
+	crc = crc32(0, data, off);
+	for (; off < ENV_SIZE; off += n) {
+		n = min_t(uint, ENV_SIZE - off, sizeof(erased));
+		crc = crc32(crc, erased, n);
+	}
+
+	return crc;
+}
+
+#ifdef ENV_LOG_SAVE
+/*
+ * Remember what is now stored, as the base for the next append. If
+ * @exported is set, @env was just filled by env_export(), so its
+ * variables match the hash table and need not be exported again.
+ */
+static void env_log_track(const env_t *env, uint off, bool exported)
+{
+	char *res;
+	uint i;
+
+	env_log_free = 0;
+	if (!env_log_image) {
+		env_log_image = memalign(ARCH_DMA_MINALIGN, sizeof(env_t));
+		env_log_vars = malloc(ENV_SIZE);
+		env_log_new = malloc(ENV_SIZE);
+		if (!env_log_image || !env_log_vars || !env_log_new) {
+			free(env_log_image);
+			free(env_log_vars);
+			free(env_log_new);
+			env_log_image = NULL;
+			return;
+		}
+	}
+	memcpy(env_log_image, env, sizeof(env_t));
+
+	/* Records can only be written where the flash is erased */
+	for (i = off; i < ENV_SIZE; i++) {
+		if (env->data[i] != 0xff)
+			return;
+	}
+
+	if (exported) {
+		memcpy(env_log_vars, env->data, ENV_SIZE);
+	} else {
+		res = env_log_vars;
+		if (hexport_r(&env_htab, '\0', 0, &res, ENV_SIZE, 0, NULL) < 0)
+			return;
+	}
+	env_log_free = off;
+}
+#endif
+
+/* Apply the records appended to an environment which was just imported */
+static void env_log_load(const env_t *env)
+{
+	struct env_log_hdr hdr;
+	const uchar *entries;
+	uint off;
+
+	off = ALIGN(env_log_vars_end(env->data), ENV_LOG_ALIGN);
+	while (off + sizeof(hdr) <= ENV_SIZE) {
+		memcpy(&hdr, env->data + off, sizeof(hdr));
+		entries = env->data + off + sizeof(hdr);
+		if (hdr.magic != ENV_LOG_MAGIC ||
+		    hdr.len > ENV_SIZE - off - sizeof(hdr) ||
+		    crc32(0, entries, hdr.len) != hdr.crc)
+			break;
+
+		debug("Applying %u bytes of changes at offset %u\n", hdr.len,
+		      off);
+		if (!himport_r(&env_htab, (const char *)entries, hdr.len, '\0',
+			       H_NOCLEAR | H_FORCE, 0, 0, NULL)) {
+			pr_err("Cannot apply environment changes: errno = %d\n",
+			       errno);
+			break;
+		}
+		off = ALIGN(off + sizeof(hdr) + hdr.len, ENV_LOG_ALIGN);
+	}
+
+#ifdef ENV_LOG_SAVE
+	env_log_track(env, off, false);
+#endif
+}
+
+#ifdef ENV_LOG_SAVE
+/* Compare the names of two "name=value" entries */
+static int env_log_keycmp(const char *a, const char *b)
+{
+	while (*a == *b && *a != '=') {
+		a++;
+		b++;
+	}
+	if (*a == '=')
+		return *b == '=' ? 0 : -1;
+	if (*b == '=')
+		return 1;
+
+	return (uchar)*a - (uchar)*b;
+}
+
+/* Add an entry of @n bytes to a record, if there is room */
+static bool env_log_add(uchar *rec, uint *len, uint max, const char *s,
+			uint n)
+{
+	if (*len + n + 1 > max)
+		return false;
+	memcpy(rec + *len, s, n);
+	rec[*len + n] = '\0';
+	*len += n + 1;
+
+	return true;
+}
+
+int env_export_append(env_t **envp, uint *offp, uint *lenp)
+{
+	struct env_log_hdr hdr;
+	char *old = env_log_vars, *new = env_log_new;
+	uint off = env_log_free, len = 0, max;
+	uchar *rec;
+	bool ok = true;
+	int cmp;
+
+	if (!env_log_image || !off || off + sizeof(hdr) >= ENV_SIZE)
+		return -ENOSPC;
+	if (hexport_r(&env_htab, '\0', 0, &new, ENV_SIZE, 0, NULL) < 0)
+		return -ENOSPC;
+
+	/* Both lists are sorted, so the changes fall out of a merge */
+	rec = env_log_image->data + off + sizeof(hdr);
+	max = ENV_SIZE - off - sizeof(hdr);
+	while (ok && (*old || *new)) {
+		if (!*old)
+			cmp = 1;
+		else if (!*new)
+			cmp = -1;
+		else
+			cmp = env_log_keycmp(old, new);
+
+		if (cmp < 0) {
+			ok = env_log_add(rec, &len, max, old,
+					 strchr(old, '=') - old);
+		} else if (cmp > 0 || strcmp(old, new)) {
+			ok = env_log_add(rec, &len, max, new, strlen(new));
+		}
+		if (cmp <= 0)
+			old += strlen(old) + 1;
+		if (cmp >= 0)
+			new += strlen(new) + 1;
+	}
+	if (!ok) {
+		/* Keep the copy the same as what is stored */
+		memset(rec, 0xff, len);
+		return -ENOSPC;
+	}
+
+	*envp = env_log_image;
+	*offp = offsetof(env_t, data) + off;
+	*lenp = 0;
+	if (!len)
+		return 0;
+
+	memset(&hdr, '\0', sizeof(hdr));
+	hdr.magic = ENV_LOG_MAGIC;
+	hdr.len = len;
+	hdr.crc = crc32(0, rec, len);
+	memcpy(env_log_image->data + off, &hdr, sizeof(hdr));
+	*lenp = sizeof(hdr) + len;
+
+	env_log_free = ALIGN(off + sizeof(hdr) + len, ENV_LOG_ALIGN);
+	old = env_log_vars;
+	env_log_vars = env_log_new;
+	env_log_new = old;
+
+	return 0;
+}
+
+void env_log_invalidate(void)
+{
+	env_log_free = 0;
+}
+#endif /* ENV_LOG_SAVE */
+
+void env_log_set_location(enum env_location loc)
+{
+#ifdef ENV_LOG_SAVE
+	if (loc != env_log_loc)
+		env_log_free = 0;
+	env_log_loc = loc;
+#endif
+}
+#endif /* CONFIG_ENV_APPEND_LOG */
+
+int env_crc_ok(const env_t *env)
+{
+	uint32_t crc;
+
+	memcpy(&crc, &env->crc, sizeof(crc));
+	if (crc32(0, env->data, ENV_SIZE) == crc)
+		return 1;
+#ifdef CONFIG_ENV_APPEND_LOG
+	if (env_log_crc(env->data) == crc)
+		return 1;
+#endif
+
+	return 0;
+}
+
 /*
  * Check if CRC is valid and (if yes) import the environment.
  * Note that "buf" may or may not be aligned.
@@ -108,19 +381,16 @@ int env_import(const char *buf, int check)
 {
 	env_t *ep = (env_t *)buf;
 
-	if (check) {
-		uint32_t crc;
-
-		memcpy(&crc, &ep->crc, sizeof(crc));
-
-		if (crc32(0, ep->data, ENV_SIZE) != crc) {
-			set_default_env("bad CRC", 0);
-			return -EIO;
-		}
+	if (check && !env_crc_ok(ep)) {
+		set_default_env("bad CRC", 0);
+		return -EIO;
 	}
 
 	if (himport_r(&env_htab, (char *)ep->data, ENV_SIZE, '\0', 0, 0,
 			0, NULL)) {
+#ifdef CONFIG_ENV_APPEND_LOG
+		env_log_load(ep);
+#endif
 		gd->flags |= GD_FLG_ENV_READY;
 		return 0;
 	}
@@ -211,8 +481,18 @@ int env_export(env_t *env_out)
 		return 1;
 	}
 
+#ifdef CONFIG_ENV_APPEND_LOG
+	/* Leave the rest erased, ready for appending changes */
+	len = env_log_vars_end(env_out->data);
+	memset(env_out->data + len, 0xff, ENV_SIZE - len);
+#endif
+
 	env_out->crc = crc32(0, env_out->data, ENV_SIZE);
 
+#ifdef ENV_LOG_SAVE
+	env_log_track(env_out, ALIGN(len, ENV_LOG_ALIGN), true);
+#endif
+
 #ifdef CONFIG_SYS_REDUNDAND_ENVIRONMENT
 	env_out->flags = ++env_flags; /* increase the serial */
 #endif
@@ -186,6 +186,7 @@ int env_load(void)
 			continue;
 
 		printf("Loading Environment from %s... ", drv->name);
+		env_log_set_location(drv->location);
 		/*
 		 * In error case, the error message must be printed during
 		 * drv->load() in some underlying API, and it must be exactly
@@ -225,6 +226,7 @@ int env_save(void)
 			return -ENODEV;
 
 		printf("Saving Environment to %s... ", drv->name);
+		env_log_set_location(drv->location);
 		ret = drv->save();
 		if (ret)
 			printf("Failed (%d)\n", ret);
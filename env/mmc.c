@@ -196,6 +196,43 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 	return (n == blk_cnt) ? 0 : -1;
 }
 
+#ifdef CONFIG_ENV_APPEND_LOG
+/*
+ * Write just the blocks holding the changes. Returns -ENOSPC if they do
+ * not fit, in which case the whole environment is written.
+ */
+static int env_mmc_append(struct mmc *mmc, int dev)
+{
+	env_t	*env;
+	uint	off, len, start, end;
+	u32	offset;
+
+	if (env_export_append(&env, &off, &len))
+		return -ENOSPC;
+	if (!len) {
+		puts("Environment unchanged\n");
+		return 0;
+	}
+
+	start = rounddown(off, mmc->write_bl_len);
+	end = roundup(off + len, mmc->write_bl_len);
+	if (end > CONFIG_ENV_SIZE || mmc_get_env_addr(mmc, 0, &offset)) {
+		env_log_invalidate();
+		return -ENOSPC;
+	}
+
+	printf("Appending to MMC(%d)... ", dev);
+	if (write_env(mmc, end - start, offset + start, (u8 *)env + start)) {
+		puts("failed\n");
+		env_log_invalidate();
+		return 1;
+	}
+	puts("done\n");
+
+	return 0;
+}
+#endif
+
 static int env_mmc_save(void)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(env_t, env_new, 1);
@@ -211,6 +248,12 @@ static int env_mmc_save(void)
 		return 1;
 	}
 
+#ifdef CONFIG_ENV_APPEND_LOG
+	ret = env_mmc_append(mmc, dev);
+	if (ret != -ENOSPC)
+		goto fini;
+#endif
+
 	ret = env_export(env_new);
 	if (ret)
 		goto fini;
@@ -228,6 +271,7 @@ static int env_mmc_save(void)
 	printf("Writing to %sMMC(%d)... ", copy ? "redundant " : "", dev);
 	if (write_env(mmc, CONFIG_ENV_SIZE, offset, (u_char *)env_new)) {
 		puts("failed\n");
+		env_log_invalidate();
 		ret = 1;
 		goto fini;
 	}
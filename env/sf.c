@@ -200,6 +200,38 @@ out:
 }
 #else
 #ifdef CMD_SAVEENV
+#ifdef CONFIG_ENV_APPEND_LOG
+/*
+ * Write just the changes into the erased part of the environment. Returns
+ * -ENOSPC if they do not fit, in which case the whole sector is rewritten.
+ */
+static int env_sf_append(void)
+{
+	env_t	*env;
+	uint	off, len;
+	int	ret;
+
+	ret = env_export_append(&env, &off, &len);
+	if (ret)
+		return ret;
+	if (!len) {
+		puts("Environment unchanged\n");
+		return 0;
+	}
+
+	puts("Appending to SPI flash...");
+	ret = spi_flash_write(env_flash, CONFIG_ENV_OFFSET + off, len,
+			      (u8 *)env + off);
+	if (ret) {
+		env_log_invalidate();
+		return ret;
+	}
+	puts("done\n");
+
+	return 0;
+}
+#endif
+
 static int env_sf_save(void)
 {
 	u32	saved_size, saved_offset, sector;
@@ -211,6 +243,12 @@ static int env_sf_save(void)
 	if (ret)
 		return ret;
 
+#ifdef CONFIG_ENV_APPEND_LOG
+	ret = env_sf_append();
+	if (ret != -ENOSPC)
+		return ret;
+#endif
+
 	/* Is the sector larger than the env (i.e. embedded) */
 	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
 		saved_size = CONFIG_ENV_SECT_SIZE - CONFIG_ENV_SIZE;
@@ -254,6 +292,8 @@ static int env_sf_save(void)
 	puts("done\n");
 
  done:
+	if (ret)
+		env_log_invalidate();
 	if (saved_buffer)
 		free(saved_buffer);
 
@@ -302,7 +342,7 @@ static int env_sf_init(void)
 {
 	env_t *env_ptr = (env_t *)(CONFIG_ENV_ADDR);
 
-	if (crc32(0, env_ptr->data, ENV_SIZE) == env_ptr->crc) {
+	if (env_crc_ok(env_ptr)) {
 		gd->env_addr	= (ulong)&(env_ptr->data);
 		gd->env_valid	= 1;
 	} else {
@@ -7,11 +7,44 @@
 
 #include "btrfs.h"
 #include <config.h>
+#include <fs.h>
 #include <malloc.h>
 #include <linux/time.h>
 
 struct btrfs_info btrfs_info;
 
+/* Result of looking up a path, as kept by the fs layer's mount cache */
+struct btrfs_path_cache {
+	struct btrfs_root root;
+	struct btrfs_inode_item inode;
+	u64 inr;
+	u8 type;
+};
+
+static u64 btrfs_lookup_path_cached(struct btrfs_root *root, const char *path,
+				    u8 *type, struct btrfs_inode_item *inode)
+{
+	struct btrfs_path_cache cache;
+
+	if (!fs_cache_lookup(path, &cache, sizeof(cache))) {
+		*root = cache.root;
+		*type = cache.type;
+		*inode = cache.inode;
+		return cache.inr;
+	}
+
+	cache.inr = btrfs_lookup_path(root, root->root_dirid, path, type,
+				      inode, 40);
+	if (cache.inr != -1ULL) {
+		cache.root = *root;
+		cache.inode = *inode;
+		cache.type = *type;
+		fs_cache_add(path, &cache, sizeof(cache));
+	}
+
+	return cache.inr;
+}
+
 static int readdir_callback(const struct btrfs_root *root,
 			    struct btrfs_dir_item *item)
 {
@@ -80,6 +113,7 @@ int btrfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
 	btrfs_part_info = fs_partition;
 
 	memset(&btrfs_info, 0, sizeof(btrfs_info));
+	btrfs_extent_cache_free();
 
 	btrfs_hash_init();
 	if (btrfs_read_superblock())
@@ -138,10 +172,11 @@ int btrfs_ls(const char *path)
 int btrfs_exists(const char *file)
 {
 	struct btrfs_root root = btrfs_info.fs_root;
+	struct btrfs_inode_item inode;
 	u64 inr;
 	u8 type;
 
-	inr = btrfs_lookup_path(&root, root.root_dirid, file, &type, NULL, 40);
+	inr = btrfs_lookup_path_cached(&root, file, &type, &inode);
 
 	return (inr != -1ULL && type == BTRFS_FT_REG_FILE);
 }
@@ -153,8 +188,7 @@ int btrfs_size(const char *file, loff_t *size)
 	u64 inr;
 	u8 type;
 
-	inr = btrfs_lookup_path(&root, root.root_dirid, file, &type, &inode,
-				40);
+	inr = btrfs_lookup_path_cached(&root, file, &type, &inode);
 
 	if (inr == -1ULL) {
 		printf("Cannot lookup file %s\n", file);
@@ -178,8 +212,7 @@ int btrfs_read(const char *file, void *buf, loff_t offset, loff_t len,
 	u64 inr, rd;
 	u8 type;
 
-	inr = btrfs_lookup_path(&root, root.root_dirid, file, &type, &inode,
-				40);
+	inr = btrfs_lookup_path_cached(&root, file, &type, &inode);
 
 	if (inr == -1ULL) {
 		printf("Cannot lookup file %s\n", file);
@@ -209,6 +242,7 @@ int btrfs_read(const char *file, void *buf, loff_t offset, loff_t len,
 
 void btrfs_close(void)
 {
+	btrfs_extent_cache_free();
 	btrfs_chunk_map_exit();
 }
 
@@ -78,10 +78,31 @@ u64 btrfs_file_read(const struct btrfs_root *, u64, u64, u64, char *);
 u64 btrfs_get_default_subvol_objectid(void);
 
 /* extent-io.c */
+#define BTRFS_EXTENT_BATCH_MAX	32
+
+/*
+ * Reads of regular extents which follow each other on disk, which are done
+ * with a single device read by btrfs_extent_batch_flush()
+ */
+struct btrfs_extent_batch {
+	u64 physical;		/* Start of the run on disk */
+	u64 len;		/* Length of the run on disk */
+	int compressed;		/* The extents are compressed */
+	int count;
+	struct btrfs_extent_batch_item {
+		struct btrfs_file_extent_item extent;
+		u64 offset;	/* Offset to read from in the file extent */
+		u64 size;	/* Number of bytes to read */
+		char *out;
+	} items[BTRFS_EXTENT_BATCH_MAX];
+};
+
 u64 btrfs_read_extent_inline(struct btrfs_path *,
 			      struct btrfs_file_extent_item *, u64, u64,
 			      char *);
-u64 btrfs_read_extent_reg(struct btrfs_path *, struct btrfs_file_extent_item *,
-			   u64, u64, char *);
+u64 btrfs_read_extent_reg(struct btrfs_extent_batch *,
+			   struct btrfs_file_extent_item *, u64, u64, char *);
+int btrfs_extent_batch_flush(struct btrfs_extent_batch *);
+void btrfs_extent_cache_free(void);
 
 #endif /* !__BTRFS_BTRFS_H__ */
@@ -7,6 +7,7 @@
 
 #include "btrfs.h"
 #include <malloc.h>
+#include <linux/sizes.h>
 
 u64 btrfs_read_extent_inline(struct btrfs_path *path,
 			     struct btrfs_file_extent_item *extent, u64 offset,
@@ -60,60 +61,215 @@ err:
 	return -1ULL;
 }
 
-u64 btrfs_read_extent_reg(struct btrfs_path *path,
-			  struct btrfs_file_extent_item *extent, u64 offset,
-			  u64 size, char *out)
+/* Largest run of compressed extents to read in one go */
+#define BTRFS_BATCH_COMPRESSED_MAX	SZ_1M
+/* Largest run of uncompressed extents, which are read straight to the output */
+#define BTRFS_BATCH_MAX_LEN		SZ_1G
+
+/*
+ * Decompressed extents which were only partly wanted, so that reading the
+ * rest, e.g. when a file is read in pieces or an extent is shared by several
+ * file extents, does not decompress them again
+ */
+struct btrfs_extent_cache {
+	u64 bytenr;	/* Logical address of the compressed extent */
+	u64 len;	/* Decompressed length */
+	char *data;	/* Decompressed data, NULL if the entry is unused */
+};
+
+static struct btrfs_extent_cache extent_cache[CONFIG_FS_BTRFS_EXTENT_CACHE];
+static int extent_cache_next;
+
+void btrfs_extent_cache_free(void)
 {
-	u64 physical, clen, dlen, orig_size = size;
-	u32 res;
-	char *cbuf, *dbuf;
+	int i;
 
-	clen = extent->disk_num_bytes;
-	dlen = extent->num_bytes;
+	for (i = 0; i < ARRAY_SIZE(extent_cache); i++) {
+		free(extent_cache[i].data);
+		extent_cache[i].data = NULL;
+	}
+	extent_cache_next = 0;
+}
 
-	if (offset > dlen)
-		return -1ULL;
+static struct btrfs_extent_cache *btrfs_extent_cache_find(u64 bytenr)
+{
+	int i;
 
-	if (size > dlen - offset)
-		size = dlen - offset;
+	for (i = 0; i < ARRAY_SIZE(extent_cache); i++) {
+		if (extent_cache[i].data && extent_cache[i].bytenr == bytenr)
+			return &extent_cache[i];
+	}
 
-	physical = btrfs_map_logical_to_physical(extent->disk_bytenr);
-	if (physical == -1ULL)
-		return -1ULL;
+	return NULL;
+}
 
-	if (extent->compression == BTRFS_COMPRESS_NONE) {
-		physical += extent->offset + offset;
-		if (!btrfs_devread(physical, size, out))
-			return -1ULL;
+/* Add a decompressed extent to the cache, which takes over @data */
+static void btrfs_extent_cache_add(u64 bytenr, char *data, u64 len)
+{
+	struct btrfs_extent_cache *ent;
 
-		return size;
+	if (!ARRAY_SIZE(extent_cache)) {
+		free(data);
+		return;
 	}
 
-	cbuf = malloc(dlen > size ? clen + dlen : clen);
-	if (!cbuf)
-		return -1ULL;
+	ent = &extent_cache[extent_cache_next];
+	if (++extent_cache_next == ARRAY_SIZE(extent_cache))
+		extent_cache_next = 0;
+	free(ent->data);
+	ent->bytenr = bytenr;
+	ent->len = len;
+	ent->data = data;
+}
 
-	if (dlen > orig_size)
-		dbuf = cbuf + clen;
+/* Decompress an extent read from disk and copy out the part wanted */
+static int btrfs_read_compressed(struct btrfs_extent_batch_item *item,
+				 const char *cbuf)
+{
+	struct btrfs_file_extent_item *extent = &item->extent;
+	u64 dlen = extent->ram_bytes, start = extent->offset + item->offset;
+	char *dbuf;
+	u32 res;
+
+	if (start + item->size > dlen)
+		return -1;
+
+	/* Decompress straight to the output if all of the extent is wanted */
+	if (item->size == dlen)
+		dbuf = item->out;
 	else
-		dbuf = out;
+		dbuf = malloc(dlen);
+	if (!dbuf)
+		return -1;
 
-	if (!btrfs_devread(physical, clen, cbuf))
-		goto err;
+	res = btrfs_decompress(extent->compression, cbuf,
+			       extent->disk_num_bytes, dbuf, dlen);
+	if (res == -1) {
+		if (dbuf != item->out)
+			free(dbuf);
+		return -1;
+	}
+	/* Anything not in the compressed data is zero */
+	if (res < dlen)
+		memset(dbuf + res, '\0', dlen - res);
 
-	res = btrfs_decompress(extent->compression, cbuf, clen, dbuf, dlen);
-	if (res == -1)
-		goto err;
+	if (dbuf != item->out) {
+		memcpy(item->out, dbuf + start, item->size);
+		btrfs_extent_cache_add(extent->disk_bytenr, dbuf, dlen);
+	}
 
-	if (dlen > orig_size)
-		memcpy(out, dbuf + offset, size);
-	else
-		memmove(out, dbuf + offset, size);
+	return 0;
+}
 
-	free(cbuf);
-	return res;
+int btrfs_extent_batch_flush(struct btrfs_extent_batch *batch)
+{
+	int count = batch->count, i, ret = 0;
+	char *cbuf, *p;
 
-err:
+	if (!count)
+		return 0;
+	batch->count = 0;
+
+	if (!batch->compressed) {
+		if (!btrfs_devread(batch->physical, batch->len,
+				   batch->items[0].out))
+			return -1;
+
+		return 0;
+	}
+
+	cbuf = malloc(batch->len);
+	if (!cbuf)
+		return -1;
+	if (!btrfs_devread(batch->physical, batch->len, cbuf)) {
+		free(cbuf);
+		return -1;
+	}
+	for (i = 0, p = cbuf; i < count && !ret; i++) {
+		ret = btrfs_read_compressed(&batch->items[i], p);
+		p += batch->items[i].extent.disk_num_bytes;
+	}
 	free(cbuf);
-	return -1ULL;
+
+	return ret;
+}
+
+/*
+ * Read part of a regular extent. Data read from disk is only present in
+ * @out after btrfs_extent_batch_flush(), so that a run of extents which are
+ * contiguous on disk is read with a single device read.
+ */
+u64 btrfs_read_extent_reg(struct btrfs_extent_batch *batch,
+			  struct btrfs_file_extent_item *extent, u64 offset,
+			  u64 size, char *out)
+{
+	struct btrfs_extent_batch_item *item;
+	struct btrfs_extent_cache *ent;
+	u64 physical, len;
+	int compressed;
+
+	if (offset >= extent->num_bytes)
+		return 0;
+
+	if (size > extent->num_bytes - offset)
+		size = extent->num_bytes - offset;
+
+	/* Holes and preallocated extents read as zeroes */
+	if (!extent->disk_bytenr ||
+	    extent->type == BTRFS_FILE_EXTENT_PREALLOC) {
+		memset(out, '\0', size);
+		return size;
+	}
+
+	compressed = extent->compression != BTRFS_COMPRESS_NONE;
+again:
+	if (compressed) {
+		ent = btrfs_extent_cache_find(extent->disk_bytenr);
+		if (ent) {
+			if (extent->offset + offset + size > ent->len)
+				return -1ULL;
+			memcpy(out, ent->data + extent->offset + offset, size);
+			return size;
+		}
+		len = extent->disk_num_bytes;
+	} else {
+		len = size;
+	}
+
+	physical = btrfs_map_logical_to_physical(extent->disk_bytenr);
+	if (physical == -1ULL)
+		return -1ULL;
+	if (!compressed)
+		physical += extent->offset + offset;
+
+	if (batch->count) {
+		item = &batch->items[batch->count - 1];
+		if (batch->compressed != compressed ||
+		    batch->physical + batch->len != physical ||
+		    batch->count == BTRFS_EXTENT_BATCH_MAX ||
+		    batch->len + len > (compressed ?
+					BTRFS_BATCH_COMPRESSED_MAX :
+					BTRFS_BATCH_MAX_LEN) ||
+		    (!compressed && item->out + item->size != out)) {
+			if (btrfs_extent_batch_flush(batch))
+				return -1ULL;
+			/* The flush may have cached this extent */
+			if (compressed)
+				goto again;
+		}
+	}
+
+	if (!batch->count) {
+		batch->physical = physical;
+		batch->len = 0;
+		batch->compressed = compressed;
+	}
+	item = &batch->items[batch->count++];
+	item->extent = *extent;
+	item->offset = offset;
+	item->size = size;
+	item->out = out;
+	batch->len += len;
+
+	return size;
 }
@@ -319,8 +319,9 @@ u64 btrfs_lookup_path(struct btrfs_root *root, u64 inr, const char *path,
 u64 btrfs_file_read(const struct btrfs_root *root, u64 inr, u64 offset,
 		    u64 size, char *buf)
 {
+	struct btrfs_extent_batch batch;
 	struct btrfs_path path;
-	struct btrfs_key key;
+	struct btrfs_key key, *found;
 	struct btrfs_file_extent_item *extent;
 	int res = 0;
 	u64 rd, rd_all = -1ULL;
@@ -336,36 +337,54 @@ u64 btrfs_file_read(const struct btrfs_root *root, u64 inr, u64 offset,
 		if (btrfs_prev_slot(&path))
 			goto out;
 
-		if (btrfs_comp_keys_type(&key, btrfs_path_leaf_key(&path)))
+		/* With no extent before @offset, start at the next one */
+		if (btrfs_comp_keys_type(&key, btrfs_path_leaf_key(&path)) &&
+		    btrfs_next_slot(&path))
 			goto out;
 	}
 
 	rd_all = 0;
+	batch.count = 0;
 
 	do {
-		if (btrfs_comp_keys_type(&key, btrfs_path_leaf_key(&path)))
+		found = btrfs_path_leaf_key(&path);
+		if (btrfs_comp_keys_type(&key, found))
 			break;
 
+		/* Gaps between extents are holes */
+		if (found->offset > offset) {
+			rd = min(found->offset - offset, size);
+			memset(buf, '\0', rd);
+			offset += rd;
+			buf += rd;
+			rd_all += rd;
+			size -= rd;
+			if (!size)
+				break;
+		}
+
 		extent = btrfs_path_item_ptr(&path,
 					     struct btrfs_file_extent_item);
 
 		if (extent->type == BTRFS_FILE_EXTENT_INLINE) {
 			btrfs_file_extent_item_to_cpu_inl(extent);
-			rd = btrfs_read_extent_inline(&path, extent, offset,
+			rd = btrfs_read_extent_inline(&path, extent,
+						      offset - found->offset,
 						      size, buf);
 		} else {
 			btrfs_file_extent_item_to_cpu(extent);
-			rd = btrfs_read_extent_reg(&path, extent, offset, size,
-						   buf);
+			rd = btrfs_read_extent_reg(&batch, extent,
+						   offset - found->offset,
+						   size, buf);
 		}
 
 		if (rd == -1ULL) {
 			printf("%s: Error reading extent\n", __func__);
-			rd_all = -1;
+			rd_all = -1ULL;
 			goto out;
 		}
 
-		offset = 0;
+		offset += rd;
 		buf += rd;
 		rd_all += rd;
 		size -= rd;
@@ -374,8 +393,15 @@ u64 btrfs_file_read(const struct btrfs_root *root, u64 inr, u64 offset,
 			break;
 	} while (!(res = btrfs_next_slot(&path)));
 
-	if (res)
-		return -1ULL;
+	if (res < 0 || btrfs_extent_batch_flush(&batch)) {
+		printf("%s: Error reading extent\n", __func__);
+		rd_all = -1ULL;
+		goto out;
+	}
+
+	/* The file ends with a hole */
+	memset(buf, '\0', size);
+	rd_all += size;
 
 out:
 	btrfs_free_path(&path);
@@ -21,6 +21,7 @@
 #include <common.h>
 #include <ext_common.h>
 #include <ext4fs.h>
+#include <fs.h>
 #include <inttypes.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -45,6 +46,17 @@ int ext4fs_indir3_blkno = -1;
 struct ext2_inode *g_parent_inode;
 static int symlinknest;
 
+/*
+ * Decoded extent tree of the most recently mapped extent-based inode. The
+ * inode is identified by the root of its tree, which is held in the inode.
+ */
+static struct ext4_extent_map {
+	char root[sizeof(((struct ext2_inode *)0)->b)];
+	struct ext4_block_run *runs;	/* Runs, in order of logical block */
+	int count;			/* Number of runs, -1 if not valid */
+	int max;			/* Space allocated for runs */
+} ext4fs_extent_map = { .count = -1 };
+
 #if defined(CONFIG_EXT4_WRITE)
 struct ext2_block_group *ext4fs_get_group_descriptor
 	(const struct ext_filesystem *fs, uint32_t bg_idx)
@@ -1522,43 +1534,176 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
-static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+static int ext4fs_extent_map_add(struct ext4_extent_map *map,
+				 const struct ext4_extent *extent)
+{
+	struct ext4_block_run *run;
+	uint len = le16_to_cpu(extent->ee_len);
+
+	if (map->count == map->max) {
+		int max = map->max ? map->max * 2 : 16;
+
+		run = realloc(map->runs, max * sizeof(*run));
+		if (!run)
+			return -ENOMEM;
+		map->runs = run;
+		map->max = max;
+	}
+
+	run = &map->runs[map->count++];
+	run->lblk = le32_to_cpu(extent->ee_block);
+	run->pblk = le16_to_cpu(extent->ee_start_hi);
+	run->pblk = (run->pblk << 32) + le32_to_cpu(extent->ee_start_lo);
+
+	/* Blocks in an unwritten extent read as zero, like a hole */
+	if (len > EXT_INIT_MAX_LEN) {
+		len -= EXT_INIT_MAX_LEN;
+		run->pblk = 0;
+	}
+	run->len = len;
+
+	return 0;
+}
+
+/* Add the extents in a (sub)tree to the map, in order of logical block */
+static int ext4fs_extent_map_walk(struct ext4_extent_map *map,
+				  struct ext4_extent_header *ext_block,
+				  int log2_blksz)
 {
 	struct ext4_extent_idx *index;
 	unsigned long long block;
-	int blksz = EXT2_BLOCK_SIZE(data);
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	char *buf;
+	int ret = 0;
 	int i;
 
-	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    entries > le16_to_cpu(ext_block->eh_max))
+		return -EINVAL;
 
-		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return NULL;
+	if (ext_block->eh_depth == 0) {
+		struct ext4_extent *extent;
 
-		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
+		extent = (struct ext4_extent *)(ext_block + 1);
+		for (i = 0; i < entries && !ret; i++)
+			ret = ext4fs_extent_map_add(map, &extent[i]);
 
-		if (--i < 0)
-			return NULL;
+		return ret;
+	}
 
+	buf = zalloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+	index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0; i < entries && !ret; i++) {
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf))
+			ret = -EIO;
+		else if (((struct ext4_extent_header *)buf)->eh_depth >=
+			 ext_block->eh_depth)
+			ret = -EINVAL;	/* a loop in a corrupted tree */
 		else
-			return NULL;
+			ret = ext4fs_extent_map_walk(map,
+					(struct ext4_extent_header *)buf,
+					log2_blksz);
 	}
+	free(buf);
+
+	return ret;
+}
+
+/* Get the extent map for an inode, decoding its extent tree if needed */
+static struct ext4_extent_map *ext4fs_get_extent_map(struct ext2_inode *inode)
+{
+	struct ext4_extent_map *map = &ext4fs_extent_map;
+	int log2_blksz;
+
+	if (map->count != -1 &&
+	    !memcmp(map->root, &inode->b, sizeof(map->root)))
+		return map;
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	map->count = 0;
+	if (ext4fs_extent_map_walk(map, (struct ext4_extent_header *)
+				   inode->b.blocks.dir_blocks, log2_blksz)) {
+		map->count = -1;
+		return NULL;
+	}
+	memcpy(map->root, &inode->b, sizeof(map->root));
+
+	return map;
+}
+
+/* Map a run of blocks in an extent-based file */
+static int ext4fs_map_extent_run(struct ext2_inode *inode, uint32_t fileblock,
+				 uint32_t max, struct ext4_block_run *run)
+{
+	struct ext4_extent_map *map;
+	struct ext4_block_run *found;
+	int lo, hi, mid;
+
+	map = ext4fs_get_extent_map(inode);
+	if (!map) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	/* Find the last run starting at or before fileblock */
+	for (lo = 0, hi = map->count; lo < hi;) {
+		mid = (lo + hi) / 2;
+		if (map->runs[mid].lblk <= fileblock)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	found = lo ? &map->runs[lo - 1] : NULL;
+
+	run->lblk = fileblock;
+	if (found && fileblock - found->lblk < found->len) {
+		run->pblk = found->pblk;
+		if (run->pblk)
+			run->pblk += fileblock - found->lblk;
+		run->len = found->len - (fileblock - found->lblk);
+	} else {
+		/* Sparse file: the hole runs up to the next extent */
+		run->pblk = 0;
+		run->len = lo < map->count ? map->runs[lo].lblk - fileblock :
+			max;
+	}
+	if (run->len > max)
+		run->len = max;
+
+	return 0;
+}
+
+int ext4fs_map_run(struct ext2_inode *inode, uint32_t fileblock, uint32_t max,
+		   struct ext4_block_run *run)
+{
+	long int blknr, next;
+
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent_run(inode, fileblock, max, run);
+
+	/* Without extents, look up each block to find how far the run goes */
+	blknr = read_allocated_block(inode, fileblock);
+	if (blknr < 0)
+		return blknr;
+	run->lblk = fileblock;
+	run->pblk = blknr;
+	for (run->len = 1; run->len < max; run->len++) {
+		next = read_allocated_block(inode, fileblock + run->len);
+		if (next < 0)
+			return next;
+		if (blknr ? next != blknr + run->len : next != 0)
+			break;
+	}
+
+	return 0;
 }
 
 static int ext4fs_blockgroup
@@ -1623,53 +1768,20 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
+		struct ext4_block_run run;
+		int ret;
 
-		extent = (struct ext4_extent *)(ext_block + 1);
+		ret = ext4fs_map_extent_run(inode, fileblock, 1, &run);
+		if (ret)
+			return ret;
 
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
-
-			if (startblock > fileblock) {
-				/* Sparse file */
-				free(buf);
-				return 0;
-
-			} else if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
-				return (fileblock - startblock) + start;
-			}
-		}
-
-		free(buf);
-		return 0;
+		return run.pblk;
 	}
 
 	/* Direct blocks. */
@@ -1971,6 +2083,10 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
+	free(ext4fs_extent_map.runs);
+	ext4fs_extent_map.runs = NULL;
+	ext4fs_extent_map.count = -1;
+	ext4fs_extent_map.max = 0;
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -2004,6 +2120,254 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+/*
+ * Create a node for a directory entry, and work out its type, reading its
+ * inode if the entry does not give the type
+ */
+static struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *diro,
+					      struct ext2_dirent *dirent,
+					      int *ftype)
+{
+	struct ext2fs_node *fdiro;
+	int type = FILETYPE_UNKNOWN;
+	int status;
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return NULL;
+
+	fdiro->data = diro->data;
+	fdiro->ino = le32_to_cpu(dirent->inode);
+
+	if (dirent->filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (dirent->filetype == FILETYPE_DIRECTORY)
+			type = FILETYPE_DIRECTORY;
+		else if (dirent->filetype == FILETYPE_SYMLINK)
+			type = FILETYPE_SYMLINK;
+		else if (dirent->filetype == FILETYPE_REG)
+			type = FILETYPE_REG;
+	} else {
+		status = ext4fs_read_inode(diro->data,
+					   le32_to_cpu(dirent->inode),
+					   &fdiro->inode);
+		if (status == 0) {
+			free(fdiro);
+			return NULL;
+		}
+		fdiro->inode_read = 1;
+
+		if ((le16_to_cpu(fdiro->inode.mode) & FILETYPE_INO_MASK) ==
+		    FILETYPE_INO_DIRECTORY) {
+			type = FILETYPE_DIRECTORY;
+		} else if ((le16_to_cpu(fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK) {
+			type = FILETYPE_SYMLINK;
+		} else if ((le16_to_cpu(fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_REG) {
+			type = FILETYPE_REG;
+		}
+	}
+	*ftype = type;
+
+	return fdiro;
+}
+
+/* Read one directory block, returning 0 if OK */
+static int ext4fs_read_dir_block(struct ext2fs_node *diro, uint32_t block,
+				 char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(diro->data);
+	loff_t actread;
+	int status;
+
+	status = ext4fs_read_file(diro, (loff_t)block * blksz, blksz, buf,
+				  &actread);
+	if (status < 0 || actread != blksz)
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Find the index entry covering @hash in an index block of a hash tree
+ * directory. The entries are sorted by hash, and the first one covers
+ * everything below the second.
+ */
+static struct ext4_dx_entry *ext4fs_dx_search(struct ext4_dx_entry *entries,
+					      int count, u32 hash)
+{
+	struct ext4_dx_entry *p = entries + 1, *q = entries + count - 1, *m;
+
+	while (p <= q) {
+		m = p + (q - p) / 2;
+		if (le32_to_cpu(m->hash) > hash)
+			q = m - 1;
+		else
+			p = m + 1;
+	}
+
+	return p - 1;
+}
+
+/* Position in one index block of a hash tree directory */
+struct ext4_dx_frame {
+	char *buf;
+	struct ext4_dx_entry *entries;
+	struct ext4_dx_entry *at;
+	int count;
+};
+
+/* Find the entry covering @hash in an index block which has been read */
+static int ext4fs_dx_init_frame(struct ext4_dx_frame *frame, int offset,
+				int blksz, u32 hash)
+{
+	struct ext4_dx_countlimit *cl;
+
+	frame->entries = (struct ext4_dx_entry *)(frame->buf + offset);
+	cl = (struct ext4_dx_countlimit *)frame->entries;
+	frame->count = le16_to_cpu(cl->count);
+	if (!frame->count || frame->count > le16_to_cpu(cl->limit) ||
+	    offset + frame->count * sizeof(struct ext4_dx_entry) > blksz)
+		return -EINVAL;
+	frame->at = ext4fs_dx_search(frame->entries, frame->count, hash);
+
+	return 0;
+}
+
+/* Read an interior index block and find the entry covering @hash */
+static int ext4fs_dx_read_frame(struct ext2fs_node *diro, uint32_t block,
+				u32 hash, struct ext4_dx_frame *frame)
+{
+	if (ext4fs_read_dir_block(diro, block, frame->buf))
+		return -EIO;
+
+	return ext4fs_dx_init_frame(frame, EXT4_DX_NODE_OFFSET,
+				    EXT2_BLOCK_SIZE(diro->data), hash);
+}
+
+/*
+ * Look up @name in a hash tree (dir_index) directory, reading only the index
+ * blocks on the way to the leaf block which holds it, rather than the whole
+ * directory.
+ *
+ * Returns 1 if found, 0 if not found, or -1 if the directory has no usable
+ * index, in which case the caller must scan it in full
+ */
+static int ext4fs_dx_find(struct ext2fs_node *diro, const char *name,
+			  struct ext2fs_node **fnode, int *ftype)
+{
+	struct ext2_sblock *sblock = &diro->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(diro->data);
+	struct ext4_dx_frame frames[EXT4_DX_MAX_LEVELS], *frame;
+	struct ext4_dx_root_info *info;
+	int len = strlen(name);
+	int version, levels, level, pos;
+	char *leaf;
+	u32 seed[4], hash, block;
+	int i, ret = -1;
+
+	if (!(le32_to_cpu(sblock->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(le32_to_cpu(diro->inode.flags) & EXT4_INDEX_FL) ||
+	    (le32_to_cpu(diro->inode.flags) & EXT4_CASEFOLD_FL))
+		return -1;
+
+	memset(frames, '\0', sizeof(frames));
+	leaf = malloc(blksz);
+	if (!leaf)
+		return -1;
+	for (i = 0; i < EXT4_DX_MAX_LEVELS; i++) {
+		frames[i].buf = malloc(blksz);
+		if (!frames[i].buf)
+			goto out;
+	}
+
+	if (ext4fs_read_dir_block(diro, 0, frames[0].buf))
+		goto out;
+	info = (struct ext4_dx_root_info *)(frames[0].buf +
+					    EXT4_DX_ROOT_INFO_OFFSET);
+	levels = info->indirect_levels + 1;
+	if (info->reserved_zero || info->info_length != sizeof(*info) ||
+	    levels > EXT4_DX_MAX_LEVELS)
+		goto out;
+
+	version = info->hash_version;
+	if (version <= DX_HASH_TEA &&
+	    (le32_to_cpu(sblock->flags) & EXT2_FLAGS_UNSIGNED_HASH))
+		version += DX_HASH_LEGACY_UNSIGNED;
+	for (i = 0; i < 4; i++)
+		seed[i] = le32_to_cpu(sblock->hash_seed[i]);
+	if (ext4fs_dirhash(name, len, version, seed, &hash))
+		goto out;
+
+	/* Walk down the index to the leaf block */
+	if (ext4fs_dx_init_frame(&frames[0], EXT4_DX_ROOT_INFO_OFFSET +
+				 info->info_length, blksz, hash))
+		goto out;
+	for (level = 1; level < levels; level++) {
+		block = le32_to_cpu(frames[level - 1].at->block) & 0x0fffffff;
+		if (ext4fs_dx_read_frame(diro, block, hash, &frames[level]))
+			goto out;
+	}
+
+	for (;;) {
+		frame = &frames[levels - 1];
+		block = le32_to_cpu(frame->at->block) & 0x0fffffff;
+		if (ext4fs_read_dir_block(diro, block, leaf))
+			goto out;
+
+		for (pos = 0; pos + sizeof(struct ext2_dirent) <= blksz; ) {
+			struct ext2_dirent *dirent;
+			int direntlen;
+
+			dirent = (struct ext2_dirent *)(leaf + pos);
+			direntlen = le16_to_cpu(dirent->direntlen);
+			if (direntlen < sizeof(*dirent) ||
+			    pos + direntlen > blksz)
+				goto out;
+			if (dirent->inode && dirent->namelen == len &&
+			    pos + sizeof(*dirent) + len <= blksz &&
+			    !memcmp(leaf + pos + sizeof(*dirent), name, len)) {
+				*fnode = ext4fs_dirent_node(diro, dirent,
+							    ftype);
+				ret = *fnode ? 1 : 0;
+				goto out;
+			}
+			pos += direntlen;
+		}
+
+		/*
+		 * Names with the same hash may continue into the next leaf
+		 * block, whose index entry then has the same hash, with bit 0
+		 * set. Find the next entry, which may be in the next index
+		 * block at any level.
+		 */
+		while (frame->at + 1 == frame->entries + frame->count) {
+			if (frame == frames)
+				break;
+			frame--;
+		}
+		if (frame->at + 1 == frame->entries + frame->count ||
+		    (le32_to_cpu(frame->at[1].hash) & ~1) != hash)
+			break;
+		frame->at++;
+		for (; frame < &frames[levels - 1]; frame++) {
+			block = le32_to_cpu(frame->at->block) & 0x0fffffff;
+			if (ext4fs_dx_read_frame(diro, block, 0, frame + 1))
+				goto out;
+		}
+	}
+	ret = 0;
+out:
+	for (i = 0; i < EXT4_DX_MAX_LEVELS; i++)
+		free(frames[i].buf);
+	free(leaf);
+
+	return ret;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2021,6 +2385,11 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
+	if (name && fnode && ftype) {
+		status = ext4fs_dx_find(diro, name, fnode, ftype);
+		if (status >= 0)
+			return status;
+	}
 	/* Search the file.  */
 	while (fpos < le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
@@ -2049,49 +2418,11 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			if (status < 0)
 				return 0;
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
+			fdiro = ext4fs_dirent_node(diro, &dirent, &type);
 			if (!fdiro)
 				return 0;
 
-			fdiro->data = diro->data;
-			fdiro->ino = le32_to_cpu(dirent.inode);
-
 			filename[dirent.namelen] = '\0';
-
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				status = ext4fs_read_inode(diro->data,
-							   le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (status == 0) {
-					free(fdiro);
-					return 0;
-				}
-				fdiro->inode_read = 1;
-
-				if ((le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
 #ifdef DEBUG
 			printf("iterate >%s<\n", filename);
 #endif /* of DEBUG */
@@ -2303,7 +2634,20 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* The filesystem may be kept mounted, with the last file still open */
+	if (ext4fs_file) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return -1;
+	if (!fs_cache_lookup(filename, fdiro, sizeof(*fdiro)))
+		goto found;
+	free(fdiro);
+	fdiro = NULL;
+
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -2314,7 +2658,10 @@ int ext4fs_open(const char *filename, loff_t *len)
 				&fdiro->inode);
 		if (status == 0)
 			goto fail;
+		fdiro->inode_read = 1;
 	}
+	fs_cache_add(filename, fdiro, sizeof(*fdiro));
+found:
 	*len = le32_to_cpu(fdiro->inode.size);
 	ext4fs_file = fdiro;
 
@@ -56,6 +56,23 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
 
+/* Hash values in a hash tree directory are below this, shifted left by 1 */
+#define EXT4_DX_HASH_EOF	0x7fffffff
+
+/**
+ * ext4fs_dirhash() - Hash a file name for a hash tree directory
+ *
+ * @name: File name, not nul-terminated
+ * @len: Length of @name
+ * @version: Hash version (DX_HASH_...), with the unsigned variants selected
+ *	if the superblock has EXT2_FLAGS_UNSIGNED_HASH
+ * @seed: Hash seed from the superblock, all zero to use the default
+ * @hashp: Returns the hash, with bit 0 clear
+ * @return 0 if OK, -EINVAL if @version is not supported
+ */
+int ext4fs_dirhash(const char *name, int len, int version, const u32 seed[4],
+		   u32 *hashp);
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
 uint16_t ext4fs_checksum_update(unsigned int i);
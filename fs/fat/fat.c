@@ -15,6 +15,7 @@
 #include <fat.h>
 #include <fs.h>
 #include <asm/byteorder.h>
+#include <asm/unaligned.h>
 #include <part.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -37,6 +38,10 @@ static void downcase(char *str, size_t len)
 static struct blk_desc *cur_dev;
 static disk_partition_t cur_part_info;
 
+/* Filesystem parameters read from the boot sector of cur_dev */
+static fsdata cur_fsdata;
+static int cur_fsdata_valid;
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
@@ -56,12 +61,90 @@ static int disk_read(__u32 block, __u32 nr_blocks, void *buf)
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(FS_FAT_CACHE)
+/* Number of sectors of the FAT read into the cache at once */
+#define FATCACHE_CHUNK_BLOCKS	64
+
+/*
+ * The FAT of cur_dev, read a chunk at a time as needed
+ *
+ * @buf: Contents of the whole FAT, or NULL if not allocated
+ * @loaded: For each chunk, non-zero if it has been read into @buf
+ */
+static struct {
+	__u8 *buf;
+	__u8 *loaded;
+} fat_cache;
+
+static void fat_cache_free(void)
+{
+	free(fat_cache.buf);
+	free(fat_cache.loaded);
+	fat_cache.buf = NULL;
+	fat_cache.loaded = NULL;
+}
+
+/*
+ * Get a pointer to 'len' bytes at offset 'off' in the FAT, reading them into
+ * the cache if needed.
+ * Return NULL if the FAT is too large to cache or cannot be read.
+ */
+static __u8 *fat_cache_get(fsdata *mydata, __u32 off, __u32 len)
+{
+	__u32 chunk_size = FATCACHE_CHUNK_BLOCKS * mydata->sect_size;
+	__u32 size = mydata->fatlength * mydata->sect_size;
+	__u32 chunk, startblock, getsize;
+
+	if (!fat_cache.buf) {
+		if (size > CONFIG_FS_FAT_CACHE_SIZE)
+			return NULL;
+		fat_cache.buf = malloc_cache_aligned(size);
+		fat_cache.loaded = calloc(DIV_ROUND_UP(size, chunk_size), 1);
+		if (!fat_cache.buf || !fat_cache.loaded) {
+			fat_cache_free();
+			return NULL;
+		}
+	}
+	if (off + len > size)
+		return NULL;
+
+	for (chunk = off / chunk_size; chunk <= (off + len - 1) / chunk_size;
+	     chunk++) {
+		if (fat_cache.loaded[chunk])
+			continue;
+		startblock = chunk * FATCACHE_CHUNK_BLOCKS;
+		getsize = min(mydata->fatlength - startblock,
+			      (__u32)FATCACHE_CHUNK_BLOCKS);
+		if (disk_read(mydata->fat_sect + startblock, getsize,
+			      fat_cache.buf + chunk * chunk_size) != getsize) {
+			debug("Error reading FAT blocks\n");
+			return NULL;
+		}
+		fat_cache.loaded[chunk] = 1;
+	}
+
+	return fat_cache.buf + off;
+}
+#else
+static inline void fat_cache_free(void) {}
+
+static inline __u8 *fat_cache_get(fsdata *mydata, __u32 off, __u32 len)
+{
+	return NULL;
+}
+#endif
+
 int fat_set_blk_dev(struct blk_desc *dev_desc, disk_partition_t *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	/* Any filesystem mounted by the fs layer is no longer current */
+	fs_cache_invalidate(NULL);
+
 	cur_dev = dev_desc;
 	cur_part_info = *info;
+	cur_fsdata_valid = 0;
+	fat_cache_free();
 
 	/* Make sure it has a valid FAT header */
 	if (disk_read(0, 1, buffer) != 1) {
@@ -91,6 +174,8 @@ int fat_register_device(struct blk_desc *dev_desc, int part_no)
 
 	/* First close any currently found FAT filesystem */
 	cur_dev = NULL;
+	cur_fsdata_valid = 0;
+	fat_cache_free();
 
 	/* Read the partition table, if present */
 	if (part_get_info(dev_desc, part_no, &info)) {
@@ -191,6 +276,33 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
+	if (mydata->fat_cached) {
+		__u8 *ptr;
+
+		switch (mydata->fatsize) {
+		case 32:
+			ptr = fat_cache_get(mydata, entry * 4, 4);
+			if (ptr)
+				return get_unaligned_le32(ptr);
+			break;
+		case 16:
+			ptr = fat_cache_get(mydata, entry * 2, 2);
+			if (ptr)
+				return get_unaligned_le16(ptr);
+			break;
+		case 12:
+			ptr = fat_cache_get(mydata, entry * 3 / 2, 2);
+			if (ptr) {
+				ret = get_unaligned_le16(ptr);
+				if (entry & 0x1)
+					ret >>= 4;
+				return ret & 0xfff;
+			}
+		}
+		/* Too large to cache, so read it a window at a time */
+		mydata->fat_cached = 0;
+	}
+
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
 		__u32 getsize = FATBUFBLOCKS;
@@ -550,6 +662,11 @@ static int get_fs_info(fsdata *mydata)
 	volume_info volinfo;
 	int ret;
 
+	if (cur_fsdata_valid) {
+		*mydata = cur_fsdata;
+		goto alloc_fatbuf;
+	}
+
 	ret = read_bootsectandvi(&bs, &volinfo, &mydata->fatsize);
 	if (ret) {
 		debug("Error: reading boot sector\n");
@@ -589,7 +706,11 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster =
 			sect_to_clust(mydata, mydata->rootdir_sect);
 	}
+	mydata->fat_cached = CONFIG_IS_ENABLED(FS_FAT_CACHE);
+	cur_fsdata = *mydata;
+	cur_fsdata_valid = 1;
 
+alloc_fatbuf:
 	mydata->fatbufnum = -1;
 	mydata->fat_dirty = 0;
 	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
@@ -959,6 +1080,32 @@ static int fat_itr_resolve(fat_itr *itr, const char *path, unsigned type)
 	return -ENOENT;
 }
 
+/**
+ * fat_itr_resolve_file() - resolve a path to a file, using the directory
+ * entry cached by the fs layer if there is one
+ *
+ * @itr: iterator initialized to the root directory
+ * @path: the path to resolve
+ * @return 0 on success or -errno, with itr->dent pointing to the file's
+ *    directory entry
+ */
+static int fat_itr_resolve_file(fat_itr *itr, const char *path)
+{
+	dir_entry *dent = (dir_entry *)itr->block;
+	int ret;
+
+	if (!fs_cache_lookup(path, dent, sizeof(*dent))) {
+		itr->dent = dent;
+		return 0;
+	}
+
+	ret = fat_itr_resolve(itr, path, TYPE_FILE);
+	if (!ret)
+		fs_cache_add(path, itr->dent, sizeof(*itr->dent));
+
+	return ret;
+}
+
 int file_fat_detectfs(void)
 {
 	boot_sector bs;
@@ -1054,7 +1201,7 @@ int fat_size(const char *filename, loff_t *size)
 	if (ret)
 		goto out_free_itr;
 
-	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	ret = fat_itr_resolve_file(itr, filename);
 	if (ret) {
 		/*
 		 * Directories don't have size, but fs_size() is not
@@ -1091,7 +1238,7 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	if (ret)
 		goto out_free_itr;
 
-	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	ret = fat_itr_resolve_file(itr, filename);
 	if (ret)
 		goto out_free_both;
 
@@ -958,6 +958,9 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 
 	mydata->fatbufnum = -1;
 	mydata->fat_dirty = 0;
+	/* The FAT is about to change, so read and write it directly */
+	mydata->fat_cached = 0;
+	fat_cache_free();
 	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <common.h>
 #include <mapmem.h>
+#include <malloc.h>
 #include <part.h>
 #include <ext4fs.h>
 #include <fat.h>
@@ -25,6 +26,47 @@ static int fs_dev_part;
 static disk_partition_t fs_partition;
 static int fs_type = FS_TYPE_ANY;
 
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+/**
+ * struct fs_cache_entry - a path looked up on the mounted filesystem
+ *
+ * @path: Path, as passed to the filesystem
+ * @data: Filesystem-specific information about the path, e.g. its inode
+ * @size: Size of @data
+ */
+struct fs_cache_entry {
+	char *path;
+	void *data;
+	int size;
+};
+
+/**
+ * struct fs_mount_cache - a filesystem which is kept mounted between calls
+ *
+ * @desc: Block device, NULL if nothing is mounted
+ * @part: Partition number
+ * @start: First block of partition
+ * @size: Size of partition in blocks
+ * @fstype: Filesystem type (FS_TYPE_...)
+ * @stale: true if the filesystem must be closed when the current operation
+ *	finishes, since the device was written or invalidated
+ * @next: Next entry to replace in @entry
+ * @entry: Paths looked up on the filesystem
+ */
+struct fs_mount_cache {
+	struct blk_desc *desc;
+	int part;
+	lbaint_t start;
+	lbaint_t size;
+	int fstype;
+	bool stale;
+	int next;
+	struct fs_cache_entry entry[CONFIG_FS_MOUNT_CACHE_ENTRIES];
+};
+
+static struct fs_mount_cache fs_mount;
+#endif
+
 static inline int fs_probe_unsupported(struct blk_desc *fs_dev_desc,
 				      disk_partition_t *fs_partition)
 {
@@ -117,6 +159,12 @@ struct fstype_info {
 	 * filesystem.
 	 */
 	bool null_dev_desc_ok;
+	/*
+	 * Can the filesystem stay mounted between calls with
+	 * CONFIG_FS_MOUNT_CACHE? Its state must only depend on the block
+	 * device contents, and its close() must release it.
+	 */
+	bool mount_cache_ok;
 	int (*probe)(struct blk_desc *fs_dev_desc,
 		     disk_partition_t *fs_partition);
 	int (*ls)(const char *dirname);
@@ -150,6 +198,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_FAT,
 		.name = "fat",
 		.null_dev_desc_ok = false,
+		.mount_cache_ok = true,
 		.probe = fat_set_blk_dev,
 		.close = fat_close,
 		.ls = fs_ls_generic,
@@ -172,6 +221,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_EXT,
 		.name = "ext4",
 		.null_dev_desc_ok = false,
+		.mount_cache_ok = true,
 		.probe = ext4fs_probe,
 		.close = ext4fs_close,
 		.ls = ext4fs_ls,
@@ -224,6 +274,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_BTRFS,
 		.name = "btrfs",
 		.null_dev_desc_ok = false,
+		.mount_cache_ok = true,
 		.probe = btrfs_probe,
 		.close = btrfs_close,
 		.ls = btrfs_ls,
@@ -278,6 +329,129 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+static void fs_mount_drop(void)
+{
+	struct fs_cache_entry *entry;
+	int i;
+
+	if (!fs_mount.desc)
+		return;
+
+	fs_get_info(fs_mount.fstype)->close();
+	for (i = 0, entry = fs_mount.entry; i < ARRAY_SIZE(fs_mount.entry);
+	     i++, entry++) {
+		free(entry->path);
+		free(entry->data);
+	}
+	memset(&fs_mount, '\0', sizeof(fs_mount));
+}
+
+/*
+ * Use the mounted filesystem if it is on the partition just selected, else
+ * close it
+ */
+static bool fs_mount_reuse(int part, int fstype)
+{
+	if (!fs_mount.desc)
+		return false;
+
+	if (fs_mount.desc == fs_dev_desc && fs_mount.part == part &&
+	    fs_mount.start == fs_partition.start &&
+	    fs_mount.size == fs_partition.size && !fs_mount.stale &&
+	    (fstype == FS_TYPE_ANY || fstype == fs_mount.fstype)) {
+		fs_type = fs_mount.fstype;
+		fs_dev_part = part;
+		return true;
+	}
+
+	fs_mount_drop();
+
+	return false;
+}
+
+static void fs_mount_add(struct fstype_info *info, int part)
+{
+	if (!info->mount_cache_ok || !fs_dev_desc)
+		return;
+
+	fs_mount.desc = fs_dev_desc;
+	fs_mount.part = part;
+	fs_mount.start = fs_partition.start;
+	fs_mount.size = fs_partition.size;
+	fs_mount.fstype = info->fstype;
+}
+
+/* Check if the current operation is on the mounted filesystem */
+static bool fs_mount_active(void)
+{
+	return fs_mount.desc && !fs_mount.stale && fs_type == fs_mount.fstype;
+}
+
+int fs_cache_lookup(const char *path, void *data, int size)
+{
+	struct fs_cache_entry *entry;
+	int i;
+
+	if (!fs_mount_active())
+		return -ENOENT;
+
+	for (i = 0, entry = fs_mount.entry; i < ARRAY_SIZE(fs_mount.entry);
+	     i++, entry++) {
+		if (entry->path && entry->size == size &&
+		    !strcmp(entry->path, path)) {
+			memcpy(data, entry->data, size);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+void fs_cache_add(const char *path, const void *data, int size)
+{
+	struct fs_cache_entry *entry;
+
+	if (!fs_mount_active())
+		return;
+
+	entry = &fs_mount.entry[fs_mount.next];
+	free(entry->path);
+	free(entry->data);
+	entry->path = strdup(path);
+	entry->data = malloc(size);
+	if (!entry->path || !entry->data) {
+		free(entry->path);
+		free(entry->data);
+		entry->path = NULL;
+		entry->data = NULL;
+		return;
+	}
+	memcpy(entry->data, data, size);
+	entry->size = size;
+	fs_mount.next = (fs_mount.next + 1) % ARRAY_SIZE(fs_mount.entry);
+}
+
+void fs_cache_invalidate(struct blk_desc *desc)
+{
+	if (desc && desc != fs_mount.desc)
+		return;
+
+	/* Leave the filesystem alone until any current operation finishes */
+	if (fs_type == FS_TYPE_ANY)
+		fs_mount_drop();
+	else
+		fs_mount.stale = true;
+}
+#else
+static inline bool fs_mount_reuse(int part, int fstype)
+{
+	return false;
+}
+
+static inline void fs_mount_add(struct fstype_info *info, int part) {}
+#endif
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -304,6 +478,9 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
+	if (fs_mount_reuse(part, fstype))
+		return 0;
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
 				fstype != info->fstype)
@@ -315,6 +492,7 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
 			fs_dev_part = part;
+			fs_mount_add(info, part);
 			return 0;
 		}
 	}
@@ -336,9 +514,14 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
+	if (fs_mount_reuse(part, FS_TYPE_ANY))
+		return 0;
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
+			fs_dev_part = part;
+			fs_mount_add(info, part);
 			return 0;
 		}
 	}
@@ -350,6 +533,15 @@ static void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+	/* Keep the filesystem mounted for the next call */
+	if (fs_mount.desc && fs_type == fs_mount.fstype) {
+		fs_type = FS_TYPE_ANY;
+		if (fs_mount.stale)
+			fs_mount_drop();
+		return;
+	}
+#endif
 	info->close();
 
 	fs_type = FS_TYPE_ANY;
@@ -402,8 +594,20 @@ int fs_size(const char *filename, loff_t *size)
 	return ret;
 }
 
-int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
-	    loff_t *actread)
+int fs_file_open(const char *filename, loff_t *size)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	int ret;
+
+	ret = info->size(filename, size);
+	if (ret)
+		fs_close();
+
+	return ret;
+}
+
+int fs_file_read(const char *filename, ulong addr, loff_t offset, loff_t len,
+		 loff_t *actread)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 	void *buf;
@@ -417,6 +621,21 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	ret = info->read(filename, buf, offset, len, actread);
 	unmap_sysmem(buf);
 
+	return ret;
+}
+
+void fs_file_close(void)
+{
+	fs_close();
+}
+
+int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
+	    loff_t *actread)
+{
+	int ret;
+
+	ret = fs_file_read(filename, addr, offset, len, actread);
+
 	/* If we requested a specific number of bytes, check we got it */
 	if (ret == 0 && len && *actread != len)
 		debug("** %s shorter than offset + len **\n", filename);
@@ -435,6 +654,7 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	buf = map_sysmem(addr, len);
 	ret = info->write(filename, buf, offset, len, actwrite);
 	unmap_sysmem(buf);
+	fs_cache_invalidate(fs_dev_desc);
 
 	if (ret < 0 && len != *actwrite) {
 		printf("** Unable to write file %s **\n", filename);
@@ -122,6 +122,10 @@ typedef struct global_data {
 	struct list_head log_head;	/* List of struct log_device */
 	int log_fmt;			/* Mask containing log format info */
 #endif
+#ifdef CONFIG_LOG_RING
+	struct log_ring *log_ring;	/* Ring buffer of log records */
+	struct log_ring *new_log_ring;	/* Relocated log ring */
+#endif
 } gd_t;
 #endif
 
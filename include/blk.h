@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -115,6 +116,10 @@ struct blk_desc {
 /**
  * blkcache_read() - attempt to read a set of blocks from cache
  *
+ * The cache may hold only the start of the requested range, in which case
+ * the leading blocks are copied and the caller must read the remainder
+ * from the device.
+ *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
  * @param start - starting block number
@@ -122,7 +127,7 @@ struct blk_desc {
  * @param blksz - size in bytes of each block
  * @param buf - buffer to contain cached data
  *
- * @return - '1' if block returned from cache, '0' otherwise.
+ * @return - number of leading blocks returned from cache (0 to blkcnt)
  */
 int blkcache_read(int iftype, int dev,
 		  lbaint_t start, lbaint_t blkcnt,
@@ -145,31 +150,50 @@ void blkcache_fill(int iftype, int dev,
 		   unsigned long blksz, void const *buffer);
 
 /**
- * blkcache_invalidate() - discard the cache for a set of blocks
- * because of a write or device (re)initialization.
+ * blkcache_invalidate() - discard the cache for a device
+ * because of device (re)initialization.
  *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
  */
 void blkcache_invalidate(int iftype, int dev);
 
+/**
+ * blkcache_invalidate_range() - discard the cache for a set of blocks
+ * because of a write or erase.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks affected
+ */
+void blkcache_invalidate_range(int iftype, int dev,
+			       lbaint_t start, lbaint_t blkcnt);
+
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * Changing the size discards the cache contents.
+ *
+ * @param size - cache capacity in bytes
+ * @param blocks - largest read (in blocks) that is added to the cache
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned long size, unsigned blocks);
 
 /*
  * statistics of the block cache
  */
 struct block_cache_stats {
 	unsigned hits;
+	unsigned partial_hits;	/* only the start of the read was cached */
 	unsigned misses;
-	unsigned entries; /* current entry count */
+	unsigned evictions;
+	unsigned entries; /* current number of lines in use */
 	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned max_entries; /* number of lines */
+	unsigned long size; /* capacity in bytes */
+	unsigned line_size;
+	unsigned ways;
 };
 
 /**
@@ -194,11 +218,140 @@ static inline void blkcache_fill(int iftype, int dev,
 
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
+static inline void blkcache_invalidate_range(int iftype, int dev,
+					     lbaint_t start,
+					     lbaint_t blkcnt) {}
+
+#endif
+
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+/**
+ * struct blk_readahead - read-ahead state for a block device
+ *
+ * This is the uclass-private data of each block device.
+ *
+ * @next:	Block following the last one read, used to detect streams
+ * @start:	First block held in @buf
+ * @count:	Number of valid blocks in @buf
+ * @size:	Capacity of @buf in blocks
+ * @window:	Current read-ahead size in blocks
+ * @buf:	Read-ahead buffer, allocated on first use
+ */
+struct blk_readahead {
+	lbaint_t next;
+	lbaint_t start;
+	lbaint_t count;
+	lbaint_t size;
+	lbaint_t window;
+	char *buf;
+};
+
+/*
+ * statistics of the read-ahead layer, across all devices
+ */
+struct blk_readahead_stats {
+	unsigned long hits;	/* blocks returned from read-ahead buffers */
+	unsigned reads;		/* read-ahead requests issued */
+	unsigned long blocks;	/* blocks read ahead */
+	unsigned shrinks;	/* window reductions due to random access */
+	unsigned long max_size;	/* largest window in bytes */
+};
+
+/**
+ * blkra_read() - read blocks through the read-ahead buffer
+ *
+ * If the start of the request is in the device's read-ahead buffer it is
+ * copied from there. If the request continues a sequential stream, a
+ * larger window is read from the device and the request is served from
+ * that.
+ *
+ * @desc:	Block device descriptor
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Destination buffer
+ * @return number of leading blocks placed in @buffer; the caller must
+ *	read any remaining blocks from the device
+ */
+ulong blkra_read(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		 void *buffer);
+
+/**
+ * blkra_invalidate() - discard read-ahead data for a device
+ *
+ * @desc:	Block device descriptor
+ */
+void blkra_invalidate(struct blk_desc *desc);
+
+/**
+ * blkra_release() - free the read-ahead buffer of a device
+ *
+ * @desc:	Block device descriptor
+ */
+void blkra_release(struct blk_desc *desc);
+
+/**
+ * blkra_configure() - set the maximum read-ahead window
+ *
+ * @size:	Largest window in bytes, 0 to disable read-ahead
+ */
+void blkra_configure(unsigned long size);
+
+/**
+ * blkra_stats() - return read-ahead statistics and reset them
+ *
+ * @stats:	Statistics are copied here
+ */
+void blkra_stats(struct blk_readahead_stats *stats);
+#else
+static inline ulong blkra_read(struct blk_desc *desc, lbaint_t start,
+			       lbaint_t blkcnt, void *buffer)
+{
+	return 0;
+}
+
+static inline void blkra_invalidate(struct blk_desc *desc) {}
+static inline void blkra_release(struct blk_desc *desc) {}
 #endif
 
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+/**
+ * struct blk_request - a queued block device request
+ *
+ * Requests are submitted in a list with blk_dsubmit() and complete
+ * asynchronously. Completion is detected by calling blk_dpoll().
+ *
+ * @list:	Entry in the caller's submission list
+ * @op:	Operation to perform
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Data buffer
+ * @blks_done:	Number of blocks transferred, valid on completion
+ * @status:	-EINPROGRESS while the request is outstanding, then 0 if OK
+ *		or -ve error number
+ * @complete:	Optional function called when the request completes
+ * @priv:	Private data for the caller
+ * @drv_priv:	Private data for the driver while the request is queued
+ */
+struct blk_request {
+	struct list_head list;
+	enum blk_req_op op;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	lbaint_t blks_done;
+	int status;
+	void (*complete)(struct blk_request *req);
+	void *priv;
+	ulong drv_priv;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -257,6 +410,32 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - queue a request without waiting for it to complete
+	 *
+	 * This is optional. Devices which do not provide it have their
+	 * requests carried out synchronously using read() / write().
+	 *
+	 * The driver must call blk_request_done() from poll() once the
+	 * request has completed.
+	 *
+	 * @dev:	Device to queue the request on
+	 * @req:	Request to queue
+	 * @return 0 if queued, -EBUSY if the queue is full and poll() must
+	 * be called to reclaim space, other -ve error number on failure
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - process completed requests
+	 *
+	 * This must be provided if submit() is.
+	 *
+	 * @dev:	Device to poll
+	 * @return number of requests still outstanding, or -ve error number
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -274,6 +453,52 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_dsubmit() - queue a list of requests on a block device
+ *
+ * Each request in @reqs is handed to the device in order and marked as
+ * in progress. The caller must keep the requests and their buffers
+ * valid until they complete. Devices without a submit() method carry
+ * out each request before this function returns.
+ *
+ * @block_dev:	Block device descriptor
+ * @reqs:	List of struct blk_request to submit
+ * @return 0 if all requests were queued, -ETIMEDOUT if the device did not
+ * make room for a request in time, other -ve on error; requests which
+ * were not queued are completed with an error status
+ */
+int blk_dsubmit(struct blk_desc *block_dev, struct list_head *reqs);
+
+/**
+ * blk_dpoll() - process completed requests on a block device
+ *
+ * @block_dev:	Block device descriptor
+ * @return number of requests still outstanding, or -ve error number
+ */
+int blk_dpoll(struct blk_desc *block_dev);
+
+/**
+ * blk_dwait() - wait for all outstanding requests on a block device
+ *
+ * @block_dev:	Block device descriptor
+ * @timeout_ms:	Time to wait in milliseconds
+ * @return 0 if all requests completed, -ETIMEDOUT on timeout, other -ve
+ * error number on failure
+ */
+int blk_dwait(struct blk_desc *block_dev, ulong timeout_ms);
+
+/**
+ * blk_request_done() - mark a request as complete
+ *
+ * This is called by drivers when a request finishes.
+ *
+ * @req:	Request which has completed
+ * @blks_done:	Number of blocks transferred
+ * @status:	0 if OK, -ve error number on failure
+ */
+void blk_request_done(struct blk_request *req, lbaint_t blks_done,
+		      int status);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -417,10 +642,15 @@ int blk_get_from_parent(struct udevice *parent, struct udevice **devp);
 static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			      lbaint_t blkcnt, void *buffer)
 {
-	ulong blks_read;
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
+	ulong blks_read, cached;
+
+	cached = blkcache_read(block_dev->if_type, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	if (cached == blkcnt)
 		return blkcnt;
+	start += cached;
+	blkcnt -= cached;
+	buffer += cached * block_dev->blksz;
 
 	/*
 	 * We could check if block_read is NULL and return -ENOSYS. But this
@@ -431,21 +661,25 @@ static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
+	else if (blks_read > blkcnt)
+		return blks_read;
 
-	return blks_read;
+	return cached + blks_read;
 }
 
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
 static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
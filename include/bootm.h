@@ -72,6 +72,29 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 		       void *load_buf, void *image_buf, ulong image_len,
 		       uint unc_len, ulong *load_end);
 
+/**
+ * bootm_decomp_stream() - decompress an image while reading it
+ *
+ * This reads the image from @src a chunk at a time and passes each chunk to
+ * the decompressor, so the compressed image is never held in memory as a
+ * whole. Only uncompressed, gzip and LZ4 images are supported.
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @load:	Destination load address in U-Boot memory
+ * @type:	OS type (IH_OS_...)
+ * @load_buf:	Place to decompress to
+ * @unc_len:	Available space for decompression; no more than
+ *		CONFIG_SYS_BOOTM_LEN is used
+ * @src:	Source to read the image from
+ * @image_len:	Number of bytes to read from @src
+ * @load_end:	Returns the end of the decompressed image
+ * @return 0 if OK, -ENOSYS if @comp cannot be streamed (in which case
+ *	nothing is read from @src), other -ve on error (-EIO, BOOTM_ERR_...)
+ */
+int bootm_decomp_stream(int comp, ulong load, int type, void *load_buf,
+			ulong unc_len, struct image_stream *src,
+			ulong image_len, ulong *load_end);
+
 /*
  * boards should define this to disable devices when EFI exits from boot
  * services.
@@ -199,6 +199,7 @@ enum bootstage_id {
 	BOOTSTATE_ID_ACCUM_DM_SPL,
 	BOOTSTATE_ID_ACCUM_DM_F,
 	BOOTSTATE_ID_ACCUM_DM_R,
+	BOOTSTAGE_ID_ACCUM_DM_SCAN,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -304,9 +305,66 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * bootstage_span_begin() - Mark the start of a span of time
+ *
+ * Spans may be nested: a span begun while another is open is recorded as
+ * being inside it. Spans appear in the bootstage report, in the device tree
+ * and in the trace-event export, where they show which parts of boot take
+ * the time.
+ *
+ * @name:	Name of the span, which must remain valid until relocation
+ * @return span ID to pass to bootstage_span_end(), or -ve if the span was not
+ *	recorded (in which case bootstage_span_end() ignores it)
+ */
+int bootstage_span_begin(const char *name);
+
+/**
+ * bootstage_span_begin_func() - Mark the start of a span for an init function
+ *
+ * This is used by initcall_run_list() with CONFIG_BOOTSTAGE_INITCALL. The span
+ * is named after the function address.
+ *
+ * @func:	Address of the function, before relocation
+ * @return span ID, as for bootstage_span_begin()
+ */
+int bootstage_span_begin_func(ulong func);
+
+/**
+ * bootstage_span_end() - Mark the end of a span of time
+ *
+ * Any spans inside this one which are still open are ended too.
+ *
+ * @span_id:	Span ID returned by bootstage_span_begin()
+ */
+void bootstage_span_end(int span_id);
+
+/**
+ * bootstage_span_end_all() - End all spans which are still open
+ *
+ * This is used after relocation, since the init function which relocates
+ * U-Boot may not return on some architectures. Its span is ended here, so
+ * that the spans in board_r are not recorded as being inside it.
+ */
+void bootstage_span_end_all(void);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
+/**
+ * bootstage_export_json() - Export bootstage data as trace-event JSON
+ *
+ * This writes the marks and spans in the Chrome trace-event format, which can
+ * be loaded into chrome://tracing or the Perfetto UI to see a timeline. Marks
+ * are instant events and spans are complete events, with their ID and parent
+ * ID as arguments. Accumulated times are listed in 'otherData'.
+ *
+ * @buf:	Buffer to write to, or NULL to write to the console
+ * @size:	Size of buffer
+ * @return number of bytes written, or needed if larger than @size
+ */
+int bootstage_export_json(char *buf, int size);
+
 /**
  * Add bootstage information to the device tree
  *
@@ -403,6 +461,24 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline int bootstage_span_begin(const char *name)
+{
+	return -ENOSYS;
+}
+
+static inline int bootstage_span_begin_func(ulong func)
+{
+	return -ENOSYS;
+}
+
+static inline void bootstage_span_end(int span_id)
+{
+}
+
+static inline void bootstage_span_end_all(void)
+{
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
@@ -436,6 +436,40 @@ int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
 
+struct gunzip_stream;
+
+/**
+ * gunzip_stream_start() - start decompressing gzip data piece by piece
+ *
+ * @dst:	Buffer to decompress into
+ * @dstlen:	Size of @dst in bytes
+ * @return stream state, or NULL if out of memory
+ */
+struct gunzip_stream *gunzip_stream_start(void *dst, ulong dstlen);
+
+/**
+ * gunzip_stream_feed() - decompress the next piece of a gzip stream
+ *
+ * The input does not need to be split at any particular boundary. Once the
+ * end of the gzip stream is reached, any further input is ignored.
+ *
+ * @gz:		Stream state from gunzip_stream_start()
+ * @src:	Compressed data
+ * @len:	Number of bytes at @src
+ * @return 0 if more input is needed, 1 if the stream is complete, -ENOBUFS
+ *	if the output buffer is full, other -ve value on corrupt data
+ */
+int gunzip_stream_feed(struct gunzip_stream *gz, const void *src, ulong len);
+
+/**
+ * gunzip_stream_finish() - finish decompressing and free the stream state
+ *
+ * @gz:		Stream state from gunzip_stream_start()
+ * @lenp:	Returns the number of bytes decompressed (may be NULL)
+ * @return 0 if the whole stream was decompressed, -EIO if it was truncated
+ */
+int gunzip_stream_finish(struct gunzip_stream *gz, ulong *lenp);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
@@ -478,6 +512,72 @@ int gzwrite(unsigned char *src, int len,
 /* lib/lz4_wrapper.c */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+struct ulz4_stream;
+
+/**
+ * ulz4fn_stream_start() - start decompressing an LZ4 frame piece by piece
+ *
+ * @dst:	Buffer to decompress into
+ * @dstn:	Size of @dst in bytes
+ * @return stream state, or NULL if out of memory
+ */
+struct ulz4_stream *ulz4fn_stream_start(void *dst, size_t dstn);
+
+/**
+ * ulz4fn_stream_feed() - decompress the next piece of an LZ4 frame
+ *
+ * Blocks which are split across calls are collected in an internal buffer;
+ * whole blocks are decompressed straight from @src.
+ *
+ * @lz:		Stream state from ulz4fn_stream_start()
+ * @src:	Compressed data
+ * @srcn:	Number of bytes at @src
+ * @return 0 if more input is needed, 1 if the frame is complete, -ENOBUFS
+ *	if the output buffer is full, other -ve value on error
+ */
+int ulz4fn_stream_feed(struct ulz4_stream *lz, const void *src, size_t srcn);
+
+/**
+ * ulz4fn_stream_finish() - finish decompressing and free the stream state
+ *
+ * @lz:		Stream state from ulz4fn_stream_start()
+ * @dstn:	Returns the number of bytes decompressed (may be NULL)
+ * @return 0 if the whole frame was decompressed, -EINVAL if it was truncated
+ */
+int ulz4fn_stream_finish(struct ulz4_stream *lz, size_t *dstn);
+
+/* lib/zstd.c */
+
+/**
+ * zstd_decompress() - decompress zstd data
+ *
+ * Decompresses all the frames in @src, skipping any skippable frames.
+ * Frames which need a dictionary are not supported.
+ *
+ * @src:	Compressed data
+ * @srcn:	Number of bytes at @src
+ * @dst:	Buffer to decompress into
+ * @dstn:	Size of @dst in bytes; returns the number of bytes decompressed
+ * @return 0 if OK, -ENOBUFS if @dst is too small, other -ve value on error
+ */
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn);
+
+/**
+ * zstd_decompress_frame() - decompress a single zstd frame
+ *
+ * This is for callers which store a frame followed by other data, e.g.
+ * padding up to a block size.
+ *
+ * @src:	Compressed data, starting with a frame
+ * @srcn:	Number of bytes at @src
+ * @dst:	Buffer to decompress into
+ * @dstn:	Size of @dst in bytes; returns the number of bytes decompressed
+ * @return number of bytes of @src in the frame, or -ve error as for
+ *	zstd_decompress()
+ */
+long zstd_decompress_frame(const void *src, size_t srcn, void *dst,
+			   size_t *dstn);
+
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
 	   int(*compar)(const void *, const void *));
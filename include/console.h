@@ -7,6 +7,9 @@
 #ifndef __CONSOLE_H
 #define __CONSOLE_H
 
+#include <log.h>
+#include <serial.h>
+
 extern char console_buffer[];
 
 /* common/console.c */
@@ -53,6 +56,19 @@ void console_record_reset_enable(void);
  */
 int console_announce_r(void);
 
+/**
+ * console_flush() - Write out all pending console output
+ *
+ * This writes out any log records waiting in the log ring, then waits until
+ * buffered serial output has been sent. Call it before U-Boot hangs, resets
+ * or hands over control, so that the last messages are not lost.
+ */
+static inline void console_flush(void)
+{
+	log_ring_flush();
+	serial_flush();
+}
+
 /*
  * CONSOLE multiplexing.
  */
@@ -123,6 +123,12 @@ enum {
  *		When CONFIG_DEVRES is enabled, devm_kmalloc() and friends will
  *		add to this list. Memory so-allocated will be freed
  *		automatically when the device is removed / unbound
+ * @seq_node: Entry in the uclass's index of devices by @seq
+ * @ofnode_node: Entry in the uclass's index of devices by @node
+ * @phandle_node: Entry in the uclass's index of devices by the phandle of
+ *		@node
+ * @bind_order: Position of this device in its uclass's list, used to pick
+ *		the first of several devices with the same key
  */
 struct udevice {
 	const struct driver *driver;
@@ -146,6 +152,12 @@ struct udevice {
 #ifdef CONFIG_DEVRES
 	struct list_head devres_head;
 #endif
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct hlist_node seq_node;
+	struct hlist_node ofnode_node;
+	struct hlist_node phandle_node;
+	ulong bind_order;
+#endif
 };
 
 /* Maximum sequence number supported */
@@ -162,9 +174,27 @@ static inline int dev_of_offset(const struct udevice *dev)
 	return ofnode_to_offset(dev->node);
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/**
+ * dev_set_ofnode() - Change the device-tree node of a device
+ *
+ * This keeps the uclass's index of devices by node up to date, so it must be
+ * used rather than writing to dev->node once the device is bound.
+ *
+ * @dev:	Device to update
+ * @node:	New node for the device
+ */
+void dev_set_ofnode(struct udevice *dev, ofnode node);
+#else
+static inline void dev_set_ofnode(struct udevice *dev, ofnode node)
+{
+	dev->node = node;
+}
+#endif
+
 static inline void dev_set_of_offset(struct udevice *dev, int of_offset)
 {
-	dev->node = offset_to_ofnode(of_offset);
+	dev_set_ofnode(dev, offset_to_ofnode(of_offset));
 }
 
 static inline bool dev_has_of_node(struct udevice *dev)
@@ -75,13 +75,15 @@ int uclass_find_next_device(struct udevice **devp);
 /**
  * uclass_find_device_by_name() - Find uclass device based on ID and name
  *
- * This searches for a device with the exactly given name.
+ * This returns the first device in the uclass whose name starts with
+ * @name, so a device with exactly that name is only found if no device
+ * before it in the uclass has a longer name starting the same way.
  *
  * The device is NOT probed, it is merely returned.
  *
  * @id: ID to look up
  * @name: name of a device to find
- * @devp: Returns pointer to device (the first one with the name)
+ * @devp: Returns pointer to device (the first one whose name matches)
  * @return 0 if OK, -ve on error
  */
 int uclass_find_device_by_name(enum uclass_id id, const char *name,
@@ -142,6 +144,106 @@ int uclass_find_device_by_of_offset(enum uclass_id id, int node,
 int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 				 struct udevice **devp);
 
+/**
+ * uclass_find_next_device_by_ofnode() - Find each device attached to a node
+ *
+ * This finds all of the devices in a uclass which are attached to a device
+ * tree node, in no particular order. It is used to search all uclasses for a
+ * node without walking the whole device tree.
+ *
+ * The device is NOT probed, it is merely returned.
+ *
+ * @uc: uclass to search
+ * @node: Device tree node to search for
+ * @devp: On entry, NULL to find the first device or the device previously
+ * returned to find the next. On exit, the device found, or NULL if there are
+ * no more.
+ */
+void uclass_find_next_device_by_ofnode(struct uclass *uc, ofnode node,
+				       struct udevice **devp);
+
+/**
+ * uclass_index_update() - Update a device's entries in its uclass's index
+ *
+ * This must be called after changing the sequence number or device tree
+ * node of a device once it is bound, so that it can still be found by those.
+ *
+ * @dev:	Device that has changed
+ */
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+void uclass_index_update(struct udevice *dev);
+#else
+static inline void uclass_index_update(struct udevice *dev) {}
+#endif
+
+/**
+ * enum dm_lookup_t - Types of device lookup counted by CONFIG_DM_STATS
+ *
+ * @DM_LOOKUP_SEQ: uclass_find_device_by_seq()
+ * @DM_LOOKUP_NAME: uclass_find_device_by_name()
+ * @DM_LOOKUP_OFNODE: uclass_find_device_by_ofnode()
+ * @DM_LOOKUP_PHANDLE: uclass_get_device_by_phandle()
+ * @DM_LOOKUP_GLOBAL_OFNODE: device_find_global_by_ofnode()
+ */
+enum dm_lookup_t {
+	DM_LOOKUP_SEQ,
+	DM_LOOKUP_NAME,
+	DM_LOOKUP_OFNODE,
+	DM_LOOKUP_PHANDLE,
+	DM_LOOKUP_GLOBAL_OFNODE,
+
+	DM_LOOKUP_COUNT,
+};
+
+/**
+ * struct dm_lookup_stats - Statistics for one type of device lookup
+ *
+ * @calls: Number of lookups
+ * @found: Number of lookups which found a device
+ * @ticks: Total time spent in lookups, in timer ticks
+ */
+struct dm_lookup_stats {
+	ulong calls;
+	ulong found;
+	u64 ticks;
+};
+
+#if CONFIG_IS_ENABLED(DM_STATS)
+/**
+ * dm_stats_start() - Note the start of a device lookup
+ *
+ * @return the current time, to pass to dm_stats_end()
+ */
+u64 dm_stats_start(void);
+
+/**
+ * dm_stats_end() - Record a device lookup
+ *
+ * Lookups are only recorded after relocation.
+ *
+ * @type:	Type of lookup
+ * @start:	Value returned by dm_stats_start() for this lookup
+ * @found:	true if a device was found
+ */
+void dm_stats_end(enum dm_lookup_t type, u64 start, bool found);
+
+/**
+ * dm_get_lookup_stats() - Get the device lookup statistics
+ *
+ * @return array of DM_LOOKUP_COUNT entries, indexed by enum dm_lookup_t
+ */
+struct dm_lookup_stats *dm_get_lookup_stats(void);
+#else
+static inline u64 dm_stats_start(void)
+{
+	return 0;
+}
+
+static inline void dm_stats_end(enum dm_lookup_t type, u64 start, bool found)
+{
+}
+#endif
+
 /**
  * uclass_bind_device() - Associate device with a uclass
  *
@@ -30,12 +30,27 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @index: Hash tables of the devices in this uclass, keyed by sequence
+ * number, device-tree node and phandle; each has 1 << @index_bits buckets.
+ * This is NULL if no device has been bound since the full malloc() became
+ * available, or if allocation failed, in which case lookups walk @dev_head
+ * instead.
+ * @index_bits: log2 of the number of buckets in each hash table
+ * @dev_count: Number of devices in this uclass
+ * @bind_count: Number of devices bound to this uclass so far, used to order
+ * devices which share a key
  */
 struct uclass {
 	void *priv;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct hlist_head *index;
+	uint index_bits;
+	uint dev_count;
+	ulong bind_count;
+#endif
 };
 
 struct driver;
@@ -289,6 +289,51 @@ int env_import_redund(const char *buf1, int buf1_status,
 		      const char *buf2, int buf2_status);
 #endif
 
+/* Check the CRC of an environment read from storage */
+int env_crc_ok(const env_t *env);
+
+#ifdef CONFIG_ENV_APPEND_LOG
+#ifdef CONFIG_SYS_REDUNDAND_ENVIRONMENT
+#error "CONFIG_ENV_APPEND_LOG does not support a redundant environment"
+#endif
+
+/**
+ * env_export_append() - Export the changes since the last load or save
+ *
+ * This adds a record with the variables which changed to a copy of the
+ * environment as it is stored, so that only the record has to be written.
+ * The copy is updated straight away, so if writing fails the caller must
+ * call env_log_invalidate().
+ *
+ * @envp:	Returns the environment as it should now be stored
+ * @offp:	Returns the offset in @envp of the bytes to write
+ * @lenp:	Returns the number of bytes to write, 0 if nothing changed
+ * @return 0 if OK, -ENOSPC if the whole environment must be saved with
+ *	env_export() instead
+ */
+int env_export_append(env_t **envp, uint *offp, uint *lenp);
+
+/**
+ * env_log_invalidate() - Forget what is stored after a failed write
+ *
+ * The next save is then a full one.
+ */
+void env_log_invalidate(void);
+
+/**
+ * env_log_set_location() - Select the location for the next load or save
+ *
+ * Only the copy stored at one location is tracked for appending changes.
+ * If @loc is a different location, the next save there is a full one.
+ *
+ * @loc:	Location about to be loaded from or saved to
+ */
+void env_log_set_location(enum env_location loc);
+#else
+static inline void env_log_invalidate(void) {}
+static inline void env_log_set_location(enum env_location loc) {}
+#endif
+
 /**
  * env_get_char() - Get a character from the early environment
  *
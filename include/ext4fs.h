@@ -30,12 +30,27 @@
 
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
+#define EXT4_CASEFOLD_FL	0x40000000 /* Casefolded directory */
 #define EXT4_EXT_MAGIC			0xf30a
+/* Extents longer than this are unwritten and read as zero */
+#define EXT_INIT_MAX_LEN		(1 << 15)
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
 #define EXT4_INDIRECT_BLOCKS		12
 
+/* Superblock flags */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+/* Hash versions for hash tree (dir_index) directories */
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
 #define EXT4_BG_INODE_UNINIT		0x0001
 #define EXT4_BG_BLOCK_UNINIT		0x0002
 #define EXT4_BG_INODE_ZEROED		0x0004
@@ -78,6 +93,50 @@ struct ext4_extent_header {
 	__le32	eh_generation;	/* generation of the tree */
 };
 
+/*
+ * Hash tree directories keep the index in the first block, after the "." and
+ * ".." entries, and in interior blocks which look like a single empty entry
+ * to code which does not know about the index.
+ */
+#define EXT4_DX_ROOT_INFO_OFFSET	24
+#define EXT4_DX_NODE_OFFSET		8
+#define EXT4_DX_MAX_LEVELS		3
+
+struct ext4_dx_root_info {
+	__le32	reserved_zero;
+	__u8	hash_version;	/* DX_HASH_... */
+	__u8	info_length;	/* 8 */
+	__u8	indirect_levels;
+	__u8	unused_flags;
+};
+
+/*
+ * Index entry, sorted by hash. The first entry of each block holds struct
+ * ext4_dx_countlimit in place of the hash, which is taken to be zero.
+ */
+struct ext4_dx_entry {
+	__le32	hash;
+	__le32	block;		/* Logical block in the directory */
+};
+
+struct ext4_dx_countlimit {
+	__le16	limit;
+	__le16	count;
+};
+
+/**
+ * struct ext4_block_run - a run of file blocks which are contiguous on disk
+ *
+ * @lblk: First block in the file
+ * @len: Number of blocks
+ * @pblk: First block on disk, or 0 if the run is a hole, which reads as zero
+ */
+struct ext4_block_run {
+	uint32_t lblk;
+	uint32_t len;
+	uint64_t pblk;
+};
+
 struct ext_filesystem {
 	/* Total Sector of partition */
 	uint64_t total_sect;
@@ -146,6 +205,23 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock);
+
+/**
+ * ext4fs_map_run() - Map a run of file blocks to disk blocks
+ *
+ * This finds how far the blocks starting at @fileblock stay contiguous on
+ * disk (or stay a hole), so that they can be read in one go. For extent-based
+ * files the decoded extent tree is cached, so mapping the blocks of a file in
+ * turn only reads its extent tree once.
+ *
+ * @inode: Inode of file
+ * @fileblock: First block in the file to map
+ * @max: Maximum number of blocks to map
+ * @run: Returns the run starting at @fileblock, with at most @max blocks
+ * @return 0 if OK, -ve on error
+ */
+int ext4fs_map_run(struct ext2_inode *inode, uint32_t fileblock, uint32_t max,
+		   struct ext4_block_run *run);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 disk_partition_t *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
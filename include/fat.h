@@ -173,6 +173,7 @@ typedef struct {
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
+	int	fat_cached;	/* Read FAT entries through the FAT cache */
 } fsdata;
 
 static inline u32 clust_to_sect(fsdata *fsdata, u32 clust)
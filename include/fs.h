@@ -85,6 +85,34 @@ int fs_size(const char *filename, loff_t *size);
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread);
 
+/*
+ * fs_file_open - Keep the filesystem open for reading a file in pieces
+ *
+ * Each fs_read() closes the filesystem again, so the device has to be set
+ * and the filesystem mounted for every read. Instead, after fs_set_blk_dev(),
+ * call this once, then fs_file_read() as often as needed and finally
+ * fs_file_close(). No other fs_...() call may be made in between.
+ *
+ * @filename: Name of the file
+ * @size: Returns the size of the file
+ * @return 0 if ok with valid *size, negative on error, in which case the
+ *	filesystem is closed
+ */
+int fs_file_open(const char *filename, loff_t *size);
+
+/*
+ * fs_file_read - Read part of a file opened with fs_file_open()
+ *
+ * This is the same as fs_read() but leaves the filesystem open.
+ */
+int fs_file_read(const char *filename, ulong addr, loff_t offset, loff_t len,
+		 loff_t *actread);
+
+/*
+ * fs_file_close - Close the filesystem after fs_file_open()
+ */
+void fs_file_close(void);
+
 /*
  * fs_write - Write file to the partition previously set by fs_set_blk_dev()
  * Note that not all filesystem types support offset!=0.
@@ -99,6 +127,59 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite);
 
+struct blk_desc;
+
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+/**
+ * fs_cache_lookup() - Look up a path on the mounted filesystem
+ *
+ * With CONFIG_FS_MOUNT_CACHE the filesystem set by fs_set_blk_dev() stays
+ * mounted between calls, along with the results of recent path lookups. This
+ * is for use by filesystem drivers while handling a call from the fs layer.
+ *
+ * @path: Path to look up
+ * @data: Returns the information stored by fs_cache_add() for @path
+ * @size: Size of @data
+ * @return 0 if found, -ENOENT if not cached or the filesystem is not mounted
+ *	by the fs layer
+ */
+int fs_cache_lookup(const char *path, void *data, int size);
+
+/**
+ * fs_cache_add() - Remember the result of looking up a path
+ *
+ * This does nothing unless the current operation is on the cached mount.
+ * The oldest entry is replaced if the cache is full.
+ *
+ * @path: Path which was looked up
+ * @data: Filesystem-specific information to store, e.g. the inode
+ * @size: Size of @data
+ */
+void fs_cache_add(const char *path, const void *data, int size);
+
+/**
+ * fs_cache_invalidate() - Drop the cached mount
+ *
+ * This must be called when a block device is written other than through the
+ * filesystem, or when a filesystem driver is used directly rather than
+ * through the fs layer. If an fs-layer operation is in progress, the
+ * filesystem is unmounted when it finishes.
+ *
+ * @desc: Block device which changed, or NULL to drop the mount regardless
+ */
+void fs_cache_invalidate(struct blk_desc *desc);
+#else
+static inline int fs_cache_lookup(const char *path, void *data, int size)
+{
+	return -ENOENT;
+}
+
+static inline void fs_cache_add(const char *path, const void *data,
+				int size) {}
+
+static inline void fs_cache_invalidate(struct blk_desc *desc) {}
+#endif
+
 /*
  * Directory entry types, matches the subset of DT_x in posix readdir()
  * which apply to u-boot.
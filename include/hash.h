@@ -72,7 +72,53 @@ struct hash_algo {
 			   int size);
 };
 
+/**
+ * struct hash_backend - an implementation of the core of a hash algorithm
+ *
+ * The software hash algorithms keep the buffering and padding in one place
+ * and hand whole blocks to a backend, so that implementations using CPU
+ * extensions only need to provide the block function. Backends are declared
+ * with U_BOOT_HASH_BACKEND() and the available one with the highest
+ * priority is used whenever a hash is started.
+ *
+ * @algo:	Name of the algorithm implemented (e.g. "sha256")
+ * @name:	Name of this implementation
+ * @priority:	Preference for this backend; higher is preferred
+ * @probe:	Check whether this backend can run on this CPU. This may be
+ *		NULL if it always can.
+ * @blocks:	Hash @blocks whole blocks from @data into @state, whose
+ *		layout depends on the algorithm
+ */
+struct hash_backend {
+	const char *algo;
+	const char *name;
+	int priority;
+	bool (*probe)(void);
+	void (*blocks)(void *state, const uint8_t *data, unsigned int blocks);
+};
+
+/* Declare a new hash backend */
+#define U_BOOT_HASH_BACKEND(__name)					\
+	ll_entry_declare(struct hash_backend, __name, hash_backend)
+
 #ifndef USE_HOSTCC
+/**
+ * hash_backend_get() - Get the preferred backend for a hash algorithm
+ *
+ * @algo_name:	Hash algorithm to look up
+ * @return the available backend with the highest priority, or NULL if there
+ * is none
+ */
+const struct hash_backend *hash_backend_get(const char *algo_name);
+
+/**
+ * hash_backend_available() - Check whether a hash backend can be used
+ *
+ * @backend:	Backend to check
+ * @return true if @backend can run on this CPU
+ */
+bool hash_backend_available(const struct hash_backend *backend);
+
 /**
  * hash_command: Process a hash command for a particular algorithm
  *
@@ -660,6 +660,86 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		   int arch, int image_type, int bootstage_id,
 		   enum fit_load_op load_op, ulong *datap, ulong *lenp);
 
+/**
+ * struct image_stream - a source which supplies an image from start to end
+ *
+ * @read:	Read up to @len bytes of the image into @buf. Returns the
+ *		number of bytes read, which is 0 at the end of the image, or
+ *		-ve error code
+ * @size:	Total size of the image in bytes
+ * @priv:	Private data for @read
+ */
+struct image_stream {
+	long (*read)(struct image_stream *st, void *buf, ulong len);
+	ulong size;
+	void *priv;
+};
+
+#if defined(CONFIG_FIT_STREAM) && !defined(USE_HOSTCC)
+/**
+ * image_stream_read() - read exactly @len bytes from a stream
+ *
+ * This calls @src->read until @len bytes have been read. Reaching the end
+ * of the image first is an error.
+ *
+ * @src:	Source to read from
+ * @buf:	Buffer to read into
+ * @len:	Number of bytes to read
+ * @return 0 if OK, -ve error code on error
+ */
+int image_stream_read(struct image_stream *src, void *buf, ulong len);
+
+/**
+ * fit_image_load_stream() - read a FIT, decompressing its kernel on the way
+ *
+ * This reads a FIT from @src to @addr, except that the data of the kernel
+ * selected by @fit_uname_config is not copied into memory. Instead it is
+ * decompressed straight to its load address as it is read, checking its
+ * hashes along the way. A following bootm of @addr then uses the kernel
+ * which is already in place.
+ *
+ * Only kernels stored as external data (mkimage -E) can be handled like
+ * this. Otherwise, or if the kernel cannot be verified piece by piece, the
+ * FIT is simply read to @addr in full and bootm deals with it as usual.
+ *
+ * @src:		Source of the FIT
+ * @addr:		Address to read the FIT to
+ * @fit_uname_config:	Configuration to use, or NULL for the default
+ * @verify:		Check the kernel hashes
+ * @return 0 if OK, -ve error code on error
+ */
+int fit_image_load_stream(struct image_stream *src, ulong addr,
+			  const char *fit_uname_config, int verify);
+
+/**
+ * fit_image_streamed() - check for a kernel loaded by fit_image_load_stream()
+ *
+ * @fit:	Pointer to the FIT
+ * @noffset:	Kernel image node offset
+ * @loadp:	Returns the address the kernel was decompressed to (may be NULL)
+ * @load_endp:	Returns the end of the decompressed kernel (may be NULL)
+ * @return true if the kernel has already been verified and loaded
+ */
+bool fit_image_streamed(const void *fit, int noffset, ulong *loadp,
+			ulong *load_endp);
+
+/**
+ * fit_image_stream_done() - forget the kernel loaded by fit_image_load_stream()
+ *
+ * This is called once bootm has used the kernel, so that a later bootm of
+ * the same FIT does not rely on memory which may since have been reused.
+ */
+void fit_image_stream_done(void);
+#else
+static inline bool fit_image_streamed(const void *fit, int noffset,
+				      ulong *loadp, ulong *load_endp)
+{
+	return false;
+}
+
+static inline void fit_image_stream_done(void) {}
+#endif
+
 #ifndef USE_HOSTCC
 /**
  * fit_get_node_from_config() - Look up an image a FIT by type
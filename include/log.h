@@ -356,6 +356,84 @@ int log_add_filter(const char *drv_name, enum log_category_t cat_list[],
  */
 int log_remove_filter(const char *drv_name, int filter_num);
 
+/**
+ * log_device_passes_filters() - Check if a log device takes a record
+ *
+ * @drv_name: Name of the log driver of the device
+ * @rec: Record to check
+ * @return true if the device exists and its filters do not block @rec
+ */
+bool log_device_passes_filters(const char *drv_name, struct log_rec *rec);
+
+/**
+ * log_console_show() - Write a log record to the console
+ *
+ * This uses the format selected by gd->log_fmt.
+ *
+ * @rec: Record to write
+ */
+void log_console_show(struct log_rec *rec);
+
+/**
+ * log_ring_dump() - Write all records in the log ring to the console
+ *
+ * Each record is shown with the time at which it was logged. Records which
+ * have not yet been written out are counted as written.
+ *
+ * @return number of records shown
+ */
+int log_ring_dump(void);
+
+/**
+ * log_ring_get_size() - Get the space needed for the log ring
+ *
+ * @return size in bytes of the ring, including its header
+ */
+int log_ring_get_size(void);
+
+/**
+ * log_ring_move() - Move the log ring to a new buffer
+ *
+ * This is used when relocating. Records are copied from the current ring,
+ * which is then no longer used.
+ *
+ * @buf: Buffer to use, of log_ring_get_size() bytes
+ */
+void log_ring_move(void *buf);
+
+#if CONFIG_IS_ENABLED(LOG_RING)
+/**
+ * log_ring_flush() - Write out log records waiting in the ring
+ *
+ * With CONFIG_LOG_RING_DEFER the console log driver does not write records
+ * as they arrive. This writes out everything logged since the last call, and
+ * is called when U-Boot is idle or about to hand over control.
+ */
+void log_ring_flush(void);
+
+/**
+ * log_ring_defer() - Leave a console log record to the log ring
+ *
+ * This is called by the console log driver for each record which passes its
+ * filters. The record is kept in the ring, if the ring's own filters did not
+ * already keep it, and written out by log_ring_flush().
+ *
+ * @rec: Record to write to the console
+ * @return true if the record is written to the console by log_ring_flush(),
+ *	false if the console driver should write it
+ */
+bool log_ring_defer(struct log_rec *rec);
+#else
+static inline void log_ring_flush(void)
+{
+}
+
+static inline bool log_ring_defer(struct log_rec *rec)
+{
+	return false;
+}
+#endif
+
 #if CONFIG_IS_ENABLED(LOG)
 /**
  * log_init() - Set up the log system ready for use
@@ -59,6 +59,24 @@ typedef void rxhand_f(uchar *pkt, unsigned dport,
 		      struct in_addr sip, unsigned sport,
 		      unsigned len);
 
+/**
+ * Find where the payload of an incoming UDP packet should be received.
+ * This is called before the packet is received in full, so only the first
+ * NET_RX_PLACE_PEEK bytes (or @len if less) at @pkt are valid.
+ * @param pkt      pointer to the application packet
+ * @param dport    destination UDP port
+ * @param sip      source IP address
+ * @param sport    source UDP port
+ * @param len      packet length
+ * @param hdr_lenp returns the number of bytes at the start of the packet
+ *                 that the rxhand_f needs; the rest goes to the destination
+ * @return destination for the remaining bytes, or NULL to receive the
+ *	packet as usual
+ */
+typedef void *rxplace_f(const uchar *pkt, unsigned dport,
+			struct in_addr sip, unsigned sport,
+			unsigned len, unsigned *hdr_lenp);
+
 /**
  * An incoming ICMP packet handler.
  * @param type	ICMP type
@@ -107,6 +125,38 @@ enum eth_recv_flags {
 	ETH_RECV_CHECK_DEVICE		= 1 << 0,
 };
 
+/**
+ * enum eth_csum_offload - Checksums handled by the Ethernet hardware
+ *
+ * @ETH_CSUM_RX_IP: The IPv4 header checksum of received packets is checked
+ *	and packets where it is wrong are dropped
+ * @ETH_CSUM_RX_UDP: The checksum of received (unfragmented) UDP datagrams is
+ *	checked and datagrams where it is wrong are dropped
+ * @ETH_CSUM_TX_IP: The IPv4 header checksum of sent packets is filled in
+ * @ETH_CSUM_TX_UDP: The checksum of sent UDP datagrams is filled in
+ */
+enum eth_csum_offload {
+	ETH_CSUM_RX_IP		= 1 << 0,
+	ETH_CSUM_RX_UDP		= 1 << 1,
+	ETH_CSUM_TX_IP		= 1 << 2,
+	ETH_CSUM_TX_UDP		= 1 << 3,
+};
+
+/**
+ * struct eth_rx_desc - A received packet, as returned by recv_batch()
+ *
+ * @packet: Start of the packet (the Ethernet header)
+ * @length: Length of the packet in bytes
+ * @payload: Where the payload was put, if net_rx_place() returned a
+ *	destination for it, else NULL. The packet then only holds the headers,
+ *	though @length still covers the whole packet
+ */
+struct eth_rx_desc {
+	uchar *packet;
+	int length;
+	void *payload;
+};
+
 /**
  * struct eth_ops - functions of Ethernet MAC controllers
  *
@@ -117,6 +167,12 @@ enum eth_recv_flags {
  *	 indicate that the hardware receive FIFO is empty. If 0 is returned, the
  *	 network stack will not process the empty packet, but free_pkt() will be
  *	 called if supplied
+ * recv_batch: Return up to @max received packets at once in @descs, and the
+ *	       number of packets returned. If there are none, return 0 or an
+ *	       error. Every packet is passed to free_pkt(), whether or not
+ *	       it was processed, before recv_batch() is called again, unless
+ *	       the device is stopped first. If provided, this is used
+ *	       instead of recv - optional
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
@@ -132,11 +188,17 @@ enum eth_recv_flags {
  *		    ROM on the board. This is how the driver should expose it
  *		    to the network stack. This function should fill in the
  *		    eth_pdata::enetaddr field - optional
+ * get_csum_offload: Return the checksums the hardware handles, as a mask of
+ *		     enum eth_csum_offload. This is called after start() and
+ *		     the stack then skips those checksums in software. Fields
+ *		     left for the hardware to fill in are sent as 0 - optional
  */
 struct eth_ops {
 	int (*start)(struct udevice *dev);
 	int (*send)(struct udevice *dev, void *packet, int length);
 	int (*recv)(struct udevice *dev, int flags, uchar **packetp);
+	int (*recv_batch)(struct udevice *dev, int flags,
+			  struct eth_rx_desc *descs, int max);
 	int (*free_pkt)(struct udevice *dev, uchar *packet, int length);
 	void (*stop)(struct udevice *dev);
 #ifdef CONFIG_MCAST_TFTP
@@ -144,6 +206,7 @@ struct eth_ops {
 #endif
 	int (*write_hwaddr)(struct udevice *dev);
 	int (*read_rom_hwaddr)(struct udevice *dev);
+	int (*get_csum_offload)(struct udevice *dev);
 };
 
 #define eth_get_ops(dev) ((struct eth_ops *)(dev)->driver->ops)
@@ -160,6 +223,38 @@ unsigned char *eth_get_ethaddr(void); /* get the current device MAC */
 int eth_is_active(struct udevice *dev); /* Test device for active state */
 int eth_init_state_only(void); /* Set active state */
 void eth_halt_state_only(void); /* Set passive state */
+
+/**
+ * eth_get_csum_offload() - Get the checksums handled by the current device
+ *
+ * @return mask of enum eth_csum_offload, 0 if the device is not started
+ */
+int eth_get_csum_offload(void);
+
+/**
+ * net_rx_pool_alloc() - Get a buffer from the receive buffer pool
+ *
+ * Drivers can use this pool for their receive rings instead of allocating
+ * buffers themselves. Each buffer holds PKTSIZE_ALIGN bytes and is aligned
+ * for DMA. There are CONFIG_NET_RX_POOL_SIZE buffers in all.
+ *
+ * @return pointer to the buffer, or NULL if none is free
+ */
+uchar *net_rx_pool_alloc(void);
+
+/**
+ * net_rx_pool_free() - Return a buffer to the receive buffer pool
+ *
+ * @packet: Buffer obtained from net_rx_pool_alloc()
+ */
+void net_rx_pool_free(uchar *packet);
+
+/**
+ * net_rx_pool_avail() - Get the number of free buffers in the pool
+ *
+ * @return number of buffers that net_rx_pool_alloc() can still return
+ */
+int net_rx_pool_avail(void);
 #endif
 
 #ifndef CONFIG_DM_ETH
@@ -192,6 +287,12 @@ static __always_inline struct eth_device *eth_get_dev(void)
 {
 	return eth_current;
 }
+
+/* Legacy drivers cannot offload checksums */
+static inline int eth_get_csum_offload(void)
+{
+	return 0;
+}
 struct eth_device *eth_get_dev_by_name(const char *devname);
 struct eth_device *eth_get_dev_by_index(int index); /* get dev @ index */
 
@@ -351,6 +452,7 @@ struct vlan_ethernet_hdr {
 #define PROT_PPP_SES	0x8864		/* PPPoE session messages	*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -524,6 +626,7 @@ extern uchar		*net_tx_packet;		/* THE transmit packet */
 extern uchar		*net_rx_packets[PKTBUFSRX]; /* Receive packets */
 extern uchar		*net_rx_packet;		/* Current receive packet */
 extern int		net_rx_packet_len;	/* Current rx packet length */
+extern void		*net_rx_payload;	/* Placed payload, or NULL */
 extern const u8		net_bcast_ethaddr[ARP_HLEN];	/* Ethernet broadcast address */
 extern const u8		net_null_ethaddr[ARP_HLEN];
 
@@ -536,7 +639,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL
+	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, WGET
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -630,9 +733,59 @@ unsigned add_ip_checksums(unsigned offset, unsigned sum, unsigned new_sum);
  */
 int ip_checksum_ok(const void *addr, unsigned nbytes);
 
+/**
+ * compute_udp_checksum() - Compute the checksum of a UDP datagram
+ *
+ * This covers the pseudo header taken from the IP header and the
+ * ntohs(ip->udp_len) bytes of UDP header and data. To fill in the checksum,
+ * set ip->udp_xsum to 0 first and store the result, or 0xffff if it is 0.
+ * For a received datagram with a checksum the result is 0 if it is correct.
+ *
+ * @ip:		IP header followed by the UDP header (must be 16-bit aligned)
+ * @return 16-bit UDP checksum
+ */
+unsigned compute_udp_checksum(const struct ip_udp_hdr *ip);
+
 /* Callbacks */
 rxhand_f *net_get_udp_handler(void);	/* Get UDP RX packet handler */
 void net_set_udp_handler(rxhand_f *);	/* Set UDP RX packet handler */
+
+/**
+ * net_set_udp_place_handler() - Let a protocol place received payloads
+ *
+ * With a place handler the protocol can say where the payload of each
+ * packet should end up, typically in the image being loaded. Drivers that
+ * support it then put the payload straight there instead of in the receive
+ * buffer, which saves copying it later. The UDP handler sees such a packet
+ * with net_rx_payload pointing to the payload.
+ *
+ * This is cleared by net_set_udp_handler(), so set it after that.
+ *
+ * @f:		Place handler, or NULL for none
+ */
+void net_set_udp_place_handler(rxplace_f *f);
+
+/* Number of bytes of UDP payload available to the place handler */
+#define NET_RX_PLACE_PEEK	32
+
+/**
+ * net_rx_place() - Find where the payload of a received packet should go
+ *
+ * Drivers which can split the headers of a received packet from the rest
+ * call this once they have the start of the packet, that is at least the
+ * Ethernet, IP and UDP headers and NET_RX_PLACE_PEEK bytes after them.
+ * Only unfragmented UDP packets whose checksums need no checking in
+ * software are placed, since the stack cannot see the payload.
+ *
+ * @pkt:	Start of the packet (the Ethernet header)
+ * @len:	Length of the whole packet
+ * @offsetp:	Returns the offset in the packet at which the payload starts
+ * @sizep:	Returns the number of payload bytes to put at the destination;
+ *		anything after that is padding and can be dropped
+ * @return destination for the payload, or NULL to receive the whole packet
+ *	into the receive buffer as usual
+ */
+void *net_rx_place(const uchar *pkt, int len, int *offsetp, int *sizep);
 rxhand_f *net_get_arp_handler(void);	/* Get ARP RX packet handler */
 void net_set_arp_handler(rxhand_f *);	/* Set ARP RX packet handler */
 void net_set_icmp_handler(rxhand_icmp_f *f); /* Set ICMP RX handler */
@@ -673,6 +826,19 @@ static inline void net_send_packet(uchar *pkt, int len)
 int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport,
 			int sport, int payload_len);
 
+/*
+ * Transmit "net_tx_packet" as an IP packet of the given protocol, performing
+ * ARP request if needed (ether will be populated). The payload must already
+ * be in place after the Ethernet and IP headers.
+ *
+ * @param ether Raw packet buffer
+ * @param dest IP address to send the packet to
+ * @param proto IP protocol number (IPPROTO_...)
+ * @param payload_len Length of data after the IP header
+ */
+int net_send_ip_packet(uchar *ether, struct in_addr dest, int proto,
+		       int payload_len);
+
 /* Processes a received packet */
 void net_process_received_packet(uchar *in_packet, int len);
 
@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+#include <net.h>
+
+struct tcp_hdr {
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* sequence number		*/
+	u32		tcp_ack;	/* acknowledgement number	*/
+	u8		tcp_hlen;	/* header length (words) << 4	*/
+	u8		tcp_flags;	/* control flags		*/
+	u16		tcp_win;	/* receive window		*/
+	u16		tcp_xsum;	/* checksum			*/
+	u16		tcp_urg;	/* urgent pointer		*/
+} __attribute__((packed));
+
+#define TCP_HDR_SIZE		(sizeof(struct tcp_hdr))
+
+#define TCP_FIN			0x01
+#define TCP_SYN			0x02
+#define TCP_RST			0x04
+#define TCP_PSH			0x08
+#define TCP_ACK			0x10
+
+#define TCP_OPT_END		0
+#define TCP_OPT_NOP		1
+#define TCP_OPT_MSS		2
+
+/* Largest segment we accept, to fit a standard Ethernet frame */
+#define TCP_MSS			(1500 - IP_HDR_SIZE - TCP_HDR_SIZE)
+
+enum tcp_event {
+	TCP_EV_CONNECTED,	/* handshake complete, data can be sent */
+	TCP_EV_CLOSED,		/* both sides have closed the connection */
+	TCP_EV_RESET,		/* connection refused or reset by the peer */
+	TCP_EV_TIMEOUT,		/* peer stopped responding */
+};
+
+/**
+ * tcp_rx_f - Called with data received on the connection
+ *
+ * Segments which arrive ahead of a gap are passed on straight away, so
+ * @offset is not always the end of the previous call. The handler may
+ * refuse such data by returning non-zero, in which case it is dropped and
+ * the peer sends it again later.
+ *
+ * @data:	Received data
+ * @offset:	Offset of @data from the start of the stream
+ * @len:	Number of bytes
+ * @return 0 if the data was taken, non-zero to drop it
+ */
+typedef int tcp_rx_f(const uchar *data, u32 offset, unsigned len);
+
+/**
+ * tcp_event_f - Called when the connection changes state
+ *
+ * After any event other than TCP_EV_CONNECTED the connection is closed and
+ * the handlers are no longer called.
+ *
+ * @event:	What happened
+ */
+typedef void tcp_event_f(enum tcp_event event);
+
+/**
+ * tcp_connect() - Open a connection
+ *
+ * Only one connection can be open at a time; any previous one is dropped.
+ * The connection is driven by net_loop(), so this is normally called from
+ * a protocol's start function.
+ *
+ * @dest:	IP address of the server
+ * @dport:	TCP port of the server
+ * @rx:		Handler for received data
+ * @event:	Handler for connection events
+ */
+void tcp_connect(struct in_addr dest, int dport, tcp_rx_f *rx,
+		 tcp_event_f *event);
+
+/**
+ * tcp_send() - Queue data to send on the connection
+ *
+ * The data is copied, so the buffer may be reused straight away. It is
+ * sent once the connection is established.
+ *
+ * @data:	Data to send
+ * @len:	Number of bytes
+ * @return 0 if OK, -ENOSPC if there is no room for the data, -ENOTCONN if
+ *	there is no connection
+ */
+int tcp_send(const void *data, unsigned len);
+
+/**
+ * tcp_close() - Close the connection once all queued data is sent
+ *
+ * The event handler is called with TCP_EV_CLOSED when the peer has closed
+ * its side as well.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_abort() - Reset the connection immediately
+ *
+ * No further events are reported.
+ */
+void tcp_abort(void);
+
+/**
+ * tcp_receive() - Process a received TCP segment
+ *
+ * @ip:		IP header of the received packet
+ * @len:	Length of the IP packet
+ */
+void tcp_receive(struct ip_udp_hdr *ip, unsigned len);
+
+/**
+ * tcp_checksum() - Calculate the checksum of a TCP segment
+ *
+ * This covers the pseudo header as well as the segment. For a received
+ * segment, the result is 0 if the checksum is correct.
+ *
+ * @src:	Source IP address
+ * @dst:	Destination IP address
+ * @tcp:	TCP header followed by the data
+ * @len:	Length of header and data
+ * @return checksum in network byte order
+ */
+unsigned tcp_checksum(struct in_addr src, struct in_addr dst,
+		      const void *tcp, unsigned len);
+
+#endif /* __TCP_H__ */
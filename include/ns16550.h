@@ -51,6 +51,8 @@
  * @base:		Base register address
  * @reg_shift:		Shift size of registers (0=byte, 1=16bit, 2=32bit...)
  * @clock:		UART base clock speed in Hz
+ * @fifo_size:		Size of the transmit FIFO in bytes (0 to send one
+ *			character at a time)
  */
 struct ns16550_platdata {
 	unsigned long base;
@@ -58,6 +60,7 @@ struct ns16550_platdata {
 	int clock;
 	int reg_offset;
 	u32 fcr;
+	int fifo_size;
 };
 
 struct udevice;
@@ -6,12 +6,21 @@
 #ifndef __SANDBOX_BLOCK_DEV__
 #define __SANDBOX_BLOCK_DEV__
 
+/* Number of requests which can be queued on a host device */
+#define HOST_QUEUE_DEPTH	4
+
 struct host_block_dev {
 #ifndef CONFIG_BLK
 	struct blk_desc blk_dev;
 #endif
 	char *filename;
 	int fd;
+#ifdef CONFIG_BLK
+	/* Ring of queued requests, completed in order by poll() */
+	struct blk_request *queue[HOST_QUEUE_DEPTH];
+	int queue_head;
+	int queue_count;
+#endif
 };
 
 int host_dev_bind(int dev, char *filename);
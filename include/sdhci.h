@@ -186,6 +186,7 @@
 /* 55-57 reserved */
 
 #define SDHCI_ADMA_ADDRESS	0x58
+#define SDHCI_ADMA_ADDRESS_HI	0x5C
 
 /* 60-FB reserved */
 
@@ -230,11 +231,54 @@
 /* to make gcc happy */
 struct sdhci_host;
 
+/* host->flags */
+#define USE_SDMA	BIT(0)
+#define USE_ADMA	BIT(1)
+#define USE_ADMA64	BIT(2)
+#define USE_DMA		(USE_SDMA | USE_ADMA | USE_ADMA64)
+
 /*
  * Host SDMA buffer boundary. Valid values from 4K to 512K in powers of 2.
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+/*
+ * ADMA2 descriptor table. Each descriptor moves up to ADMA_MAX_LEN bytes,
+ * and the table is large enough to map the largest transfer the block
+ * count register allows (ADMA_MAX_BLOCKS of MMC_MAX_BLOCK_LEN bytes) in a
+ * single chain.
+ */
+#define ADMA_MAX_LEN		65532
+#define ADMA_MAX_BLOCKS		65535
+#define ADMA_ALIGN		4	/* Alignment of data for a descriptor */
+#define ADMA_TABLE_NO_ENTRIES	\
+	DIV_ROUND_UP(ADMA_MAX_BLOCKS * MMC_MAX_BLOCK_LEN, ADMA_MAX_LEN)
+#define ADMA_TABLE_SZ		\
+	(ADMA_TABLE_NO_ENTRIES * sizeof(struct sdhci_adma_desc))
+
+/* Descriptor attributes */
+#define ADMA_DESC_ATTR_VALID	BIT(0)
+#define ADMA_DESC_ATTR_END	BIT(1)
+#define ADMA_DESC_ATTR_INT	BIT(2)
+#define ADMA_DESC_ATTR_ACT1	BIT(4)
+#define ADMA_DESC_ATTR_ACT2	BIT(5)
+#define ADMA_DESC_TRANSFER_DATA	ADMA_DESC_ATTR_ACT2
+
+/*
+ * With 64-bit DMA addresses the descriptor carries the upper address word
+ * too (the 96-bit format of the SDHCI 3.00 specification).
+ */
+struct sdhci_adma_desc {
+	u8 attr;
+	u8 reserved;
+	u16 len;
+	u32 addr_lo;
+#ifdef CONFIG_DMA_ADDR_T_64BIT
+	u32 addr_hi;
+#endif
+} __packed;
+
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32	(*read_l)(struct sdhci_host *host, int reg);
@@ -272,6 +316,8 @@ struct sdhci_host {
 	uint	voltages;
 
 	struct mmc_config cfg;
+	u32	flags;
+	struct sdhci_adma_desc *adma_desc_table;
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -52,6 +52,9 @@ struct hsearch_data {
 	struct _ENTRY *table;
 	unsigned int size;
 	unsigned int filled;
+	unsigned int deleted;	/* slots freed by hdelete_r() */
+	unsigned int *sorted;	/* table indices in ascending key order */
+	int busy;		/* change_ok() or a callback is running */
 /*
  * Callback function which will check whether the given change for variable
  * "__item" to "newval" may be applied or not, and possibly apply such change.
@@ -63,7 +66,10 @@ struct hsearch_data {
 		int flag);
 };
 
-/* Create a new hash table which will contain at most "__nel" elements.  */
+/*
+ * Create a new hash table with room for "__nel" elements. The table grows
+ * as needed when entries are added.
+ */
 extern int hcreate_r(size_t __nel, struct hsearch_data *__htab);
 
 /* Destroy current internal hash table.  */
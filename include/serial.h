@@ -111,6 +111,22 @@ struct dm_serial_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*putc)(struct udevice *dev, const char ch);
+	/**
+	 * puts() - Write a run of characters
+	 *
+	 * This writes as many characters as the UART can accept without
+	 * waiting, e.g. enough to fill its transmit FIFO. No translation is
+	 * done, so '\n' is written as is.
+	 *
+	 * This method is optional. If it is not provided, putc() is used.
+	 *
+	 * @dev: Device pointer
+	 * @s: Characters to write
+	 * @len: Number of characters in @s (at least 1)
+	 * @return number of characters written, -EAGAIN if the UART cannot
+	 *	take any yet, other -ve on error
+	 */
+	int (*puts)(struct udevice *dev, const char *s, size_t len);
 	/**
 	 * pending() - Check if input/output characters are waiting
 	 *
@@ -169,6 +185,10 @@ struct dm_serial_ops {
  * @buf:	Pointer to the RX buffer
  * @rd_ptr:	Read pointer in the RX buffer
  * @wr_ptr:	Write pointer in the RX buffer
+ *
+ * @tx_buf:	Pointer to the TX buffer, NULL if output is not buffered
+ * @tx_rd:	Offset of the next character to send (free-running)
+ * @tx_wr:	Offset where the next character is added (free-running)
  */
 struct serial_dev_priv {
 	struct stdio_dev *sdev;
@@ -176,11 +196,30 @@ struct serial_dev_priv {
 	char *buf;
 	int rd_ptr;
 	int wr_ptr;
+
+	char *tx_buf;
+	uint tx_rd;
+	uint tx_wr;
 };
 
 /* Access the serial operations for a device */
 #define serial_get_ops(dev)	((struct dm_serial_ops *)(dev)->driver->ops)
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+/**
+ * serial_flush() - Wait until all buffered output has been sent
+ *
+ * With CONFIG_SERIAL_TX_BUFFER, output to the serial console is queued and
+ * fed to the UART when it has room. This waits until the queue and the
+ * UART itself are empty, e.g. before a reset or booting an OS.
+ */
+void serial_flush(void);
+#else
+static inline void serial_flush(void)
+{
+}
+#endif
+
 void atmel_serial_initialize(void);
 void mcf_serial_initialize(void);
 void mpc85xx_serial_initialize(void);
@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Tests for library functions
+ */
+
+#ifndef __TEST_LIB_H__
+#define __TEST_LIB_H__
+
+#include <test/test.h>
+
+/* Declare a new library function test */
+#define LIB_TEST(_name, _flags)	UNIT_TEST(_name, _flags, lib_test)
+
+/* Largest and smallest buffer used to time library functions */
+#define LIB_BENCH_SIZE		(16 << 20)
+#define LIB_BENCH_MIN_SIZE	(64 << 10)
+
+/**
+ * lib_bench_alloc() - Allocate a buffer for timing a library function
+ *
+ * This tries LIB_BENCH_SIZE first, then halves the size until the
+ * allocation succeeds, so that boards with a small malloc() pool can still
+ * run the benchmarks.
+ *
+ * @sizep:	Returns the size of the buffer
+ * @fill:	Byte to fill the buffer with
+ * @return pointer to the buffer, which the caller must free(), or NULL if
+ *	not even LIB_BENCH_MIN_SIZE bytes are available (a message is shown)
+ */
+void *lib_bench_alloc(ulong *sizep, int fill);
+
+/**
+ * lib_bench_show() - Show how long some processing took
+ *
+ * @name:	Name of the implementation which was timed
+ * @start:	Value of timer_get_us() when processing started
+ * @bytes:	Number of bytes processed
+ * @extra:	Text to show at the end of the line, e.g. the result
+ */
+void lib_bench_show(const char *name, ulong start, ulong bytes,
+		    const char *extra);
+
+#endif /* __TEST_LIB_H__ */
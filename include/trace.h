@@ -23,11 +23,25 @@ enum {
 	 * this value.
 	 */
 	FUNC_SITE_SIZE	= 4,	/* distance between function sites */
+
+	TRACE_DEPTH_BUCKETS	= 16,	/* size of call-depth histograms */
+	TRACE_SAMPLE_DEPTH	= 32,	/* max stack depth kept in a sample */
 };
 
 enum trace_chunk_type {
 	TRACE_CHUNK_FUNCS,
 	TRACE_CHUNK_CALLS,
+	TRACE_CHUNK_STATS,
+	TRACE_CHUNK_SAMPLES,
+};
+
+/* What tracing records, see trace_set_mode() */
+enum trace_mode {
+	TRACE_MODE_CALLS,	/* each function entry/exit, with a timestamp */
+	TRACE_MODE_AGG,		/* time and call depth for each function */
+	TRACE_MODE_SAMPLE,	/* the call stack at regular intervals */
+
+	TRACE_MODE_COUNT,
 };
 
 /* A trace record for a function, as written to the profile output file */
@@ -36,6 +50,32 @@ struct trace_output_func {
 	uint32_t call_count;		/* Number of times called */
 };
 
+/*
+ * Aggregate statistics for a function, as written to the profile output
+ * file. Inclusive time includes the time spent in functions it calls,
+ * exclusive time does not.
+ */
+struct trace_func_stats {
+	uint32_t func;			/* Function offset into code */
+	uint32_t calls;			/* Number of times called */
+	uint64_t incl_us;		/* Inclusive time in microseconds */
+	uint64_t excl_us;		/* Exclusive time in microseconds */
+	/* Number of calls at each call depth, the last is for all deeper */
+	uint32_t depth_hist[TRACE_DEPTH_BUCKETS];
+};
+
+/*
+ * A call stack seen when sampling, as written to the profile output file.
+ * If @depth is more than TRACE_SAMPLE_DEPTH then only the innermost
+ * functions are kept.
+ */
+struct trace_sample {
+	uint32_t count;			/* Number of samples with this stack */
+	uint32_t depth;			/* Call depth */
+	/* Function offsets, outermost first */
+	uint32_t stack[TRACE_SAMPLE_DEPTH];
+};
+
 /* A header at the start of the trace output buffer */
 struct trace_output_hdr {
 	enum trace_chunk_type type;	/* Record type */
@@ -79,6 +119,49 @@ struct trace_call {
 
 int trace_list_calls(void *buff, int buff_size, unsigned int *needed);
 
+/**
+ * Dump the aggregate function statistics into a buffer
+ *
+ * This writes a TRACE_CHUNK_STATS chunk, with a struct trace_func_stats
+ * for each function called while tracing in TRACE_MODE_AGG.
+ *
+ * @param buff		Buffer in which to place data, or NULL to count size
+ * @param buff_size	Size of buffer
+ * @param needed	Returns number of bytes used / needed
+ * @return 0 if ok, -1 on error (buffer exhausted)
+ */
+int trace_list_stats(void *buff, int buff_size, unsigned int *needed);
+
+/**
+ * Dump the call stacks seen when sampling into a buffer
+ *
+ * This writes a TRACE_CHUNK_SAMPLES chunk, with a struct trace_sample for
+ * each run of identical samples taken in TRACE_MODE_SAMPLE.
+ *
+ * @param buff		Buffer in which to place data, or NULL to count size
+ * @param buff_size	Size of buffer
+ * @param needed	Returns number of bytes used / needed
+ * @return 0 if ok, -1 on error (buffer exhausted)
+ */
+int trace_list_samples(void *buff, int buff_size, unsigned int *needed);
+
+/**
+ * Select what tracing records
+ *
+ * TRACE_MODE_CALLS records every function entry and exit, which quickly
+ * fills the buffer. TRACE_MODE_AGG instead keeps a fixed table with the
+ * time spent in each function and the call depths it was called at.
+ * TRACE_MODE_SAMPLE records the call stack every @sample_us microseconds,
+ * reading the timer only every few function calls.
+ *
+ * The buffer space used by the previous mode is cleared.
+ *
+ * @param mode		Mode to use
+ * @param sample_us	Sample period for TRACE_MODE_SAMPLE
+ * @return 0 if ok, -1 if trace is not initialised or @mode is invalid
+ */
+int trace_set_mode(enum trace_mode mode, unsigned int sample_us);
+
 /**
  * Turn function tracing on and off
  *
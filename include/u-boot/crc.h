@@ -16,6 +16,45 @@ uint32_t crc32 (uint32_t, const unsigned char *, uint);
 uint32_t crc32_wd (uint32_t, const unsigned char *, uint, uint);
 uint32_t crc32_no_comp (uint32_t, const unsigned char *, uint);
 
+/**
+ * enum crc32_impl - implementations of crc32()
+ *
+ * @CRC32_IMPL_BYTE:	One table lookup per byte
+ * @CRC32_IMPL_SLICE8:	Eight table lookups per eight bytes (slice-by-8)
+ * @CRC32_IMPL_ARMV8:	ARMv8 CRC32 instructions
+ */
+enum crc32_impl {
+	CRC32_IMPL_BYTE,
+	CRC32_IMPL_SLICE8,
+	CRC32_IMPL_ARMV8,
+
+	CRC32_IMPL_COUNT,
+};
+
+/**
+ * crc32_impl_name() - get the name of a crc32() implementation
+ *
+ * @impl:	Implementation to check
+ * @return name of @impl, or NULL if it is not available in this build or
+ *	on this CPU
+ */
+const char *crc32_impl_name(enum crc32_impl impl);
+
+/**
+ * crc32_with_impl() - calculate crc32() with a particular implementation
+ *
+ * crc32() picks the fastest implementation available. This is provided so
+ * that they can be tested and compared against each other.
+ *
+ * @impl:	Implementation to use, which must be available
+ * @crc:	Starting CRC value
+ * @p:		Data to checksum
+ * @len:	Number of bytes at @p
+ * @return updated CRC value
+ */
+uint32_t crc32_with_impl(enum crc32_impl impl, uint32_t crc,
+			 const unsigned char *p, uint len);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
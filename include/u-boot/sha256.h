@@ -14,6 +14,8 @@ typedef struct {
 	uint32_t total[2];
 	uint32_t state[8];
 	uint8_t buffer[64];
+	/* Hashes whole 64-byte blocks into state, chosen by sha256_starts() */
+	void (*blocks)(void *state, const uint8_t *data, unsigned int blocks);
 } sha256_context;
 
 void sha256_starts(sha256_context * ctx);
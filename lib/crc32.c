@@ -167,6 +167,17 @@ const uint32_t * ZEXPORT get_crc_table()
 }
 #endif
 
+#ifdef USE_HOSTCC
+#define CRC32_SLICE_BY_8
+#else
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#define CRC32_SLICE_BY_8
+#endif
+#if defined(CONFIG_ARM64) && CONFIG_IS_ENABLED(ARMV8_CRC32)
+#define CRC32_ARMV8
+#endif
+#endif
+
 /* ========================================================================= */
 # if __BYTE_ORDER == __LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[(crc ^ (x)) & 255] ^ (crc >> 8)
@@ -176,10 +187,10 @@ const uint32_t * ZEXPORT get_crc_table()
 
 /* ========================================================================= */
 
-/* No ones complement version. JFFS2 (and other things ?)
- * don't use ones compliment in their CRC calculations.
- */
-uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+#if !defined(USE_HOSTCC) || !defined(CRC32_SLICE_BY_8)
+/* Byte-at-a-time version, using a single table */
+static uint32_t __efi_runtime crc32_byte(uint32_t crc, const Bytef *buf,
+					 uInt len)
 {
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
@@ -219,8 +230,172 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 
     return le32_to_cpu(crc);
 }
+#endif
 #undef DO_CRC
 
+#ifdef CRC32_SLICE_BY_8
+/*
+ * crc_slice[k][n] is the CRC of byte n followed by k zero bytes, in CPU
+ * byte order. With these, eight bytes of input are folded into the CRC with
+ * eight independent lookups rather than a chain of eight dependent ones.
+ */
+static int __efi_runtime_data crc_slice_empty = 1;
+static uint32_t __efi_runtime_data crc_slice[8][256];
+
+static void __efi_runtime make_crc_slice(void)
+{
+	uint32_t c;
+	int n, k;
+
+#ifdef CONFIG_DYNAMIC_CRC_TABLE
+	if (crc_table_empty)
+		make_crc_table();
+#endif
+	for (n = 0; n < 256; n++)
+		crc_slice[0][n] = le32_to_cpu(crc_table[n]);
+	for (n = 0; n < 256; n++) {
+		c = crc_slice[0][n];
+		for (k = 1; k < 8; k++) {
+			c = crc_slice[0][c & 0xff] ^ (c >> 8);
+			crc_slice[k][n] = c;
+		}
+	}
+	crc_slice_empty = 0;
+}
+
+static uint32_t __efi_runtime crc32_slice8(uint32_t crc, const Bytef *buf,
+					   uInt len)
+{
+	const uint32_t (*t)[256] = crc_slice;
+	uint32_t lo, hi;
+
+	if (crc_slice_empty)
+		make_crc_slice();
+
+	while (len && ((uintptr_t)buf & 7)) {
+		crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	for (; len >= 8; len -= 8, buf += 8) {
+		lo = crc ^ le32_to_cpu(*(const uint32_t *)buf);
+		hi = le32_to_cpu(*(const uint32_t *)(buf + 4));
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+		      t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+		      t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+		      t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+
+	while (len--)
+		crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+#endif
+
+#ifdef CRC32_ARMV8
+/* -1 until the CPU has been checked, then whether it has CRC32 insns */
+static int __efi_runtime_data crc_armv8 = -1;
+
+static bool __efi_runtime crc32_armv8_present(void)
+{
+	u64 isar0;
+
+	if (crc_armv8 < 0) {
+		asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+		crc_armv8 = ((isar0 >> 16) & 0xf) != 0;
+	}
+
+	return crc_armv8;
+}
+
+/* The CRC32 instructions use the same reflected polynomial as crc32() */
+#define CRC32B(crc, val) \
+	asm(".arch_extension crc\n\tcrc32b %w0, %w0, %w1" : "+r" (crc) : \
+	    "r" (val))
+#define CRC32X(crc, val) \
+	asm(".arch_extension crc\n\tcrc32x %w0, %w0, %x1" : "+r" (crc) : \
+	    "r" (val))
+
+static uint32_t __efi_runtime crc32_armv8(uint32_t crc, const Bytef *buf,
+					  uInt len)
+{
+	const u64 *p;
+
+	while (len && ((uintptr_t)buf & 7)) {
+		CRC32B(crc, *buf++);
+		len--;
+	}
+
+	for (p = (const u64 *)buf; len >= 8; len -= 8)
+		CRC32X(crc, le64_to_cpu(*p++));
+
+	for (buf = (const Bytef *)p; len; len--)
+		CRC32B(crc, *buf++);
+
+	return crc;
+}
+#endif
+
+/* No ones complement version. JFFS2 (and other things ?)
+ * don't use ones compliment in their CRC calculations.
+ */
+uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+{
+#ifdef CRC32_ARMV8
+	if (crc32_armv8_present())
+		return crc32_armv8(crc, buf, len);
+#endif
+#ifdef CRC32_SLICE_BY_8
+	return crc32_slice8(crc, buf, len);
+#else
+	return crc32_byte(crc, buf, len);
+#endif
+}
+
+#ifndef USE_HOSTCC
+const char *crc32_impl_name(enum crc32_impl impl)
+{
+	switch (impl) {
+	case CRC32_IMPL_BYTE:
+		return "byte";
+#ifdef CRC32_SLICE_BY_8
+	case CRC32_IMPL_SLICE8:
+		return "slice-by-8";
+#endif
+#ifdef CRC32_ARMV8
+	case CRC32_IMPL_ARMV8:
+		return crc32_armv8_present() ? "armv8" : NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+uint32_t crc32_with_impl(enum crc32_impl impl, uint32_t crc, const Bytef *p,
+			 uInt len)
+{
+	crc ^= 0xffffffffL;
+	switch (impl) {
+#ifdef CRC32_SLICE_BY_8
+	case CRC32_IMPL_SLICE8:
+		crc = crc32_slice8(crc, p, len);
+		break;
+#endif
+#ifdef CRC32_ARMV8
+	case CRC32_IMPL_ARMV8:
+		crc = crc32_armv8(crc, p, len);
+		break;
+#endif
+	default:
+		crc = crc32_byte(crc, p, len);
+		break;
+	}
+
+	return crc ^ 0xffffffffL;
+}
+#endif
+
 uint32_t __efi_runtime crc32(uint32_t crc, const Bytef *p, uInt len)
 {
      return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
@@ -79,6 +79,73 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 	return zunzip(dst, dstlen, src, lenp, 1, offset);
 }
 
+struct gunzip_stream {
+	z_stream s;
+	bool done;
+};
+
+struct gunzip_stream *gunzip_stream_start(void *dst, ulong dstlen)
+{
+	struct gunzip_stream *gz;
+	int r;
+
+	gz = calloc(1, sizeof(*gz));
+	if (!gz)
+		return NULL;
+	gz->s.zalloc = gzalloc;
+	gz->s.zfree = gzfree;
+
+	/* Let zlib deal with the gzip header and check the trailer */
+	r = inflateInit2(&gz->s, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(gz);
+		return NULL;
+	}
+	gz->s.next_out = dst;
+	gz->s.avail_out = dstlen;
+
+	return gz;
+}
+
+int gunzip_stream_feed(struct gunzip_stream *gz, const void *src, ulong len)
+{
+	int r;
+
+	if (gz->done)
+		return 1;
+
+	gz->s.next_in = (unsigned char *)src;
+	gz->s.avail_in = len;
+	while (gz->s.avail_in) {
+		r = inflate(&gz->s, Z_SYNC_FLUSH);
+		if (r == Z_STREAM_END) {
+			gz->done = true;
+			return 1;
+		}
+		if (r == Z_BUF_ERROR && !gz->s.avail_out)
+			return -ENOBUFS;
+		if (r != Z_OK) {
+			printf("Error: inflate() returned %d\n", r);
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+int gunzip_stream_finish(struct gunzip_stream *gz, ulong *lenp)
+{
+	int ret = gz->done ? 0 : -EIO;
+
+	if (lenp)
+		*lenp = gz->s.total_out;
+	inflateEnd(&gz->s);
+	free(gz);
+
+	return ret;
+}
+
 #ifdef CONFIG_CMD_UNZIP
 __weak
 void gzwrite_progress_init(u64 expectedsize)
@@ -9,6 +9,7 @@
 
 #include <common.h>
 #include <bootstage.h>
+#include <console.h>
 
 /**
  * hang - stop processing by staying in an endless loop
@@ -24,6 +25,7 @@ void hang(void)
 		defined(CONFIG_SPL_SERIAL_SUPPORT))
 	puts("### ERROR ### Please RESET the board ###\n");
 #endif
+	console_flush();
 	bootstage_error(BOOTSTAGE_ID_NEED_RESET);
 	for (;;)
 		;
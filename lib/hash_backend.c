@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Selection of hash algorithm backends
+ */
+
+#include <common.h>
+#include <hash.h>
+
+bool hash_backend_available(const struct hash_backend *backend)
+{
+	return !backend->probe || backend->probe();
+}
+
+const struct hash_backend *hash_backend_get(const char *algo_name)
+{
+	const struct hash_backend *start, *backend, *best = NULL;
+	const int n_ents = ll_entry_count(struct hash_backend, hash_backend);
+
+	start = ll_entry_start(struct hash_backend, hash_backend);
+	for (backend = start; backend != start + n_ents; backend++) {
+		if (strcmp(backend->algo, algo_name))
+			continue;
+		if (best && backend->priority <= best->priority)
+			continue;
+		if (hash_backend_available(backend))
+			best = backend;
+	}
+
+	return best;
+}
@@ -65,6 +65,13 @@ typedef struct _ENTRY {
 static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	int idx);
 
+/*
+ * The table is rehashed once this fraction of it is in use, counting the
+ * slots of deleted entries, which still lengthen the probe sequences.
+ */
+#define HTAB_LOAD_NUM	3
+#define HTAB_LOAD_DEN	4
+
 /*
  * hcreate()
  */
@@ -87,6 +94,170 @@ static int isprime(unsigned int number)
 	return number % div != 0;
 }
 
+/* Return the first prime number not smaller than nel */
+static unsigned int next_prime(unsigned int nel)
+{
+	nel |= 1;		/* make odd */
+	while (!isprime(nel))
+		nel += 2;
+
+	return nel;
+}
+
+/*
+ * Compute the first hash of a key. Index zero is never used, see the
+ * comment for the hsearch function.
+ */
+static unsigned int hash_key(const char *key, unsigned int size)
+{
+	unsigned int len = strlen(key);
+	unsigned int hval = len;
+	unsigned int count = len;
+
+	/* Compute an value for the given string. Perhaps use a better method. */
+	while (count-- > 0) {
+		hval <<= 4;
+		hval += key[count];
+	}
+
+	/*
+	 * First hash function:
+	 * simply take the modul but prevent zero.
+	 */
+	hval %= size;
+	if (hval == 0)
+		++hval;
+
+	return hval;
+}
+
+/*
+ * Second hash function, as suggested in [Knuth]: step backwards through the
+ * table by an amount which depends on the first hash. Because the size is
+ * prime this guarantees to step through all available indices.
+ */
+static unsigned int probe_next(unsigned int idx, unsigned int hval,
+			       unsigned int size)
+{
+	unsigned int hval2 = 1 + hval % (size - 2);
+
+	if (idx <= hval2)
+		return size + idx - hval2;
+
+	return idx - hval2;
+}
+
+/*
+ * Besides the hash table itself we keep the table indices of all entries
+ * sorted by key, so the table can be walked in order without sorting it.
+ * sorted_pos() returns the position of a key in that list, or the position
+ * where it would have to be inserted.
+ */
+static unsigned int sorted_pos(struct hsearch_data *htab, const char *key)
+{
+	unsigned int lo = 0, hi = htab->filled, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(htab->table[htab->sorted[mid]].entry.key, key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void sorted_insert(struct hsearch_data *htab, unsigned int idx)
+{
+	unsigned int pos = sorted_pos(htab, htab->table[idx].entry.key);
+
+	memmove(&htab->sorted[pos + 1], &htab->sorted[pos],
+		(htab->filled - pos) * sizeof(htab->sorted[0]));
+	htab->sorted[pos] = idx;
+}
+
+static void sorted_remove(struct hsearch_data *htab, unsigned int idx)
+{
+	unsigned int pos = sorted_pos(htab, htab->table[idx].entry.key);
+
+	if (pos >= htab->filled || htab->sorted[pos] != idx)
+		return;
+	memmove(&htab->sorted[pos], &htab->sorted[pos + 1],
+		(htab->filled - pos - 1) * sizeof(htab->sorted[0]));
+}
+
+/*
+ * Move all entries to a new table of (at least) nel elements. This also
+ * drops the slots of deleted entries. The entries are moved in key order,
+ * which gives the new sorted index for free.
+ */
+static int hresize_r(struct hsearch_data *htab, unsigned int nel)
+{
+	_ENTRY *table;
+	unsigned int *sorted;
+	unsigned int size, hval, idx, i;
+
+	size = next_prime(nel);
+	table = calloc(size + 1, sizeof(_ENTRY));
+	sorted = calloc(size, sizeof(*sorted));
+	if (!table || !sorted) {
+		free(table);
+		free(sorted);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < htab->filled; i++) {
+		_ENTRY *old = &htab->table[htab->sorted[i]];
+
+		hval = hash_key(old->entry.key, size);
+		for (idx = hval; table[idx].used;)
+			idx = probe_next(idx, hval, size);
+		table[idx].used = hval;
+		table[idx].entry = old->entry;
+		sorted[i] = idx;
+	}
+
+	debug("hresize: %u -> %u entries, %u used\n", htab->size, size,
+	      htab->filled);
+	free(htab->table);
+	free(htab->sorted);
+	htab->table = table;
+	htab->sorted = sorted;
+	htab->size = size;
+	htab->deleted = 0;
+
+	return 0;
+}
+
+/*
+ * Check with change_ok() and the entry's callback whether a change may be
+ * made. Both may modify the table themselves, so it must not be reallocated
+ * while they run: the caller still holds an index into it.
+ *
+ * Returns 0 if the change is allowed, else the errno value to report.
+ */
+static int hcheck_change(struct hsearch_data *htab, ENTRY *ep,
+			 const char *newval, enum env_op op, int flag)
+{
+	int ret = 0;
+
+	htab->busy++;
+	if (htab->change_ok != NULL &&
+	    htab->change_ok(ep, newval, op, flag)) {
+		debug("change_ok() rejected changing variable "
+			"%s, skipping it!\n", ep->key);
+		ret = EPERM;
+	} else if (ep->callback && ep->callback(ep->key, newval, op, flag)) {
+		debug("callback() rejected changing variable "
+			"%s, skipping it!\n", ep->key);
+		ret = EINVAL;
+	}
+	htab->busy--;
+
+	return ret;
+}
+
 /*
  * Before using the hash table we must allocate memory for it.
  * Test for an existing table are done. We allocate one element
@@ -109,17 +280,21 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 		return 0;
 
 	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
-
-	htab->size = nel;
+	htab->size = next_prime(nel);
 	htab->filled = 0;
+	htab->deleted = 0;
+	htab->busy = 0;
 
 	/* allocate memory and zero out */
 	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
 	if (htab->table == NULL)
 		return 0;
+	htab->sorted = calloc(htab->size, sizeof(*htab->sorted));
+	if (htab->sorted == NULL) {
+		free(htab->table);
+		htab->table = NULL;
+		return 0;
+	}
 
 	/* everything went alright */
 	return 1;
@@ -155,9 +330,11 @@ void hdestroy_r(struct hsearch_data *htab)
 		}
 	}
 	free(htab->table);
+	free(htab->sorted);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->sorted = NULL;
 }
 
 /*
@@ -195,6 +372,9 @@ void hdestroy_r(struct hsearch_data *htab)
  *   internal hash table, which is also guaranteed to be positive.
  *   This allows us direct access to the found hash table slot for
  *   example for functions like hdelete().
+ * - The table is not fixed in size: when adding an entry would fill it
+ *   beyond HTAB_LOAD_NUM / HTAB_LOAD_DEN it is rehashed into one twice
+ *   as large. An index is therefore only valid until the next ENTER.
  */
 
 int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
@@ -229,24 +409,13 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
 		/* Overwrite existing value? */
 		if ((action == ENTER) && (item.data != NULL)) {
-			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
-				debug("change_ok() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EPERM);
-				*retval = NULL;
-				return 0;
-			}
+			int err;
 
-			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
-			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
+			/* check for permission, and call any callback */
+			err = hcheck_change(htab, &htab->table[idx].entry,
+					    item.data, env_op_overwrite, flag);
+			if (err) {
+				__set_errno(err);
 				*retval = NULL;
 				return 0;
 			}
@@ -271,27 +440,28 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	      struct hsearch_data *htab, int flag)
 {
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
-
 	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
+	 * Make room before looking for a slot, as long as no caller further
+	 * up is holding on to an index. Only grow the table if the live
+	 * entries need it; otherwise just get rid of deleted slots.
 	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+	if (action == ENTER && !htab->busy &&
+	    (htab->filled + htab->deleted + 1) * HTAB_LOAD_DEN >
+	    htab->size * HTAB_LOAD_NUM) {
+		unsigned int nel = htab->size;
+
+		if ((htab->filled + 1) * HTAB_LOAD_DEN * 2 >
+		    htab->size * HTAB_LOAD_NUM)
+			nel *= 2;
+		if (hresize_r(htab, nel))
+			debug("hsearch: cannot resize table to %u\n", nel);
+	}
+
+	hval = hash_key(item.key, htab->size);
 
 	/* The first index tried. */
 	idx = hval;
@@ -301,8 +471,6 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		 * Further action might be required according to the
 		 * action value.
 		 */
-		unsigned hval2;
-
 		if (htab->table[idx].used == -1
 		    && !first_deleted)
 			first_deleted = idx;
@@ -312,21 +480,8 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		if (ret != -1)
 			return ret;
 
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
 		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
+			idx = probe_next(idx, hval, htab->size);
 
 			/*
 			 * If we visited all entries leave the loop
@@ -363,16 +518,21 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		if (first_deleted)
 			idx = first_deleted;
 
-		htab->table[idx].used = hval;
 		htab->table[idx].entry.key = strdup(item.key);
 		htab->table[idx].entry.data = strdup(item.data);
 		if (!htab->table[idx].entry.key ||
 		    !htab->table[idx].entry.data) {
+			free((void *)htab->table[idx].entry.key);
+			free(htab->table[idx].entry.data);
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
+		htab->table[idx].used = hval;
+		if (first_deleted)
+			--htab->deleted;
 
+		sorted_insert(htab, idx);
 		++htab->filled;
 
 		/* This is a new entry, so look up a possible callback */
@@ -380,25 +540,12 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		/* Also look for flags */
 		env_flags_init(&htab->table[idx].entry);
 
-		/* check for permission */
-		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
-			debug("change_ok() rejected setting variable "
-				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
-			__set_errno(EPERM);
-			*retval = NULL;
-			return 0;
-		}
-
-		/* If there is a callback, call it */
-		if (htab->table[idx].entry.callback &&
-		    htab->table[idx].entry.callback(item.key, item.data,
-		    env_op_create, flag)) {
-			debug("callback() rejected setting variable "
-				"%s, skipping it!\n", item.key);
+		/* check for permission, and call any callback */
+		ret = hcheck_change(htab, &htab->table[idx].entry, item.data,
+				    env_op_create, flag);
+		if (ret) {
 			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
-			__set_errno(EINVAL);
+			__set_errno(ret);
 			*retval = NULL;
 			return 0;
 		}
@@ -429,6 +576,7 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 {
 	/* free used ENTRY */
 	debug("hdelete: DELETING key \"%s\"\n", key);
+	sorted_remove(htab, idx);
 	free((void *)ep->key);
 	free(ep->data);
 	ep->callback = NULL;
@@ -436,12 +584,13 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	htab->table[idx].used = -1;
 
 	--htab->filled;
+	++htab->deleted;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 {
 	ENTRY e, *ep;
-	int idx;
+	int idx, err;
 
 	debug("hdelete: DELETE key \"%s\"\n", key);
 
@@ -453,21 +602,10 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 		return 0;	/* not found */
 	}
 
-	/* Check for permission */
-	if (htab->change_ok != NULL &&
-	    htab->change_ok(ep, NULL, env_op_delete, flag)) {
-		debug("change_ok() rejected deleting variable "
-			"%s, skipping it!\n", key);
-		__set_errno(EPERM);
-		return 0;
-	}
-
-	/* If there is a callback, call it */
-	if (htab->table[idx].entry.callback &&
-	    htab->table[idx].entry.callback(key, NULL, env_op_delete, flag)) {
-		debug("callback() rejected deleting variable "
-			"%s, skipping it!\n", key);
-		__set_errno(EINVAL);
+	/* Check for permission, and call any callback */
+	err = hcheck_change(htab, ep, NULL, env_op_delete, flag);
+	if (err) {
+		__set_errno(err);
 		return 0;
 	}
 
@@ -494,7 +632,8 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  * for later re-import.
  *
  * The entries in the result list will be sorted by ascending key
- * values.
+ * values. They are taken from the sorted index in that order, so no
+ * sorting is needed here.
  *
  * If the separator character is different from NUL, then any
  * separator characters and backslash characters in the values will
@@ -519,14 +658,6 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  *		bytes in the string will be '\0'-padded.
  */
 
-static int cmpkey(const void *p1, const void *p2)
-{
-	ENTRY *e1 = *(ENTRY **) p1;
-	ENTRY *e2 = *(ENTRY **) p2;
-
-	return (strcmp(e1->key, e2->key));
-}
-
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -586,11 +717,22 @@ static int match_entry(ENTRY *ep, int flag,
 	return 0;
 }
 
+/* Check whether an entry is to be exported */
+static int export_entry(ENTRY *ep, int flag, int argc, char * const argv[])
+{
+	if ((argc > 0) && !match_entry(ep, flag, argc, argv))
+		return 0;
+
+	if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+		return 0;
+
+	return 1;
+}
+
 ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	ENTRY *list[htab->size];
 	char *res, *p;
 	size_t totlen;
 	int i, n;
@@ -605,54 +747,33 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	      htab, htab->size, htab->filled, (ulong)size);
 	/*
 	 * Pass 1:
-	 * search used entries,
-	 * save addresses and compute total length
+	 * search used entries and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
-
-			if ((argc > 0) && (found == 0))
-				continue;
+	for (i = 0, n = 0, totlen = 0; i < htab->filled; ++i) {
+		ENTRY *ep = &htab->table[htab->sorted[i]].entry;
 
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
-
-			list[n++] = ep;
+		if (!export_entry(ep, flag, argc, argv))
+			continue;
 
-			totlen += strlen(ep->key);
+		++n;
+		totlen += strlen(ep->key);
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
-#ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
-	for (i = 0; i < n; ++i) {
-		printf("\t%3d: %p ==> %-10s => %s\n",
-		       i, list[i], list[i]->key, list[i]->data);
-	}
-#endif
-
-	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
@@ -662,7 +783,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 			return (-1);
 		}
 	} else {
-		size = totlen;
+		size = totlen + 1;
 	}
 
 	/* Check if the user provided a buffer */
@@ -682,15 +803,19 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	 * Pass 2:
 	 * export sorted list of result data
 	 */
-	for (i = 0, p = res; i < n; ++i) {
+	for (i = 0, p = res; n && i < htab->filled; ++i) {
+		ENTRY *ep = &htab->table[htab->sorted[i]].entry;
 		const char *s;
 
-		s = list[i]->key;
+		if (!export_entry(ep, flag, argc, argv))
+			continue;
+
+		s = ep->key;
 		while (*s)
 			*p++ = *s++;
 		*p++ = '=';
 
-		s = list[i]->data;
+		s = ep->data;
 
 		while (*s) {
 			if ((*s == sep) || (*s == '\\'))
@@ -15,6 +15,7 @@ int initcall_run_list(const init_fnc_t init_sequence[])
 
 	for (init_fnc_ptr = init_sequence; *init_fnc_ptr; ++init_fnc_ptr) {
 		unsigned long reloc_ofs = 0;
+		int span = -1;
 		int ret;
 
 		if (gd->flags & GD_FLG_RELOC)
@@ -27,7 +28,12 @@ int initcall_run_list(const init_fnc_t init_sequence[])
 			debug(" (relocated to %p)\n", (char *)*init_fnc_ptr);
 		else
 			debug("\n");
+		if (CONFIG_IS_ENABLED(BOOTSTAGE_INITCALL))
+			span = bootstage_span_begin_func((ulong)*init_fnc_ptr -
+							 reloc_ofs);
 		ret = (*init_fnc_ptr)();
+		if (CONFIG_IS_ENABLED(BOOTSTAGE_INITCALL))
+			bootstage_span_end(span);
 		if (ret) {
 			printf("initcall sequence %p failed at call %p (err=%d)\n",
 			       init_sequence,
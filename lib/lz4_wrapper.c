@@ -5,8 +5,11 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <malloc.h>
 #include <linux/kernel.h>
+#include <linux/sizes.h>
 #include <linux/types.h>
+#include <asm/unaligned.h>
 
 static u16 LZ4_readLE16(const void *src) { return le16_to_cpu(*(u16 *)src); }
 static void LZ4_copy4(void *dst, const void *src) { *(u32 *)dst = *(u32 *)src; }
@@ -136,3 +139,185 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	*dstn = out - dst;
 	return ret;
 }
+
+enum ulz4_state {
+	ULZ4_FRAME_HEADER,
+	ULZ4_FRAME_SKIP,
+	ULZ4_BLOCK_HEADER,
+	ULZ4_BLOCK,
+	ULZ4_DONE,
+};
+
+struct ulz4_stream {
+	void *dst;
+	void *out;
+	const void *end;
+	enum ulz4_state state;
+	int has_block_checksum;
+	struct lz4_block_header b;
+	size_t max_block;
+	size_t need;		/* bytes needed to finish the current state */
+	size_t have;		/* bytes of that collected in 'buf' so far */
+	u8 *buf;		/* holds one block, plus its checksum */
+	u8 hdr[sizeof(struct lz4_frame_header) + sizeof(u64) + sizeof(u8)];
+};
+
+struct ulz4_stream *ulz4fn_stream_start(void *dst, size_t dstn)
+{
+	struct ulz4_stream *lz;
+
+	lz = calloc(1, sizeof(*lz));
+	if (!lz)
+		return NULL;
+	lz->dst = dst;
+	lz->out = dst;
+	lz->end = dst + dstn;
+	lz->state = ULZ4_FRAME_HEADER;
+	lz->need = sizeof(struct lz4_frame_header);
+
+	return lz;
+}
+
+/*
+ * Collect the next 'need' bytes of input. If they are all present in the
+ * input they are used in place, otherwise they are copied to 'buf' until
+ * enough have arrived. Returns NULL if more input is needed.
+ */
+static const u8 *ulz4_gather(struct ulz4_stream *lz, u8 *buf,
+			     const u8 **in, size_t *inn)
+{
+	const u8 *p;
+	size_t n;
+
+	if (!lz->have && *inn >= lz->need) {
+		p = *in;
+		*in += lz->need;
+		*inn -= lz->need;
+		return p;
+	}
+
+	n = min(*inn, lz->need - lz->have);
+	memcpy(buf + lz->have, *in, n);
+	lz->have += n;
+	*in += n;
+	*inn -= n;
+	if (lz->have < lz->need)
+		return NULL;
+	lz->have = 0;
+
+	return buf;
+}
+
+static int ulz4_frame_header(struct ulz4_stream *lz, const u8 *p)
+{
+	const struct lz4_frame_header *h = (const void *)p;
+
+	if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if (h->reserved0 || h->reserved1 || h->reserved2)
+		return -EINVAL;	/* reserved must be zero */
+	if (!h->independent_blocks)
+		return -EPROTONOSUPPORT; /* we can't support this yet */
+	lz->has_block_checksum = h->has_block_checksum;
+
+	/* Blocks are 64KiB << (2 * (max_block_size - 4)) at most */
+	if (h->max_block_size < 4)
+		return -EINVAL;
+	lz->max_block = SZ_64K << (2 * (h->max_block_size - 4));
+	lz->buf = malloc(lz->max_block + sizeof(u32));
+	if (!lz->buf)
+		return -ENOMEM;
+
+	lz->state = ULZ4_FRAME_SKIP;
+	lz->need = sizeof(u8);
+	if (h->has_content_size)
+		lz->need += sizeof(u64);
+
+	return 0;
+}
+
+static int ulz4_block(struct ulz4_stream *lz, const void *in)
+{
+	size_t size;
+	int ret;
+
+	if (lz->b.not_compressed) {
+		size = min((ptrdiff_t)lz->b.size, lz->end - lz->out);
+		memcpy(lz->out, in, size);
+		lz->out += size;
+		if (size < lz->b.size)
+			return -ENOBUFS;	/* output overrun */
+	} else {
+		/* constant folding essential, do not touch params! */
+		ret = LZ4_decompress_generic(in, lz->out, lz->b.size,
+				lz->end - lz->out, endOnInputSize,
+				full, 0, noDict, lz->out, NULL, 0);
+		if (ret < 0)
+			return -EPROTO;	/* decompression error */
+		lz->out += ret;
+	}
+
+	return 0;
+}
+
+int ulz4fn_stream_feed(struct ulz4_stream *lz, const void *src, size_t srcn)
+{
+	const u8 *in = src;
+	const u8 *p;
+	int ret;
+
+	while (lz->state != ULZ4_DONE) {
+		p = ulz4_gather(lz, lz->state == ULZ4_BLOCK ? lz->buf : lz->hdr,
+				&in, &srcn);
+		if (!p)
+			return 0;
+
+		switch (lz->state) {
+		case ULZ4_FRAME_HEADER:
+			ret = ulz4_frame_header(lz, p);
+			if (ret)
+				return ret;
+			break;
+		case ULZ4_FRAME_SKIP:
+			lz->state = ULZ4_BLOCK_HEADER;
+			lz->need = sizeof(struct lz4_block_header);
+			break;
+		case ULZ4_BLOCK_HEADER:
+			lz->b.raw = le32_to_cpu(get_unaligned((u32 *)p));
+			if (!lz->b.size) {
+				lz->state = ULZ4_DONE;
+				break;
+			}
+			if (lz->b.size > lz->max_block)
+				return -EINVAL;	/* input overrun */
+			lz->state = ULZ4_BLOCK;
+			lz->need = lz->b.size;
+			if (lz->has_block_checksum)
+				lz->need += sizeof(u32);
+			break;
+		case ULZ4_BLOCK:
+			ret = ulz4_block(lz, p);
+			if (ret)
+				return ret;
+			lz->state = ULZ4_BLOCK_HEADER;
+			lz->need = sizeof(struct lz4_block_header);
+			break;
+		case ULZ4_DONE:
+			break;
+		}
+	}
+
+	return 1;
+}
+
+int ulz4fn_stream_finish(struct ulz4_stream *lz, size_t *dstn)
+{
+	int ret = lz->state == ULZ4_DONE ? 0 : -EINVAL;
+
+	if (dstn)
+		*dstn = lz->out - lz->dst;
+	free(lz->buf);
+	free(lz);
+
+	return ret;
+}
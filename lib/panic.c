@@ -10,6 +10,7 @@
  */
 
 #include <common.h>
+#include <console.h>
 #if !defined(CONFIG_PANIC_HANG)
 #include <command.h>
 #endif
@@ -19,6 +20,7 @@ static void panic_finish(void) __attribute__ ((noreturn));
 static void panic_finish(void)
 {
 	putc('\n');
+	console_flush();
 #if defined(CONFIG_PANIC_HANG)
 	hang();
 #else
@@ -31,6 +33,7 @@ static void panic_finish(void)
 
 void panic_str(const char *str)
 {
+	log_ring_flush();
 	puts(str);
 	panic_finish();
 }
@@ -39,6 +42,8 @@ void panic(const char *fmt, ...)
 {
 #if CONFIG_IS_ENABLED(PRINTF)
 	va_list args;
+
+	log_ring_flush();
 	va_start(args, fmt);
 	vprintf(fmt, args);
 	va_end(args);
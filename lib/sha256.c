@@ -7,6 +7,7 @@
 
 #ifndef USE_HOSTCC
 #include <common.h>
+#include <hash.h>
 #include <linux/string.h>
 #else
 #include <string.h>
@@ -41,8 +42,15 @@ const uint8_t sha256_der_prefix[SHA256_DER_LEN] = {
 }
 #endif
 
+static void sha256_blocks_generic(void *state, const uint8_t *data,
+				  unsigned int blocks);
+
 void sha256_starts(sha256_context * ctx)
 {
+#ifndef USE_HOSTCC
+	const struct hash_backend *backend;
+#endif
+
 	ctx->total[0] = 0;
 	ctx->total[1] = 0;
 
@@ -54,9 +62,18 @@ void sha256_starts(sha256_context * ctx)
 	ctx->state[5] = 0x9B05688C;
 	ctx->state[6] = 0x1F83D9AB;
 	ctx->state[7] = 0x5BE0CD19;
+
+#ifndef USE_HOSTCC
+	backend = hash_backend_get("sha256");
+	if (backend) {
+		ctx->blocks = backend->blocks;
+		return;
+	}
+#endif
+	ctx->blocks = sha256_blocks_generic;
 }
 
-static void sha256_process(sha256_context *ctx, const uint8_t data[64])
+static void sha256_process(uint32_t state[8], const uint8_t data[64])
 {
 	uint32_t temp1, temp2;
 	uint32_t W[64];
@@ -103,14 +120,14 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	d += temp1; h = temp1 + temp2;		\
 }
 
-	A = ctx->state[0];
-	B = ctx->state[1];
-	C = ctx->state[2];
-	D = ctx->state[3];
-	E = ctx->state[4];
-	F = ctx->state[5];
-	G = ctx->state[6];
-	H = ctx->state[7];
+	A = state[0];
+	B = state[1];
+	C = state[2];
+	D = state[3];
+	E = state[4];
+	F = state[5];
+	G = state[6];
+	H = state[7];
 
 	P(A, B, C, D, E, F, G, H, W[0], 0x428A2F98);
 	P(H, A, B, C, D, E, F, G, W[1], 0x71374491);
@@ -177,16 +194,34 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	P(C, D, E, F, G, H, A, B, R(62), 0xBEF9A3F7);
 	P(B, C, D, E, F, G, H, A, R(63), 0xC67178F2);
 
-	ctx->state[0] += A;
-	ctx->state[1] += B;
-	ctx->state[2] += C;
-	ctx->state[3] += D;
-	ctx->state[4] += E;
-	ctx->state[5] += F;
-	ctx->state[6] += G;
-	ctx->state[7] += H;
+	state[0] += A;
+	state[1] += B;
+	state[2] += C;
+	state[3] += D;
+	state[4] += E;
+	state[5] += F;
+	state[6] += G;
+	state[7] += H;
 }
 
+static void sha256_blocks_generic(void *state, const uint8_t *data,
+				  unsigned int blocks)
+{
+	while (blocks--) {
+		sha256_process(state, data);
+		data += 64;
+	}
+}
+
+#ifndef USE_HOSTCC
+U_BOOT_HASH_BACKEND(sha256_generic) = {
+	.algo		= "sha256",
+	.name		= "generic",
+	.priority	= 0,
+	.blocks		= sha256_blocks_generic,
+};
+#endif
+
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 {
 	uint32_t left, fill;
@@ -205,16 +240,16 @@ void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 
 	if (left && length >= fill) {
 		memcpy((void *) (ctx->buffer + left), (void *) input, fill);
-		sha256_process(ctx, ctx->buffer);
+		ctx->blocks(ctx->state, ctx->buffer, 1);
 		length -= fill;
 		input += fill;
 		left = 0;
 	}
 
-	while (length >= 64) {
-		sha256_process(ctx, input);
-		length -= 64;
-		input += 64;
+	if (length >= 64) {
+		ctx->blocks(ctx->state, input, length / 64);
+		input += length & ~0x3f;
+		length &= 0x3f;
 	}
 
 	if (length)
@@ -14,6 +14,21 @@ DECLARE_GLOBAL_DATA_PTR;
 static char trace_enabled __attribute__((section(".data")));
 static char trace_inited __attribute__((section(".data")));
 
+enum {
+	TRACE_STACK_MAX		= 64,	/* depth of the shadow call stack */
+	TRACE_SAMPLE_CHECK	= 32,	/* calls between timer checks */
+	TRACE_SAMPLE_US		= 1000,	/* default sample period */
+	TRACE_NO_SLOT		= -1U,	/* function has no stats entry */
+};
+
+/* A function on the shadow call stack kept for aggregation and sampling */
+struct trace_frame {
+	u32 func;		/* Function number */
+	u32 slot;		/* Stats table index, or TRACE_NO_SLOT */
+	u32 start_us;		/* Time of entry */
+	u32 child_us;		/* Time spent in callees so far */
+};
+
 /* The header block at the start of the trace memory area */
 struct trace_hdr {
 	int func_count;		/* Total number of function call sites */
@@ -36,6 +51,29 @@ struct trace_hdr {
 	int depth;
 	int depth_limit;
 	int max_depth;
+
+	/*
+	 * With TRACE_MODE_AGG or TRACE_MODE_SAMPLE the space used for the
+	 * function trace list holds a stats table or samples instead
+	 */
+	enum trace_mode mode;
+	struct trace_func_stats *stats;	/* Stats table, indexed by hash */
+	ulong stats_size;	/* Num. of entries in table (power of 2) */
+	ulong stats_used;	/* Num. of entries used */
+	ulong stats_dropped;	/* Function calls not counted: table full */
+
+	struct trace_sample *samples;	/* Samples taken */
+	ulong sample_size;	/* Num. of samples we have space for */
+	ulong sample_count;	/* Num. of samples written */
+	ulong sample_dropped;	/* Samples lost: no space */
+	uint sample_us;		/* Sample period */
+	ulong next_sample_us;	/* Time of the next sample */
+	int sample_countdown;	/* Calls until the timer is checked */
+
+	/* Shadow call stack, from where tracing was started */
+	struct trace_frame stack[TRACE_STACK_MAX];
+	int sp;			/* Num. of functions on the stack */
+	int stack_overflow;	/* Num. of calls beyond TRACE_STACK_MAX */
 };
 
 static struct trace_hdr *hdr;	/* Pointer to start of trace buffer */
@@ -85,6 +123,157 @@ static void __attribute__((no_instrument_function)) add_textbase(void)
 	hdr->ftrace_count++;
 }
 
+/* Find the stats entry for a function, adding it if needed */
+static u32 __attribute__((no_instrument_function)) agg_find_slot(u32 func)
+{
+	ulong mask = hdr->stats_size - 1;
+	u32 hash = func * 2654435761U;
+	ulong slot = (hash ^ (hash >> 16)) & mask;
+	ulong i;
+
+	for (i = 0; i <= mask; i++, slot = (slot + 1) & mask) {
+		struct trace_func_stats *stats = &hdr->stats[slot];
+
+		if (stats->calls && stats->func == func)
+			return slot;
+		if (!stats->calls) {
+			/* Keep a free entry so that lookups always stop */
+			if (hdr->stats_used == mask)
+				break;
+			stats->func = func;
+			hdr->stats_used++;
+			return slot;
+		}
+	}
+
+	return TRACE_NO_SLOT;
+}
+
+static void __attribute__((no_instrument_function)) stack_push(u32 func,
+							u32 slot, u32 now)
+{
+	struct trace_frame *frame;
+
+	if (hdr->sp == TRACE_STACK_MAX) {
+		hdr->stack_overflow++;
+		return;
+	}
+	frame = &hdr->stack[hdr->sp++];
+	frame->func = func;
+	frame->slot = slot;
+	frame->start_us = now;
+	frame->child_us = 0;
+}
+
+/*
+ * Pop a function from the shadow stack, returning false if it is not on
+ * it (e.g. it was entered before tracing started). Anything above it has
+ * been left without a function exit (e.g. by longjmp()), so is popped too.
+ */
+static bool __attribute__((no_instrument_function)) stack_pop(u32 func,
+							      u32 now)
+{
+	struct trace_frame *frame;
+	u32 elapsed;
+	int sp;
+
+	if (hdr->stack_overflow) {
+		hdr->stack_overflow--;
+		return true;
+	}
+	for (sp = hdr->sp - 1; sp >= 0 && hdr->stack[sp].func != func; sp--)
+		;
+	if (sp < 0)
+		return false;
+
+	while (hdr->sp > sp) {
+		frame = &hdr->stack[--hdr->sp];
+		if (hdr->mode != TRACE_MODE_AGG)
+			continue;
+		elapsed = now - frame->start_us;
+		if (frame->slot != TRACE_NO_SLOT) {
+			struct trace_func_stats *stats;
+
+			stats = &hdr->stats[frame->slot];
+			stats->incl_us += elapsed;
+			stats->excl_us += elapsed - frame->child_us;
+		}
+		if (hdr->sp)
+			hdr->stack[hdr->sp - 1].child_us += elapsed;
+	}
+
+	return true;
+}
+
+static void __attribute__((no_instrument_function)) agg_enter(u32 func)
+{
+	u32 slot = agg_find_slot(func);
+
+	if (slot != TRACE_NO_SLOT) {
+		struct trace_func_stats *stats = &hdr->stats[slot];
+
+		stats->calls++;
+		stats->depth_hist[min(hdr->sp, TRACE_DEPTH_BUCKETS - 1)]++;
+	} else {
+		hdr->stats_dropped++;
+	}
+	stack_push(func, slot, timer_get_us());
+}
+
+/* Record the current call stack, merging it with the last if the same */
+static void __attribute__((no_instrument_function)) add_sample(uint weight)
+{
+	struct trace_sample *rec;
+	int depth = min(hdr->sp, TRACE_SAMPLE_DEPTH);
+	int base = hdr->sp - depth;
+	int i;
+
+	if (hdr->sample_count) {
+		rec = &hdr->samples[hdr->sample_count - 1];
+		if (rec->depth == hdr->sp) {
+			for (i = 0; i < depth; i++) {
+				if (rec->stack[i] != hdr->stack[base + i].func)
+					break;
+			}
+			if (i == depth) {
+				rec->count += weight;
+				return;
+			}
+		}
+	}
+	if (hdr->sample_count == hdr->sample_size) {
+		hdr->sample_dropped += weight;
+		return;
+	}
+	rec = &hdr->samples[hdr->sample_count++];
+	rec->count = weight;
+	rec->depth = hdr->sp;
+	for (i = 0; i < depth; i++)
+		rec->stack[i] = hdr->stack[base + i].func;
+}
+
+/*
+ * Take a sample if the sample period has passed. Reading the timer is
+ * relatively slow, so this is only checked every TRACE_SAMPLE_CHECK calls.
+ * If several periods have passed, the sample counts for each of them.
+ */
+static void __attribute__((no_instrument_function)) sample_check(void)
+{
+	ulong now, late;
+	uint periods;
+
+	if (--hdr->sample_countdown > 0)
+		return;
+	hdr->sample_countdown = TRACE_SAMPLE_CHECK;
+	now = timer_get_us();
+	late = now - hdr->next_sample_us;
+	if ((long)late < 0)
+		return;
+	periods = late / hdr->sample_us + 1;
+	hdr->next_sample_us += periods * hdr->sample_us;
+	add_sample(periods);
+}
+
 /**
  * This is called on every function entry
  *
@@ -100,8 +289,19 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 	if (trace_enabled) {
 		int func;
 
-		add_ftrace(func_ptr, caller, FUNCF_ENTRY);
 		func = func_ptr_to_num(func_ptr);
+		switch (hdr->mode) {
+		case TRACE_MODE_CALLS:
+			add_ftrace(func_ptr, caller, FUNCF_ENTRY);
+			break;
+		case TRACE_MODE_AGG:
+			agg_enter(func);
+			break;
+		default:
+			stack_push(func, TRACE_NO_SLOT, 0);
+			sample_check();
+			break;
+		}
 		if (func < hdr->func_count) {
 			hdr->call_accum[func]++;
 			hdr->call_count++;
@@ -117,7 +317,7 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 /**
  * This is called on every function exit
  *
- * We do nothing here.
+ * We record the exit, or the time spent in the function.
  *
  * @param func_ptr	Pointer to function being entered
  * @param caller	Pointer to function which called this function
@@ -126,7 +326,18 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_exit(
 		void *func_ptr, void *caller)
 {
 	if (trace_enabled) {
-		add_ftrace(func_ptr, caller, FUNCF_EXIT);
+		switch (hdr->mode) {
+		case TRACE_MODE_CALLS:
+			add_ftrace(func_ptr, caller, FUNCF_EXIT);
+			break;
+		case TRACE_MODE_AGG:
+			stack_pop(func_ptr_to_num(func_ptr), timer_get_us());
+			break;
+		default:
+			stack_pop(func_ptr_to_num(func_ptr), 0);
+			sample_check();
+			break;
+		}
 		hdr->depth--;
 	}
 }
@@ -231,6 +442,136 @@ int trace_list_calls(void *buff, int buff_size, unsigned *needed)
 	return 0;
 }
 
+int trace_list_stats(void *buff, int buff_size, unsigned int *needed)
+{
+	struct trace_output_hdr *output_hdr = NULL;
+	void *end, *ptr = buff;
+	ulong slot;
+	int upto;
+
+	end = buff ? buff + buff_size : NULL;
+
+	/* Place some header information */
+	if (ptr + sizeof(struct trace_output_hdr) < end)
+		output_hdr = ptr;
+	ptr += sizeof(struct trace_output_hdr);
+
+	/* Add the stats for each function called */
+	for (slot = upto = 0; hdr->stats && slot < hdr->stats_size; slot++) {
+		struct trace_func_stats *stats = &hdr->stats[slot];
+
+		if (!stats->calls)
+			continue;
+		if (ptr + sizeof(struct trace_func_stats) < end) {
+			struct trace_func_stats *out = ptr;
+
+			*out = *stats;
+			out->func = stats->func * FUNC_SITE_SIZE;
+			upto++;
+		}
+		ptr += sizeof(struct trace_func_stats);
+	}
+
+	/* Update the header */
+	if (output_hdr) {
+		output_hdr->rec_count = upto;
+		output_hdr->type = TRACE_CHUNK_STATS;
+	}
+
+	/* Work out how must of the buffer we used */
+	*needed = ptr - buff;
+	if (ptr > end)
+		return -1;
+	return 0;
+}
+
+int trace_list_samples(void *buff, int buff_size, unsigned int *needed)
+{
+	struct trace_output_hdr *output_hdr = NULL;
+	void *end, *ptr = buff;
+	ulong rec;
+	int upto, i;
+
+	end = buff ? buff + buff_size : NULL;
+
+	/* Place some header information */
+	if (ptr + sizeof(struct trace_output_hdr) < end)
+		output_hdr = ptr;
+	ptr += sizeof(struct trace_output_hdr);
+
+	/* Add each sample */
+	for (rec = upto = 0; hdr->samples && rec < hdr->sample_count; rec++) {
+		if (ptr + sizeof(struct trace_sample) < end) {
+			struct trace_sample *sample = &hdr->samples[rec];
+			struct trace_sample *out = ptr;
+
+			out->count = sample->count;
+			out->depth = sample->depth;
+			for (i = 0; i < TRACE_SAMPLE_DEPTH; i++) {
+				out->stack[i] = i < sample->depth ?
+					sample->stack[i] * FUNC_SITE_SIZE : 0;
+			}
+			upto++;
+		}
+		ptr += sizeof(struct trace_sample);
+	}
+
+	/* Update the header */
+	if (output_hdr) {
+		output_hdr->rec_count = upto;
+		output_hdr->type = TRACE_CHUNK_SAMPLES;
+	}
+
+	/* Work out how must of the buffer we used */
+	*needed = ptr - buff;
+	if (ptr > end)
+		return -1;
+	return 0;
+}
+
+int trace_set_mode(enum trace_mode mode, unsigned int sample_us)
+{
+	size_t area = hdr ? hdr->ftrace_size * sizeof(*hdr->ftrace) : 0;
+	int was_enabled = trace_enabled;
+
+	if (!trace_inited || mode >= TRACE_MODE_COUNT)
+		return -1;
+
+	trace_enabled = 0;
+	hdr->stats = NULL;
+	hdr->samples = NULL;
+	hdr->sp = 0;
+	hdr->stack_overflow = 0;
+	hdr->ftrace_count = 0;
+	switch (mode) {
+	case TRACE_MODE_CALLS:
+		add_textbase();
+		break;
+	case TRACE_MODE_AGG:
+		hdr->stats = (struct trace_func_stats *)hdr->ftrace;
+		hdr->stats_size = area / sizeof(*hdr->stats);
+		if (hdr->stats_size)
+			hdr->stats_size = 1UL << (fls(hdr->stats_size) - 1);
+		hdr->stats_used = 0;
+		hdr->stats_dropped = 0;
+		memset(hdr->stats, '\0', hdr->stats_size * sizeof(*hdr->stats));
+		break;
+	default:
+		hdr->samples = (struct trace_sample *)hdr->ftrace;
+		hdr->sample_size = area / sizeof(*hdr->samples);
+		hdr->sample_count = 0;
+		hdr->sample_dropped = 0;
+		hdr->sample_us = sample_us ? sample_us : TRACE_SAMPLE_US;
+		hdr->sample_countdown = TRACE_SAMPLE_CHECK;
+		hdr->next_sample_us = timer_get_us() + hdr->sample_us;
+		break;
+	}
+	hdr->mode = mode;
+	trace_enabled = was_enabled;
+
+	return 0;
+}
+
 /* Print basic information about tracing */
 void trace_print_stats(void)
 {
@@ -262,6 +603,23 @@ void trace_print_stats(void)
 	printf("%15d call depth limit\n", hdr->depth_limit);
 	print_grouped_ull(hdr->ftrace_too_deep_count, 10);
 	puts(" calls not traced due to depth\n");
+	switch (hdr->mode) {
+	case TRACE_MODE_CALLS:
+		break;
+	case TRACE_MODE_AGG:
+		print_grouped_ull(hdr->stats_used, 10);
+		printf(" functions aggregated (table size %lu)\n",
+		       hdr->stats_size);
+		print_grouped_ull(hdr->stats_dropped, 10);
+		puts(" calls not aggregated due to table size\n");
+		break;
+	default:
+		print_grouped_ull(hdr->sample_count, 10);
+		printf(" sampled call stacks (every %u us)\n", hdr->sample_us);
+		print_grouped_ull(hdr->sample_dropped, 10);
+		puts(" samples dropped due to overflow\n");
+		break;
+	}
 }
 
 void __attribute__((no_instrument_function)) trace_set_enabled(int enabled)
@@ -0,0 +1,927 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Zstandard decompression
+ *
+ * This follows the format described in RFC 8878. Only the decoder is
+ * implemented, for frames without a dictionary. Data is decompressed
+ * straight into the output buffer, so the whole output is used as the
+ * history window and no separate window buffer is needed.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <asm/unaligned.h>
+
+#define ZSTD_MAGIC		0xfd2fb528
+#define ZSTD_MAGIC_SKIPPABLE	0x184d2a50	/* low four bits are ignored */
+#define ZSTD_BLOCK_MAX		(128 * 1024)
+
+#define ZSTD_BLOCK_RAW		0
+#define ZSTD_BLOCK_RLE		1
+#define ZSTD_BLOCK_COMPRESSED	2
+
+#define ZSTD_LIT_RAW		0
+#define ZSTD_LIT_RLE		1
+#define ZSTD_LIT_COMPRESSED	2
+#define ZSTD_LIT_TREELESS	3
+
+#define ZSTD_SEQ_PREDEFINED	0
+#define ZSTD_SEQ_RLE		1
+#define ZSTD_SEQ_COMPRESSED	2
+#define ZSTD_SEQ_REPEAT		3
+
+#define ZSTD_HUF_MAX_BITS	11
+#define ZSTD_HUF_MAX_SYMBOLS	256
+#define ZSTD_FSE_MAX_LOG	9
+#define ZSTD_FSE_MAX_SYMBOLS	256
+
+#define ZSTD_HUF_WEIGHT_MAX_LOG	6
+
+/* Baseline and number of extra bits for each literal length code */
+static const u32 zstd_ll_base[36] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 0x80, 0x100, 0x200, 0x400,
+	0x800, 0x1000, 0x2000, 0x4000, 0x8000, 0x10000,
+};
+
+static const u8 zstd_ll_bits[36] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+/* Baseline and number of extra bits for each match length code */
+static const u32 zstd_ml_base[53] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 0x83, 0x103, 0x203,
+	0x403, 0x803, 0x1003, 0x2003, 0x4003, 0x8003, 0x10003,
+};
+
+static const u8 zstd_ml_bits[53] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+/* Predefined distributions, used when a table is not sent */
+static const s16 zstd_ll_default[36] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1,
+};
+
+static const s16 zstd_ml_default[53] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1,
+};
+
+static const s16 zstd_of_default[29] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1,
+};
+
+/*
+ * A bitstream. Entropy-coded streams are read backwards, from the last bit
+ * to the first; headers are read forwards. @pos is the bit position, which
+ * goes negative when a backward stream is read past its start. Bits before
+ * the start read as zero.
+ */
+struct zstd_bits {
+	const u8 *src;
+	size_t len;
+	long pos;
+};
+
+struct zstd_fse_entry {
+	u8 symbol;
+	u8 bits;
+	u16 base;
+};
+
+struct zstd_fse {
+	int log;	/* Accuracy log, -1 if there is no table */
+	struct zstd_fse_entry table[1 << ZSTD_FSE_MAX_LOG];
+};
+
+struct zstd_huf {
+	int max_bits;	/* 0 if there is no table */
+	u8 symbol[1 << ZSTD_HUF_MAX_BITS];
+	u8 bits[1 << ZSTD_HUF_MAX_BITS];
+};
+
+/* State which is kept between the blocks of a frame */
+struct zstd_ctx {
+	struct zstd_fse ll, of, ml;
+	struct zstd_huf huf;
+	u32 rep[3];
+	u8 *base;	/* Start of the frame's output, for offset checks */
+	u8 lit[ZSTD_BLOCK_MAX];
+};
+
+static u64 zstd_load(const u8 *src, size_t avail)
+{
+	u64 val = 0;
+	int i;
+
+	if (avail >= sizeof(u64))
+		return get_unaligned_le64(src);
+	for (i = avail - 1; i >= 0; i--)
+		val = val << 8 | src[i];
+
+	return val;
+}
+
+/* Get @n bits (up to 32) below the current position of a backward stream */
+static u32 zstd_peek(const struct zstd_bits *b, int n)
+{
+	long pos = b->pos - n;
+	u64 val;
+
+	if (!n)
+		return 0;
+	if (pos >= 0) {
+		val = zstd_load(b->src + (pos >> 3), b->len - (pos >> 3));
+		val >>= pos & 7;
+	} else if (pos + n > 0) {
+		val = zstd_load(b->src, b->len) << -pos;
+	} else {
+		return 0;
+	}
+
+	return val & ((1ULL << n) - 1);
+}
+
+static u32 zstd_read(struct zstd_bits *b, int n)
+{
+	u32 val = zstd_peek(b, n);
+
+	b->pos -= n;
+
+	return val;
+}
+
+/* Read @n bits forwards */
+static u32 zstd_read_fwd(struct zstd_bits *b, int n)
+{
+	size_t byte = b->pos >> 3;
+	u64 val = 0;
+
+	if (byte < b->len) {
+		val = zstd_load(b->src + byte, b->len - byte);
+		val = (val >> (b->pos & 7)) & ((1ULL << n) - 1);
+	}
+	b->pos += n;
+
+	return val;
+}
+
+/* Set up a backward stream, which ends with a padding marker bit */
+static int zstd_init_bits(struct zstd_bits *b, const u8 *src, size_t len)
+{
+	if (!len || !src[len - 1])
+		return -EPROTO;
+	b->src = src;
+	b->len = len;
+	b->pos = (len - 1) * 8 + fls(src[len - 1]) - 1;
+
+	return 0;
+}
+
+static int zstd_fse_build(struct zstd_fse *fse, const s16 *norm, int count,
+			  int log)
+{
+	u16 next[ZSTD_FSE_MAX_SYMBOLS];
+	int size = 1 << log;
+	int high = size - 1;
+	int step = (size >> 1) + (size >> 3) + 3;
+	int pos = 0;
+	int s, i;
+
+	/* Symbols with "less than 1" probability go at the end */
+	for (s = 0; s < count; s++) {
+		if (norm[s] == -1) {
+			fse->table[high--].symbol = s;
+			next[s] = 1;
+		}
+	}
+	for (s = 0; s < count; s++) {
+		if (norm[s] <= 0)
+			continue;
+		next[s] = norm[s];
+		for (i = 0; i < norm[s]; i++) {
+			fse->table[pos].symbol = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+	if (pos)
+		return -EPROTO;
+
+	for (i = 0; i < size; i++) {
+		struct zstd_fse_entry *ent = &fse->table[i];
+		u16 state = next[ent->symbol]++;
+
+		ent->bits = log - (fls(state) - 1);
+		ent->base = (state << ent->bits) - size;
+	}
+	fse->log = log;
+
+	return 0;
+}
+
+static void zstd_fse_rle(struct zstd_fse *fse, u8 symbol)
+{
+	fse->table[0].symbol = symbol;
+	fse->table[0].bits = 0;
+	fse->table[0].base = 0;
+	fse->log = 0;
+}
+
+/*
+ * Read an FSE table description, returning the number of bytes used or a
+ * -ve error
+ */
+static int zstd_fse_read(struct zstd_fse *fse, const u8 *src, size_t len,
+			 int max_log, int max_symbol)
+{
+	s16 norm[ZSTD_FSE_MAX_SYMBOLS];
+	struct zstd_bits b = { src, len, 0 };
+	int remaining, log, count = 0;
+	int ret;
+
+	if (!len)
+		return -EINVAL;
+	log = zstd_read_fwd(&b, 4) + 5;
+	if (log > max_log)
+		return -EPROTO;
+
+	remaining = 1 << log;
+	while (remaining > 0 && count <= max_symbol) {
+		int bits = fls(remaining + 1);
+		u32 mask = (1 << (bits - 1)) - 1;
+		u32 small = (1 << bits) - 1 - (remaining + 1);
+		u32 val = zstd_read_fwd(&b, bits);
+		int proba;
+
+		if ((val & mask) < small) {
+			val &= mask;
+			b.pos--;
+		} else if (val > mask) {
+			val -= small;
+		}
+		proba = val - 1;
+		remaining -= proba < 0 ? -proba : proba;
+		norm[count++] = proba;
+
+		if (!proba) {
+			int repeat, i;
+
+			/* 2-bit count of further zeroes, 3 means more follow */
+			do {
+				repeat = zstd_read_fwd(&b, 2);
+				for (i = 0; i < repeat && count <= max_symbol;
+				     i++)
+					norm[count++] = 0;
+			} while (repeat == 3);
+		}
+		if (b.pos > len * 8)
+			return -EINVAL;
+	}
+	if (remaining)
+		return -EPROTO;
+
+	ret = zstd_fse_build(fse, norm, count, log);
+	if (ret)
+		return ret;
+
+	return (b.pos + 7) / 8;
+}
+
+static int zstd_huf_build(struct zstd_huf *huf, const u8 *weights, int count)
+{
+	u32 rank_count[ZSTD_HUF_MAX_BITS + 1] = { 0 };
+	u32 rank_idx[ZSTD_HUF_MAX_BITS + 1];
+	u8 bits[ZSTD_HUF_MAX_SYMBOLS];
+	u32 total = 0, left;
+	int max_bits, s, i;
+
+	for (s = 0; s < count; s++) {
+		if (weights[s] > ZSTD_HUF_MAX_BITS)
+			return -EPROTO;
+		if (weights[s])
+			total += 1 << (weights[s] - 1);
+	}
+	if (!total)
+		return -EPROTO;
+	max_bits = fls(total);
+	if (max_bits > ZSTD_HUF_MAX_BITS)
+		return -EPROTO;
+
+	/* The weight of the last symbol is implied by the others */
+	left = (1 << max_bits) - total;
+	if (left & (left - 1))
+		return -EPROTO;
+	for (s = 0; s < count; s++)
+		bits[s] = weights[s] ? max_bits + 1 - weights[s] : 0;
+	bits[count++] = max_bits + 1 - fls(left);
+
+	for (s = 0; s < count; s++)
+		rank_count[bits[s]]++;
+	rank_idx[max_bits] = 0;
+	for (i = max_bits; i >= 1; i--) {
+		rank_idx[i - 1] = rank_idx[i] +
+				  rank_count[i] * (1 << (max_bits - i));
+		memset(&huf->bits[rank_idx[i]], i,
+		       rank_idx[i - 1] - rank_idx[i]);
+	}
+	if (rank_idx[0] != 1 << max_bits)
+		return -EPROTO;
+
+	for (s = 0; s < count; s++) {
+		if (bits[s]) {
+			u32 len = 1 << (max_bits - bits[s]);
+
+			memset(&huf->symbol[rank_idx[bits[s]]], s, len);
+			rank_idx[bits[s]] += len;
+		}
+	}
+	huf->max_bits = max_bits;
+
+	return 0;
+}
+
+/*
+ * Read a Huffman tree description, returning the number of bytes used or a
+ * -ve error
+ */
+static int zstd_huf_read(struct zstd_huf *huf, const u8 *src, size_t len)
+{
+	u8 weights[ZSTD_HUF_MAX_SYMBOLS];
+	int count = 0, hdr, ret;
+
+	if (!len)
+		return -EINVAL;
+	hdr = src[0];
+	if (hdr >= 128) {
+		/* Weights stored directly, 4 bits each */
+		count = hdr - 127;
+		if ((count + 1) / 2 + 1 > len)
+			return -EINVAL;
+		for (ret = 0; ret < count; ret++) {
+			u8 byte = src[1 + ret / 2];
+
+			weights[ret] = ret & 1 ? byte & 0xf : byte >> 4;
+		}
+		len = (count + 1) / 2;
+	} else {
+		/* Weights compressed with FSE, using two interleaved states */
+		struct zstd_fse fse;
+		struct zstd_fse_entry *ent;
+		struct zstd_bits b;
+		u32 state[2];
+		int used, i = 0;
+
+		if (hdr + 1 > len)
+			return -EINVAL;
+		used = zstd_fse_read(&fse, src + 1, hdr,
+				     ZSTD_HUF_WEIGHT_MAX_LOG,
+				     ZSTD_HUF_MAX_BITS);
+		if (used < 0)
+			return used;
+		ret = zstd_init_bits(&b, src + 1 + used, hdr - used);
+		if (ret)
+			return ret;
+		state[0] = zstd_read(&b, fse.log);
+		state[1] = zstd_read(&b, fse.log);
+		do {
+			if (count >= ZSTD_HUF_MAX_SYMBOLS - 2)
+				return -EPROTO;
+			ent = &fse.table[state[i]];
+			weights[count++] = ent->symbol;
+			state[i] = ent->base + zstd_read(&b, ent->bits);
+			i ^= 1;
+		} while (b.pos >= 0);
+		/* The other state holds one last weight */
+		weights[count++] = fse.table[state[i]].symbol;
+		len = hdr;
+	}
+
+	ret = zstd_huf_build(huf, weights, count);
+	if (ret)
+		return ret;
+
+	return len + 1;
+}
+
+static int zstd_huf_stream(const struct zstd_huf *huf, const u8 *src,
+			   size_t len, u8 *out, size_t count)
+{
+	struct zstd_bits b;
+	int ret;
+
+	ret = zstd_init_bits(&b, src, len);
+	if (ret)
+		return ret;
+	while (count--) {
+		u32 idx = zstd_peek(&b, huf->max_bits);
+
+		*out++ = huf->symbol[idx];
+		b.pos -= huf->bits[idx];
+	}
+	if (b.pos)
+		return -EPROTO;
+
+	return 0;
+}
+
+/*
+ * Decode the literals section of a block into ctx->lit, returning the
+ * number of bytes used or a -ve error
+ */
+static int zstd_literals(struct zstd_ctx *ctx, const u8 *src, size_t len,
+			 size_t *lit_len)
+{
+	int type = src[0] & 3, format = (src[0] >> 2) & 3;
+	size_t regen, comp, hdr, used;
+	int ret;
+
+	if (type == ZSTD_LIT_RAW || type == ZSTD_LIT_RLE) {
+		switch (format) {
+		case 1:
+			hdr = 2;
+			break;
+		case 3:
+			hdr = 3;
+			break;
+		default:
+			hdr = 1;
+			break;
+		}
+		if (len < hdr + 1)
+			return -EINVAL;
+		regen = src[0] >> (hdr == 1 ? 3 : 4);
+		if (hdr > 1)
+			regen |= src[1] << 4;
+		if (hdr > 2)
+			regen |= src[2] << 12;
+		if (regen > ZSTD_BLOCK_MAX)
+			return -EPROTO;
+		if (type == ZSTD_LIT_RLE) {
+			memset(ctx->lit, src[hdr], regen);
+			hdr++;
+		} else {
+			if (len < hdr + regen)
+				return -EINVAL;
+			memcpy(ctx->lit, src + hdr, regen);
+			hdr += regen;
+		}
+		*lit_len = regen;
+
+		return hdr;
+	}
+
+	/* Huffman-compressed, in one stream or four */
+	if (len < 5)
+		return -EINVAL;
+	if (format < 2) {
+		u32 val = get_unaligned_le32(src) & 0xffffff;
+
+		hdr = 3;
+		regen = (val >> 4) & 0x3ff;
+		comp = (val >> 14) & 0x3ff;
+	} else if (format == 2) {
+		u32 val = get_unaligned_le32(src);
+
+		hdr = 4;
+		regen = (val >> 4) & 0x3fff;
+		comp = (val >> 18) & 0x3fff;
+	} else {
+		u64 val = get_unaligned_le32(src) | (u64)src[4] << 32;
+
+		hdr = 5;
+		regen = (val >> 4) & 0x3ffff;
+		comp = (val >> 22) & 0x3ffff;
+	}
+	if (regen > ZSTD_BLOCK_MAX)
+		return -EPROTO;
+	if (len < hdr + comp)
+		return -EINVAL;
+	used = hdr + comp;
+	src += hdr;
+
+	if (type == ZSTD_LIT_COMPRESSED) {
+		ret = zstd_huf_read(&ctx->huf, src, comp);
+		if (ret < 0)
+			return ret;
+		src += ret;
+		comp -= ret;
+	} else if (!ctx->huf.max_bits) {
+		return -EPROTO;
+	}
+
+	if (!format) {
+		ret = zstd_huf_stream(&ctx->huf, src, comp, ctx->lit, regen);
+	} else {
+		size_t size[4], part = (regen + 3) / 4;
+		u8 *out = ctx->lit;
+		int i;
+
+		if (comp < 6 || regen < 3 * part)
+			return -EPROTO;
+		size[0] = get_unaligned_le16(src);
+		size[1] = get_unaligned_le16(src + 2);
+		size[2] = get_unaligned_le16(src + 4);
+		if (size[0] + size[1] + size[2] > comp - 6)
+			return -EPROTO;
+		size[3] = comp - 6 - size[0] - size[1] - size[2];
+		src += 6;
+		for (i = 0, ret = 0; i < 4 && !ret; i++) {
+			size_t count = i < 3 ? part : regen - 3 * part;
+
+			ret = zstd_huf_stream(&ctx->huf, src, size[i], out,
+					      count);
+			src += size[i];
+			out += count;
+		}
+	}
+	if (ret)
+		return ret;
+	*lit_len = regen;
+
+	return used;
+}
+
+/* How one of the sequence codes is coded */
+struct zstd_code {
+	const s16 *norm;	/* Predefined distribution */
+	int count;		/* Number of symbols in @norm */
+	int log;		/* Accuracy log of @norm */
+	int max_log;		/* Largest accuracy log allowed */
+	int max_symbol;		/* Largest code allowed */
+};
+
+static const struct zstd_code zstd_ll_code = {
+	zstd_ll_default, ARRAY_SIZE(zstd_ll_default), 6, 9, 35
+};
+
+static const struct zstd_code zstd_of_code = {
+	zstd_of_default, ARRAY_SIZE(zstd_of_default), 5, 8, 31
+};
+
+static const struct zstd_code zstd_ml_code = {
+	zstd_ml_default, ARRAY_SIZE(zstd_ml_default), 6, 9, 52
+};
+
+/*
+ * Set up the table for a sequence code as given by @mode, returning the
+ * number of bytes used or a -ve error
+ */
+static int zstd_seq_table(struct zstd_fse *fse, int mode, const u8 *src,
+			  size_t len, const struct zstd_code *code)
+{
+	int ret;
+
+	switch (mode) {
+	case ZSTD_SEQ_PREDEFINED:
+		ret = zstd_fse_build(fse, code->norm, code->count, code->log);
+		return ret;
+	case ZSTD_SEQ_RLE:
+		if (!len)
+			return -EINVAL;
+		if (src[0] > code->max_symbol)
+			return -EPROTO;
+		zstd_fse_rle(fse, src[0]);
+		return 1;
+	case ZSTD_SEQ_COMPRESSED:
+		return zstd_fse_read(fse, src, len, code->max_log,
+				     code->max_symbol);
+	default:
+		/* Use the table from the previous block */
+		return fse->log < 0 ? -EPROTO : 0;
+	}
+}
+
+/* Work out the offset of a match, which may be one of the last three used */
+static u32 zstd_offset(u32 rep[3], u32 val, u32 lit_len)
+{
+	u32 offset;
+	int idx;
+
+	if (val > 3) {
+		offset = val - 3;
+	} else {
+		idx = val - 1 + !lit_len;
+		if (!idx)
+			return rep[0];
+		offset = idx < 3 ? rep[idx] : rep[0] - 1;
+		if (idx == 1) {
+			rep[1] = rep[0];
+			rep[0] = offset;
+			return offset;
+		}
+	}
+	rep[2] = rep[1];
+	rep[1] = rep[0];
+	rep[0] = offset;
+
+	return offset;
+}
+
+/* Decode the sequences section of a block and write out the block */
+static int zstd_sequences(struct zstd_ctx *ctx, const u8 *src, size_t len,
+			  size_t lit_len, u8 **outp, u8 *end)
+{
+	const u8 *lit = ctx->lit, *lit_end = ctx->lit + lit_len;
+	const u8 *src_end = src + len;
+	u8 *out = *outp;
+	int count, ret;
+
+	if (!len)
+		return -EINVAL;
+	count = *src++;
+	if (count == 255) {
+		if (src_end - src < 2)
+			return -EINVAL;
+		count = get_unaligned_le16(src) + 0x7f00;
+		src += 2;
+	} else if (count >= 128) {
+		if (src_end - src < 1)
+			return -EINVAL;
+		count = ((count - 128) << 8) + *src++;
+	}
+
+	if (count) {
+		const struct zstd_fse_entry *ll, *of, *ml;
+		u32 ll_state, of_state, ml_state;
+		struct zstd_bits b;
+		int modes;
+
+		if (src_end - src < 1)
+			return -EINVAL;
+		modes = *src++;
+		if (modes & 3)
+			return -EPROTO;
+		ret = zstd_seq_table(&ctx->ll, modes >> 6, src, src_end - src,
+				     &zstd_ll_code);
+		if (ret < 0)
+			return ret;
+		src += ret;
+		ret = zstd_seq_table(&ctx->of, (modes >> 4) & 3, src,
+				     src_end - src, &zstd_of_code);
+		if (ret < 0)
+			return ret;
+		src += ret;
+		ret = zstd_seq_table(&ctx->ml, (modes >> 2) & 3, src,
+				     src_end - src, &zstd_ml_code);
+		if (ret < 0)
+			return ret;
+		src += ret;
+
+		ret = zstd_init_bits(&b, src, src_end - src);
+		if (ret)
+			return ret;
+		ll_state = zstd_read(&b, ctx->ll.log);
+		of_state = zstd_read(&b, ctx->of.log);
+		ml_state = zstd_read(&b, ctx->ml.log);
+
+		while (count--) {
+			u32 offset, match, lit_n;
+			const u8 *from;
+
+			ll = &ctx->ll.table[ll_state];
+			of = &ctx->of.table[of_state];
+			ml = &ctx->ml.table[ml_state];
+			offset = (1U << of->symbol) + zstd_read(&b, of->symbol);
+			match = zstd_ml_base[ml->symbol] +
+				zstd_read(&b, zstd_ml_bits[ml->symbol]);
+			lit_n = zstd_ll_base[ll->symbol] +
+				zstd_read(&b, zstd_ll_bits[ll->symbol]);
+			offset = zstd_offset(ctx->rep, offset, lit_n);
+			if (count) {
+				ll_state = ll->base + zstd_read(&b, ll->bits);
+				ml_state = ml->base + zstd_read(&b, ml->bits);
+				of_state = of->base + zstd_read(&b, of->bits);
+			}
+
+			if (lit_n > lit_end - lit)
+				return -EPROTO;
+			if (lit_n + match > end - out)
+				return -ENOBUFS;
+			memcpy(out, lit, lit_n);
+			out += lit_n;
+			lit += lit_n;
+
+			if (!offset || offset > out - ctx->base)
+				return -EPROTO;
+			from = out - offset;
+			if (offset >= match) {
+				memcpy(out, from, match);
+				out += match;
+			} else {
+				/* The match overlaps what it produces */
+				while (match--)
+					*out++ = *from++;
+			}
+		}
+		if (b.pos)
+			return -EPROTO;
+	}
+
+	if (lit_end - lit > end - out)
+		return -ENOBUFS;
+	memcpy(out, lit, lit_end - lit);
+	*outp = out + (lit_end - lit);
+
+	return 0;
+}
+
+static int zstd_block(struct zstd_ctx *ctx, const u8 *src, size_t len,
+		      u8 **outp, u8 *end)
+{
+	size_t lit_len = 0;
+	int ret;
+
+	if (!len)
+		return -EINVAL;
+	ret = zstd_literals(ctx, src, len, &lit_len);
+	if (ret < 0)
+		return ret;
+
+	return zstd_sequences(ctx, src + ret, len - ret, lit_len, outp, end);
+}
+
+/*
+ * Decompress a frame, returning the number of bytes of @src it used or a -ve
+ * error
+ */
+static long zstd_frame(struct zstd_ctx *ctx, const u8 *src, size_t len,
+		       u8 *dst, size_t *dstn)
+{
+	static const u8 dict_size[4] = { 0, 1, 2, 4 };
+	const u8 *in = src, *in_end = src + len;
+	u8 *out = dst, *out_end = dst + *dstn;
+	int fcs_size, single, last;
+	u64 content_size = 0;
+	u32 dict = 0;
+	int fhd, i;
+
+	*dstn = 0;
+	if (len < 6)
+		return -EINVAL;
+	if (get_unaligned_le32(in) != ZSTD_MAGIC)
+		return -EPROTONOSUPPORT;
+	fhd = in[4];
+	in += 5;
+	if (fhd & 8)
+		return -EINVAL;	/* reserved must be zero */
+
+	single = fhd & 0x20;
+	fcs_size = fhd >> 6 ? 1 << (fhd >> 6) : !!single;
+	if (in_end - in < !single + dict_size[fhd & 3] + fcs_size)
+		return -EINVAL;
+	/* No window is needed since all the output is kept */
+	if (!single)
+		in++;
+	for (i = dict_size[fhd & 3] - 1; i >= 0; i--)
+		dict = dict << 8 | in[i];
+	in += dict_size[fhd & 3];
+	if (dict)
+		return -EPROTONOSUPPORT;	/* no dictionary support */
+	for (i = fcs_size - 1; i >= 0; i--)
+		content_size = content_size << 8 | in[i];
+	if (fcs_size == 2)
+		content_size += 256;
+	in += fcs_size;
+	if (fcs_size && content_size > out_end - out)
+		return -ENOBUFS;
+
+	ctx->ll.log = -1;
+	ctx->of.log = -1;
+	ctx->ml.log = -1;
+	ctx->huf.max_bits = 0;
+	ctx->rep[0] = 1;
+	ctx->rep[1] = 4;
+	ctx->rep[2] = 8;
+	ctx->base = dst;
+
+	do {
+		u32 hdr, size;
+		int ret = 0;
+
+		if (in_end - in < 3)
+			return -EINVAL;
+		hdr = in[0] | in[1] << 8 | in[2] << 16;
+		in += 3;
+		last = hdr & 1;
+		size = hdr >> 3;
+		if (size > ZSTD_BLOCK_MAX)
+			return -EPROTO;
+
+		switch ((hdr >> 1) & 3) {
+		case ZSTD_BLOCK_RAW:
+			if (size > in_end - in)
+				return -EINVAL;
+			if (size > out_end - out)
+				return -ENOBUFS;
+			memcpy(out, in, size);
+			in += size;
+			out += size;
+			break;
+		case ZSTD_BLOCK_RLE:
+			if (in_end - in < 1)
+				return -EINVAL;
+			if (size > out_end - out)
+				return -ENOBUFS;
+			memset(out, *in++, size);
+			out += size;
+			break;
+		case ZSTD_BLOCK_COMPRESSED:
+			if (size > in_end - in)
+				return -EINVAL;
+			ret = zstd_block(ctx, in, size, &out, out_end);
+			in += size;
+			break;
+		default:
+			return -EPROTO;
+		}
+		if (ret)
+			return ret;
+	} while (!last);
+
+	/* The content checksum is not checked */
+	if (fhd & 4) {
+		if (in_end - in < 4)
+			return -EINVAL;
+		in += 4;
+	}
+	if (fcs_size && out - dst != content_size)
+		return -EPROTO;
+	*dstn = out - dst;
+
+	return in - src;
+}
+
+long zstd_decompress_frame(const void *src, size_t srcn, void *dst,
+			   size_t *dstn)
+{
+	struct zstd_ctx *ctx;
+	long ret;
+
+	ctx = malloc(sizeof(*ctx));
+	if (!ctx) {
+		*dstn = 0;
+		return -ENOMEM;
+	}
+	ret = zstd_frame(ctx, src, srcn, dst, dstn);
+	free(ctx);
+
+	return ret;
+}
+
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	const u8 *in = src, *in_end = in + srcn;
+	u8 *out = dst, *out_end = out + *dstn;
+	struct zstd_ctx *ctx;
+	long ret = 0;
+
+	*dstn = 0;
+	ctx = malloc(sizeof(*ctx));
+	if (!ctx)
+		return -ENOMEM;
+
+	do {
+		size_t size;
+
+		if (in_end - in < 8) {
+			ret = -EINVAL;	/* input overrun */
+			break;
+		}
+		if ((get_unaligned_le32(in) & ~0xf) == ZSTD_MAGIC_SKIPPABLE) {
+			size = get_unaligned_le32(in + 4);
+			if (size > in_end - in - 8) {
+				ret = -EINVAL;
+				break;
+			}
+			in += 8 + size;
+			continue;
+		}
+		size = out_end - out;
+		ret = zstd_frame(ctx, in, in_end - in, out, &size);
+		if (ret < 0)
+			break;
+		in += ret;
+		out += size;
+	} while (in < in_end);
+
+	free(ctx);
+	*dstn = out - (u8 *)dst;
+
+	return ret < 0 ? ret : 0;
+}
@@ -10,29 +10,66 @@
 #include <common.h>
 #include <net.h>
 
-unsigned compute_ip_checksum(const void *vptr, unsigned nbytes)
+/*
+ * Add up @nbytes at @vptr as 16-bit words in one's complement arithmetic.
+ * The data is loaded 32 bits at a time into a 64-bit accumulator, which
+ * cannot overflow for any buffer that fits in memory, so the carries only
+ * need to be folded back in once at the end. The one's complement sum does
+ * not depend on how the words are grouped or on byte order, so the result
+ * is the same as adding one 16-bit word at a time.
+ */
+static u64 ip_checksum_add(u64 sum, const void *vptr, unsigned nbytes)
 {
-	int sum, oddbyte;
-	const unsigned short *ptr = vptr;
+	const u8 *ptr = vptr;
+	u16 oddbyte;
 
-	sum = 0;
-	while (nbytes > 1) {
-		sum += *ptr++;
+	if (((ulong)ptr & 2) && nbytes >= 2) {
+		sum += *(const u16 *)ptr;
+		ptr += 2;
 		nbytes -= 2;
 	}
-	if (nbytes == 1) {
+	while (nbytes >= 16) {
+		const u32 *p = (const u32 *)ptr;
+
+		sum += (u64)p[0] + p[1] + p[2] + p[3];
+		ptr += 16;
+		nbytes -= 16;
+	}
+	while (nbytes >= 4) {
+		sum += *(const u32 *)ptr;
+		ptr += 4;
+		nbytes -= 4;
+	}
+	if (nbytes >= 2) {
+		sum += *(const u16 *)ptr;
+		ptr += 2;
+		nbytes -= 2;
+	}
+	if (nbytes) {
 		oddbyte = 0;
-		((u8 *)&oddbyte)[0] = *(u8 *)ptr;
-		((u8 *)&oddbyte)[1] = 0;
+		((u8 *)&oddbyte)[0] = *ptr;
 		sum += oddbyte;
 	}
-	sum = (sum >> 16) + (sum & 0xffff);
-	sum += (sum >> 16);
-	sum = ~sum & 0xffff;
 
 	return sum;
 }
 
+/* Fold a sum from ip_checksum_add() to 16 bits and complement it */
+static unsigned ip_checksum_fold(u64 sum)
+{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum & 0xffff;
+}
+
+unsigned compute_ip_checksum(const void *vptr, unsigned nbytes)
+{
+	return ip_checksum_fold(ip_checksum_add(0, vptr, nbytes));
+}
+
 unsigned add_ip_checksums(unsigned offset, unsigned sum, unsigned new)
 {
 	unsigned long checksum;
@@ -57,3 +94,15 @@ int ip_checksum_ok(const void *addr, unsigned nbytes)
 {
 	return !(compute_ip_checksum(addr, nbytes) & 0xfffe);
 }
+
+unsigned compute_udp_checksum(const struct ip_udp_hdr *ip)
+{
+	unsigned len = ntohs(ip->udp_len);
+	u64 sum;
+
+	/* The pseudo header: addresses, protocol and UDP length */
+	sum = ip_checksum_add(0, &ip->ip_src, 2 * sizeof(struct in_addr));
+	sum += htons(IPPROTO_UDP) + ip->udp_len;
+
+	return ip_checksum_fold(ip_checksum_add(sum, &ip->udp_src, len));
+}
@@ -8,6 +8,8 @@
 #include <common.h>
 #include <dm.h>
 #include <environment.h>
+#include <malloc.h>
+#include <memalign.h>
 #include <net.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
@@ -36,6 +38,71 @@ struct eth_uclass_priv {
 /* eth_errno - This stores the most recent failure code from DM functions */
 static int eth_errno;
 
+/*
+ * eth_csum_offload - Checksums handled by the current device, read when it
+ * is started so that the stack need not ask the driver for every packet
+ */
+static int eth_csum_offload;
+
+/* Number of packets to process in one call to eth_rx() */
+#define ETH_RX_BUDGET		32
+/* Number of packets to ask recv_batch() for at once */
+#define ETH_RX_BATCH		16
+
+/*
+ * The receive buffer pool is a single DMA-aligned allocation, split into
+ * CONFIG_NET_RX_POOL_SIZE buffers. Free buffers are kept on a stack.
+ */
+static uchar *rx_pool;
+static uchar *rx_pool_free_list[CONFIG_NET_RX_POOL_SIZE];
+static int rx_pool_free_count;
+
+static int net_rx_pool_init(void)
+{
+	int i;
+
+	if (rx_pool)
+		return 0;
+	rx_pool = memalign(ARCH_DMA_MINALIGN,
+			   CONFIG_NET_RX_POOL_SIZE * PKTSIZE_ALIGN);
+	if (!rx_pool)
+		return -ENOMEM;
+	for (i = 0; i < CONFIG_NET_RX_POOL_SIZE; i++)
+		rx_pool_free_list[i] = rx_pool + i * PKTSIZE_ALIGN;
+	rx_pool_free_count = CONFIG_NET_RX_POOL_SIZE;
+
+	return 0;
+}
+
+uchar *net_rx_pool_alloc(void)
+{
+	if (net_rx_pool_init() || !rx_pool_free_count)
+		return NULL;
+
+	return rx_pool_free_list[--rx_pool_free_count];
+}
+
+void net_rx_pool_free(uchar *packet)
+{
+	if (!packet)
+		return;
+	if (rx_pool_free_count == CONFIG_NET_RX_POOL_SIZE ||
+	    packet < rx_pool ||
+	    packet >= rx_pool + CONFIG_NET_RX_POOL_SIZE * PKTSIZE_ALIGN) {
+		debug("%s: %p is not from the pool\n", __func__, packet);
+		return;
+	}
+	rx_pool_free_list[rx_pool_free_count++] = packet;
+}
+
+int net_rx_pool_avail(void)
+{
+	if (net_rx_pool_init())
+		return 0;
+
+	return rx_pool_free_count;
+}
+
 static struct eth_uclass_priv *eth_get_uclass_priv(void)
 {
 	struct uclass *uc;
@@ -238,6 +305,15 @@ static int on_ethaddr(const char *name, const char *value, enum env_op op,
 }
 U_BOOT_ENV_CALLBACK(ethaddr, on_ethaddr);
 
+static void eth_read_csum_offload(struct udevice *dev)
+{
+	const struct eth_ops *ops = eth_get_ops(dev);
+
+	eth_csum_offload = 0;
+	if (ops->get_csum_offload)
+		eth_csum_offload = ops->get_csum_offload(dev);
+}
+
 int eth_init(void)
 {
 	char *ethact = env_get("ethact");
@@ -278,6 +354,7 @@ int eth_init(void)
 						current->uclass_priv;
 
 					priv->state = ETH_STATE_ACTIVE;
+					eth_read_csum_offload(current);
 					return 0;
 				}
 			} else {
@@ -314,6 +391,12 @@ void eth_halt(void)
 	priv = current->uclass_priv;
 	if (priv)
 		priv->state = ETH_STATE_PASSIVE;
+	eth_csum_offload = 0;
+}
+
+int eth_get_csum_offload(void)
+{
+	return eth_csum_offload;
 }
 
 int eth_is_active(struct udevice *dev)
@@ -347,6 +430,47 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+/*
+ * Process each packet as it is taken from the batch. Once a packet changes
+ * the state of the network loop or stops the device, the rest of the batch
+ * is dropped. Stopping the device gives back its buffers, so nothing is
+ * freed after that.
+ */
+static int eth_rx_batch(struct udevice *dev, int flags)
+{
+	const struct eth_ops *ops = eth_get_ops(dev);
+	struct eth_rx_desc descs[ETH_RX_BATCH];
+	enum net_loop_state state = net_state;
+	bool running = true;
+	int done = 0;
+	int ret, i;
+
+	while (running && done < ETH_RX_BUDGET) {
+		ret = ops->recv_batch(dev, flags, descs,
+				      min(ETH_RX_BATCH, ETH_RX_BUDGET - done));
+		flags = 0;
+		if (ret <= 0)
+			return ret;
+		for (i = 0; i < ret; i++) {
+			if (running) {
+				net_rx_payload = descs[i].payload;
+				net_process_received_packet(descs[i].packet,
+							    descs[i].length);
+				net_rx_payload = NULL;
+			}
+			if (!eth_is_active(dev))
+				return done + i + 1;
+			running = net_state == state;
+			if (ops->free_pkt)
+				ops->free_pkt(dev, descs[i].packet,
+					      descs[i].length);
+		}
+		done += ret;
+	}
+
+	return done;
+}
+
 int eth_rx(void)
 {
 	struct udevice *current;
@@ -362,17 +486,23 @@ int eth_rx(void)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
-	/* Process up to 32 packets at one time */
+	/* Process up to ETH_RX_BUDGET packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
-	for (i = 0; i < 32; i++) {
-		ret = eth_get_ops(current)->recv(current, flags, &packet);
-		flags = 0;
-		if (ret > 0)
-			net_process_received_packet(packet, ret);
-		if (ret >= 0 && eth_get_ops(current)->free_pkt)
-			eth_get_ops(current)->free_pkt(current, packet, ret);
-		if (ret <= 0)
-			break;
+	if (eth_get_ops(current)->recv_batch) {
+		ret = eth_rx_batch(current, flags);
+	} else {
+		for (i = 0; i < ETH_RX_BUDGET; i++) {
+			ret = eth_get_ops(current)->recv(current, flags,
+							 &packet);
+			flags = 0;
+			if (ret > 0)
+				net_process_received_packet(packet, ret);
+			if (ret >= 0 && eth_get_ops(current)->free_pkt)
+				eth_get_ops(current)->free_pkt(current, packet,
+							       ret);
+			if (ret <= 0)
+				break;
+		}
 	}
 	if (ret == -EAGAIN)
 		ret = 0;
@@ -472,6 +602,8 @@ static int eth_post_probe(struct udevice *dev)
 			ops->send += gd->reloc_off;
 		if (ops->recv)
 			ops->recv += gd->reloc_off;
+		if (ops->recv_batch)
+			ops->recv_batch += gd->reloc_off;
 		if (ops->free_pkt)
 			ops->free_pkt += gd->reloc_off;
 		if (ops->stop)
@@ -484,6 +616,8 @@ static int eth_post_probe(struct udevice *dev)
 			ops->write_hwaddr += gd->reloc_off;
 		if (ops->read_rom_hwaddr)
 			ops->read_rom_hwaddr += gd->reloc_off;
+		if (ops->get_csum_offload)
+			ops->get_csum_offload += gd->reloc_off;
 
 		reloc_done++;
 	}
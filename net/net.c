@@ -94,6 +94,7 @@
 #include <errno.h>
 #include <net.h>
 #include <net/fastboot.h>
+#include <net/tcp.h>
 #include <net/tftp.h>
 #if defined(CONFIG_LED_STATUS)
 #include <miiphy.h>
@@ -117,6 +118,9 @@
 #if defined(CONFIG_CMD_WOL)
 #include "wol.h"
 #endif
+#if defined(CONFIG_CMD_WGET)
+#include "wget.h"
+#endif
 
 /** BOOTP EXTENTIONS **/
 
@@ -149,6 +153,8 @@ struct in_addr	net_server_ip;
 uchar *net_rx_packet;
 /* Current rx packet length */
 int		net_rx_packet_len;
+/* Where the driver put the payload of the current rx packet, or NULL */
+void		*net_rx_payload;
 /* IP packet ID */
 static unsigned	net_ip_id;
 /* Ethernet bcast address */
@@ -193,6 +199,8 @@ static uchar net_pkt_buf[(PKTBUFSRX+1) * PKTSIZE_ALIGN + PKTALIGN];
 uchar *net_rx_packets[PKTBUFSRX];
 /* Current UDP RX packet handler */
 static rxhand_f *udp_packet_handler;
+/* Current UDP RX payload place handler */
+static rxplace_f *udp_place_handler;
 /* Current ARP RX packet handler */
 static rxhand_f *arp_packet_handler;
 #ifdef CONFIG_CMD_TFTPPUT
@@ -368,6 +376,10 @@ static void net_clear_handlers(void)
 static void net_cleanup_loop(void)
 {
 	net_clear_handlers();
+#ifdef CONFIG_PROT_TCP
+	/* Drop any connection left open by an interrupted transfer */
+	tcp_abort();
+#endif
 }
 
 void net_init(void)
@@ -501,6 +513,11 @@ restart:
 			nfs_start();
 			break;
 #endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_CDP)
 		case CDP:
 			cdp_start();
@@ -761,6 +778,55 @@ void net_set_udp_handler(rxhand_f *f)
 		udp_packet_handler = dummy_handler;
 	else
 		udp_packet_handler = f;
+	udp_place_handler = NULL;
+}
+
+void net_set_udp_place_handler(rxplace_f *f)
+{
+	udp_place_handler = f;
+}
+
+void *net_rx_place(const uchar *pkt, int len, int *offsetp, int *sizep)
+{
+	const struct ethernet_hdr *et = (const struct ethernet_hdr *)pkt;
+	const struct ip_udp_hdr *ip;
+	int offload = eth_get_csum_offload();
+	unsigned udp_len, hdr_len = 0;
+	struct in_addr dst_ip, src_ip;
+	void *dest;
+
+	if (!udp_place_handler || len < ETHER_HDR_SIZE + IP_UDP_HDR_SIZE ||
+	    ntohs(et->et_protlen) != PROT_IP)
+		return NULL;
+	ip = (const struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	if (ip->ip_hl_v != 0x45 || ip->ip_p != IPPROTO_UDP ||
+	    ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG))
+		return NULL;
+	udp_len = ntohs(ip->udp_len);
+	if (ntohs(ip->ip_len) > len - ETHER_HDR_SIZE ||
+	    udp_len < UDP_HDR_SIZE || udp_len > ntohs(ip->ip_len) - IP_HDR_SIZE)
+		return NULL;
+	if (!(offload & ETH_CSUM_RX_IP) && !ip_checksum_ok(ip, IP_HDR_SIZE))
+		return NULL;
+#ifdef CONFIG_UDP_CHECKSUM
+	if (ip->udp_xsum && !(offload & ETH_CSUM_RX_UDP))
+		return NULL;
+#endif
+	dst_ip = net_read_ip((void *)&ip->ip_dst);
+	if (net_ip.s_addr && dst_ip.s_addr != net_ip.s_addr)
+		return NULL;
+
+	src_ip = net_read_ip((void *)&ip->ip_src);
+	dest = udp_place_handler((uchar *)ip + IP_UDP_HDR_SIZE,
+				 ntohs(ip->udp_dst), src_ip,
+				 ntohs(ip->udp_src), udp_len - UDP_HDR_SIZE,
+				 &hdr_len);
+	if (!dest || hdr_len > udp_len - UDP_HDR_SIZE)
+		return NULL;
+	*offsetp = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + hdr_len;
+	*sizep = udp_len - UDP_HDR_SIZE - hdr_len;
+
+	return dest;
 }
 
 rxhand_f *net_get_arp_handler(void)
@@ -799,6 +865,37 @@ void net_set_timeout_handler(ulong iv, thand_f *f)
 	}
 }
 
+/*
+ * Send the frame in net_tx_packet, first resolving the destination MAC
+ * address with ARP if it is not known yet
+ */
+static int net_send_ip_frame(uchar *ether, struct in_addr dest, int size,
+			     const char *what)
+{
+	/* if MAC address was not discovered yet, do an ARP request */
+	if (memcmp(ether, net_null_ethaddr, 6) == 0) {
+		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
+
+		/* save the ip and eth addr for the packet to send after arp */
+		net_arp_wait_packet_ip = dest;
+		arp_wait_packet_ethaddr = ether;
+
+		/* size of the waiting packet */
+		arp_wait_tx_packet_size = size;
+
+		/* and do the ARP request */
+		arp_wait_try = 1;
+		arp_wait_timer_start = get_timer(0);
+		arp_request();
+		return 1;	/* waiting */
+	} else {
+		debug_cond(DEBUG_DEV_PKT, "sending %s to %pI4/%pM\n",
+			   what, &dest, ether);
+		net_send_packet(net_tx_packet, size);
+		return 0;	/* transmitted */
+	}
+}
+
 int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 		int payload_len)
 {
@@ -826,28 +923,31 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 	net_set_udp_header(pkt, dest, dport, sport, payload_len);
 	pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 
-	/* if MAC address was not discovered yet, do an ARP request */
-	if (memcmp(ether, net_null_ethaddr, 6) == 0) {
-		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
+	return net_send_ip_frame(ether, dest, pkt_hdr_size + payload_len,
+				 "UDP");
+}
 
-		/* save the ip and eth addr for the packet to send after arp */
-		net_arp_wait_packet_ip = dest;
-		arp_wait_packet_ethaddr = ether;
+int net_send_ip_packet(uchar *ether, struct in_addr dest, int proto,
+		       int payload_len)
+{
+	struct ip_udp_hdr *ip;
+	int eth_hdr_size;
 
-		/* size of the waiting packet */
-		arp_wait_tx_packet_size = pkt_hdr_size + payload_len;
+	assert(net_tx_packet != NULL);
+	if (net_tx_packet == NULL)
+		return -1;
 
-		/* and do the ARP request */
-		arp_wait_try = 1;
-		arp_wait_timer_start = get_timer(0);
-		arp_request();
-		return 1;	/* waiting */
-	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
-			   &dest, ether);
-		net_send_packet(net_tx_packet, pkt_hdr_size + payload_len);
-		return 0;	/* transmitted */
-	}
+	eth_hdr_size = net_set_ether(net_tx_packet, ether, PROT_IP);
+	ip = (struct ip_udp_hdr *)(net_tx_packet + eth_hdr_size);
+	net_set_ip_header((uchar *)ip, dest, net_ip);
+	ip->ip_len = htons(IP_HDR_SIZE + payload_len);
+	ip->ip_p = proto;
+	if (!(eth_get_csum_offload() & ETH_CSUM_TX_IP))
+		ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+
+	return net_send_ip_frame(ether, dest,
+				 eth_hdr_size + IP_HDR_SIZE + payload_len,
+				 "IP");
 }
 
 #ifdef CONFIG_IP_DEFRAG
@@ -1053,6 +1153,7 @@ void net_process_received_packet(uchar *in_packet, int len)
 {
 	struct ethernet_hdr *et;
 	struct ip_udp_hdr *ip;
+	struct ip_udp_hdr *orig_ip __maybe_unused;
 	struct in_addr dst_ip;
 	struct in_addr src_ip;
 	int eth_proto;
@@ -1183,8 +1284,9 @@ void net_process_received_packet(uchar *in_packet, int len)
 		/* Can't deal with IP options (headers != 20 bytes) */
 		if ((ip->ip_hl_v & 0x0f) > 0x05)
 			return;
-		/* Check the Checksum of the header */
-		if (!ip_checksum_ok((uchar *)ip, IP_HDR_SIZE)) {
+		/* Check the Checksum of the header, unless the hardware did */
+		if (!(eth_get_csum_offload() & ETH_CSUM_RX_IP) &&
+		    !ip_checksum_ok((uchar *)ip, IP_HDR_SIZE)) {
 			debug("checksum bad\n");
 			return;
 		}
@@ -1199,6 +1301,7 @@ void net_process_received_packet(uchar *in_packet, int len)
 		}
 		/* Read source IP address for later use */
 		src_ip = net_read_ip(&ip->ip_src);
+		orig_ip = ip;
 		/*
 		 * The function returns the unchanged packet if it's not
 		 * a fragment, and either the complete packet or NULL if
@@ -1231,6 +1334,11 @@ void net_process_received_packet(uchar *in_packet, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#ifdef CONFIG_PROT_TCP
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			tcp_receive(ip, len);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1240,42 +1348,18 @@ void net_process_received_packet(uchar *in_packet, int len)
 			   &dst_ip, &src_ip, len);
 
 #ifdef CONFIG_UDP_CHECKSUM
-		if (ip->udp_xsum != 0) {
-			ulong   xsum;
-			ushort *sumptr;
-			ushort  sumlen;
-
-			xsum  = ip->ip_p;
-			xsum += (ntohs(ip->udp_len));
-			xsum += (ntohl(ip->ip_src.s_addr) >> 16) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_src.s_addr) >>  0) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_dst.s_addr) >> 16) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_dst.s_addr) >>  0) & 0x0000ffff;
-
-			sumlen = ntohs(ip->udp_len);
-			sumptr = (ushort *)&(ip->udp_src);
-
-			while (sumlen > 1) {
-				ushort sumdata;
-
-				sumdata = *sumptr++;
-				xsum += ntohs(sumdata);
-				sumlen -= 2;
-			}
-			if (sumlen > 0) {
-				ushort sumdata;
-
-				sumdata = *(unsigned char *)sumptr;
-				sumdata = (sumdata << 8) & 0xff00;
-				xsum += sumdata;
-			}
-			while ((xsum >> 16) != 0) {
-				xsum = (xsum & 0x0000ffff) +
-				       ((xsum >> 16) & 0x0000ffff);
-			}
-			if ((xsum != 0x00000000) && (xsum != 0x0000ffff)) {
-				printf(" UDP wrong checksum %08lx %08x\n",
-				       xsum, ntohs(ip->udp_xsum));
+		/*
+		 * Hardware can only check datagrams which arrived whole, so
+		 * reassembled ones are always checked here
+		 */
+		if (ip->udp_xsum != 0 &&
+		    (ip != orig_ip ||
+		     !(eth_get_csum_offload() & ETH_CSUM_RX_UDP))) {
+			if (ntohs(ip->udp_len) < UDP_HDR_SIZE ||
+			    ntohs(ip->udp_len) > len - IP_HDR_SIZE ||
+			    compute_udp_checksum(ip)) {
+				printf(" UDP wrong checksum %04x\n",
+				       ntohs(ip->udp_xsum));
 				return;
 			}
 		}
@@ -1337,6 +1421,9 @@ static int net_check_prereq(enum proto_t protocol)
 #endif
 #if defined(CONFIG_CMD_NFS)
 	case NFS:
+#endif
+#if defined(CONFIG_CMD_WGET)
+	case WGET:
 #endif
 		/* Fall through */
 	case TFTPGET:
@@ -1492,7 +1579,9 @@ void net_set_udp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
 	net_set_ip_header(pkt, dest, net_ip);
 	ip->ip_len   = htons(IP_UDP_HDR_SIZE + len);
 	ip->ip_p     = IPPROTO_UDP;
-	ip->ip_sum   = compute_ip_checksum(ip, IP_HDR_SIZE);
+	/* Checksums offloaded to the hardware are left as 0 for it to fill */
+	if (!(eth_get_csum_offload() & ETH_CSUM_TX_IP))
+		ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
 
 	ip->udp_src  = htons(sport);
 	ip->udp_dst  = htons(dport);
@@ -1539,7 +1628,8 @@ int net_parse_bootfile(struct in_addr *ipaddr, char *filename, int max_len)
 
 #if	defined(CONFIG_CMD_NFS)		|| \
 	defined(CONFIG_CMD_SNTP)	|| \
-	defined(CONFIG_CMD_DNS)
+	defined(CONFIG_CMD_DNS)		|| \
+	defined(CONFIG_PROT_TCP)
 /*
  * make port a little random (1024-17407)
  * This keeps the math somewhat trivial to compute, and seems to work with
@@ -45,12 +45,49 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* Largest number of READ requests that can be outstanding */
+#define NFS_READ_WINDOW_MAX	16
+/* Resend a request once this many later ones have been answered */
+#define NFS_READ_OVERTAKEN	3
+
 static int fs_mounted;
 static unsigned long rpc_id;
 static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/**
+ * struct nfs_read_slot - an outstanding READ request
+ *
+ * @xid:	RPC id of the request, 0 if the slot is free
+ * @offset:	File offset requested
+ * @len:	Number of bytes requested
+ * @sent:	get_timer() value when the request was sent
+ * @seq:	Order in which the request was sent
+ * @overtaken:	Number of replies received to requests sent after this one
+ */
+struct nfs_read_slot {
+	ulong xid;
+	uint offset;
+	uint len;
+	ulong sent;
+	uint seq;
+	int overtaken;
+};
+
+/*
+ * Reads are pipelined: up to nfs_read_window READ requests for consecutive
+ * parts of the file are outstanding at once. Replies are matched to their
+ * request by RPC id and stored wherever they belong, so they may arrive in
+ * any order. nfs_offset is the next offset to be requested.
+ */
+static struct nfs_read_slot nfs_read_slots[NFS_READ_WINDOW_MAX];
+static const int nfs_read_window = CONFIG_NFS_READ_WINDOW;
+static uint nfs_read_size;
+static uint nfs_read_seq;
+static ulong nfs_read_bytes;	/* bytes received, for progress */
+static bool nfs_eof;		/* true if nfs_file_end is known */
+static uint nfs_file_end;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -170,7 +207,7 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static ulong rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 {
 	struct rpc_t rpc_pkt;
 	unsigned long id;
@@ -215,6 +252,8 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 
 	net_send_udp_packet(net_server_ethaddr, nfs_server_ip, sport,
 			    nfs_our_port, pktlen);
+
+	return id;
 }
 
 /**************************************************************************
@@ -356,7 +395,7 @@ static void nfs_lookup_req(char *fname)
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static ulong nfs_read_req(int offset, int readlen)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -383,7 +422,147 @@ static void nfs_read_req(int offset, int readlen)
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	return rpc_req(PROG_NFS, NFS_READ, data, len);
+}
+
+static void nfs_read_send(struct nfs_read_slot *slot)
+{
+	slot->xid = nfs_read_req(slot->offset, slot->len);
+	slot->sent = get_timer(0);
+	slot->seq = ++nfs_read_seq;
+	slot->overtaken = 0;
+}
+
+/* Start the read phase, with no requests outstanding */
+static void nfs_read_start(void)
+{
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+	nfs_offset = 0;
+	nfs_read_bytes = 0;
+	nfs_eof = false;
+	if (supported_nfs_versions & NFSV2_FLAG)
+		nfs_read_size = NFS_READ_SIZE;
+	else
+		nfs_read_size = NFS3_READ_SIZE;
+}
+
+/* Send new requests until the window is full or the end of file is reached */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		slot = &nfs_read_slots[i];
+		if (slot->xid)
+			continue;
+		if (nfs_eof && nfs_offset >= nfs_file_end)
+			break;
+		slot->offset = nfs_offset;
+		slot->len = nfs_read_size;
+		nfs_offset += nfs_read_size;
+		nfs_read_send(slot);
+	}
+}
+
+/**
+ * nfs_read_resend() - Send outstanding requests again
+ *
+ * @all:	true to resend all requests, false to resend only those that
+ *		have timed out or have been overtaken by later requests, which
+ *		probably means that the request or its reply was lost
+ */
+static void nfs_read_resend(bool all)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		slot = &nfs_read_slots[i];
+		if (!slot->xid)
+			continue;
+		if (all || slot->overtaken >= NFS_READ_OVERTAKEN ||
+		    get_timer(slot->sent) > nfs_timeout) {
+			debug("resend read at %x\n", slot->offset);
+			nfs_read_send(slot);
+		}
+	}
+}
+
+/* Check whether the whole file has been read */
+static bool nfs_read_done(void)
+{
+	int i;
+
+	if (!nfs_eof)
+		return false;
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_slots[i].xid)
+			return false;
+	}
+
+	return true;
+}
+
+static struct nfs_read_slot *nfs_read_find(ulong xid)
+{
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_slots[i].xid == xid)
+			return &nfs_read_slots[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * nfs_read_complete() - Update the window after a successful reply
+ *
+ * @slot:	Request that was answered
+ * @rlen:	Number of bytes returned
+ * @eof:	true if the server reported the end of the file
+ */
+static void nfs_read_complete(struct nfs_read_slot *slot, uint rlen,
+			      bool eof)
+{
+	struct nfs_read_slot *other;
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		other = &nfs_read_slots[i];
+		if (other->xid && other->seq < slot->seq)
+			other->overtaken++;
+	}
+
+	/*
+	 * NFSv2 has no end-of-file flag, so the end is found by reading
+	 * nothing. Requests from beyond the end need no answer.
+	 */
+	if (eof || !rlen) {
+		if (!nfs_eof || slot->offset + rlen < nfs_file_end)
+			nfs_file_end = slot->offset + rlen;
+		nfs_eof = true;
+		for (i = 0; i < nfs_read_window; i++) {
+			other = &nfs_read_slots[i];
+			if (other->xid && other->offset >= nfs_file_end)
+				other->xid = 0;
+		}
+	}
+
+	if (slot->xid && rlen < slot->len && !eof) {
+		/*
+		 * Short read, so ask for the rest. The server probably has a
+		 * lower limit than we asked for, so keep to that from now on.
+		 */
+		if (rlen && rlen < nfs_read_size)
+			nfs_read_size = rlen;
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_send(slot);
+	} else {
+		slot->xid = 0;
+	}
 }
 
 /**************************************************************************
@@ -416,7 +595,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend(true);
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -655,16 +834,20 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	struct nfs_read_slot *slot;
+	ulong prev_bytes;
+	uint offset;
+	bool eof = false;
 	int rlen;
-	uchar *data_ptr;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	/* Only the headers are needed here; the data is stored from pkt */
+	memcpy(&rpc_pkt.u.data[0], pkt, min_t(unsigned, len,
+					      sizeof(rpc_pkt.u.reply)));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	slot = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!slot)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -678,32 +861,41 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		offset = (uchar *)&rpc_pkt.u.reply.data[19] - rpc_pkt.u.data;
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset] != 0;
 		/* Skip unused values :
 			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		offset = (uchar *)&rpc_pkt.u.reply.data[4 + nfsv3_data_offset] -
+			rpc_pkt.u.data;
 	}
 
-	if (store_block(data_ptr, nfs_offset, rlen))
+	if (rlen < 0 || rlen > slot->len || offset + rlen > len)
+		return -NFS_RPC_DROP;
+
+	if (store_block(pkt + offset, slot->offset, rlen))
 			return -9999;
 
+	prev_bytes = nfs_read_bytes;
+	nfs_read_bytes += rlen;
+	if (prev_bytes / (NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE) !=
+	    nfs_read_bytes / (NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE))
+		puts("\n\t ");
+	if (prev_bytes / (NFS_READ_SIZE / 2 * 10) !=
+	    nfs_read_bytes / (NFS_READ_SIZE / 2 * 10))
+		putc('#');
+
+	nfs_read_complete(slot, rlen, eof);
+
 	return rlen;
 }
 
@@ -796,9 +988,8 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			nfs_send();
+			nfs_read_start();
+			nfs_read_fill();
 		}
 		break;
 
@@ -825,15 +1016,15 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0 && !nfs_read_done()) {
+			nfs_read_resend(false);
+			nfs_read_fill();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
 			if (rlen < 0)
 				debug("NFS READ error (%d)\n", rlen);
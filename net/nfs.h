@@ -44,6 +44,28 @@
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
 #define NFS_MAX_ATTRS	26
 
+/*
+ * NFSv3 has no protocol limit on the read size. When IP fragments are
+ * reassembled, ask for as much as fits in a reassembled datagram, leaving
+ * room for the RPC, UDP and IP headers.
+ */
+#ifdef CONFIG_IP_DEFRAG
+# ifndef CONFIG_NET_MAXDEFRAG
+#  define NFS3_READ_SIZE	8192	/* net.c defaults to 16384 */
+# elif CONFIG_NET_MAXDEFRAG >= 32768 + 512
+#  define NFS3_READ_SIZE	32768
+# elif CONFIG_NET_MAXDEFRAG >= 16384 + 512
+#  define NFS3_READ_SIZE	16384
+# elif CONFIG_NET_MAXDEFRAG >= 8192 + 512
+#  define NFS3_READ_SIZE	8192
+# elif CONFIG_NET_MAXDEFRAG >= 4096 + 512
+#  define NFS3_READ_SIZE	4096
+# endif
+#endif
+#ifndef NFS3_READ_SIZE
+# define NFS3_READ_SIZE	NFS_READ_SIZE
+#endif
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
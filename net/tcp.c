@@ -0,0 +1,649 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Minimal TCP client
+ *
+ * This handles a single connection at a time, opened by us, which is all a
+ * download over HTTP needs. The receive side advertises a window of
+ * CONFIG_TCP_RCV_WINDOW bytes so that the server can keep many segments in
+ * flight. Received data is handed to the protocol straight away, including
+ * segments that arrive after a gap, and the ranges stored beyond the gap
+ * are remembered so that the acknowledgement can jump past them once the
+ * gap is filled. A gap is reported with an immediate duplicate ACK, which
+ * makes the server resend the missing segment without waiting for its
+ * retransmission timer (fast retransmit). SACK is not supported.
+ *
+ * The send side only has to carry a short request, so it keeps a small
+ * buffer of unacknowledged data which is resent when the retransmission
+ * timer (RFC 6298) expires or on the third duplicate ACK.
+ */
+
+#include <common.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <asm/unaligned.h>
+#include "net_rand.h"
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_FIN_WAIT,		/* we have closed, waiting for the peer */
+	TCP_LAST_ACK,		/* peer has closed, waiting for our FIN ACK */
+};
+
+#define TCP_TX_BUF_SIZE		1024
+#define TCP_OOO_MAX		8	/* out-of-order ranges remembered */
+#define TCP_RTO_INIT		1000	/* ms, RFC 6298 */
+#define TCP_RTO_MIN		200
+#define TCP_RTO_MAX		8000
+#define TCP_RETRIES		8
+#define TCP_DELACK		40	/* ms to wait before a lone ACK */
+#define TCP_IDLE_TIMEOUT	30000	/* ms without hearing from the peer */
+#define TCP_DUP_ACKS		3	/* duplicate ACKs for fast retransmit */
+
+static enum tcp_state tcp_state;
+static struct in_addr tcp_remote_ip;
+static uchar tcp_remote_ether[ARP_HLEN];
+static int tcp_lport, tcp_rport;
+static unsigned tcp_conn_count;
+static tcp_rx_f *tcp_rx_handler;
+static tcp_event_f *tcp_event_handler;
+
+/* Send state */
+static u32 tcp_snd_una;		/* oldest unacknowledged sequence number */
+static u32 tcp_snd_nxt;		/* next sequence number to send */
+static unsigned tcp_snd_wnd;	/* peer's receive window */
+static unsigned tcp_snd_mss;	/* peer's maximum segment size */
+static uchar tcp_tx_buf[TCP_TX_BUF_SIZE];	/* data from tcp_snd_una on */
+static unsigned tcp_tx_len;
+static bool tcp_fin_queued;	/* send a FIN after the data */
+static bool tcp_fin_sent;
+static int tcp_dup_acks;
+
+/* Receive state */
+static u32 tcp_irs;		/* peer's initial sequence number */
+static u32 tcp_rcv_nxt;		/* next sequence number expected */
+static int tcp_ack_owed;	/* segments received but not acknowledged */
+static struct {
+	u32 start;
+	u32 end;
+} tcp_ooo[TCP_OOO_MAX];		/* stored ranges beyond tcp_rcv_nxt, sorted */
+static int tcp_ooo_count;
+
+/* Timers, all in ms from get_timer() */
+static ulong tcp_rto;
+static ulong tcp_srtt, tcp_rttvar;	/* scaled by 8 and 4 */
+static ulong tcp_rto_start;
+static int tcp_retries;
+static bool tcp_rtt_timing;
+static u32 tcp_rtt_seq;
+static ulong tcp_rtt_start;
+static ulong tcp_delack_start;
+static ulong tcp_idle_start;
+
+static inline bool seq_lt(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static inline bool seq_le(u32 a, u32 b)
+{
+	return (s32)(a - b) <= 0;
+}
+
+unsigned tcp_checksum(struct in_addr src, struct in_addr dst,
+		      const void *tcp, unsigned len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} pseudo;
+	unsigned sum;
+
+	pseudo.src = src;
+	pseudo.dst = dst;
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(len);
+	sum = compute_ip_checksum(&pseudo, sizeof(pseudo));
+
+	return add_ip_checksums(sizeof(pseudo), sum,
+				compute_ip_checksum(tcp, len));
+}
+
+static void tcp_send_segment(u8 flags, u32 seq, const void *data,
+			     unsigned len)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_HDR_SIZE;
+	struct tcp_hdr *tcp = (struct tcp_hdr *)pkt;
+	unsigned hlen = TCP_HDR_SIZE;
+
+	if (flags & TCP_SYN) {
+		/* Tell the server how large a segment we can take */
+		pkt[hlen++] = TCP_OPT_MSS;
+		pkt[hlen++] = 4;
+		put_unaligned_be16(TCP_MSS, pkt + hlen);
+		hlen += 2;
+	}
+	if (len)
+		memcpy(pkt + hlen, data, len);
+
+	tcp->tcp_src = htons(tcp_lport);
+	tcp->tcp_dst = htons(tcp_rport);
+	tcp->tcp_seq = htonl(seq);
+	tcp->tcp_ack = flags & TCP_ACK ? htonl(tcp_rcv_nxt) : 0;
+	tcp->tcp_hlen = (hlen / 4) << 4;
+	tcp->tcp_flags = flags;
+	tcp->tcp_win = htons(CONFIG_TCP_RCV_WINDOW);
+	tcp->tcp_xsum = 0;
+	tcp->tcp_urg = 0;
+	tcp->tcp_xsum = tcp_checksum(net_ip, tcp_remote_ip, tcp, hlen + len);
+
+	if (flags & TCP_ACK)
+		tcp_ack_owed = 0;
+	net_send_ip_packet(tcp_remote_ether, tcp_remote_ip, IPPROTO_TCP,
+			   hlen + len);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+static void tcp_finish(enum tcp_event event)
+{
+	tcp_event_f *handler = tcp_event_handler;
+
+	tcp_state = TCP_CLOSED;
+	tcp_rx_handler = NULL;
+	tcp_event_handler = NULL;
+	net_set_timeout_handler(0, NULL);
+	if (handler)
+		handler(event);
+}
+
+static bool tcp_outstanding(void)
+{
+	return tcp_snd_una != tcp_snd_nxt;
+}
+
+static void tcp_timeout_handler(void);
+
+/* Arm the net_loop() timer for whichever of our timers expires first */
+static void tcp_update_timer(void)
+{
+	ulong now = get_timer(0);
+	ulong next = tcp_idle_start + TCP_IDLE_TIMEOUT;
+
+	if (tcp_state == TCP_CLOSED)
+		return;
+	if (tcp_outstanding() && tcp_rto_start + tcp_rto < next)
+		next = tcp_rto_start + tcp_rto;
+	if (tcp_ack_owed && tcp_delack_start + TCP_DELACK < next)
+		next = tcp_delack_start + TCP_DELACK;
+
+	net_set_timeout_handler(next > now ? next - now : 1,
+				tcp_timeout_handler);
+}
+
+/* Send whatever new data and FIN the peer's window allows */
+static void tcp_output(void)
+{
+	unsigned sent, len;
+
+	if (tcp_state == TCP_SYN_SENT || tcp_state == TCP_CLOSED)
+		return;
+
+	sent = tcp_snd_nxt - tcp_snd_una;
+	if (tcp_fin_sent)
+		return;
+	while (sent < tcp_tx_len && sent < tcp_snd_wnd) {
+		len = min(tcp_tx_len - sent, tcp_snd_mss);
+		len = min(len, tcp_snd_wnd - sent);
+		if (!tcp_outstanding())
+			tcp_rto_start = get_timer(0);
+		if (!tcp_rtt_timing) {
+			tcp_rtt_timing = true;
+			tcp_rtt_seq = tcp_snd_nxt + len;
+			tcp_rtt_start = get_timer(0);
+		}
+		tcp_send_segment(TCP_ACK | TCP_PSH, tcp_snd_nxt,
+				 tcp_tx_buf + sent, len);
+		tcp_snd_nxt += len;
+		sent += len;
+	}
+	if (tcp_fin_queued && sent == tcp_tx_len) {
+		if (!tcp_outstanding())
+			tcp_rto_start = get_timer(0);
+		tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_nxt, NULL, 0);
+		tcp_snd_nxt++;
+		tcp_fin_sent = true;
+	}
+}
+
+/* Resend the oldest unacknowledged segment */
+static void tcp_retransmit(void)
+{
+	unsigned len;
+
+	/* Karn's algorithm: don't time retransmitted segments */
+	tcp_rtt_timing = false;
+	tcp_rto_start = get_timer(0);
+
+	if (tcp_state == TCP_SYN_SENT) {
+		tcp_send_segment(TCP_SYN, tcp_snd_una, NULL, 0);
+	} else if (tcp_tx_len) {
+		len = min(tcp_tx_len, tcp_snd_mss);
+		len = min(len, tcp_snd_nxt - tcp_snd_una);
+		tcp_send_segment(TCP_ACK | TCP_PSH, tcp_snd_una, tcp_tx_buf,
+				 len);
+	} else if (tcp_fin_sent) {
+		tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_una, NULL, 0);
+	}
+}
+
+static void tcp_timeout_handler(void)
+{
+	ulong now = get_timer(0);
+
+	if (tcp_ack_owed && now - tcp_delack_start >= TCP_DELACK)
+		tcp_send_ack();
+
+	if (tcp_outstanding() && now - tcp_rto_start >= tcp_rto) {
+		if (++tcp_retries > TCP_RETRIES) {
+			tcp_finish(TCP_EV_TIMEOUT);
+			return;
+		}
+		debug_cond(DEBUG_DEV_PKT, "tcp: retransmit, rto %lu\n",
+			   tcp_rto);
+		tcp_rto = min_t(ulong, tcp_rto * 2, TCP_RTO_MAX);
+		tcp_retransmit();
+	} else if (now - tcp_idle_start >= TCP_IDLE_TIMEOUT) {
+		tcp_finish(TCP_EV_TIMEOUT);
+		return;
+	}
+
+	tcp_update_timer();
+}
+
+/* Update the retransmission timeout from a round-trip sample (RFC 6298) */
+static void tcp_rtt_sample(ulong rtt)
+{
+	if (!tcp_srtt) {
+		tcp_srtt = rtt << 3;
+		tcp_rttvar = rtt << 1;
+	} else {
+		long err = rtt - (tcp_srtt >> 3);
+
+		tcp_srtt += err;
+		if (err < 0)
+			err = -err;
+		tcp_rttvar += err - (tcp_rttvar >> 2);
+	}
+	tcp_rto = (tcp_srtt >> 3) + max_t(ulong, tcp_rttvar, 1);
+	tcp_rto = clamp_t(ulong, tcp_rto, TCP_RTO_MIN, TCP_RTO_MAX);
+}
+
+static void tcp_parse_options(const uchar *opt, unsigned len)
+{
+	unsigned i = 0;
+
+	while (i < len && opt[i] != TCP_OPT_END) {
+		if (opt[i] == TCP_OPT_NOP) {
+			i++;
+			continue;
+		}
+		if (i + 1 >= len || opt[i + 1] < 2 || i + opt[i + 1] > len)
+			break;
+		if (opt[i] == TCP_OPT_MSS && opt[i + 1] == 4)
+			tcp_snd_mss = min_t(unsigned,
+					    get_unaligned_be16(opt + i + 2),
+					    TCP_MSS);
+		i += opt[i + 1];
+	}
+}
+
+static void tcp_process_ack(u32 ack, unsigned wnd, bool has_data)
+{
+	unsigned acked;
+
+	if (seq_lt(tcp_snd_nxt, ack)) {
+		/* Acknowledges something we never sent */
+		tcp_send_ack();
+		return;
+	}
+
+	if (seq_lt(tcp_snd_una, ack)) {
+		acked = ack - tcp_snd_una;
+		if (tcp_fin_sent && ack == tcp_snd_nxt)
+			acked--;	/* the FIN is not in the buffer */
+		acked = min(acked, tcp_tx_len);
+		tcp_tx_len -= acked;
+		memmove(tcp_tx_buf, tcp_tx_buf + acked, tcp_tx_len);
+
+		if (tcp_rtt_timing && seq_le(tcp_rtt_seq, ack)) {
+			tcp_rtt_timing = false;
+			tcp_rtt_sample(get_timer(0) - tcp_rtt_start);
+		}
+		tcp_snd_una = ack;
+		tcp_retries = 0;
+		tcp_dup_acks = 0;
+		tcp_rto_start = get_timer(0);
+	} else if (ack == tcp_snd_una && tcp_outstanding() && !has_data &&
+		   wnd == tcp_snd_wnd) {
+		if (++tcp_dup_acks == TCP_DUP_ACKS) {
+			debug_cond(DEBUG_DEV_PKT, "tcp: fast retransmit\n");
+			tcp_retransmit();
+		}
+	}
+	tcp_snd_wnd = wnd;
+}
+
+/* Add a stored range beyond the gap, merging it with its neighbours */
+static bool tcp_ooo_add(u32 start, u32 end)
+{
+	int i, j;
+
+	for (i = 0; i < tcp_ooo_count && seq_lt(tcp_ooo[i].end, start); i++)
+		;
+	if (i < tcp_ooo_count && seq_le(tcp_ooo[i].start, end)) {
+		/* Overlaps or touches range i, and possibly later ones */
+		if (seq_lt(start, tcp_ooo[i].start))
+			tcp_ooo[i].start = start;
+		if (seq_lt(tcp_ooo[i].end, end))
+			tcp_ooo[i].end = end;
+		for (j = i + 1; j < tcp_ooo_count &&
+		     seq_le(tcp_ooo[j].start, tcp_ooo[i].end); j++)
+			if (seq_lt(tcp_ooo[i].end, tcp_ooo[j].end))
+				tcp_ooo[i].end = tcp_ooo[j].end;
+		memmove(&tcp_ooo[i + 1], &tcp_ooo[j],
+			(tcp_ooo_count - j) * sizeof(tcp_ooo[0]));
+		tcp_ooo_count -= j - i - 1;
+		return true;
+	}
+	if (tcp_ooo_count == TCP_OOO_MAX)
+		return false;
+	memmove(&tcp_ooo[i + 1], &tcp_ooo[i],
+		(tcp_ooo_count - i) * sizeof(tcp_ooo[0]));
+	tcp_ooo[i].start = start;
+	tcp_ooo[i].end = end;
+	tcp_ooo_count++;
+
+	return true;
+}
+
+/* Move tcp_rcv_nxt past any stored ranges that the new data has reached */
+static void tcp_ooo_advance(void)
+{
+	while (tcp_ooo_count && seq_le(tcp_ooo[0].start, tcp_rcv_nxt)) {
+		if (seq_lt(tcp_rcv_nxt, tcp_ooo[0].end))
+			tcp_rcv_nxt = tcp_ooo[0].end;
+		tcp_ooo_count--;
+		memmove(&tcp_ooo[0], &tcp_ooo[1],
+			tcp_ooo_count * sizeof(tcp_ooo[0]));
+	}
+}
+
+static bool tcp_ooo_has(u32 start, u32 end)
+{
+	int i;
+
+	for (i = 0; i < tcp_ooo_count; i++)
+		if (seq_le(tcp_ooo[i].start, start) &&
+		    seq_le(end, tcp_ooo[i].end))
+			return true;
+
+	return false;
+}
+
+static void tcp_receive_data(u32 seq, const uchar *data, unsigned len)
+{
+	u32 end = seq + len;
+	u32 wnd_end = tcp_rcv_nxt + CONFIG_TCP_RCV_WINDOW;
+	bool had_gap = tcp_ooo_count;
+
+	/* Trim anything we already have, or that lies outside the window */
+	if (seq_le(end, tcp_rcv_nxt) || seq_le(wnd_end, seq)) {
+		tcp_send_ack();
+		return;
+	}
+	if (seq_lt(seq, tcp_rcv_nxt)) {
+		data += tcp_rcv_nxt - seq;
+		seq = tcp_rcv_nxt;
+	}
+	if (seq_lt(wnd_end, end))
+		end = wnd_end;
+	len = end - seq;
+
+	if (seq != tcp_rcv_nxt) {
+		/*
+		 * Keep data that arrives after a gap if there is room to note
+		 * it, and ask for the missing segment with a duplicate ACK
+		 */
+		if (!tcp_ooo_has(seq, end) && tcp_rx_handler &&
+		    !tcp_rx_handler(data, seq - tcp_irs - 1, len) &&
+		    tcp_state != TCP_CLOSED && !tcp_ooo_add(seq, end))
+			debug_cond(DEBUG_DEV_PKT, "tcp: too many gaps\n");
+		/* The handler may have aborted the connection */
+		if (tcp_state != TCP_CLOSED)
+			tcp_send_ack();
+		return;
+	}
+
+	if (tcp_rx_handler && tcp_rx_handler(data, seq - tcp_irs - 1, len))
+		return;
+	if (tcp_state == TCP_CLOSED)
+		return;
+	tcp_rcv_nxt = end;
+	tcp_ooo_advance();
+
+	/* Acknowledge every other segment, and any filled gap at once */
+	if (had_gap || ++tcp_ack_owed >= 2) {
+		tcp_send_ack();
+	} else {
+		tcp_delack_start = get_timer(0);
+	}
+}
+
+static void tcp_receive_fin(u32 seq)
+{
+	if (seq != tcp_rcv_nxt) {
+		/* Some data before the FIN is still missing */
+		tcp_send_ack();
+		return;
+	}
+	tcp_rcv_nxt++;
+
+	if (tcp_state == TCP_ESTABLISHED) {
+		tcp_state = TCP_LAST_ACK;
+		tcp_fin_queued = true;
+		tcp_output();
+		if (!tcp_fin_sent)
+			tcp_send_ack();
+	} else {
+		/* We closed first, so we are done; skip TIME-WAIT */
+		tcp_send_ack();
+		tcp_finish(TCP_EV_CLOSED);
+	}
+}
+
+void tcp_receive(struct ip_udp_hdr *ip, unsigned len)
+{
+	struct tcp_hdr *tcp = (struct tcp_hdr *)((uchar *)ip + IP_HDR_SIZE);
+	struct in_addr src_ip, dst_ip;
+	unsigned hlen, dlen;
+	u32 seq, ack;
+	u8 flags;
+
+	if (tcp_state == TCP_CLOSED || len < IP_HDR_SIZE + TCP_HDR_SIZE)
+		return;
+	len -= IP_HDR_SIZE;
+	hlen = (tcp->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || hlen > len)
+		return;
+
+	src_ip = net_read_ip(&ip->ip_src);
+	dst_ip = net_read_ip(&ip->ip_dst);
+	if (src_ip.s_addr != tcp_remote_ip.s_addr ||
+	    ntohs(tcp->tcp_src) != tcp_rport ||
+	    ntohs(tcp->tcp_dst) != tcp_lport)
+		return;
+	if (tcp_checksum(src_ip, dst_ip, tcp, len)) {
+		debug_cond(DEBUG_DEV_PKT, "tcp: bad checksum\n");
+		return;
+	}
+
+	flags = tcp->tcp_flags;
+	seq = ntohl(tcp->tcp_seq);
+	ack = ntohl(tcp->tcp_ack);
+	dlen = len - hlen;
+	tcp_idle_start = get_timer(0);
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if (!(flags & TCP_ACK) || ack != tcp_snd_nxt)
+			return;
+		if (flags & TCP_RST) {
+			tcp_finish(TCP_EV_RESET);
+			return;
+		}
+		if (!(flags & TCP_SYN))
+			return;
+		tcp_irs = seq;
+		tcp_rcv_nxt = seq + 1;
+		tcp_snd_una = ack;
+		tcp_snd_wnd = ntohs(tcp->tcp_win);
+		tcp_parse_options((uchar *)tcp + TCP_HDR_SIZE,
+				  hlen - TCP_HDR_SIZE);
+		if (tcp_retries == 0)
+			tcp_rtt_sample(get_timer(0) - tcp_rtt_start);
+		tcp_rtt_timing = false;
+		tcp_retries = 0;
+		tcp_state = TCP_ESTABLISHED;
+
+		tcp_ack_owed = 1;
+		tcp_output();
+		if (tcp_event_handler)
+			tcp_event_handler(TCP_EV_CONNECTED);
+		if (tcp_ack_owed)
+			tcp_send_ack();
+		tcp_update_timer();
+		return;
+	}
+
+	if (flags & TCP_RST) {
+		/* Only believe a reset that is within our window */
+		if (seq_le(tcp_rcv_nxt, seq) &&
+		    seq_lt(seq, tcp_rcv_nxt + CONFIG_TCP_RCV_WINDOW))
+			tcp_finish(TCP_EV_RESET);
+		return;
+	}
+	if (flags & TCP_SYN) {
+		/* Our ACK of the SYN was lost, so send it again */
+		tcp_send_ack();
+		return;
+	}
+
+	if (flags & TCP_ACK) {
+		tcp_process_ack(ack, ntohs(tcp->tcp_win),
+				dlen || (flags & TCP_FIN));
+		if (tcp_state == TCP_LAST_ACK && tcp_fin_sent &&
+		    tcp_snd_una == tcp_snd_nxt) {
+			tcp_finish(TCP_EV_CLOSED);
+			return;
+		}
+	}
+
+	if (dlen)
+		tcp_receive_data(seq, (uchar *)tcp + hlen, dlen);
+	if ((flags & TCP_FIN) && tcp_state != TCP_CLOSED)
+		tcp_receive_fin(seq + dlen);
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	tcp_output();
+	tcp_update_timer();
+}
+
+void tcp_connect(struct in_addr dest, int dport, tcp_rx_f *rx,
+		 tcp_event_f *event)
+{
+	u32 iss;
+
+	tcp_remote_ip = dest;
+	memset(tcp_remote_ether, 0, sizeof(tcp_remote_ether));
+	tcp_rport = dport;
+	tcp_lport = 49152 + ((random_port() + ++tcp_conn_count) & 0x3fff);
+	tcp_rx_handler = rx;
+	tcp_event_handler = event;
+
+	/* Clock-driven initial sequence number, as in RFC 793 */
+	iss = seed_mac() + get_timer(0) * 250;
+	tcp_snd_una = iss;
+	tcp_snd_nxt = iss + 1;
+	tcp_snd_wnd = 0;
+	tcp_snd_mss = 536;	/* RFC 1122 default */
+	tcp_tx_len = 0;
+	tcp_fin_queued = false;
+	tcp_fin_sent = false;
+	tcp_dup_acks = 0;
+	tcp_rcv_nxt = 0;
+	tcp_ack_owed = 0;
+	tcp_ooo_count = 0;
+
+	tcp_rto = TCP_RTO_INIT;
+	tcp_srtt = 0;
+	tcp_rttvar = 0;
+	tcp_retries = 0;
+	tcp_rtt_timing = false;
+	tcp_rtt_start = get_timer(0);
+	tcp_rto_start = tcp_rtt_start;
+	tcp_idle_start = tcp_rtt_start;
+
+	tcp_state = TCP_SYN_SENT;
+	tcp_send_segment(TCP_SYN, iss, NULL, 0);
+	tcp_update_timer();
+}
+
+int tcp_send(const void *data, unsigned len)
+{
+	if (tcp_state != TCP_SYN_SENT && tcp_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+	if (tcp_fin_queued || len > sizeof(tcp_tx_buf) - tcp_tx_len)
+		return -ENOSPC;
+
+	memcpy(tcp_tx_buf + tcp_tx_len, data, len);
+	tcp_tx_len += len;
+	tcp_output();
+	tcp_update_timer();
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	if (tcp_state == TCP_SYN_SENT) {
+		tcp_abort();
+		return;
+	}
+	if (tcp_state != TCP_ESTABLISHED)
+		return;
+
+	tcp_state = TCP_FIN_WAIT;
+	tcp_fin_queued = true;
+	tcp_output();
+	tcp_update_timer();
+}
+
+void tcp_abort(void)
+{
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	if (tcp_state != TCP_SYN_SENT)
+		tcp_send_segment(TCP_RST | TCP_ACK, tcp_snd_nxt, NULL, 0);
+	tcp_event_handler = NULL;
+	tcp_finish(TCP_EV_RESET);
+}
@@ -29,6 +29,10 @@
 #endif
 /* Number of "loading" hashes per line (for checking the image size) */
 #define HASHES_PER_LINE	65
+/* Lower limit for the adaptive retransmit timeout, in millisecs (RFC 6298) */
+#define TFTP_RTO_MIN	1000UL
+/* Largest window we will ask for (RFC 7440) */
+#define TFTP_WINDOWSIZE_MAX	64
 
 /*
  *	TFTP operations.
@@ -44,6 +48,17 @@ static ulong timeout_ms = TIMEOUT;
 static int timeout_count_max = TIMEOUT_COUNT;
 static ulong time_start;   /* Record time we started tftp */
 
+/*
+ * Once data is flowing the retransmit timeout follows the measured round
+ * trip time from sending an ACK to receiving the next block, as TCP does
+ * (RFC 6298). timeout_ms is the upper limit and is what the server is told.
+ */
+static ulong tftp_rto;		/* current retransmit timeout (ms) */
+static long tftp_srtt;		/* smoothed round-trip time (ms << 3) */
+static long tftp_rttvar;	/* round-trip time variation (ms << 2) */
+static ulong tftp_ack_time;	/* when the ACK being timed was sent */
+static bool tftp_rtt_timing;	/* true if tftp_ack_time is valid */
+
 /*
  * These globals govern the timeout behavior when attempting a connection to a
  * TFTP server. tftp_timeout_ms specifies the number of milliseconds to
@@ -80,6 +95,13 @@ static ulong	tftp_prev_block;
 static ulong	tftp_block_wrap;
 /* memory offset due to wrapping */
 static ulong	tftp_block_wrap_offset;
+/* last block number we acknowledged */
+static ulong	tftp_last_ack;
+/* bit n is set if block tftp_prev_block + 2 + n is already stored */
+static u64	tftp_window_map;
+/* number of the final (short) block, if it has been received */
+static ushort	tftp_final_block;
+static bool	tftp_final_seen;
 static int	tftp_state;
 #ifdef CONFIG_TFTP_TSIZE
 /* The file size reported by the server */
@@ -133,6 +155,8 @@ static char tftp_filename[MAX_LEN];
 
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_windowsize_option = CONFIG_TFTP_WINDOWSIZE;
 
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
@@ -162,6 +186,8 @@ static void mcast_cleanup(void)
 	tftp_mcast_ending_block = -1;
 }
 
+#else
+#define tftp_mcast_active	0
 #endif	/* CONFIG_MCAST_TFTP */
 
 static inline void store_block(int block, uchar *src, unsigned len)
@@ -193,7 +219,11 @@ static inline void store_block(int block, uchar *src, unsigned len)
 	{
 		void *ptr = map_sysmem(load_addr + offset, len);
 
-		memcpy(ptr, src, len);
+		/* The driver may have put the data in place already */
+		if (!net_rx_payload)
+			memcpy(ptr, src, len);
+		else if (ptr != net_rx_payload)
+			memmove(ptr, net_rx_payload, len);
 		unmap_sysmem(ptr);
 	}
 #ifdef CONFIG_MCAST_TFTP
@@ -211,11 +241,46 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_last_ack = 0;
+	tftp_window_map = 0;
+	tftp_final_seen = false;
+	tftp_rtt_timing = false;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
 }
 
+/* Start the timeout clock at the beginning of a transfer */
+static void tftp_rtt_init(void)
+{
+	tftp_rto = timeout_ms;
+	tftp_srtt = 0;
+	tftp_rttvar = 0;
+	tftp_rtt_timing = false;
+}
+
+/* Update the retransmit timeout with a new round-trip time sample */
+static void tftp_rtt_sample(ulong rtt)
+{
+	long delta;
+
+	if (!tftp_srtt) {
+		tftp_srtt = (rtt << 3) ?: 1;
+		tftp_rttvar = rtt << 1;
+	} else {
+		delta = rtt - (tftp_srtt >> 3);
+		tftp_srtt += delta;
+		if (tftp_srtt <= 0)
+			tftp_srtt = 1;
+		if (delta < 0)
+			delta = -delta;
+		delta -= tftp_rttvar >> 2;
+		tftp_rttvar += delta;
+	}
+	tftp_rto = (tftp_srtt >> 3) + tftp_rttvar;
+	tftp_rto = clamp(tftp_rto, TFTP_RTO_MIN, timeout_ms);
+}
+
 #ifdef CONFIG_CMD_TFTPPUT
 /**
  * Load the next block from memory to be sent over tftp.
@@ -372,6 +437,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* and for more than one block per ACK (RFC 7440) */
+		if (tftp_state == STATE_SEND_RRQ && tftp_windowsize_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+				       0, tftp_windowsize_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -404,6 +473,9 @@ static void tftp_send(void)
 		s[0] = htons(TFTP_ACK);
 		s[1] = htons(tftp_cur_block);
 		pkt = (uchar *)(s + 2);
+		tftp_last_ack = tftp_cur_block;
+		tftp_ack_time = get_timer(0);
+		tftp_rtt_timing = true;
 #ifdef CONFIG_CMD_TFTPPUT
 		if (tftp_put_active) {
 			int toload = tftp_block_size;
@@ -457,6 +529,100 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/**
+ * tftp_window_block() - Handle a data block that arrived out of order
+ *
+ * With a window of more than one block the server sends several blocks per
+ * ACK. A block beyond the one we expect next means that one was lost. Store
+ * it straight away and remember that we have it, so that it is skipped when
+ * the gap is filled. The server is told about the gap by acknowledging the
+ * last block received in order, which makes it start the window again from
+ * there. Anything outside the window is a duplicate and is dropped.
+ *
+ * @block:	Block number from the packet
+ * @src:	Block data
+ * @len:	Length of the block data
+ */
+static void tftp_window_block(ushort block, uchar *src, unsigned len)
+{
+	ushort ahead = block - (ushort)(tftp_prev_block + 1);
+
+	if (ahead >= tftp_windowsize || tftp_window_map & (1ULL << (ahead - 1)))
+		return;
+
+	store_block(tftp_prev_block + ahead, src, len);
+	tftp_window_map |= 1ULL << (ahead - 1);
+	if (len < tftp_block_size) {
+		tftp_final_block = block;
+		tftp_final_seen = true;
+	}
+
+	/* Report each gap once; the timeout handles a lost retransmission */
+	if ((ushort)tftp_last_ack != (ushort)tftp_prev_block) {
+		tftp_cur_block = tftp_prev_block;
+		tftp_send();
+	}
+}
+
+/**
+ * tftp_window_advance() - Move past blocks that were stored out of order
+ *
+ * This is called when the next block in order has been stored.
+ *
+ * @return true if any blocks were skipped
+ */
+static bool tftp_window_advance(void)
+{
+	bool skipped = false;
+
+	while (tftp_window_map & 1) {
+		tftp_window_map >>= 1;
+		tftp_cur_block = (ushort)(tftp_prev_block + 1);
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+		skipped = true;
+	}
+	tftp_window_map >>= 1;
+
+	return skipped;
+}
+
+#ifndef CONFIG_SYS_DIRECT_FLASH_TFTP
+/**
+ * tftp_place() - Find where a data block should be received
+ *
+ * Blocks within the current window can go straight to their place in the
+ * file, so that store_block() need not copy them. Anything else, including
+ * a first block which starts the transfer without an OACK, is received as
+ * usual.
+ */
+static void *tftp_place(const uchar *pkt, unsigned dest, struct in_addr sip,
+			unsigned src, unsigned len, unsigned *hdr_lenp)
+{
+	ulong offset;
+	ushort ahead;
+
+	if (dest != tftp_our_port || src != tftp_remote_port ||
+	    tftp_state != STATE_DATA || tftp_put_active || len < 4 ||
+	    len - 4 > tftp_block_size || ntohs(*(__be16 *)pkt) != TFTP_DATA)
+		return NULL;
+#ifdef CONFIG_MCAST_TFTP
+	if (tftp_mcast_active)
+		return NULL;
+#endif
+	ahead = ntohs(*(__be16 *)(pkt + 2)) - (ushort)(tftp_prev_block + 1);
+	if (ahead >= tftp_windowsize)
+		return NULL;
+
+	/* This is the offset store_block() works out for the block */
+	offset = (tftp_prev_block + ahead) * tftp_block_size +
+		 tftp_block_wrap_offset;
+	*hdr_lenp = 4;
+
+	return map_sysmem(load_addr + offset, len - 4);
+}
+#endif
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
@@ -540,6 +706,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				/* The server may only reduce the window */
+				tftp_windowsize = clamp(tftp_windowsize,
+					(unsigned short)1,
+					tftp_windowsize_option);
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -562,12 +739,25 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_cur_block++;
 		}
 #endif
+		if (tftp_state == STATE_OACK && !tftp_mcast_active) {
+			/*
+			 * The transfer starts here. With a window, a later
+			 * block may arrive before block 1 if that is lost.
+			 */
+			tftp_state = STATE_DATA;
+			new_transfer();
+		}
 		tftp_send(); /* Send ACK or first data block */
 		break;
 	case TFTP_DATA:
 		if (len < 2)
 			return;
 		len -= 2;
+		if (tftp_windowsize > 1 && tftp_state == STATE_DATA &&
+		    ntohs(*(__be16 *)pkt) != (ushort)(tftp_prev_block + 1)) {
+			tftp_window_block(ntohs(*(__be16 *)pkt), pkt + 2, len);
+			break;
+		}
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
 		update_block_number();
@@ -604,9 +794,18 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		timeout_count = 0;
+		if (tftp_rtt_timing) {
+			tftp_rtt_sample(get_timer(tftp_ack_time));
+			tftp_rtt_timing = false;
+		}
+		net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
 
 		store_block(tftp_cur_block - 1, pkt + 2, len);
+		if (len < tftp_block_size) {
+			tftp_final_block = tftp_cur_block;
+			tftp_final_seen = true;
+		}
 
 		/*
 		 *	Acknowledge the block just received, which will prompt
@@ -638,6 +837,23 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 		}
 #endif
+		if (tftp_windowsize > 1) {
+			bool skipped = tftp_window_advance();
+			bool last = tftp_final_seen &&
+				tftp_final_block == (ushort)tftp_prev_block;
+
+			/*
+			 * Acknowledge at the end of each window, at the end
+			 * of the file and when filling a gap has moved us on
+			 */
+			if (last || skipped ||
+			    (ushort)(tftp_prev_block - tftp_last_ack) >=
+			    tftp_windowsize)
+				tftp_send();
+			if (last)
+				tftp_complete();
+			break;
+		}
 		tftp_send();
 
 #ifdef CONFIG_MCAST_TFTP
@@ -689,9 +905,14 @@ static void tftp_timeout_handler(void)
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		/* Back off, and do not time the retransmission (Karn) */
+		tftp_rto = min(tftp_rto * 2, timeout_ms);
+		net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
+		if (tftp_state == STATE_DATA && !tftp_put_active)
+			tftp_cur_block = tftp_prev_block;
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
+		tftp_rtt_timing = false;
 	}
 }
 
@@ -710,6 +931,12 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = env_get("tftpwindowsize");
+	if (ep != NULL)
+		tftp_windowsize_option = clamp_t(int,
+						 simple_strtol(ep, NULL, 10),
+						 1, TFTP_WINDOWSIZE_MAX);
+
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -731,8 +958,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_windowsize_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -802,8 +1029,12 @@ void tftp_start(enum proto_t protocol)
 	time_start = get_timer(0);
 	timeout_count_max = tftp_timeout_count_max;
 
+	tftp_rtt_init();
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 	net_set_udp_handler(tftp_handler);
+#ifndef CONFIG_SYS_DIRECT_FLASH_TFTP
+	net_set_udp_place_handler(tftp_place);
+#endif
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
 #endif
@@ -824,8 +1055,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -851,10 +1083,12 @@ void tftp_start_server(void)
 	timeout_count_max = tftp_timeout_count_max;
 	timeout_count = 0;
 	timeout_ms = TIMEOUT;
+	tftp_rtt_init();
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * HTTP download over TCP
+ *
+ * Fetch a file with a single HTTP/1.0 GET request and store the body at
+ * load_addr. The response headers must fit in a small buffer; only the
+ * status line, Content-Length and Transfer-Encoding are looked at. A server
+ * may not use a transfer coding such as chunked in reply to HTTP/1.0, so a
+ * response which does is refused rather than stored with the coding left
+ * in. The request asks the server to close the connection after the
+ * response, and TCP only reports the close once everything before it has
+ * arrived, so that marks the end of the body whether or not its length was
+ * given.
+ */
+
+#include <common.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tcp.h>
+#include "wget.h"
+
+#define WGET_HDR_MAX		1024	/* room for the response headers */
+#define WGET_HASH_BYTES		(64 << 10)	/* bytes per "loading" hash */
+#define HASHES_PER_LINE		65
+
+enum wget_state {
+	WGET_CONNECTING,
+	WGET_HEADERS,
+	WGET_BODY,
+	WGET_DONE,
+};
+
+static enum wget_state wget_state;
+static struct in_addr wget_server_ip;
+static char wget_path[512];
+static char wget_hdr[WGET_HDR_MAX + 1];
+static unsigned wget_hdr_len;
+static u32 wget_body_start;		/* stream offset of the body */
+static ulong wget_content_len;
+static bool wget_have_len;
+static ulong wget_body_len;		/* end of the body data so far */
+static int wget_hashes;
+
+static void wget_fail(const char *msg)
+{
+	printf("\n%s\n", msg);
+	wget_state = WGET_DONE;
+	tcp_abort();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_show_progress(void)
+{
+	while (wget_hashes < wget_body_len / WGET_HASH_BYTES) {
+		putc('#');
+		if (++wget_hashes % HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+}
+
+static int wget_store_body(const uchar *data, u32 offset, unsigned len)
+{
+	void *ptr;
+
+	if (wget_have_len) {
+		if (offset >= wget_content_len)
+			return 0;
+		len = min_t(ulong, len, wget_content_len - offset);
+	}
+
+	ptr = map_sysmem(load_addr + offset, len);
+	memcpy(ptr, data, len);
+	unmap_sysmem(ptr);
+
+	if (offset + len > wget_body_len) {
+		wget_body_len = offset + len;
+		net_boot_file_size = wget_body_len;
+		wget_show_progress();
+	}
+
+	return 0;
+}
+
+/* Parse the response headers, returning 0 if the body can follow */
+static int wget_parse_headers(void)
+{
+	char *line, *end;
+	int status;
+
+	line = strchr(wget_hdr, ' ');
+	if (strncmp(wget_hdr, "HTTP/1.", 7) || !line) {
+		wget_fail("Bad HTTP response");
+		return -EPROTO;
+	}
+	status = simple_strtoul(line + 1, NULL, 10);
+	if (status != 200) {
+		end = strstr(line, "\r\n");
+		*end = '\0';
+		printf("\nHTTP error:%s", line);
+		wget_fail("Download failed");
+		return -ENOENT;
+	}
+
+	wget_have_len = false;
+	for (line = strstr(wget_hdr, "\r\n"); line; line = end) {
+		line += 2;
+		end = strstr(line, "\r\n");
+		if (!strncasecmp(line, "Content-Length:", 15)) {
+			wget_content_len = simple_strtoul(line + 15, NULL, 10);
+			wget_have_len = true;
+		} else if (!strncasecmp(line, "Transfer-Encoding:", 18)) {
+			wget_fail("HTTP transfer encoding not supported");
+			return -EPROTONOSUPPORT;
+		}
+	}
+	if (wget_have_len)
+		debug("HTTP content length %lu\n", wget_content_len);
+
+	return 0;
+}
+
+static int wget_rx(const uchar *data, u32 offset, unsigned len)
+{
+	char *end;
+	unsigned take;
+	int ret;
+
+	if (wget_state == WGET_BODY) {
+		if (offset < wget_body_start) {
+			take = min(len, wget_body_start - offset);
+			offset += take;
+			data += take;
+			len -= take;
+		}
+		return len ? wget_store_body(data, offset - wget_body_start,
+					     len) : 0;
+	}
+	if (wget_state != WGET_HEADERS)
+		return 0;
+
+	/* Collect the headers in order, so refuse data beyond a gap */
+	if (offset != wget_hdr_len)
+		return -EAGAIN;
+	take = min(len, WGET_HDR_MAX - wget_hdr_len);
+	memcpy(wget_hdr + wget_hdr_len, data, take);
+	wget_hdr[wget_hdr_len + take] = '\0';
+	end = strstr(wget_hdr, "\r\n\r\n");
+	if (!end) {
+		wget_hdr_len += take;
+		if (wget_hdr_len == WGET_HDR_MAX)
+			wget_fail("HTTP headers too long");
+		return 0;
+	}
+
+	end[2] = '\0';
+	wget_body_start = end + 4 - wget_hdr;
+	ret = wget_parse_headers();
+	if (ret)
+		return ret;
+	wget_state = WGET_BODY;
+	if (offset + len > wget_body_start)
+		return wget_store_body(data + wget_body_start - offset, 0,
+				       offset + len - wget_body_start);
+
+	return 0;
+}
+
+static void wget_event(enum tcp_event event)
+{
+	char req[sizeof(wget_path) + 128];
+	int len;
+
+	switch (event) {
+	case TCP_EV_CONNECTED:
+		len = snprintf(req, sizeof(req),
+			       "GET %s HTTP/1.0\r\n"
+			       "Host: %pI4\r\n"
+			       "User-Agent: U-Boot\r\n"
+			       "Connection: close\r\n\r\n",
+			       wget_path, &wget_server_ip);
+		wget_state = WGET_HEADERS;
+		if (len >= sizeof(req) || tcp_send(req, len))
+			wget_fail("HTTP request too long");
+		break;
+	case TCP_EV_CLOSED:
+		if (wget_state != WGET_BODY ||
+		    (wget_have_len && wget_body_len != wget_content_len)) {
+			wget_fail("Connection closed before the end of the file");
+			break;
+		}
+		wget_state = WGET_DONE;
+		puts("\ndone\n");
+		net_set_state(NETLOOP_SUCCESS);
+		break;
+	case TCP_EV_RESET:
+		wget_fail("Connection reset by server");
+		break;
+	case TCP_EV_TIMEOUT:
+		wget_fail("Connection timed out");
+		break;
+	}
+}
+
+void wget_start(void)
+{
+	char *path = wget_path;
+	int port;
+
+	wget_server_ip = net_server_ip;
+	if (!net_parse_bootfile(&wget_server_ip, wget_path + 1,
+				sizeof(wget_path) - 1)) {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	/* Make sure the path is absolute */
+	if (wget_path[1] == '/')
+		path++;
+	else
+		wget_path[0] = '/';
+	if (path != wget_path)
+		memmove(wget_path, path, strlen(path) + 1);
+
+	port = env_get_ulong("httpdstp", 10, WGET_HTTP_PORT);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4:%d; our IP address is %pI4\n",
+	       &wget_server_ip, port, &net_ip);
+	printf("Filename '%s'.\n", wget_path);
+	printf("Load address: 0x%lx\nLoading: *\b", load_addr);
+
+	wget_state = WGET_CONNECTING;
+	wget_hdr_len = 0;
+	wget_body_len = 0;
+	wget_content_len = 0;
+	wget_have_len = false;
+	wget_hashes = 0;
+	net_boot_file_size = 0;
+
+	tcp_connect(wget_server_ip, port, wget_rx, wget_event);
+}
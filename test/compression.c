@@ -117,6 +117,23 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -19 -c /tmp/plain.txt > /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -292,6 +309,40 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	ut_asserteq(in_size, strlen(plain));
+	ut_asserteq(0, memcmp(plain, in, in_size));
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	int ret;
+	size_t output_size = out_max;
+
+	ret = zstd_decompress(in, in_size, out, &output_size);
+	if (out_size)
+		*out_size = output_size;
+
+	return (ret != 0);
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -436,6 +487,209 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
+/*
+ * Write the data held in zstd_multi_block[]: a run of random letters
+ * followed by copies of parts of it, each with one letter added
+ */
+static void zstd_test_data(u8 *buf, int size)
+{
+	u32 seed = 1;
+	int pos, i;
+	uint r;
+
+	for (pos = 0; pos < 300; pos++) {
+		seed = seed * 1103515245 + 12345;
+		buf[pos] = 'a' + ((seed >> 16) & 15);
+	}
+	while (pos < size) {
+		seed = seed * 1103515245 + 12345;
+		r = seed >> 16;
+		for (i = 0; i < 80 && pos < size; i++, pos++)
+			buf[pos] = buf[r % 300 + i];
+		if (pos < size)
+			buf[pos++] = 'a' + ((r >> 8) & 15);
+	}
+}
+
+/*
+ * zstd -6 --zstd=wlog=10 --no-check of 2100 bytes from zstd_test_data()
+ *
+ * The 1KiB window limits blocks to 1KiB, so there are three compressed
+ * blocks. The first has four-stream Huffman literals, the second reuses the
+ * Huffman table (treeless literals) and the third has raw literals. Between
+ * them the sequences use predefined, RLE, compressed and repeated tables.
+ */
+static const char zstd_multi_block[] =
+	"\x28\xb5\x2f\xfd\x40\x00\x34\x07\x64\x06\x00\x26\x53\x2b\x0b\xd0"
+	"\x0f\x24\x49\x92\x24\xc9\x07\x00\x28\x0f\x27\x00\x27\x00\x27\x00"
+	"\xec\x46\x6a\xae\xdd\x38\x6e\xff\x9f\xf9\x6e\x3a\x8c\x29\xba\xe5"
+	"\xf7\x45\x8c\x51\xb2\x63\x9a\x8c\x9a\x67\x77\x2f\xe6\xf1\x71\xc1"
+	"\xfc\x6d\xb4\xb2\xbb\xe1\x16\x3d\xbf\x71\x09\xef\xd1\x1b\x7c\x8c"
+	"\x45\xa8\xd6\x69\xf7\x16\x65\xc2\x81\xc2\x1e\x92\x38\x26\xa5\x6f"
+	"\x2d\x23\x89\xab\x3d\x9c\x05\x85\xf1\x0b\x10\xf6\xde\x19\x94\xb7"
+	"\xb0\x8c\x5a\xc6\xf7\x06\x60\xab\x9e\x0d\x4f\x9b\xee\x8f\x25\x75"
+	"\x11\x50\x23\x07\xf9\x13\x00\xba\x47\x18\x33\xa1\x46\x68\xfe\xee"
+	"\x3d\xdb\x5d\x0d\x11\x35\x94\xa3\x25\x7b\x52\xd1\x20\xf6\x9f\x4a"
+	"\x57\x1b\x16\xc8\xa3\xe5\x3a\x91\xc7\xe9\x1e\xdb\x30\xaa\x9e\x35"
+	"\x3c\x26\x34\x4b\xc0\x77\x75\x56\x80\x32\x12\x09\x04\x28\x79\xb9"
+	"\xa4\x03\x89\xf3\x62\x12\xcd\xbd\xd7\xfb\x1b\x8e\xb5\xd7\x34\xcb"
+	"\x3a\x0d\x81\xa5\x73\x66\x0a\x3c\x03\x00\x03\x45\x0a\x2d\xa6\xc3"
+	"\x98\xa2\x5b\x7e\x5f\xc4\x18\x25\x3b\xa6\xc9\xa8\x79\x76\xf7\x62"
+	"\x1e\x1f\x17\x5a\xf1\xcd\xb4\xda\x9d\xec\x46\x6a\xae\xdd\x38\x6e"
+	"\xff\x9f\xf9\xee\x83\x01\x12\x20\x10\x76\x18\xf3\x01\x68\x17\xc9"
+	"\xae\x10\x24\xf1\x79\x52\x10\xe3\x83\x08\x10\x99\x94\x85\xeb\x50"
+	"\x69\x97\xa3\x10\x3c\x13\x08\xfc\x5c\x86\x8e\x22\x62\x61\x28\x18"
+	"\xce\xbb\x27\xa1\x03\xc3\x9e\xa3\x09\x47\xa5\x49\x2f\x9e\xbb\x82"
+	"\x20\x55\x00\x00\x08\x67\x02\x30\x1c\x4f\x64\x8d\x1b\x08";
+#define ZSTD_MULTI_BLOCK_DATA	2100
+
+/*
+ * A frame written by hand: a raw block holding "raw block " then an RLE
+ * block of 200 'r' characters, with the content size in the header
+ */
+static const char zstd_raw_rle[] =
+	"\x28\xb5\x2f\xfd\x20\xd2"
+	"\x50\x00\x00" "raw block "
+	"\x43\x06\x00" "r";
+
+/* Decompress @src and check that it gives @expect */
+static int zstd_check(struct unit_test_state *uts, const void *src,
+		      size_t srcn, const u8 *expect, size_t size)
+{
+	size_t outn = size + 16;
+	u8 *out;
+
+	out = malloc(outn);
+	ut_assertnonnull(out);
+	ut_assertok(zstd_decompress(src, srcn, out, &outn));
+	ut_asserteq(size, outn);
+	ut_assertok(memcmp(expect, out, size));
+	free(out);
+
+	return 0;
+}
+
+/* Test zstd frames with each kind of block and literals section */
+static int compression_test_zstd_blocks(struct unit_test_state *uts)
+{
+	u8 expect[ZSTD_MULTI_BLOCK_DATA];
+	char buf[512];
+	size_t outn;
+	long ret;
+
+	memcpy(expect, "raw block ", 10);
+	memset(expect + 10, 'r', 200);
+	ut_assertok(zstd_check(uts, zstd_raw_rle, sizeof(zstd_raw_rle) - 1,
+			       expect, 210));
+
+	zstd_test_data(expect, sizeof(expect));
+	ut_assertok(zstd_check(uts, zstd_multi_block,
+			       sizeof(zstd_multi_block) - 1, expect,
+			       sizeof(expect)));
+
+	/* Frames one after the other make up one output */
+	memcpy(buf, zstd_raw_rle, sizeof(zstd_raw_rle) - 1);
+	memcpy(buf + sizeof(zstd_raw_rle) - 1, zstd_compressed,
+	       zstd_compressed_size);
+	memcpy(expect, "raw block ", 10);
+	memset(expect + 10, 'r', 200);
+	memcpy(expect + 210, plain, strlen(plain));
+	ut_assertok(zstd_check(uts, buf,
+			       sizeof(zstd_raw_rle) - 1 + zstd_compressed_size,
+			       expect, 210 + strlen(plain)));
+
+	/*
+	 * btrfs pads each compressed extent to a sector, which only
+	 * zstd_decompress_frame() allows for
+	 */
+	memcpy(buf, zstd_compressed, zstd_compressed_size);
+	memset(buf + zstd_compressed_size, '\0',
+	       sizeof(buf) - zstd_compressed_size);
+	outn = sizeof(expect);
+	ret = zstd_decompress_frame(buf, sizeof(buf), expect, &outn);
+	ut_asserteq(zstd_compressed_size, ret);
+	ut_asserteq(strlen(plain), outn);
+	ut_assertok(memcmp(plain, expect, outn));
+	outn = sizeof(expect);
+	ut_assert(zstd_decompress(buf, sizeof(buf), expect, &outn));
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_blocks, 0);
+
+/* Test that zstd reports an error for bad input rather than using it */
+static int compression_test_zstd_corrupt(struct unit_test_state *uts)
+{
+	char buf[sizeof(zstd_multi_block)];
+	u8 out[ZSTD_MULTI_BLOCK_DATA];
+	size_t outn;
+
+	/* Not a zstd frame */
+	memcpy(buf, zstd_raw_rle, sizeof(zstd_raw_rle));
+	buf[0] ^= 1;
+	outn = sizeof(out);
+	ut_asserteq(-EPROTONOSUPPORT,
+		    zstd_decompress(buf, sizeof(zstd_raw_rle) - 1, out, &outn));
+
+	/* Reserved bit set in the frame header */
+	memcpy(buf, zstd_raw_rle, sizeof(zstd_raw_rle));
+	buf[4] |= 8;
+	outn = sizeof(out);
+	ut_asserteq(-EINVAL,
+		    zstd_decompress(buf, sizeof(zstd_raw_rle) - 1, out, &outn));
+
+	/* Reserved block type */
+	memcpy(buf, zstd_raw_rle, sizeof(zstd_raw_rle));
+	buf[6] |= 6;
+	outn = sizeof(out);
+	ut_asserteq(-EPROTO,
+		    zstd_decompress(buf, sizeof(zstd_raw_rle) - 1, out, &outn));
+
+	/* Content size in the header does not match the data */
+	memcpy(buf, zstd_raw_rle, sizeof(zstd_raw_rle));
+	buf[5]++;
+	outn = sizeof(out);
+	ut_asserteq(-EPROTO,
+		    zstd_decompress(buf, sizeof(zstd_raw_rle) - 1, out, &outn));
+
+	/* Output buffer too small */
+	outn = 209;
+	ut_asserteq(-ENOBUFS, zstd_decompress(zstd_raw_rle,
+					      sizeof(zstd_raw_rle) - 1, out,
+					      &outn));
+
+	/* Truncated, in the last block and in the first */
+	outn = sizeof(out);
+	ut_asserteq(-EINVAL, zstd_decompress(zstd_multi_block,
+					     sizeof(zstd_multi_block) - 21,
+					     out, &outn));
+	outn = sizeof(out);
+	ut_asserteq(-EINVAL, zstd_decompress(zstd_multi_block, 100, out,
+					     &outn));
+
+	/* Damaged sequences in the first and second blocks */
+	memcpy(buf, zstd_multi_block, sizeof(zstd_multi_block));
+	buf[200] ^= 0xff;
+	outn = sizeof(out);
+	ut_assert(zstd_decompress(buf, sizeof(zstd_multi_block) - 1, out,
+				  &outn) < 0);
+	memcpy(buf, zstd_multi_block, sizeof(zstd_multi_block));
+	buf[270] ^= 0xff;
+	outn = sizeof(out);
+	ut_assert(zstd_decompress(buf, sizeof(zstd_multi_block) - 1, out,
+				  &outn) < 0);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_corrupt, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -532,6 +786,106 @@ static int compression_test_bootm_none(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+#ifdef CONFIG_FIT_STREAM
+/* Hands out the image a few bytes at a time, to split up headers/blocks */
+#define STREAM_READ_MAX		7
+
+struct mem_stream {
+	const char *buf;
+	ulong pos;
+};
+
+static long mem_stream_read(struct image_stream *st, void *buf, ulong len)
+{
+	struct mem_stream *ms = st->priv;
+
+	len = min(len, st->size - ms->pos);
+	len = min(len, (ulong)STREAM_READ_MAX);
+	memcpy(buf, ms->buf + ms->pos, len);
+	ms->pos += len;
+
+	return len;
+}
+
+static int run_bootm_stream(void *image, ulong image_len, int comp_type,
+			    uint unc_len, ulong *load_end)
+{
+	const ulong load_addr = 0x1000;
+	struct mem_stream ms = { .buf = image };
+	struct image_stream st = {
+		.read = mem_stream_read,
+		.size = image_len,
+		.priv = &ms,
+	};
+
+	return bootm_decomp_stream(comp_type, load_addr, IH_TYPE_KERNEL,
+				   map_sysmem(load_addr, 0), unc_len, &st,
+				   image_len, load_end);
+}
+
+/**
+ * run_bootm_stream_test() - Run tests on the bootm streaming decompression
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_bootm_stream_test(struct unit_test_state *uts, int comp_type,
+				 mutate_func compress)
+{
+	ulong compress_size = 1024;
+	void *compress_buff;
+	ulong load_end;
+	int unc_len;
+
+	printf("Testing stream: %s\n", genimg_get_comp_name(comp_type));
+	compress_buff = malloc(compress_size);
+	ut_assertnonnull(compress_buff);
+	unc_len = strlen(plain);
+	compress(uts, (void *)plain, unc_len, compress_buff, compress_size,
+		 &compress_size);
+
+	ut_assertok(run_bootm_stream(compress_buff, compress_size, comp_type,
+				     unc_len, &load_end));
+	ut_asserteq(0x1000 + unc_len, load_end);
+	ut_assertok(memcmp(plain, map_sysmem(0x1000, 0), unc_len));
+	ut_assert(run_bootm_stream(compress_buff, compress_size, comp_type,
+				   unc_len - 1, &load_end));
+
+	if (comp_type != IH_COMP_NONE) {
+		/* A truncated image must not be accepted */
+		ut_assert(run_bootm_stream(compress_buff, compress_size / 2,
+					   comp_type, 0x10000, &load_end));
+
+		memset(compress_buff + compress_size / 2, '\x49',
+		       compress_size / 2);
+		ut_assert(run_bootm_stream(compress_buff, compress_size,
+					   comp_type, 0x10000, &load_end));
+	}
+	free(compress_buff);
+
+	return 0;
+}
+
+static int compression_test_bootm_stream_gzip(struct unit_test_state *uts)
+{
+	return run_bootm_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_bootm_stream_gzip, 0);
+
+static int compression_test_bootm_stream_lz4(struct unit_test_state *uts)
+{
+	return run_bootm_stream_test(uts, IH_COMP_LZ4, compress_using_lz4);
+}
+COMPRESSION_TEST(compression_test_bootm_stream_lz4, 0);
+
+static int compression_test_bootm_stream_none(struct unit_test_state *uts)
+{
+	return run_bootm_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_bootm_stream_none, 0);
+#endif
+
 int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct unit_test *tests = ll_entry_start(struct unit_test,
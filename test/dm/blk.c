@@ -5,6 +5,8 @@
 
 #include <common.h>
 #include <dm.h>
+#include <os.h>
+#include <sandboxblockdev.h>
 #include <usb.h>
 #include <asm/state.h>
 #include <dm/test.h>
@@ -167,3 +169,216 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+static int blk_test_complete_count;
+
+static void blk_test_complete(struct blk_request *req)
+{
+	blk_test_complete_count++;
+}
+
+/* Test queued requests, including more than the device can hold at once */
+static int dm_test_blk_submit(struct unit_test_state *uts)
+{
+	const char *fname = "blk_submit.img";
+	struct blk_request reqs[HOST_QUEUE_DEPTH * 2];
+	char data[512 * ARRAY_SIZE(reqs)], buf[sizeof(data)];
+	struct blk_desc *desc;
+	LIST_HEAD(list);
+	int fd, i;
+
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT);
+	ut_assert(fd >= 0);
+	memset(data, '\0', sizeof(data));
+	ut_asserteq(sizeof(data), os_write(fd, data, sizeof(data)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(1, (char *)fname));
+	ut_assertok(host_get_dev_err(1, &desc));
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 3;
+	for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+		reqs[i].op = BLK_REQ_WRITE;
+		reqs[i].start = i;
+		reqs[i].blkcnt = 1;
+		reqs[i].buffer = data + i * 512;
+		reqs[i].complete = blk_test_complete;
+		list_add_tail(&reqs[i].list, &list);
+	}
+	blk_test_complete_count = 0;
+	ut_assertok(blk_dsubmit(desc, &list));
+
+	/* Submitting had to wait for space, but the last few are queued */
+	ut_asserteq(HOST_QUEUE_DEPTH, blk_dpoll(desc) + 1);
+	ut_asserteq(HOST_QUEUE_DEPTH + 1, blk_test_complete_count);
+	ut_assertok(blk_dwait(desc, 1000));
+	ut_asserteq(ARRAY_SIZE(reqs), blk_test_complete_count);
+	for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+		ut_assertok(reqs[i].status);
+		ut_asserteq(1, reqs[i].blks_done);
+	}
+
+	/* Read it all back in reverse, with one request past the end */
+	INIT_LIST_HEAD(&list);
+	memset(buf, '\0', sizeof(buf));
+	for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+		reqs[i].op = BLK_REQ_READ;
+		reqs[i].start = ARRAY_SIZE(reqs) - 1 - i;
+		reqs[i].buffer = buf + reqs[i].start * 512;
+		list_add_tail(&reqs[i].list, &list);
+	}
+	reqs[0].start = ARRAY_SIZE(reqs);
+	reqs[0].buffer = buf;
+	ut_assertok(blk_dsubmit(desc, &list));
+	ut_assertok(blk_dwait(desc, 1000));
+	ut_asserteq(-EIO, reqs[0].status);
+	for (i = 1; i < ARRAY_SIZE(reqs); i++)
+		ut_assertok(reqs[i].status);
+	ut_assertok(memcmp(data, buf, sizeof(data) - 512));
+
+	ut_assertok(host_dev_bind(1, NULL));
+	os_unlink(fname);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+/* Test that the block cache handles partial hits and range invalidation */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	char data[8 * 512], buf[8 * 512];
+	int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7;
+	blkcache_invalidate(IF_TYPE_HOST, 1);
+	blkcache_stats(&stats);
+
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 1, 6, 4, 512, buf));
+	blkcache_fill(IF_TYPE_HOST, 1, 6, 4, 512, data);
+	ut_asserteq(4, blkcache_read(IF_TYPE_HOST, 1, 6, 4, 512, buf));
+	ut_assertok(memcmp(buf, data, 4 * 512));
+
+	/* Only the first two blocks of this read are cached */
+	ut_asserteq(2, blkcache_read(IF_TYPE_HOST, 1, 8, 4, 512, buf));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 2, 6, 4, 512, buf));
+
+	/* A write to block 7 must only drop that block */
+	blkcache_invalidate_range(IF_TYPE_HOST, 1, 7, 1);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 1, 6, 4, 512, buf));
+	ut_asserteq(2, blkcache_read(IF_TYPE_HOST, 1, 8, 2, 512, buf));
+	ut_assertok(memcmp(buf, data + 2 * 512, 2 * 512));
+
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.hits);
+	ut_asserteq(2, stats.partial_hits);
+	ut_asserteq(2, stats.misses);
+
+	blkcache_invalidate(IF_TYPE_HOST, 1);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 1, 8, 2, 512, buf));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+#endif
+
+#if CONFIG_IS_ENABLED(BLOCK_READAHEAD)
+static int blk_test_ra_read(struct unit_test_state *uts,
+			    struct blk_desc *desc, lbaint_t start,
+			    lbaint_t blkcnt, const char *data)
+{
+	char buf[16 * 512];
+
+	ut_asserteq(blkcnt, blk_dread(desc, start, blkcnt, buf));
+	ut_assertok(memcmp(buf, data + start * 512, blkcnt * 512));
+
+	return 0;
+}
+
+static int blk_test_ra_stats(struct unit_test_state *uts, unsigned long hits,
+			     unsigned reads, unsigned long blocks,
+			     unsigned shrinks)
+{
+	struct blk_readahead_stats stats;
+
+	blkra_stats(&stats);
+	ut_asserteq(hits, stats.hits);
+	ut_asserteq(reads, stats.reads);
+	ut_asserteq(blocks, stats.blocks);
+	ut_asserteq(shrinks, stats.shrinks);
+
+	return 0;
+}
+
+/* Test that the read-ahead window follows sequential and random reads */
+static int dm_test_blk_readahead(struct unit_test_state *uts)
+{
+	const char *fname = "blk_readahead.img";
+	char data[64 * 512];
+	struct blk_desc *desc;
+	int fd, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 3 + i / 512;
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(data), os_write(fd, data, sizeof(data)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(1, (char *)fname));
+	ut_assertok(host_get_dev_err(1, &desc));
+
+	/* Keep the block cache out of the way */
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+	blkcache_configure(0, 0);
+#endif
+
+	/*
+	 * Scanning for partitions has read from the device, so read block 0
+	 * and drop the window to get a known state: a stream ending there
+	 */
+	ut_assertok(blk_test_ra_read(uts, desc, 0, 1, data));
+	blkra_invalidate(desc);
+	blkra_configure(32 * 512);
+
+	/* The next read fills the smallest window, which serves the rest */
+	ut_assertok(blk_test_ra_read(uts, desc, 1, 1, data));
+	ut_assertok(blk_test_ra_read(uts, desc, 2, 2, data));
+	ut_assertok(blk_test_ra_read(uts, desc, 4, 5, data));
+	ut_assertok(blk_test_ra_stats(uts, 8, 1, 8, 0));
+
+	/* Carrying on past the end of it doubles the window */
+	ut_assertok(blk_test_ra_read(uts, desc, 9, 1, data));
+	ut_assertok(blk_test_ra_read(uts, desc, 10, 15, data));
+	ut_assertok(blk_test_ra_stats(uts, 16, 1, 16, 0));
+
+	/*
+	 * A read elsewhere goes straight to the device and halves the
+	 * window, so the stream which follows it reads 16 blocks, not 32
+	 */
+	ut_assertok(blk_test_ra_read(uts, desc, 40, 1, data));
+	ut_assertok(blk_test_ra_stats(uts, 0, 0, 0, 1));
+	ut_assertok(blk_test_ra_read(uts, desc, 41, 1, data));
+	ut_assertok(blk_test_ra_stats(uts, 1, 1, 16, 0));
+
+	/* A write drops the buffered blocks and starts again from the bottom */
+	memset(data + 42 * 512, 0xa5, 512);
+	ut_asserteq(1, blk_dwrite(desc, 42, 1, data + 42 * 512));
+	ut_assertok(blk_test_ra_read(uts, desc, 42, 1, data));
+	ut_assertok(blk_test_ra_stats(uts, 1, 1, 8, 0));
+	ut_assertok(blk_test_ra_read(uts, desc, 43, 7, data));
+	ut_assertok(blk_test_ra_stats(uts, 7, 0, 0, 0));
+
+	blkra_configure(CONFIG_BLOCK_READAHEAD_SIZE);
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+	blkcache_configure(CONFIG_BLOCK_CACHE_SIZE,
+			   CONFIG_BLOCK_CACHE_MAX_BLOCKS);
+#endif
+	ut_assertok(host_dev_bind(1, NULL));
+	os_unlink(fname);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_readahead, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
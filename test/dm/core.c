@@ -11,6 +11,7 @@
 #include <fdtdec.h>
 #include <malloc.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
@@ -870,3 +871,167 @@ static int dm_test_uclass_names(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_uclass_names, DM_TESTF_SCAN_PDATA);
+
+#define INDEX_DEV_COUNT	40
+
+/* Test that lookups by seq and name find the right device as devices change */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *dev[INDEX_DEV_COUNT], *found;
+	char name[20];
+	int i;
+
+	/* All these have the same name, so the first bound must be found */
+	for (i = 0; i < INDEX_DEV_COUNT; i++)
+		ut_assertok(device_bind_by_name(dms->root, false,
+						&driver_info_manual, &dev[i]));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, dev[0]->name,
+					       &found));
+	ut_asserteq_ptr(dev[0], found);
+
+	for (i = 0; i < INDEX_DEV_COUNT; i++) {
+		snprintf(name, sizeof(name), "index-%d", i);
+		ut_assertok(device_set_name(dev[i], name));
+	}
+	for (i = 0; i < INDEX_DEV_COUNT; i++) {
+		snprintf(name, sizeof(name), "index-%d", i);
+		ut_assertok(uclass_find_device_by_name(UCLASS_TEST, name,
+						       &found));
+		ut_asserteq_ptr(dev[i], found);
+	}
+
+	/* A prefix still finds the first device that starts with it */
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index-1", &found));
+	ut_asserteq_ptr(dev[1], found);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index", &found));
+	ut_asserteq_ptr(dev[0], found);
+
+	/* A prefix match earlier in the list wins over a later exact match */
+	ut_assertok(device_set_name(dev[0], "index-10-first"));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index-10",
+					       &found));
+	ut_asserteq_ptr(dev[0], found);
+
+	/* Sequence numbers are allocated on probe and dropped on remove */
+	for (i = 0; i < INDEX_DEV_COUNT; i++) {
+		ut_assertok(device_probe(dev[i]));
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, dev[i]->seq,
+						      false, &found));
+		ut_asserteq_ptr(dev[i], found);
+	}
+	for (i = 0; i < INDEX_DEV_COUNT; i += 2) {
+		int seq = dev[i]->seq;
+
+		ut_assertok(device_remove(dev[i], DM_REMOVE_NORMAL));
+		ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, seq,
+							       false, &found));
+	}
+	for (i = 1; i < INDEX_DEV_COUNT; i += 2) {
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, dev[i]->seq,
+						      false, &found));
+		ut_asserteq_ptr(dev[i], found);
+	}
+
+	/* Unbound devices must not be found */
+	for (i = 0; i < INDEX_DEV_COUNT; i++) {
+		ut_assertok(device_remove(dev[i], DM_REMOVE_NORMAL));
+		ut_assertok(device_unbind(dev[i]));
+	}
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST, "index",
+							&found));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, DM_TESTF_SCAN_PDATA);
+
+/* Test that lookups by node and phandle agree with the device tree */
+static int dm_test_uclass_index_ofnode(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *dev, *found, *manual;
+	ofnode node;
+	uint phandle;
+
+	for (uclass_first_device(UCLASS_TEST_FDT, &dev);
+	     dev;
+	     uclass_next_device(&dev)) {
+		ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST_FDT,
+							 dev_ofnode(dev),
+							 &found));
+		ut_asserteq_ptr(dev, found);
+		ut_assertok(device_find_global_by_ofnode(dev_ofnode(dev),
+							 &found));
+		ut_assert(ofnode_equal(dev_ofnode(dev), dev_ofnode(found)));
+
+		phandle = dev_read_phandle(dev);
+		if (phandle) {
+			ut_assertok(uclass_get_device_by_phandle_id(
+					UCLASS_TEST_FDT, phandle, &found));
+			ut_asserteq_ptr(dev, found);
+		}
+	}
+
+	/* Moving a device to another node must move it in the index */
+	node = ofnode_path("/a-test");
+	ut_assert(ofnode_valid(node));
+	ut_assertok(device_bind_by_name(dms->root, false, &driver_info_manual,
+					&manual));
+	ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST, node,
+							  &found));
+	dev_set_ofnode(manual, node);
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node, &found));
+	ut_asserteq_ptr(manual, found);
+
+	/* The FDT device is an earlier sibling, so a tree walk finds it */
+	ut_assertok(device_find_global_by_ofnode(node, &found));
+	ut_asserteq_str("a-test", found->name);
+
+	dev_set_ofnode(manual, ofnode_null());
+	ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST, node,
+							  &found));
+	ut_assertok(device_unbind(manual));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index_ofnode, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that compatible-string lookups match a search of all drivers */
+static int dm_test_lists_compat(struct unit_test_state *uts)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *of_match, *id, *expect_id;
+	struct driver *entry, *drv, *expect;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (of_match = entry->of_match;
+		     of_match && of_match->compatible;
+		     of_match++) {
+			/* The first driver in the list must win */
+			for (expect = driver; expect != entry + 1; expect++) {
+				for (expect_id = expect->of_match;
+				     expect_id && expect_id->compatible;
+				     expect_id++) {
+					if (!strcmp(expect_id->compatible,
+						    of_match->compatible))
+						break;
+				}
+				if (expect_id && expect_id->compatible)
+					break;
+			}
+			drv = lists_driver_lookup_compat(of_match->compatible,
+							 &id);
+			ut_asserteq_ptr(expect, drv);
+			ut_asserteq_ptr(expect_id, id);
+		}
+	}
+
+	ut_assertnull(lists_driver_lookup_compat("u-boot,no-such-driver", &id));
+	drv = lists_driver_lookup_compat("denx,u-boot-fdt-test", &id);
+	ut_assertnonnull(drv);
+	ut_asserteq_str("testfdt_drv", drv->name);
+
+	return 0;
+}
+DM_TEST(dm_test_lists_compat, 0);
@@ -10,11 +10,14 @@
 #include <dm.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
+#include <net/tcp.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 #include <asm/eth.h>
+#include <asm/unaligned.h>
 #include <test/ut.h>
 
 #define DM_TEST_ETH_NUM		4
@@ -258,3 +261,734 @@ static int dm_test_net_retry(struct unit_test_state *uts)
 	return retval;
 }
 DM_TEST(dm_test_net_retry, DM_TESTF_SCAN_FDT);
+
+#define SB_TFTP_PORT	1069
+
+/**
+ * struct sb_tftp_server - state of the mock TFTP server
+ *
+ * @windowsize: largest window the server accepts, 0 if it does not
+ *	support the windowsize option
+ * @blksize: largest block size the server accepts
+ * @size: size of the file being served
+ * @drop: block to drop the first time it is sent, 0 for none
+ * @udp_csum: true to fill in the UDP checksum of packets sent
+ * @check_csum: true to require valid IP and UDP checksums on packets received
+ * @window: window size agreed with the client
+ * @block_size: block size agreed with the client
+ * @acks: number of ACKs received
+ * @sent: number of data blocks sent
+ * @bad_csum: number of packets received with a bad or missing checksum
+ */
+struct sb_tftp_server {
+	int windowsize;
+	int blksize;
+	int size;
+	int drop;
+	bool udp_csum;
+	bool check_csum;
+	int window;
+	int block_size;
+	int acks;
+	int sent;
+	int bad_csum;
+};
+
+static struct sb_tftp_server sb_tftp;
+
+static u8 sb_tftp_byte(int offset)
+{
+	return offset ^ (offset >> 8) ^ (offset >> 16);
+}
+
+static void sb_tftp_send(struct udevice *dev, void *req, const void *data,
+			 int len)
+{
+	struct ethernet_hdr *req_eth = req;
+	struct ip_udp_hdr *req_ip = req + ETHER_HDR_SIZE;
+	uchar pkt[PKTSIZE_ALIGN];
+	struct ethernet_hdr *eth = (void *)pkt;
+	struct ip_udp_hdr *ip = (void *)pkt + ETHER_HDR_SIZE;
+	unsigned sum;
+
+	memcpy(eth->et_dest, req_eth->et_src, ARP_HLEN);
+	memcpy(eth->et_src, req_eth->et_dest, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+	memcpy(pkt + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE, data, len);
+	net_set_udp_header((uchar *)ip, net_read_ip(&req_ip->ip_src),
+			   ntohs(req_ip->udp_src), SB_TFTP_PORT, len);
+	net_write_ip(&ip->ip_src, net_read_ip(&req_ip->ip_dst));
+	ip->ip_sum = 0;
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+	if (sb_tftp.udp_csum) {
+		sum = compute_udp_checksum(ip);
+		ip->udp_xsum = sum ? sum : 0xffff;
+	}
+
+	/* A full queue drops the packet, as a real device would */
+	sandbox_eth_recv_queue(dev, pkt,
+			       ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len);
+}
+
+static void sb_tftp_rrq(struct udevice *dev, void *packet, char *opt,
+			char *end)
+{
+	char oack[64], *p = oack;
+
+	sb_tftp.block_size = 512;
+	sb_tftp.window = 1;
+
+	/* Skip the filename and mode, then look at the options */
+	opt += strlen(opt) + 1;
+	opt += strlen(opt) + 1;
+	while (opt < end) {
+		char *val = opt + strlen(opt) + 1;
+
+		if (!strcmp(opt, "blksize"))
+			sb_tftp.block_size = min((int)simple_strtoul(val, NULL,
+								     10),
+						 sb_tftp.blksize);
+		else if (!strcmp(opt, "windowsize") && sb_tftp.windowsize)
+			sb_tftp.window = min((int)simple_strtoul(val, NULL, 10),
+					     sb_tftp.windowsize);
+		opt = val + strlen(val) + 1;
+	}
+
+	*p++ = 0;
+	*p++ = 6;	/* OACK */
+	p += sprintf(p, "blksize") + 1;
+	p += sprintf(p, "%d", sb_tftp.block_size) + 1;
+	if (sb_tftp.window > 1) {
+		p += sprintf(p, "windowsize") + 1;
+		p += sprintf(p, "%d", sb_tftp.window) + 1;
+	}
+	sb_tftp_send(dev, packet, oack, p - oack);
+}
+
+/* Send the window following the block the client has acknowledged */
+static void sb_tftp_ack(struct udevice *dev, void *packet, int block)
+{
+	uchar data[4 + 1468];
+	int i, n, offset, len;
+
+	sb_tftp.acks++;
+	for (i = 1; i <= sb_tftp.window; i++) {
+		n = block + i;
+		offset = (n - 1) * sb_tftp.block_size;
+		if (offset > sb_tftp.size)
+			break;
+		len = min(sb_tftp.block_size, sb_tftp.size - offset);
+		if (n == sb_tftp.drop) {
+			sb_tftp.drop = 0;
+			continue;
+		}
+		data[0] = 0;
+		data[1] = 3;	/* DATA */
+		put_unaligned_be16(n, data + 2);
+		for (offset = 0; offset < len; offset++)
+			data[4 + offset] = sb_tftp_byte((n - 1) *
+						sb_tftp.block_size + offset);
+		sb_tftp_send(dev, packet, data, 4 + len);
+		sb_tftp.sent++;
+		if (len < sb_tftp.block_size)
+			break;
+	}
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *data = packet + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+
+	if (sandbox_eth_arp_req_to_reply(dev, packet, len) != -EAGAIN)
+		return 0;
+	if (ip->ip_p != IPPROTO_UDP)
+		return 0;
+	if (sb_tftp.check_csum && (!ip_checksum_ok(ip, IP_HDR_SIZE) ||
+				   !ip->udp_xsum || compute_udp_checksum(ip)))
+		sb_tftp.bad_csum++;
+
+	switch (get_unaligned_be16(data)) {
+	case 1:	/* RRQ */
+		sb_tftp_rrq(dev, packet, (char *)data + 2, packet + len);
+		break;
+	case 4:	/* ACK */
+		sb_tftp_ack(dev, packet, get_unaligned_be16(data + 2));
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_tftp_check(struct unit_test_state *uts)
+{
+	u8 *buf;
+	int i;
+
+	ut_asserteq(sb_tftp.size, net_loop(TFTPGET));
+	buf = map_sysmem(load_addr, sb_tftp.size);
+	for (i = 0; i < sb_tftp.size; i++) {
+		if (buf[i] != sb_tftp_byte(i)) {
+			printf("Mismatch at offset %x\n", i);
+			ut_assert(false);
+		}
+	}
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_eth_tftp(struct unit_test_state *uts)
+{
+	int blocks;
+
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sb_tftp.windowsize = 8;
+	sb_tftp.blksize = 512;
+	sb_tftp.size = 40 * 512 + 100;
+	blocks = sb_tftp.size / 512 + 1;
+
+	/*
+	 * Lock-step transfer, one ACK per block. Once the OACK is received
+	 * each block goes straight to the load address.
+	 */
+	sandbox_eth_get_placed(0);
+	env_set("tftpwindowsize", "1");
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(blocks + 1, sb_tftp.acks);
+	ut_asserteq(blocks, sb_tftp.sent);
+	ut_asserteq(blocks, sandbox_eth_get_placed(0));
+
+	/* With a window, one ACK for each group of eight blocks */
+	sb_tftp.acks = 0;
+	sb_tftp.sent = 0;
+	env_set("tftpwindowsize", "16");
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(8, sb_tftp.window);
+	ut_asserteq(1 + DIV_ROUND_UP(blocks, 8), sb_tftp.acks);
+	ut_asserteq(blocks, sb_tftp.sent);
+	ut_asserteq(blocks, sandbox_eth_get_placed(0));
+
+	/*
+	 * A lost block is reported straight away by acknowledging the block
+	 * before it, and the rest of the window is kept
+	 */
+	sb_tftp.acks = 0;
+	sb_tftp.sent = 0;
+	sb_tftp.drop = 12;
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(0, sb_tftp.drop);
+	ut_assert(sb_tftp.acks <= 3 + DIV_ROUND_UP(blocks, 8));
+
+	/*
+	 * If block 1 is lost the rest of the first window is kept and the
+	 * transfer carries on once the ACK of the OACK is sent again
+	 */
+	sb_tftp.acks = 0;
+	sb_tftp.sent = 0;
+	sb_tftp.drop = 1;
+	env_set("tftptimeout", "1000");
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(0, sb_tftp.drop);
+	ut_asserteq(2 + DIV_ROUND_UP(blocks, 8), sb_tftp.acks);
+	env_set("tftptimeout", NULL);
+
+	/*
+	 * A full window of 16 blocks arrives as one burst behind the packet
+	 * that triggered it and must be received without any loss
+	 */
+	sb_tftp.acks = 0;
+	sb_tftp.sent = 0;
+	sb_tftp.windowsize = 16;
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(16, sb_tftp.window);
+	ut_asserteq(1 + DIV_ROUND_UP(blocks, 16), sb_tftp.acks);
+	ut_asserteq(blocks, sb_tftp.sent);
+
+	/*
+	 * UDP checksums from the server are checked in software, so the
+	 * payload must stay in the packet
+	 */
+	sb_tftp.acks = 0;
+	sb_tftp.sent = 0;
+	sb_tftp.windowsize = 8;
+	sb_tftp.udp_csum = true;
+	sandbox_eth_get_placed(0);
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(blocks, sb_tftp.sent);
+	ut_asserteq(0, sandbox_eth_get_placed(0));
+
+	/*
+	 * With checksum offload the device fills in the checksums of sent
+	 * packets and checks the ones received instead of the stack
+	 */
+	sb_tftp.acks = 0;
+	sb_tftp.sent = 0;
+	sb_tftp.check_csum = true;
+	sandbox_eth_set_csum_offload(0, ETH_CSUM_RX_IP | ETH_CSUM_RX_UDP |
+				     ETH_CSUM_TX_IP | ETH_CSUM_TX_UDP);
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(blocks, sb_tftp.sent);
+	ut_asserteq(0, sb_tftp.bad_csum);
+	ut_asserteq(blocks - 8, sandbox_eth_get_placed(0));
+	sandbox_eth_set_csum_offload(0, 0);
+	sb_tftp.udp_csum = false;
+	sb_tftp.check_csum = false;
+
+	/* A server without the option falls back to lock-step */
+	sb_tftp.acks = 0;
+	sb_tftp.sent = 0;
+	sb_tftp.windowsize = 0;
+	ut_assertok(sb_tftp_check(uts));
+	ut_asserteq(1, sb_tftp.window);
+	ut_asserteq(blocks + 1, sb_tftp.acks);
+
+	return 0;
+}
+
+static int dm_test_eth_tftp(struct unit_test_state *uts)
+{
+	ulong old_load_addr = load_addr;
+	int retval;
+
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "test.img",
+		      sizeof(net_boot_file_name));
+	load_addr = 0x100000;
+	env_set("ethact", "eth@10002000");
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+
+	retval = _dm_test_eth_tftp(uts);
+
+	/* Restore the env */
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_csum_offload(0, 0);
+	env_set("tftpwindowsize", NULL);
+	env_set("tftptimeout", NULL);
+	env_set("ethact", NULL);
+	load_addr = old_load_addr;
+	net_server_ip.s_addr = 0;
+
+	return retval;
+}
+DM_TEST(dm_test_eth_tftp, DM_TESTF_SCAN_FDT);
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_eth_rx_pool(struct unit_test_state *uts, uchar **buf,
+				int avail)
+{
+	int i;
+
+	for (i = 0; i < avail; i++) {
+		buf[i] = net_rx_pool_alloc();
+		ut_assertnonnull(buf[i]);
+		ut_assert(IS_ALIGNED((ulong)buf[i], ARCH_DMA_MINALIGN));
+		if (i)
+			ut_assert(buf[i] != buf[i - 1]);
+	}
+	ut_asserteq(0, net_rx_pool_avail());
+	ut_assertnull(net_rx_pool_alloc());
+
+	/* With the pool empty the reply is dropped, as by real hardware */
+	env_set("ethact", "eth@10002000");
+	env_set("netretry", "no");
+	sandbox_eth_skip_timeout();
+	ut_asserteq(-ETIMEDOUT, net_loop(PING));
+
+	return 0;
+}
+
+/* Test the receive buffer pool used by the sandbox driver */
+static int dm_test_eth_rx_pool(struct unit_test_state *uts)
+{
+	uchar *buf[CONFIG_NET_RX_POOL_SIZE] = { NULL };
+	int avail, retval, i;
+
+	net_ping_ip = string_to_ip("1.1.2.2");
+	avail = net_rx_pool_avail();
+	ut_assert(avail > 0);
+
+	retval = _dm_test_eth_rx_pool(uts, buf, avail);
+
+	/* Return the buffers and restore the env */
+	for (i = 0; i < avail; i++)
+		net_rx_pool_free(buf[i]);
+	env_set("netretry", NULL);
+	env_set("ethact", NULL);
+	if (retval)
+		return retval;
+	ut_asserteq(avail, net_rx_pool_avail());
+
+	/* Buffers which are not from the pool are ignored */
+	net_rx_pool_free((uchar *)buf);
+	ut_asserteq(avail, net_rx_pool_avail());
+
+	/* The pool works again once buffers are returned */
+	ut_assertok(net_loop(PING));
+
+	return 0;
+}
+DM_TEST(dm_test_eth_rx_pool, DM_TESTF_SCAN_FDT);
+
+#if defined(CONFIG_CMD_WGET)
+#define SB_HTTP_PORT	80
+#define SB_HTTP_MSS	1000
+
+/**
+ * struct sb_http_server - state of the mock HTTP server
+ *
+ * @size: size of the file being served
+ * @window: most data the server sends before waiting for an ACK
+ * @iss: server's initial sequence number
+ * @drop: data segment to drop the first time it is sent, counting from 1,
+ *	0 for none
+ * @abort: true to make net_loop() fail once the request is received, with
+ *	the connection still open
+ * @chunked: true to send the file with chunked transfer encoding
+ * @client_port: client's TCP port
+ * @rcv_nxt: next sequence number expected from the client
+ * @snd_una: oldest sequence number the client has not acknowledged
+ * @snd_nxt: next sequence number to send
+ * @hdr: response headers
+ * @hdr_len: length of the response headers
+ * @resp_len: length of the response, headers and body
+ * @fin_sent: true once the server has sent its FIN
+ * @client_fin: true once the server has received the client's FIN
+ * @requests: number of requests received
+ * @dup_acks: number of duplicate ACKs received in a row
+ * @fast_retransmits: number of segments resent after three duplicate ACKs
+ * @bad_csum: number of segments received with a bad checksum
+ * @late_replies: number of segments received after the connection should
+ *	have been dropped
+ */
+struct sb_http_server {
+	int size;
+	int window;
+	u32 iss;
+	int drop;
+	bool abort;
+	bool chunked;
+	int client_port;
+	u32 rcv_nxt;
+	u32 snd_una;
+	u32 snd_nxt;
+	char hdr[128];
+	int hdr_len;
+	int resp_len;
+	bool fin_sent;
+	bool client_fin;
+	int requests;
+	int dup_acks;
+	int fast_retransmits;
+	int bad_csum;
+	int late_replies;
+};
+
+static struct sb_http_server sb_http;
+
+static void sb_http_send(struct udevice *dev, void *req, u8 flags, u32 seq,
+			 const void *data, int len)
+{
+	struct ethernet_hdr *req_eth = req;
+	struct ip_udp_hdr *req_ip = req + ETHER_HDR_SIZE;
+	uchar pkt[PKTSIZE_ALIGN];
+	struct ethernet_hdr *eth = (void *)pkt;
+	struct ip_udp_hdr *ip = (void *)pkt + ETHER_HDR_SIZE;
+	struct tcp_hdr *tcp = (void *)ip + IP_HDR_SIZE;
+	struct in_addr src = net_read_ip(&req_ip->ip_dst);
+	struct in_addr dst = net_read_ip(&req_ip->ip_src);
+
+	memcpy(eth->et_dest, req_eth->et_src, ARP_HLEN);
+	memcpy(eth->et_src, req_eth->et_dest, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+	net_set_ip_header((uchar *)ip, dst, src);
+	ip->ip_len = htons(IP_HDR_SIZE + TCP_HDR_SIZE + len);
+	ip->ip_p = IPPROTO_TCP;
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+
+	tcp->tcp_src = htons(SB_HTTP_PORT);
+	tcp->tcp_dst = htons(sb_http.client_port);
+	tcp->tcp_seq = htonl(seq);
+	tcp->tcp_ack = htonl(sb_http.rcv_nxt);
+	tcp->tcp_hlen = (TCP_HDR_SIZE / 4) << 4;
+	tcp->tcp_flags = flags;
+	tcp->tcp_win = htons(0xffff);
+	tcp->tcp_xsum = 0;
+	tcp->tcp_urg = 0;
+	memcpy(tcp + 1, data, len);
+	tcp->tcp_xsum = tcp_checksum(src, dst, tcp, TCP_HDR_SIZE + len);
+
+	sandbox_eth_recv_queue(dev, pkt, ETHER_HDR_SIZE + IP_HDR_SIZE +
+			       TCP_HDR_SIZE + len);
+}
+
+/* Send the part of the response starting at @seq */
+static void sb_http_send_data(struct udevice *dev, void *req, u32 seq,
+			      int len)
+{
+	uchar data[SB_HTTP_MSS];
+	int offset = seq - sb_http.iss - 1;
+	int i;
+
+	for (i = 0; i < len; i++, offset++)
+		data[i] = offset < sb_http.hdr_len ? sb_http.hdr[offset] :
+			  sb_tftp_byte(offset - sb_http.hdr_len);
+	sb_http_send(dev, req, TCP_ACK | TCP_PSH, seq, data, len);
+}
+
+/* Send as much of the response as the window allows, then the FIN */
+static void sb_http_output(struct udevice *dev, void *req)
+{
+	int offset, len;
+
+	while (1) {
+		offset = sb_http.snd_nxt - sb_http.iss - 1;
+		if (offset >= sb_http.resp_len ||
+		    sb_http.snd_nxt - sb_http.snd_una >= sb_http.window)
+			break;
+		len = min(SB_HTTP_MSS, sb_http.resp_len - offset);
+		if (sb_http.drop && offset / SB_HTTP_MSS + 1 == sb_http.drop)
+			sb_http.drop = 0;
+		else
+			sb_http_send_data(dev, req, sb_http.snd_nxt, len);
+		sb_http.snd_nxt += len;
+	}
+	if (sb_http.resp_len && offset == sb_http.resp_len &&
+	    !sb_http.fin_sent) {
+		sb_http_send(dev, req, TCP_FIN | TCP_ACK, sb_http.snd_nxt,
+			     NULL, 0);
+		sb_http.snd_nxt++;
+		sb_http.fin_sent = true;
+	}
+}
+
+static void sb_http_request(const char *data, int len)
+{
+	sb_http.requests++;
+	if (len > 24 && !strncmp(data, "GET /test.img HTTP/1.0\r\n", 24) &&
+	    sb_http.chunked) {
+		/* The body is not really chunked; the client must not look */
+		sb_http.hdr_len = sprintf(sb_http.hdr,
+					  "HTTP/1.1 200 OK\r\n"
+					  "Transfer-Encoding: chunked\r\n"
+					  "Connection: close\r\n\r\n");
+		sb_http.resp_len = sb_http.hdr_len + sb_http.size;
+	} else if (len > 24 &&
+		   !strncmp(data, "GET /test.img HTTP/1.0\r\n", 24)) {
+		sb_http.hdr_len = sprintf(sb_http.hdr,
+					  "HTTP/1.1 200 OK\r\n"
+					  "Content-Length: %d\r\n"
+					  "Connection: close\r\n\r\n",
+					  sb_http.size);
+		sb_http.resp_len = sb_http.hdr_len + sb_http.size;
+	} else {
+		sb_http.hdr_len = sprintf(sb_http.hdr,
+					  "HTTP/1.1 404 Not Found\r\n"
+					  "Content-Length: 0\r\n\r\n");
+		sb_http.resp_len = sb_http.hdr_len;
+	}
+}
+
+static int sb_http_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct tcp_hdr *tcp = (void *)ip + IP_HDR_SIZE;
+	int tcp_len, hlen, dlen;
+	u32 seq, ack;
+	u8 flags;
+
+	if (sandbox_eth_arp_req_to_reply(dev, packet, len) != -EAGAIN)
+		return 0;
+	if (ip->ip_p != IPPROTO_TCP || ntohs(tcp->tcp_dst) != SB_HTTP_PORT)
+		return 0;
+	tcp_len = ntohs(ip->ip_len) - IP_HDR_SIZE;
+	if (tcp_checksum(net_read_ip(&ip->ip_src), net_read_ip(&ip->ip_dst),
+			 tcp, tcp_len)) {
+		sb_http.bad_csum++;
+		return 0;
+	}
+	hlen = (tcp->tcp_hlen >> 4) * 4;
+	dlen = tcp_len - hlen;
+	flags = tcp->tcp_flags;
+	seq = ntohl(tcp->tcp_seq);
+	ack = ntohl(tcp->tcp_ack);
+
+	if (flags & TCP_SYN) {
+		sb_http.client_port = ntohs(tcp->tcp_src);
+		sb_http.rcv_nxt = seq + 1;
+		sb_http.snd_una = sb_http.iss;
+		sb_http.snd_nxt = sb_http.iss + 1;
+		sb_http.resp_len = 0;
+		sb_http.fin_sent = false;
+		sb_http.client_fin = false;
+		sb_http_send(dev, packet, TCP_SYN | TCP_ACK, sb_http.iss,
+			     NULL, 0);
+		return 0;
+	}
+	if (flags & TCP_RST)
+		return 0;
+
+	if (dlen && seq == sb_http.rcv_nxt) {
+		sb_http.rcv_nxt += dlen;
+		sb_http_request((char *)tcp + hlen, dlen);
+		if (sb_http.abort) {
+			net_set_state(NETLOOP_FAIL);
+			return 0;
+		}
+	}
+	if ((flags & TCP_FIN) && seq + dlen == sb_http.rcv_nxt) {
+		sb_http.rcv_nxt++;
+		sb_http.client_fin = true;
+	}
+
+	if ((s32)(ack - sb_http.snd_una) > 0) {
+		sb_http.snd_una = ack;
+		sb_http.dup_acks = 0;
+	} else if (ack == sb_http.snd_una && !dlen && !(flags & TCP_FIN) &&
+		   sb_http.snd_una != sb_http.snd_nxt &&
+		   ++sb_http.dup_acks == 3) {
+		sb_http.fast_retransmits++;
+		sb_http_send_data(dev, packet, sb_http.snd_una,
+				  min_t(int, SB_HTTP_MSS,
+					sb_http.snd_nxt - sb_http.snd_una));
+	}
+
+	sb_http_output(dev, packet);
+	if (dlen || (flags & TCP_FIN))
+		sb_http_send(dev, packet, TCP_ACK, sb_http.snd_nxt, NULL, 0);
+
+	return 0;
+}
+
+/*
+ * Serve TFTP, but first send a segment on the HTTP connection, which the
+ * client should no longer know about
+ */
+static int sb_http_late_handler(struct udevice *dev, void *packet,
+				unsigned int len)
+{
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth = packet;
+
+	if (ntohs(eth->et_protlen) == PROT_IP && ip->ip_p == IPPROTO_TCP) {
+		sb_http.late_replies++;
+		return 0;
+	}
+	if (ntohs(eth->et_protlen) == PROT_IP && sb_http.abort) {
+		sb_http_send(dev, packet, TCP_ACK | TCP_PSH | TCP_FIN,
+			     sb_http.snd_nxt, "late", 4);
+		sb_http.abort = false;
+	}
+
+	return sb_tftp_handler(dev, packet, len);
+}
+
+static int sb_http_check(struct unit_test_state *uts)
+{
+	u8 *buf;
+	int i;
+
+	ut_asserteq(sb_http.size, net_loop(WGET));
+	buf = map_sysmem(load_addr, sb_http.size);
+	for (i = 0; i < sb_http.size; i++) {
+		if (buf[i] != sb_tftp_byte(i)) {
+			printf("Mismatch at offset %x\n", i);
+			ut_assert(false);
+		}
+	}
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_eth_wget(struct unit_test_state *uts)
+{
+	memset(&sb_http, '\0', sizeof(sb_http));
+	sb_http.size = 40 * SB_HTTP_MSS + 123;
+	sb_http.window = 8 * SB_HTTP_MSS;
+	/* Make the server's sequence numbers wrap during the transfer */
+	sb_http.iss = 0xfffff000;
+
+	ut_assertok(sb_http_check(uts));
+	ut_asserteq(1, sb_http.requests);
+	ut_assert(sb_http.client_fin);
+	ut_asserteq(0, sb_http.fast_retransmits);
+	ut_asserteq(0, sb_http.bad_csum);
+
+	/* A lost segment is resent after duplicate ACKs, with no timeout */
+	sb_http.requests = 0;
+	sb_http.drop = 5;
+	ut_assertok(sb_http_check(uts));
+	ut_asserteq(0, sb_http.drop);
+	ut_asserteq(1, sb_http.fast_retransmits);
+
+	/* The transfer also works if the headers and body share a segment */
+	sb_http.fast_retransmits = 0;
+	sb_http.size = 100;
+	ut_assertok(sb_http_check(uts));
+	ut_asserteq(0, sb_http.fast_retransmits);
+
+	/* A chunked response cannot be stored, so is reported as an error */
+	sb_http.requests = 0;
+	sb_http.chunked = true;
+	ut_asserteq(-ETIMEDOUT, net_loop(WGET));
+	ut_asserteq(1, sb_http.requests);
+	sb_http.chunked = false;
+
+	/* A missing file is reported as an error */
+	sb_http.requests = 0;
+	copy_filename(net_boot_file_name, "missing.img",
+		      sizeof(net_boot_file_name));
+	ut_asserteq(-ETIMEDOUT, net_loop(WGET));
+	ut_asserteq(1, sb_http.requests);
+
+	/*
+	 * A transfer which stops with the connection still open must not
+	 * leave it to take data during the next transfer
+	 */
+	copy_filename(net_boot_file_name, "test.img",
+		      sizeof(net_boot_file_name));
+	sb_http.abort = true;
+	ut_asserteq(-ETIMEDOUT, net_loop(WGET));
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sb_tftp.blksize = 512;
+	sb_tftp.size = 10 * 512 + 100;
+	sandbox_eth_set_tx_handler(0, sb_http_late_handler);
+	ut_assertok(sb_tftp_check(uts));
+	ut_assert(!sb_http.abort);
+	ut_asserteq(0, sb_http.late_replies);
+
+	return 0;
+}
+
+/* Test a download over HTTP from a mock server */
+static int dm_test_eth_wget(struct unit_test_state *uts)
+{
+	ulong old_load_addr = load_addr;
+	int retval;
+
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "test.img",
+		      sizeof(net_boot_file_name));
+	load_addr = 0x100000;
+	env_set("ethact", "eth@10002000");
+	env_set("netretry", "no");
+	sandbox_eth_set_tx_handler(0, sb_http_handler);
+
+	retval = _dm_test_eth_wget(uts);
+
+	/* Restore the env */
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("netretry", NULL);
+	env_set("ethact", NULL);
+	load_addr = old_load_addr;
+	net_server_ip.s_addr = 0;
+
+	return retval;
+}
+DM_TEST(dm_test_eth_wget, DM_TESTF_SCAN_FDT);
+#endif
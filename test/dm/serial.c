@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the serial uclass
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <serial.h>
+#include <asm/test.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Test that queued output is sent when polling for input and on a flush */
+static int dm_test_serial_tx_buffer(struct unit_test_state *uts)
+{
+	struct udevice *dev, *old_dev = gd->cur_serial_dev;
+	struct serial_dev_priv *upriv;
+	uint count;
+
+	ut_assertok(uclass_first_device_err(UCLASS_SERIAL, &dev));
+	upriv = dev_get_uclass_priv(dev);
+	ut_assertnonnull(upriv->tx_buf);
+	ut_asserteq(upriv->tx_rd, upriv->tx_wr);
+	gd->cur_serial_dev = dev;
+
+	/* Output stays in the buffer while the UART is busy */
+	count = sandbox_serial_get_tx_count(dev);
+	sandbox_serial_set_tx_busy(dev, true);
+	serial_puts("tx\n");
+	ut_asserteq(4, upriv->tx_wr - upriv->tx_rd);
+	ut_asserteq(count, sandbox_serial_get_tx_count(dev));
+
+	/* Checking for input sends it once the UART has room */
+	sandbox_serial_set_tx_busy(dev, false);
+	serial_tstc();
+	ut_asserteq(upriv->tx_rd, upriv->tx_wr);
+	ut_asserteq(count + 4, sandbox_serial_get_tx_count(dev));
+
+	/* So does a flush */
+	sandbox_serial_set_tx_busy(dev, true);
+	serial_puts("tx\n");
+	ut_asserteq(4, upriv->tx_wr - upriv->tx_rd);
+	sandbox_serial_set_tx_busy(dev, false);
+	serial_flush();
+	ut_asserteq(upriv->tx_rd, upriv->tx_wr);
+	ut_asserteq(count + 8, sandbox_serial_get_tx_count(dev));
+
+	gd->cur_serial_dev = old_dev;
+
+	return 0;
+}
+DM_TEST(dm_test_serial_tx_buffer, DM_TESTF_SCAN_FDT);
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tests for appending environment changes (CONFIG_ENV_APPEND_LOG)
+ */
+
+#include <common.h>
+#include <environment.h>
+#include <malloc.h>
+#include <test/env.h>
+#include <test/ut.h>
+
+/* Records are replayed in order, up to the first one which is not valid */
+static int env_test_append_replay(struct unit_test_state *uts)
+{
+	env_t *saved, *env, *img;
+	uint off, len;
+
+	saved = malloc(sizeof(env_t));
+	env = malloc(sizeof(env_t));
+	ut_assertnonnull(saved);
+	ut_assertnonnull(env);
+	ut_assertok(env_export(saved));
+
+	/* A full save leaves the rest erased, then changes are appended */
+	env_set("append_a", "1");
+	env_set("append_b", "1");
+	ut_assertok(env_export(env));
+	env_set("append_b", "2");
+	ut_assertok(env_export_append(&img, &off, &len));
+	ut_assert(len > 0);
+	env_set("append_a", NULL);
+	ut_assertok(env_export_append(&img, &off, &len));
+	ut_assert(len > 0);
+	env_set("append_c", "3");
+	ut_assertok(env_export_append(&img, &off, &len));
+	ut_assert(len > 0);
+	ut_assertok(env_export_append(&img, &off, &len));
+	ut_asserteq(0, len);
+
+	/* The CRC only covers the variables and the erased log area */
+	memcpy(env, img, sizeof(env_t));
+	ut_assert(env_crc_ok(env));
+	ut_assertok(env_import((char *)env, 1));
+	ut_assertnull(env_get("append_a"));
+	ut_asserteq_str("2", env_get("append_b"));
+	ut_asserteq_str("3", env_get("append_c"));
+
+	/* Corrupt the last record, as if writing it was interrupted */
+	ut_assertok(env_export_append(&img, &off, &len));
+	ut_asserteq(0, len);
+	env_set("append_c", NULL);
+	env_set("append_d", "4");
+	ut_assertok(env_export_append(&img, &off, &len));
+	ut_assert(len > 0);
+	memcpy(env, img, sizeof(env_t));
+	off -= offsetof(env_t, data);
+	env->data[off + len - 1] ^= 0xff;
+	ut_assert(env_crc_ok(env));
+	ut_assertok(env_import((char *)env, 1));
+	ut_assertnull(env_get("append_a"));
+	ut_asserteq_str("2", env_get("append_b"));
+	ut_asserteq_str("3", env_get("append_c"));
+	ut_assertnull(env_get("append_d"));
+
+	ut_assertok(env_import((char *)saved, 1));
+	ut_assertnull(env_get("append_b"));
+	free(env);
+	free(saved);
+
+	return 0;
+}
+ENV_TEST(env_test_append_replay, 0);
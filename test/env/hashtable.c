@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tests for the environment hash table
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <search.h>
+#include <test/env.h>
+#include <test/ut.h>
+
+#define HTAB_TEST_ENTRIES	300
+
+static int htab_set(struct hsearch_data *htab, const char *key,
+		    const char *data)
+{
+	ENTRY e, *ep;
+
+	e.key = key;
+	e.data = (char *)data;
+
+	return hsearch_r(e, ENTER, &ep, htab, 0);
+}
+
+static char *htab_get(struct hsearch_data *htab, const char *key)
+{
+	ENTRY e, *ep;
+
+	e.key = key;
+	e.data = NULL;
+	if (!hsearch_r(e, FIND, &ep, htab, 0))
+		return NULL;
+
+	return ep->data;
+}
+
+/* Adding entries beyond the initial size grows the table */
+static int env_test_htab_grow(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = {};
+	char key[16], data[16];
+	int i;
+
+	ut_assert(hcreate_r(5, &htab));
+	for (i = 0; i < HTAB_TEST_ENTRIES; i++) {
+		snprintf(key, sizeof(key), "var%d", i);
+		snprintf(data, sizeof(data), "%d", i * 3);
+		ut_assert(htab_set(&htab, key, data));
+	}
+	ut_asserteq(HTAB_TEST_ENTRIES, htab.filled);
+	ut_assert(htab.size > HTAB_TEST_ENTRIES);
+
+	for (i = 0; i < HTAB_TEST_ENTRIES; i++) {
+		snprintf(key, sizeof(key), "var%d", i);
+		snprintf(data, sizeof(data), "%d", i * 3);
+		ut_asserteq_str(data, htab_get(&htab, key));
+	}
+	ut_assertnull(htab_get(&htab, "var-1"));
+
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_grow, 0);
+
+/* Export is sorted by key, across deletes and re-inserts */
+static int env_test_htab_export_sorted(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = {};
+	char key[16], *res = NULL, *p, *prev;
+	int i, count;
+
+	ut_assert(hcreate_r(5, &htab));
+	for (i = 0; i < HTAB_TEST_ENTRIES; i++) {
+		snprintf(key, sizeof(key), "v%d", (i * 37) % HTAB_TEST_ENTRIES);
+		ut_assert(htab_set(&htab, key, "x"));
+	}
+	for (i = 0; i < HTAB_TEST_ENTRIES; i += 2) {
+		snprintf(key, sizeof(key), "v%d", i);
+		ut_assert(hdelete_r(key, &htab, 0));
+	}
+	ut_assert(htab_set(&htab, "v0", "again"));
+	ut_asserteq(HTAB_TEST_ENTRIES / 2 + 1, htab.filled);
+
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	prev = NULL;
+	count = 0;
+	for (p = strtok(res, "\n"); p; p = strtok(NULL, "\n")) {
+		*strchr(p, '=') = '\0';
+		if (prev)
+			ut_assert(strcmp(prev, p) < 0);
+		prev = p;
+		count++;
+	}
+	ut_asserteq(HTAB_TEST_ENTRIES / 2 + 1, count);
+	ut_asserteq_str("again", htab_get(&htab, "v0"));
+	ut_assertnull(htab_get(&htab, "v2"));
+
+	free(res);
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_export_sorted, 0);
@@ -0,0 +1,118 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0+
+
+# This script tests U-Boot's btrfs filesystem code's ability to read files
+# with zstd-compressed extents, holes, and parts of extents.
+#
+# btrfs file reads collect extents which follow each other on disk and read
+# them in one go, then decompress each compressed extent. An extent which is
+# only partly wanted is decompressed once and kept in a small cache. This
+# test checks that files mixing compressed and uncompressed extents, and
+# sparse files, are read correctly, in full, from an offset and in pieces.
+#
+# To execute the test, simply run it from the U-Boot source root directory:
+#
+#    cd u-boot
+#    ./test/fs/btrfs-zstd-test.sh
+#
+# The test will create a btrfs filesystem image with mkfs.btrfs --rootdir and
+# --compress (so no root access is needed; this needs btrfs-progs 6.13 or
+# later), record the CRCs of the test files, build U-Boot sandbox, invoke
+# U-Boot sandbox to read the files and validate that the CRCs match. Each
+# check prints either "PASS" or "FAILURE".
+#
+# All temporary files used by this script are created in ./sandbox to avoid
+# polluting the source tree. test/fs/fs-test.sh also uses this directory for
+# the same purpose.
+
+odir=sandbox
+img=${odir}/btrfs-zstd.img
+tmp=${odir}/btrfs-zstd
+root=${tmp}/root
+mixedfn=mixed.txt
+sparsefn=sparse.txt
+crcaddr=0
+loadaddr=1000
+
+for prereq in mkfs.btrfs dd seq crc32; do
+    if [ ! -x "`which $prereq`" ]; then
+        echo "Missing $prereq binary. Exiting!"
+        exit 1
+    fi
+done
+if ! mkfs.btrfs --help 2>&1 | grep -q -- --compress; then
+    echo "mkfs.btrfs does not support --compress. Exiting!"
+    exit 1
+fi
+
+make O=${odir} -s sandbox_defconfig && make O=${odir} -s -j8
+
+rm -rf ${tmp}
+mkdir -p ${root}
+
+# Text compresses well and random data not at all, so the file has runs of
+# zstd extents, 128KiB of data each, with uncompressed extents between them
+for ((i = 0; i < 4; i++)); do
+    seq $((i * 100000)) $((i * 100000 + 60000))
+    dd if=/dev/urandom bs=1024 count=100 2>/dev/null
+done > ${root}/${mixedfn}
+
+# Leave holes at the start, in the middle and at the end
+seq 1 50000 > ${tmp}/text
+dd if=${tmp}/text of=${root}/${sparsefn} bs=1024 seek=200 count=150 \
+    >/dev/null 2>&1
+dd if=${tmp}/text of=${root}/${sparsefn} bs=1024 seek=500 count=50 \
+    conv=notrunc >/dev/null 2>&1
+truncate -s 1000000 ${root}/${sparsefn}
+
+rm -f ${img}
+truncate -s 128M ${img}
+mkfs.btrfs -q -f --rootdir ${root} --compress zstd ${img}
+if [ $? -ne 0 ]; then
+    echo Could not create btrfs filesystem
+    exit $?
+fi
+
+# Get the CRC of part of a file, in the byte order found in U-Boot's memory
+crc_of() {
+    local crc=0x`tail -c +$(($2 + 1)) $1 | head -c $3 | crc32 /dev/stdin`
+
+    printf %02x%02x%02x%02x \
+        $((${crc} & 0xff)) \
+        $(((${crc} >> 8) & 0xff)) \
+        $(((${crc} >> 16) & 0xff)) \
+        $((${crc} >> 24))
+}
+
+# Emit U-Boot commands to read part of a file and check its CRC
+check() {
+    local fn=$1 size=$2 offset=$3
+
+    echo "load host 0:0 ${loadaddr} ${fn} ${size} ${offset}"
+    echo "crc32 ${loadaddr} \$filesize ${crcaddr}"
+    echo "if itest.l *${crcaddr} != `crc_of ${root}/${fn} ${offset} ${size}`;" \
+        "then echo FAILURE; else echo PASS; fi"
+}
+
+mixedsize=`stat -c %s ${root}/${mixedfn}`
+sparsesize=`stat -c %s ${root}/${sparsefn}`
+
+(
+    echo "host bind 0 ${img}"
+    check ${mixedfn} ${mixedsize} 0
+    # Start part way into a compressed extent and end in a later one
+    check ${mixedfn} 300000 5000
+    check ${mixedfn} 1000 $((mixedsize - 1000))
+    # Read one compressed extent in pieces, which uses the cache
+    for ((i = 0; i < 8; i++)); do
+        check ${mixedfn} 16384 $((131072 + i * 16384))
+    done
+    check ${sparsefn} ${sparsesize} 0
+    check ${sparsefn} 300000 4999
+    check ${sparsefn} 1000 $((sparsesize - 1000))
+    echo "reset"
+) | ./sandbox/u-boot
+if [ $? -ne 0 ]; then
+    echo U-Boot exit status indicates an error
+    exit $?
+fi
@@ -0,0 +1,119 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0+
+
+# This script tests U-Boot's ext4 filesystem code's ability to read files with
+# many extents, and sparse files.
+#
+# ext4 file reads map each run of blocks which is contiguous on disk and read
+# it in one go, using a cached copy of the file's extent tree. This test
+# checks that files whose extent tree needs index blocks, and files with
+# holes, are read correctly, both in full and from an offset.
+#
+# To execute the test, simply run it from the U-Boot source root directory:
+#
+#    cd u-boot
+#    ./test/fs/ext4-extent-test.sh
+#
+# The test will create an ext4 filesystem image with debugfs (so no root
+# access is needed), record the CRCs of the test files, build U-Boot sandbox,
+# invoke U-Boot sandbox to read the files and validate that the CRCs match.
+# Each check prints either "PASS" or "FAILURE".
+#
+# All temporary files used by this script are created in ./sandbox to avoid
+# polluting the source tree. test/fs/fs-test.sh also uses this directory for
+# the same purpose.
+
+odir=sandbox
+img=${odir}/ext4-extent.img
+tmp=${odir}/ext4-extent
+fill=/dev/urandom
+fragfn=fragmented.img
+sparsefn=sparse.img
+crcaddr=0
+loadaddr=1000
+
+for prereq in mkfs.ext4 debugfs dd crc32; do
+    if [ ! -x "`which $prereq`" ]; then
+        echo "Missing $prereq binary. Exiting!"
+        exit 1
+    fi
+done
+
+make O=${odir} -s sandbox_defconfig && make O=${odir} -s -j8
+
+mkdir -p ${tmp}
+
+# Fill the filesystem with small files and remove every other one, so that a
+# large file written afterwards has hundreds of extents
+dd if=/dev/zero of=${img} bs=1024 count=$((64 * 1024)) >/dev/null 2>&1
+mkfs.ext4 -q -b 1024 -O ^has_journal ${img}
+if [ $? -ne 0 ]; then
+    echo Could not create ext4 filesystem
+    exit $?
+fi
+for ((i = 0; i < 400; i++)); do
+    dd if=${fill} of=${tmp}/small-${i} bs=1024 count=3 >/dev/null 2>&1
+done
+(
+    for ((i = 0; i < 400; i++)); do
+        echo "write ${tmp}/small-${i} small-${i}"
+    done
+    for ((i = 0; i < 400; i += 2)); do
+        echo "rm small-${i}"
+    done
+) | debugfs -w ${img} >/dev/null 2>&1
+
+# 511 deliberately to get a file size that is not a multiple of the block size
+dd if=${fill} of=${tmp}/${fragfn} bs=511 count=6000 >/dev/null 2>&1
+
+# Leave holes at the start, in the middle and at the end
+rm -f ${tmp}/${sparsefn}
+dd if=${fill} of=${tmp}/${sparsefn} bs=1024 seek=100 count=5 \
+    >/dev/null 2>&1
+dd if=${fill} of=${tmp}/${sparsefn} bs=1024 seek=300 count=7 conv=notrunc \
+    >/dev/null 2>&1
+truncate -s 1000000 ${tmp}/${sparsefn}
+
+debugfs -w ${img} >/dev/null 2>&1 << EOF
+write ${tmp}/${fragfn} ${fragfn}
+write ${tmp}/${sparsefn} ${sparsefn}
+EOF
+
+# Get the CRC of part of a file, in the byte order found in U-Boot's memory
+crc_of() {
+    local crc=0x`tail -c +$(($2 + 1)) $1 | head -c $3 | crc32 /dev/stdin`
+
+    printf %02x%02x%02x%02x \
+        $((${crc} & 0xff)) \
+        $(((${crc} >> 8) & 0xff)) \
+        $(((${crc} >> 16) & 0xff)) \
+        $((${crc} >> 24))
+}
+
+# Emit U-Boot commands to read part of a file and check its CRC
+check() {
+    local fn=$1 size=$2 offset=$3
+
+    echo "load host 0:0 ${loadaddr} ${fn} ${size} ${offset}"
+    echo "crc32 ${loadaddr} \$filesize ${crcaddr}"
+    echo "if itest.l *${crcaddr} != `crc_of ${tmp}/${fn} ${offset} ${size}`;" \
+        "then echo FAILURE; else echo PASS; fi"
+}
+
+fragsize=`stat -c %s ${tmp}/${fragfn}`
+sparsesize=`stat -c %s ${tmp}/${sparsefn}`
+
+(
+    echo "host bind 0 ${img}"
+    check ${fragfn} ${fragsize} 0
+    check ${fragfn} $((fragsize - 1234567)) 1234567
+    check ${fragfn} 5000 1000
+    check ${sparsefn} ${sparsesize} 0
+    check ${sparsefn} 300000 4999
+    check ${sparsefn} 1000 $((sparsesize - 1000))
+    echo "reset"
+) | ./sandbox/u-boot
+if [ $? -ne 0 ]; then
+    echo U-Boot exit status indicates an error
+    exit $?
+fi
@@ -0,0 +1,132 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0+
+
+# This script tests U-Boot's ext4 filesystem code's ability to look up files
+# in hash tree (dir_index) directories.
+#
+# Large directories have an index, sorted by a hash of the file name, which
+# ext4 path lookups use to read just the directory block holding the name.
+# This test checks that files are found in indexed directories, for each hash
+# version, and that names which are not present are reported as missing.
+#
+# To execute the test, simply run it from the U-Boot source root directory:
+#
+#    cd u-boot
+#    ./test/fs/ext4-htree-test.sh
+#
+# The test will create ext4 filesystem images with mkfs.ext4 -d and index
+# their directories with e2fsck -D (so no root access is needed), build U-Boot
+# sandbox, invoke U-Boot sandbox to read files and validate that the CRCs
+# match. Each check prints either "PASS" or "FAILURE".
+#
+# All temporary files used by this script are created in ./sandbox to avoid
+# polluting the source tree. test/fs/fs-test.sh also uses this directory for
+# the same purpose.
+
+odir=sandbox
+tmp=${odir}/ext4-htree
+root=${tmp}/root
+nfiles=8000
+crcaddr=0
+loadaddr=1000
+
+for prereq in mkfs.ext4 e2fsck debugfs dd crc32; do
+    if [ ! -x "`which $prereq`" ]; then
+        echo "Missing $prereq binary. Exiting!"
+        exit 1
+    fi
+done
+
+make O=${odir} -s sandbox_defconfig && make O=${odir} -s -j8
+
+rm -rf ${root}
+mkdir -p ${root}/modules/kernel
+
+# Enough files that the index needs more than one level with 1KiB blocks
+for ((i = 0; i < nfiles; i++)); do
+    echo "module ${i}" > ${root}/modules/mod-${i}.ko
+done
+# Names with the top bit set, which hash differently with signed and
+# unsigned chars
+for ((i = 0; i < 50; i++)); do
+    echo "module ${i}" > ${root}/modules/modülé-${i}.ko
+done
+dd if=/dev/urandom of=${root}/modules/kernel/vmlinux bs=1024 count=100 \
+    >/dev/null 2>&1
+ln -s mod-1234.ko ${root}/modules/link.ko
+
+# Create an image, using the given hash version and signedness, and index its
+# directories
+mkimage() {
+    local img=$1 hash=$2 flags=$3
+
+    dd if=/dev/zero of=${img} bs=1024 count=$((32 * 1024)) >/dev/null 2>&1
+    mkfs.ext4 -q -b 1024 -O ^has_journal,dir_index -d ${root} ${img}
+    if [ $? -ne 0 ]; then
+        echo Could not create ext4 filesystem
+        exit 1
+    fi
+    debugfs -w -R "ssv def_hash_version ${hash}" ${img} >/dev/null 2>&1
+    debugfs -w -R "ssv flags ${flags}" ${img} >/dev/null 2>&1
+    e2fsck -fyD ${img} >/dev/null 2>&1
+    if ! debugfs -R "htree /modules" ${img} 2>/dev/null | \
+            grep -q "Indirect levels: 1"; then
+        echo "Could not index directory in ${img}"
+        exit 1
+    fi
+}
+
+# Get the CRC of a file, in the byte order found in U-Boot's memory
+crc_of() {
+    local crc=0x`crc32 $1`
+
+    printf %02x%02x%02x%02x \
+        $((${crc} & 0xff)) \
+        $(((${crc} >> 8) & 0xff)) \
+        $(((${crc} >> 16) & 0xff)) \
+        $((${crc} >> 24))
+}
+
+# Emit U-Boot commands to read a file and check its CRC
+check() {
+    local fn=$1
+
+    echo "load host 0:0 ${loadaddr} ${fn}"
+    echo "crc32 ${loadaddr} \$filesize ${crcaddr}"
+    echo "if itest.l *${crcaddr} != `crc_of ${root}/${fn}`;" \
+        "then echo FAILURE; else echo PASS; fi"
+}
+
+# Emit U-Boot commands to check that a file is not found
+check_missing() {
+    local fn=$1
+
+    echo "if load host 0:0 ${loadaddr} ${fn}; then echo FAILURE;" \
+        "else echo PASS; fi"
+}
+
+# Images with the legacy, half MD4 and TEA hashes, using signed (1) and
+# unsigned (2) chars
+images="legacy:1 half_md4:1 tea:2 half_md4:2"
+
+for image in ${images}; do
+    img=${tmp}/${image%:*}-${image#*:}.img
+    mkimage ${img} ${image%:*} ${image#*:}
+    (
+        echo "host bind 0 ${img}"
+        check modules/mod-0.ko
+        check modules/mod-1234.ko
+        check modules/mod-$((nfiles - 1)).ko
+        check modules/modülé-7.ko
+        check modules/link.ko
+        check modules/kernel/vmlinux
+        check_missing modules/mod-${nfiles}.ko
+        check_missing modules/mod-12.k
+        check_missing modules/kernel/mod-0.ko
+        echo "reset"
+    ) | ./sandbox/u-boot
+    if [ $? -ne 0 ]; then
+        echo U-Boot exit status indicates an error
+        exit $?
+    fi
+done
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Helpers for timing library functions
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <test/lib.h>
+
+void *lib_bench_alloc(ulong *sizep, int fill)
+{
+	ulong size;
+	void *buf;
+
+	for (size = LIB_BENCH_SIZE; size >= LIB_BENCH_MIN_SIZE; size /= 2) {
+		buf = malloc(size);
+		if (buf) {
+			memset(buf, fill, size);
+			*sizep = size;
+			return buf;
+		}
+	}
+	printf("Not enough memory for benchmark, skipping\n");
+
+	return NULL;
+}
+
+void lib_bench_show(const char *name, ulong start, ulong bytes,
+		    const char *extra)
+{
+	ulong us = max(timer_get_us() - start, 1UL);
+
+	printf("%-12s %8lu us  %6lu MB/s%s\n", name, us, bytes / us, extra);
+}
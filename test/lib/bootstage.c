@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for bootstage spans
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+/* Export bootstage as JSON to a new buffer, which the caller must free */
+static char *span_test_export(void)
+{
+	char dummy;
+	char *buf;
+	int size;
+
+	size = bootstage_export_json(&dummy, 1);
+	buf = malloc(size + 1);
+	if (!buf)
+		return NULL;
+	bootstage_export_json(buf, size);
+	buf[size] = '\0';
+
+	return buf;
+}
+
+/* Check that the export has a span with the given state, ID and parent */
+static int span_test_check(struct unit_test_state *uts, const char *json,
+			   const char *name, char ph, int id, int parent)
+{
+	char event[40], args[40];
+	const char *ptr, *end;
+
+	snprintf(event, sizeof(event), "\"name\":\"%s\",\"ph\":\"%c\"", name,
+		 ph);
+	snprintf(args, sizeof(args), "\"args\":{\"id\":%d,\"parent\":%d}", id,
+		 parent);
+	ptr = strstr(json, event);
+	ut_assertnonnull(ptr);
+	end = strchr(ptr, '\n');
+	ut_assertnonnull(end);
+	ptr = strstr(ptr, args);
+	ut_assert(ptr && ptr < end);
+
+	return 0;
+}
+
+/* Spans nest, ending a span ends those inside it and all can be ended */
+static int lib_test_bootstage_span(struct unit_test_state *uts)
+{
+	int outer, mid, inner, next, last;
+	char *json;
+
+	outer = bootstage_span_begin("ut_outer");
+	mid = bootstage_span_begin("ut_mid");
+	inner = bootstage_span_begin("ut_inner");
+	ut_assert(outer >= 0);
+	ut_asserteq(outer + 1, mid);
+	ut_asserteq(mid + 1, inner);
+
+	/* Leave the innermost open, as an error path might */
+	bootstage_span_end(mid);
+	next = bootstage_span_begin("ut_next");
+	last = bootstage_span_begin("ut_last");
+	ut_asserteq(inner + 1, next);
+	ut_asserteq(next + 1, last);
+
+	/* Ending a span twice changes nothing */
+	bootstage_span_end(mid);
+
+	json = span_test_export();
+	ut_assertnonnull(json);
+	ut_assertok(span_test_check(uts, json, "ut_mid", 'X', mid, outer));
+	ut_assertok(span_test_check(uts, json, "ut_inner", 'X', inner, mid));
+	ut_assertok(span_test_check(uts, json, "ut_next", 'B', next, outer));
+	ut_assertok(span_test_check(uts, json, "ut_last", 'B', last, next));
+	ut_assertnonnull(strstr(json, "\"name\":\"ut_outer\",\"ph\":\"B\""));
+	free(json);
+
+	bootstage_span_end_all();
+	json = span_test_export();
+	ut_assertnonnull(json);
+	ut_assertnull(strstr(json, "\"ph\":\"B\""));
+	ut_assertok(span_test_check(uts, json, "ut_next", 'X', next, outer));
+	ut_assertok(span_test_check(uts, json, "ut_last", 'X', last, next));
+	free(json);
+
+	/* A span begun now has no parent */
+	outer = bootstage_span_begin("ut_after");
+	ut_assert(outer >= 0);
+	bootstage_span_end(outer);
+	json = span_test_export();
+	ut_assertnonnull(json);
+	ut_assertok(span_test_check(uts, json, "ut_after", 'X', outer, -1));
+	free(json);
+
+	return 0;
+}
+LIB_TEST(lib_test_bootstage_span, 0);
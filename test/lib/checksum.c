@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the IP and UDP checksum functions
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <net.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+#define CSUM_TEST_SIZE		4096
+#define CSUM_OVERFLOW_SIZE	(256 << 10)
+#define CSUM_BENCH_LOOPS	4
+
+/* The plain 16-bit loop which compute_ip_checksum() used to be */
+static unsigned csum_ref(const void *vptr, unsigned nbytes)
+{
+	const u16 *ptr = vptr;
+	u64 sum = 0;
+	u16 oddbyte;
+
+	while (nbytes > 1) {
+		sum += *ptr++;
+		nbytes -= 2;
+	}
+	if (nbytes == 1) {
+		oddbyte = 0;
+		((u8 *)&oddbyte)[0] = *(u8 *)ptr;
+		sum += oddbyte;
+	}
+	while (sum >> 16)
+		sum = (sum >> 16) + (sum & 0xffff);
+
+	return ~sum & 0xffff;
+}
+
+/* The example from RFC 1071 */
+static int lib_test_checksum_check(struct unit_test_state *uts)
+{
+	static const u8 data[] __aligned(4) = {
+		0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7
+	};
+
+	ut_asserteq(0x220d, ntohs(compute_ip_checksum(data, sizeof(data))));
+	ut_asserteq(0x220d, ntohs(csum_ref(data, sizeof(data))));
+
+	return 0;
+}
+LIB_TEST(lib_test_checksum_check, 0);
+
+/* The checksum must match the 16-bit loop for any alignment/size */
+static int lib_test_checksum_sizes(struct unit_test_state *uts)
+{
+	uint offset, len;
+	u8 *buf;
+	int i;
+
+	buf = malloc(CSUM_TEST_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < CSUM_TEST_SIZE; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	for (offset = 0; offset < 16; offset += 2) {
+		for (len = 0; len < CSUM_TEST_SIZE - 16;
+		     len += len < 64 ? 1 : 61)
+			ut_asserteq(csum_ref(buf + offset, len),
+				    compute_ip_checksum(buf + offset, len));
+	}
+
+	/* A buffer of 0xff bytes large enough to overflow a 32-bit sum */
+	free(buf);
+	buf = malloc(CSUM_OVERFLOW_SIZE);
+	ut_assertnonnull(buf);
+	memset(buf, 0xff, CSUM_OVERFLOW_SIZE);
+	ut_asserteq(0, compute_ip_checksum(buf, CSUM_OVERFLOW_SIZE));
+	buf[0] = 0xfe;
+	ut_asserteq(csum_ref(buf, CSUM_OVERFLOW_SIZE),
+		    compute_ip_checksum(buf, CSUM_OVERFLOW_SIZE));
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_checksum_sizes, 0);
+
+/* A UDP checksum filled in by compute_udp_checksum() must verify */
+static int lib_test_checksum_udp(struct unit_test_state *uts)
+{
+	u8 pkt[IP_UDP_HDR_SIZE + 64] __aligned(4);
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)pkt;
+	unsigned sum;
+	int len;
+
+	for (len = 0; len < 64; len += 7) {
+		memset(pkt, '\0', sizeof(pkt));
+		ip->ip_src = string_to_ip("192.168.1.1");
+		ip->ip_dst = string_to_ip("192.168.1.2");
+		ip->ip_p = IPPROTO_UDP;
+		ip->udp_src = htons(1069);
+		ip->udp_dst = htons(69);
+		ip->udp_len = htons(UDP_HDR_SIZE + len);
+		memset(pkt + IP_UDP_HDR_SIZE, len, len);
+
+		sum = compute_udp_checksum(ip);
+		ip->udp_xsum = sum ? sum : 0xffff;
+		ut_asserteq(0, compute_udp_checksum(ip));
+
+		/* Corrupting a byte of the pseudo header or data is caught */
+		pkt[15] ^= 0x10;
+		ut_assert(compute_udp_checksum(ip) != 0);
+		pkt[15] ^= 0x10;
+		if (len) {
+			pkt[IP_UDP_HDR_SIZE + len - 1] ^= 0x01;
+			ut_assert(compute_udp_checksum(ip) != 0);
+		}
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_checksum_udp, 0);
+
+/* Show the throughput of the checksum against the 16-bit loop */
+static int lib_test_checksum_bench(struct unit_test_state *uts)
+{
+	unsigned sum = 0, ref = 0;
+	ulong start, size;
+	char extra[16];
+	u8 *buf;
+	int i;
+
+	buf = lib_bench_alloc(&size, 0xa5);
+	if (!buf)
+		return 0;
+
+	start = timer_get_us();
+	for (i = 0; i < CSUM_BENCH_LOOPS; i++)
+		ref = csum_ref(buf, size);
+	snprintf(extra, sizeof(extra), "  sum %04x", ref);
+	lib_bench_show("16-bit", start, size * CSUM_BENCH_LOOPS, extra);
+
+	start = timer_get_us();
+	for (i = 0; i < CSUM_BENCH_LOOPS; i++)
+		sum = compute_ip_checksum(buf, size);
+	snprintf(extra, sizeof(extra), "  sum %04x", sum);
+	lib_bench_show("wide", start, size * CSUM_BENCH_LOOPS, extra);
+	free(buf);
+	ut_asserteq(ref, sum);
+
+	return 0;
+}
+LIB_TEST(lib_test_checksum_bench, 0);
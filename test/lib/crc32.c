@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the crc32() implementations
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+#define CRC32_TEST_SIZE		4096
+#define CRC32_BENCH_LOOPS	4
+
+/* The standard check value for CRC-32 */
+static int lib_test_crc32_check(struct unit_test_state *uts)
+{
+	const unsigned char *check = (const unsigned char *)"123456789";
+	enum crc32_impl impl;
+
+	ut_asserteq(0xcbf43926, crc32(0, check, 9));
+	for (impl = 0; impl < CRC32_IMPL_COUNT; impl++) {
+		if (!crc32_impl_name(impl))
+			continue;
+		ut_asserteq(0xcbf43926, crc32_with_impl(impl, 0, check, 9));
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_check, 0);
+
+/* Each implementation must match the byte-wise one for any alignment/size */
+static int lib_test_crc32_impls(struct unit_test_state *uts)
+{
+	unsigned char *buf;
+	enum crc32_impl impl;
+	uint offset, len;
+	u32 expect;
+	int i;
+
+	buf = malloc(CRC32_TEST_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < CRC32_TEST_SIZE; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	for (offset = 0; offset < 16; offset++) {
+		for (len = 0; len < CRC32_TEST_SIZE - 16;
+		     len += len < 64 ? 1 : 61) {
+			expect = crc32_with_impl(CRC32_IMPL_BYTE, 0x1234,
+						 buf + offset, len);
+			ut_asserteq(expect, crc32(0x1234, buf + offset, len));
+			for (impl = 0; impl < CRC32_IMPL_COUNT; impl++) {
+				if (!crc32_impl_name(impl))
+					continue;
+				ut_asserteq(expect,
+					    crc32_with_impl(impl, 0x1234,
+							    buf + offset, len));
+			}
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_impls, 0);
+
+/* Show the throughput of each implementation */
+static int lib_test_crc32_bench(struct unit_test_state *uts)
+{
+	enum crc32_impl impl;
+	unsigned char *buf;
+	ulong start, size;
+	const char *name;
+	char extra[16];
+	u32 crc;
+	int i;
+
+	buf = lib_bench_alloc(&size, 0xa5);
+	if (!buf)
+		return 0;
+
+	for (impl = 0; impl < CRC32_IMPL_COUNT; impl++) {
+		name = crc32_impl_name(impl);
+		if (!name)
+			continue;
+		crc = 0;
+		start = timer_get_us();
+		for (i = 0; i < CRC32_BENCH_LOOPS; i++)
+			crc = crc32_with_impl(impl, crc, buf, size);
+		snprintf(extra, sizeof(extra), "  crc %08x", crc);
+		lib_bench_show(name, start, size * CRC32_BENCH_LOOPS, extra);
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_bench, 0);
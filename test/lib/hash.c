@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the hash backends
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <malloc.h>
+#include <u-boot/sha256.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+#define HASH_TEST_SIZE		4096
+
+/* SHA-256 of "abc" */
+static const u8 sha256_abc[SHA256_SUM_LEN] = {
+	0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+	0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+	0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+	0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+};
+
+static void sha256_with_backend(const struct hash_backend *backend,
+				const u8 *data, uint len, u8 *digest)
+{
+	sha256_context ctx;
+
+	sha256_starts(&ctx);
+	ctx.blocks = backend->blocks;
+	sha256_update(&ctx, data, len);
+	sha256_finish(&ctx, digest);
+}
+
+/* Every available SHA-256 backend must give the same results */
+static int lib_test_hash_sha256_backends(struct unit_test_state *uts)
+{
+	const struct hash_backend *start, *backend;
+	u8 expect[SHA256_SUM_LEN], digest[SHA256_SUM_LEN];
+	int n_ents, i, len, found = 0;
+	u8 *buf;
+
+	ut_assertnonnull(hash_backend_get("sha256"));
+	ut_assertnull(hash_backend_get("nonexistent"));
+
+	buf = malloc(HASH_TEST_SIZE + 1);
+	ut_assertnonnull(buf);
+	for (i = 0; i < HASH_TEST_SIZE + 1; i++)
+		buf[i] = i * 13 + (i >> 7);
+
+	start = ll_entry_start(struct hash_backend, hash_backend);
+	n_ents = ll_entry_count(struct hash_backend, hash_backend);
+	for (backend = start; backend != start + n_ents; backend++) {
+		if (strcmp(backend->algo, "sha256") ||
+		    !hash_backend_available(backend))
+			continue;
+		found++;
+
+		sha256_with_backend(backend, (const u8 *)"abc", 3, digest);
+		ut_assertok(memcmp(sha256_abc, digest, SHA256_SUM_LEN));
+
+		/* Use an odd offset to check unaligned input */
+		for (len = 0; len < HASH_TEST_SIZE; len += len < 200 ? 1 : 97) {
+			sha256_csum_wd(buf + 1, len, expect, CHUNKSZ_SHA256);
+			sha256_with_backend(backend, buf + 1, len, digest);
+			ut_assertok(memcmp(expect, digest, SHA256_SUM_LEN));
+		}
+	}
+	ut_assert(found > 0);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_sha256_backends, 0);
+
+/* hash_block() must use the preferred backend and give the right answer */
+static int lib_test_hash_block(struct unit_test_state *uts)
+{
+	u8 digest[SHA256_SUM_LEN];
+	int size = sizeof(digest);
+
+	ut_assertok(hash_block("sha256", "abc", 3, digest, &size));
+	ut_asserteq(SHA256_SUM_LEN, size);
+	ut_assertok(memcmp(sha256_abc, digest, SHA256_SUM_LEN));
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_block, 0);
+
+/* Show the throughput of each backend */
+static int lib_test_hash_bench(struct unit_test_state *uts)
+{
+	const struct hash_backend *start, *backend;
+	u8 digest[SHA256_SUM_LEN];
+	ulong begin, size;
+	char name[32];
+	int n_ents;
+	u8 *buf;
+
+	buf = lib_bench_alloc(&size, 0x5a);
+	if (!buf)
+		return 0;
+
+	start = ll_entry_start(struct hash_backend, hash_backend);
+	n_ents = ll_entry_count(struct hash_backend, hash_backend);
+	for (backend = start; backend != start + n_ents; backend++) {
+		if (!hash_backend_available(backend) ||
+		    strcmp(backend->algo, "sha256"))
+			continue;
+		snprintf(name, sizeof(name), "%s %s", backend->algo,
+			 backend->name);
+		begin = timer_get_us();
+		sha256_with_backend(backend, buf, size, digest);
+		lib_bench_show(name, begin, size,
+			       backend == hash_backend_get(backend->algo) ?
+			       "  (selected)" : "");
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_bench, 0);
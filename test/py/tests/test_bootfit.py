@@ -0,0 +1,134 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Check that bootfit streams a compressed kernel from a file in a FIT with
+# external data, decompressing it straight to its load address
+
+import gzip
+import os
+import pytest
+import u_boot_utils as util
+
+# The kernel has a hash node of each kind which can be checked as it streams
+base_its = '''
+/dts-v1/;
+
+/ {
+        description = "bootfit test image";
+        #address-cells = <1>;
+
+        images {
+                kernel {
+                        data = /incbin/("%(kernel)s");
+                        type = "kernel";
+                        arch = "sandbox";
+                        os = "linux";
+                        compression = "%(comp)s";
+                        load = <0x100000>;
+                        entry = <0x100000>;
+                        hash-1 {
+                                algo = "crc32";
+                        };
+                        hash-2 {
+                                algo = "sha1";
+                        };
+                };
+        };
+        configurations {
+                default = "conf";
+                conf {
+                        kernel = "kernel";
+                };
+        };
+};
+'''
+
+# Keep the FIT well away from the kernel, so the two do not overlap
+fit_addr = 0x1000000
+kernel_addr = 0x100000
+
+def make_fname(cons, leaf):
+    """Make a temporary filename
+
+    Args:
+        cons: U-Boot console
+        leaf: Leaf name of file to create (within temporary directory)
+    Return:
+        Temporary filename
+    """
+    return os.path.join(cons.config.build_dir, leaf)
+
+def make_kernel_data():
+    """Make a kernel which compresses to several stream buffers' worth
+
+    Returns:
+        Kernel contents as bytes
+    """
+    data = ''
+    seed = 1
+    for i in range(20000):
+        seed = (seed * 1103515245 + 12345) & 0x7fffffff
+        data += 'line %d of a kernel which does not boot %x\n' % (i, seed)
+    return data.encode('ascii')
+
+def run_bootfit(cons, comp, compress):
+    """Stream a kernel from a FIT on the host and check what was loaded
+
+    Args:
+        cons: U-Boot console
+        comp: FIT compression type of the kernel
+        compress: Function which compresses a file, given its name and the
+            name of the output file
+    """
+    kernel = make_fname(cons, 'bootfit-kernel')
+    kernel_comp = make_fname(cons, 'bootfit-kernel.' + comp)
+    its = make_fname(cons, 'bootfit.its')
+    fit = make_fname(cons, 'bootfit.fit')
+    kernel_out = make_fname(cons, 'bootfit-kernel.out')
+
+    data = make_kernel_data()
+    with open(kernel, 'wb') as fd:
+        fd.write(data)
+    compress(kernel, kernel_comp)
+    with open(its, 'w') as fd:
+        fd.write(base_its % {'kernel': kernel_comp, 'comp': comp})
+    mkimage = cons.config.build_dir + '/tools/mkimage'
+    util.run_and_log(cons, [mkimage, '-E', '-f', its, fit])
+    if os.path.exists(kernel_out):
+        os.remove(kernel_out)
+
+    cons.run_command('setenv loadaddr %x' % fit_addr)
+    cons.run_command('setenv verify y')
+    output = cons.run_command('bootfit hostfs 0 %s' % fit)
+    assert "Streaming 'kernel' kernel" in output
+    assert 'crc32+ sha1+ OK' in output
+    assert 'Kernel already loaded from stream' in output
+    assert 'Transferring control to Linux' in output
+    cons.run_command('sb save hostfs 0 %x %s %x' % (kernel_addr, kernel_out,
+                                                    len(data)))
+    with open(kernel_out, 'rb') as fd:
+        assert fd.read() == data
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_bootfit')
+@pytest.mark.requiredtool('dtc')
+def test_bootfit_gzip(u_boot_console):
+    """Test streaming a gzip-compressed kernel"""
+    def compress(fname, out):
+        with open(fname, 'rb') as inf, gzip.open(out, 'wb') as outf:
+            outf.write(inf.read())
+
+    run_bootfit(u_boot_console, 'gzip', compress)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_bootfit')
+@pytest.mark.buildconfigspec('lz4')
+@pytest.mark.requiredtool('dtc')
+@pytest.mark.requiredtool('lz4')
+def test_bootfit_lz4(u_boot_console):
+    """Test streaming an LZ4-compressed kernel"""
+    cons = u_boot_console
+
+    def compress(fname, out):
+        util.run_and_log(cons, ['lz4', '-f', '-9', fname, out])
+
+    run_bootfit(cons, 'lz4', compress)
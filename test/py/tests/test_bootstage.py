@@ -0,0 +1,40 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+"""
+This tests the trace-event export of bootstage, using the 'bootstage json'
+command.
+"""
+
+import json
+import pytest
+import u_boot_utils
+
+@pytest.mark.buildconfigspec('cmd_bootstage')
+def test_bootstage_json(u_boot_console):
+    """Test that the bootstage JSON export is valid and has the marks"""
+    cons = u_boot_console
+    output = cons.run_command('bootstage json')
+    trace = json.loads(output)
+    events = trace['traceEvents']
+    marks = [event['name'] for event in events if event['ph'] == 'i']
+    assert 'reset' in marks
+    assert 'board_init_f' in marks
+    assert 'main_loop' in marks
+
+    spans = [event for event in events if event['ph'] in 'XB']
+    for i, span in enumerate(spans):
+        assert span['args']['id'] == i
+        assert span['args']['parent'] < i
+    if cons.config.buildconfig.get('config_bootstage_initcall'):
+        assert [span for span in spans if span['name'].startswith('initcall')]
+
+@pytest.mark.buildconfigspec('cmd_bootstage')
+def test_bootstage_json_mem(u_boot_console):
+    """Test writing the bootstage JSON export to memory"""
+    cons = u_boot_console
+    addr = '%x' % u_boot_utils.find_ram_base(cons)
+    output = cons.run_command('bootstage json %s 10' % addr)
+    assert 'Not enough space' in output
+    output = cons.run_command('bootstage json %s 100000; echo $filesize' %
+                              addr)
+    assert int(output, 16) > 10
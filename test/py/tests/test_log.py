@@ -124,3 +124,17 @@ def test_log_format(u_boot_console):
         run_with_format('FLfm', 'file.c:123-func() msg')
         run_with_format('lm', 'NOTICE. msg')
         run_with_format('m', 'msg')
+
+@pytest.mark.buildconfigspec('log_ring')
+def test_log_dump(u_boot_console):
+    """Test that 'log dump' shows records kept in the ring buffer"""
+    cons = u_boot_console
+    cons.run_command('log format m')
+    output = cons.run_command('log rec arch notice file.c 123 func ring-msg')
+    assert output == 'ring-msg'
+    output = cons.run_command('log dump')
+    lines = output.splitlines()
+    assert lines
+    assert lines[-1].startswith('[')
+    assert lines[-1].endswith('] ring-msg')
+    cons.run_command('log format default')
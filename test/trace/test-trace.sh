@@ -54,11 +54,46 @@ check_results() {
 	fi
 }
 
+# Run with the given trace mode and save the 'trace agg' output to ${prof}
+run_trace_mode() {
+	echo "Run trace in $1 mode"
+	./${OUTPUT_DIR}/u-boot <<END
+trace mode $1 $2
+hash sha256 1000000 1000000
+trace agg 0 e00000
+sb save host 0 ${prof} 0 \${profoffset}
+reset
+END
+}
+
+# Check that proftool's output for the given command shows the hashing
+check_proftool() {
+	echo "Check proftool $1"
+
+	./${OUTPUT_DIR}/tools/proftool -m ${OUTPUT_DIR}/System.map \
+		-p ${prof} $1 >${tmp} || fail "proftool $1 error"
+	if ! grep -q sha256_update ${tmp}; then
+		fail "proftool $1 output error"
+	fi
+}
+
 echo "Simple trace test / sanity check using sandbox"
 echo
 tmp="$(tempfile)"
+prof="$(tempfile)"
 build_uboot "${TRACE_OPT}"
 run_trace >${tmp}
 check_results ${tmp}
-rm ${tmp}
+
+# The aggregate stats list each function with its call count
+run_trace_mode agg >${tmp}
+check_proftool dump-stats
+
+# Each folded stack ends with its number of samples
+run_trace_mode sample 100 >${tmp}
+check_proftool dump-folded
+if grep -qv ' [0-9][0-9]*$' ${tmp}; then
+	fail "folded output error"
+fi
+rm ${tmp} ${prof}
 echo "Test passed"
@@ -0,0 +1,177 @@
+#!/usr/bin/env python
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Convert bootstage timings into the Chrome trace-event format
+#
+# The output can be loaded into chrome://tracing or https://ui.perfetto.dev
+# to see the boot timeline, with nested spans shown as a flame chart.
+#
+# The input is either:
+#    - the output of the 'bootstage json' command, saved to a file or
+#      captured from the console log
+#    - a bootstage device-tree node as seen by Linux, e.g.
+#      /proc/device-tree/bootstage (see CONFIG_BOOTSTAGE_FDT)
+#
+# Spans recorded with CONFIG_BOOTSTAGE_INITCALL are named after the address of
+# the init function. Pass U-Boot's System.map with -m to show function names
+# instead.
+
+from __future__ import print_function
+
+import bisect
+import json
+from optparse import OptionParser
+import os
+import re
+import struct
+import sys
+
+RE_INITCALL = re.compile(r'^initcall (0x[0-9a-f]+)$')
+
+def ReadJson(fname):
+    """Read the output of the 'bootstage json' command
+
+    Any console output before or after the JSON is ignored.
+
+    Args:
+        fname: Filename to read
+
+    Returns:
+        Dict containing the trace
+    """
+    with open(fname) as fd:
+        data = fd.read()
+    start = data.find('{"displayTimeUnit"')
+    end = data.rfind('}}')
+    if start == -1 or end == -1:
+        raise ValueError("No bootstage JSON found in '%s'" % fname)
+    return json.loads(data[start:end + 2])
+
+def ReadProp(node, name):
+    """Read a property from a device-tree node directory
+
+    Args:
+        node: Path to node directory
+        name: Property name
+
+    Returns:
+        Property contents as bytes, or None if not present
+    """
+    fname = os.path.join(node, name)
+    if not os.path.exists(fname):
+        return None
+    with open(fname, 'rb') as fd:
+        return fd.read()
+
+def PropCells(data):
+    """Convert a property value into a list of 32-bit cells"""
+    return list(struct.unpack('>%dI' % (len(data) // 4), data))
+
+def PropStrings(data):
+    """Convert a property value into a list of strings"""
+    return data.decode('utf-8').rstrip('\0').split('\0')
+
+def Event(ph, name, ts, **kwargs):
+    """Create a trace event on the U-Boot track"""
+    event = {'name': name, 'ph': ph, 'ts': ts, 'pid': 0, 'tid': 0}
+    event.update(kwargs)
+    return event
+
+def ReadDeviceTree(node):
+    """Read the bootstage node which U-Boot adds to the OS device tree
+
+    Args:
+        node: Path to bootstage node directory
+
+    Returns:
+        Dict containing the trace
+    """
+    events = [Event('M', 'thread_name', 0, args={'name': 'U-Boot'})]
+    accum = {}
+    for subnode in sorted(os.listdir(node)):
+        path = os.path.join(node, subnode)
+        if subnode == 'spans' or not os.path.isdir(path):
+            continue
+        name = PropStrings(ReadProp(path, 'name'))[0]
+        mark = ReadProp(path, 'mark')
+        if mark is not None:
+            events.append(Event('i', name, PropCells(mark)[0], s='p'))
+        else:
+            accum[name] = PropCells(ReadProp(path, 'accum'))[0]
+
+    spans = os.path.join(node, 'spans')
+    if os.path.isdir(spans):
+        names = PropStrings(ReadProp(spans, 'name'))
+        starts = PropCells(ReadProp(spans, 'start'))
+        ends = PropCells(ReadProp(spans, 'end'))
+        parents = PropCells(ReadProp(spans, 'parent'))
+        for i, name in enumerate(names):
+            parent = parents[i] if parents[i] != 0xffffffff else -1
+            args = {'id': i, 'parent': parent}
+            if ends[i]:
+                events.append(Event('X', name, starts[i],
+                                    dur=ends[i] - starts[i], args=args))
+            else:
+                events.append(Event('B', name, starts[i], args=args))
+
+    return {'displayTimeUnit': 'ms', 'traceEvents': events,
+            'otherData': accum}
+
+def ReadSystemMap(fname):
+    """Read the function symbols from a System.map file
+
+    Args:
+        fname: Filename to read
+
+    Returns:
+        Tuple:
+            Sorted list of symbol addresses
+            List of symbol names, in the same order
+    """
+    syms = []
+    with open(fname) as fd:
+        for line in fd:
+            parts = line.split()
+            if len(parts) == 3 and parts[1] in 'tTwW':
+                syms.append((int(parts[0], 16), parts[2]))
+    syms.sort()
+    return [addr for addr, _ in syms], [name for _, name in syms]
+
+def ResolveNames(trace, addrs, names):
+    """Replace the addresses of init functions with their names"""
+    for event in trace['traceEvents']:
+        m = RE_INITCALL.match(event['name'])
+        if not m:
+            continue
+        addr = int(m.group(1), 16)
+        pos = bisect.bisect_right(addrs, addr) - 1
+        if pos >= 0:
+            event['name'] = names[pos]
+            event.setdefault('args', {})['addr'] = m.group(1)
+
+def main():
+    parser = OptionParser(usage='%prog [options] <bootstage.json | dt-node>')
+    parser.add_option('-m', '--map', type='string',
+                      help='System.map file to resolve init function names')
+    parser.add_option('-o', '--output', type='string',
+                      help='Output file (default: stdout)')
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error('Please provide an input file or device-tree node')
+
+    if os.path.isdir(args[0]):
+        trace = ReadDeviceTree(args[0])
+    else:
+        trace = ReadJson(args[0])
+    if options.map:
+        ResolveNames(trace, *ReadSystemMap(options.map))
+
+    out = open(options.output, 'w') if options.output else sys.stdout
+    json.dump(trace, out, indent=1, sort_keys=True)
+    out.write('\n')
+    if options.output:
+        out.close()
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -55,6 +55,10 @@ struct func_info *func_list;
 int func_count;
 struct trace_call *call_list;
 int call_count;
+struct trace_func_stats *stats_list;
+int stats_count;
+struct trace_sample *sample_list;
+int sample_count;
 int verbose;	/* Verbosity level 0=none, 1=warn, 2=notice, 3=info, 4=debug */
 unsigned long text_offset;		/* text address of first function */
 
@@ -85,6 +89,8 @@ static void usage(void)
 		"\n"
 		"Commands\n"
 		"   dump-ftrace\t\tDump out textual data in ftrace format\n"
+		"   dump-stats\t\tDump out per-function time and call depths\n"
+		"   dump-folded\t\tDump out call stacks in folded format\n"
 		"\n"
 		"Options:\n"
 		"   -m <map>\tSpecify Systen.map file\n"
@@ -226,6 +232,32 @@ static int read_calls(FILE *fin, int count)
 	return 0;
 }
 
+static int read_stats(FILE *fin, int count)
+{
+	notice("stats count: %d\n", count);
+	stats_list = calloc(count, sizeof(*stats_list));
+	if (!stats_list) {
+		error("Cannot allocate stats_list\n");
+		return -1;
+	}
+	stats_count = count;
+
+	return read_data(fin, stats_list, count * sizeof(*stats_list));
+}
+
+static int read_samples(FILE *fin, int count)
+{
+	notice("sample count: %d\n", count);
+	sample_list = calloc(count, sizeof(*sample_list));
+	if (!sample_list) {
+		error("Cannot allocate sample_list\n");
+		return -1;
+	}
+	sample_count = count;
+
+	return read_data(fin, sample_list, count * sizeof(*sample_list));
+}
+
 static int read_profile(FILE *fin, int *not_found)
 {
 	struct trace_output_hdr hdr;
@@ -243,12 +275,25 @@ static int read_profile(FILE *fin, int *not_found)
 		switch (hdr.type) {
 		case TRACE_CHUNK_FUNCS:
 			/* Ignored at present */
+			if (fseek(fin, hdr.rec_count *
+				  sizeof(struct trace_output_func), SEEK_CUR))
+				return 1;
 			break;
 
 		case TRACE_CHUNK_CALLS:
 			if (read_calls(fin, hdr.rec_count))
 				return 1;
 			break;
+
+		case TRACE_CHUNK_STATS:
+			if (read_stats(fin, hdr.rec_count))
+				return 1;
+			break;
+
+		case TRACE_CHUNK_SAMPLES:
+			if (read_samples(fin, hdr.rec_count))
+				return 1;
+			break;
 		}
 	}
 	return 0;
@@ -532,6 +577,198 @@ static int make_ftrace(void)
 	return 0;
 }
 
+static int h_cmp_stats_excl(const void *v1, const void *v2)
+{
+	const struct trace_func_stats *s1 = v1, *s2 = v2;
+
+	if (s1->excl_us != s2->excl_us)
+		return s1->excl_us < s2->excl_us ? 1 : -1;
+
+	return s1->calls < s2->calls ? 1 : s1->calls > s2->calls ? -1 : 0;
+}
+
+static const char *func_name(uint32_t offset, char *buf, int size)
+{
+	struct func_info *func = find_func_by_offset(offset);
+
+	if (func)
+		return func->name;
+	snprintf(buf, size, "%x", offset);
+
+	return buf;
+}
+
+/*
+ * Write a table of the functions, most exclusive time first:
+ *
+ *    excl_us    incl_us    calls  function  [call depth histogram]
+ */
+static int make_stats(void)
+{
+	struct trace_func_stats *stats;
+	char buf[20];
+	int i, d;
+
+	qsort(stats_list, stats_count, sizeof(*stats_list), h_cmp_stats_excl);
+	printf("%12s %12s %10s  %s\n", "excl_us", "incl_us", "calls",
+	       "function  [depth:calls ...]");
+	for (i = 0, stats = stats_list; i < stats_count; i++, stats++) {
+		struct func_info *func = find_func_by_offset(stats->func);
+
+		if (func && !(func->flags & FUNCF_TRACE))
+			continue;
+		printf("%12llu %12llu %10u  %s ",
+		       (unsigned long long)stats->excl_us,
+		       (unsigned long long)stats->incl_us, stats->calls,
+		       func_name(stats->func, buf, sizeof(buf)));
+		putchar('[');
+		for (d = 0; d < TRACE_DEPTH_BUCKETS; d++) {
+			if (stats->depth_hist[d])
+				printf(" %d%s:%u", d,
+				       d == TRACE_DEPTH_BUCKETS - 1 ? "+" : "",
+				       stats->depth_hist[d]);
+		}
+		printf(" ]\n");
+	}
+
+	return 0;
+}
+
+/* A call stack in folded format and its weight */
+struct folded_stack {
+	char *stack;
+	unsigned long count;
+};
+
+static struct folded_stack *folded_list;
+static int folded_count, folded_alloced;
+
+static void add_folded(const uint32_t *funcs, int depth, int truncated,
+		       unsigned long count)
+{
+	struct folded_stack *item;
+	char buf[20], *str;
+	size_t len = 1;
+	int i;
+
+	if (!count)
+		return;
+	for (i = 0; i < depth; i++)
+		len += strlen(func_name(funcs[i], buf, sizeof(buf))) + 1;
+	str = malloc(len + 4);
+	assert(str);
+	strcpy(str, truncated ? "...;" : "");
+	for (i = 0; i < depth; i++) {
+		if (i)
+			strcat(str, ";");
+		strcat(str, func_name(funcs[i], buf, sizeof(buf)));
+	}
+
+	if (folded_count == folded_alloced) {
+		folded_alloced += 256;
+		folded_list = realloc(folded_list,
+				      sizeof(*folded_list) * folded_alloced);
+		assert(folded_list);
+	}
+	item = &folded_list[folded_count++];
+	item->stack = str;
+	item->count = count;
+}
+
+static int h_cmp_folded(const void *v1, const void *v2)
+{
+	const struct folded_stack *f1 = v1, *f2 = v2;
+
+	return strcmp(f1->stack, f2->stack);
+}
+
+/*
+ * Build stacks from the call trace, weighted by the time spent in each. As
+ * with samples, only the innermost TRACE_SAMPLE_DEPTH functions are kept.
+ */
+static void folded_from_calls(void)
+{
+	uint32_t *stack = NULL;
+	struct trace_call *call;
+	unsigned long last = 0, now;
+	int depth = 0, max_depth = 0, missing = 0;
+	int i, base;
+
+	for (i = 0, call = call_list; i < call_count; i++, call++) {
+		if (TRACE_CALL_TYPE(call) != FUNCF_ENTRY &&
+		    TRACE_CALL_TYPE(call) != FUNCF_EXIT)
+			continue;
+
+		/* Charge the time since the last event to the current stack */
+		now = call->flags & FUNCF_TIMESTAMP_MASK;
+		if (depth) {
+			base = MAX(depth - TRACE_SAMPLE_DEPTH, 0);
+			add_folded(stack + base, depth - base, base != 0,
+				   (now - last) & FUNCF_TIMESTAMP_MASK);
+		}
+		last = now;
+
+		if (TRACE_CALL_TYPE(call) == FUNCF_ENTRY) {
+			/* Keep the whole stack, so outer frames come back */
+			if (depth == max_depth) {
+				max_depth += 64;
+				stack = realloc(stack,
+						sizeof(*stack) * max_depth);
+				assert(stack);
+			}
+			stack[depth++] = call->func;
+		} else if (depth) {
+			depth--;
+		} else {
+			missing++;
+		}
+	}
+	free(stack);
+	if (missing)
+		warn("%d function exits without an entry\n", missing);
+}
+
+/*
+ * Write call stacks in the folded format used by flame-graph tools, one
+ * line per stack with its weight:
+ *
+ *    board_init_r;initr_dm;dm_init 1234
+ *
+ * With samples the weight is the number of samples, otherwise it is the
+ * time in microseconds taken from the call trace.
+ */
+static int make_folded(void)
+{
+	struct trace_sample *sample;
+	int i, depth;
+
+	if (sample_count) {
+		for (i = 0, sample = sample_list; i < sample_count;
+		     i++, sample++) {
+			depth = MIN(sample->depth, TRACE_SAMPLE_DEPTH);
+			add_folded(sample->stack, depth,
+				   sample->depth > TRACE_SAMPLE_DEPTH,
+				   sample->count);
+		}
+	} else {
+		folded_from_calls();
+	}
+
+	qsort(folded_list, folded_count, sizeof(*folded_list), h_cmp_folded);
+	for (i = 0; i < folded_count; i++) {
+		struct folded_stack *item = &folded_list[i];
+
+		/* Merge identical stacks */
+		while (i + 1 < folded_count &&
+		       !strcmp(item->stack, folded_list[i + 1].stack))
+			item->count += folded_list[++i].count;
+		if (*item->stack)
+			printf("%s %lu\n", item->stack, item->count);
+	}
+
+	return 0;
+}
+
 static int prof_tool(int argc, char * const argv[],
 		     const char *prof_fname, const char *map_fname,
 		     const char *trace_config_fname)
@@ -552,6 +789,10 @@ static int prof_tool(int argc, char * const argv[],
 
 		if (0 == strcmp(cmd, "dump-ftrace"))
 			err = make_ftrace();
+		else if (0 == strcmp(cmd, "dump-stats"))
+			err = make_stats();
+		else if (0 == strcmp(cmd, "dump-folded"))
+			err = make_folded();
 		else
 			warn("Unknown command '%s'\n", cmd);
 	}